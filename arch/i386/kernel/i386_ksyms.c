@@ -106,6 +106,10 @@ EXPORT_SYMBOL(clear_user);
 EXPORT_SYMBOL(__clear_user);
 EXPORT_SYMBOL(__generic_copy_from_user);
 EXPORT_SYMBOL(__generic_copy_to_user);
+EXPORT_SYMBOL(__sse2_copy_from_user);
+EXPORT_SYMBOL(__sse2_copy_to_user);
+EXPORT_SYMBOL(_sse2_memcpy);
+EXPORT_SYMBOL(sse2_copy_threshold);
 EXPORT_SYMBOL(strnlen_user);
 
 EXPORT_SYMBOL(pci_alloc_consistent);
@@ -388,9 +388,12 @@ int pci_mmap_page_range(struct pci_dev *dev, struct vm_area_struct *vma,
 		prot |= _PAGE_PCD | _PAGE_PWT;
 	vma->vm_page_prot = __pgprot(prot);
 
-	/* Write-combine setting is ignored, it is changed via the mtrr
-	 * interfaces on this platform.
+	/* Write-combining goes through the PAT when we have one; without
+	 * it the mtrr interfaces are the only way to get it.
 	 */
+	if (write_combine && pat_wc_enabled)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
 	if (remap_page_range(vma->vm_start, vma->vm_pgoff << PAGE_SHIFT,
 			     vma->vm_end - vma->vm_start,
 			     vma->vm_page_prot))
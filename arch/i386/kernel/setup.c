@@ -3230,6 +3230,11 @@ void __init cpu_init (void)
 
 #undef CD
 
+	/*
+	 * Set up the page attribute table for write-combining:
+	 */
+	pat_init();
+
 	/*
 	 * Force FPU initialization:
 	 */
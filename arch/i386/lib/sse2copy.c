@@ -0,0 +1,285 @@
+/*
+ *	SSE2 streaming copies
+ *
+ *	memcpy() and the user copy routines normally go through rep movs,
+ *	which pulls the destination into the cache.  When a transfer is
+ *	larger than the cache, as when a big read() or write() streams
+ *	through the page cache, that just evicts everything else.  These
+ *	versions use prefetchnta on the source and movntdq on the
+ *	destination so the data bypasses the cache.
+ *
+ *	The XMM registers are borrowed through kernel_fpu_begin(), so none
+ *	of this may be used from interrupts.  A user copy must also not
+ *	sleep on a page fault while it holds them: with PF_NOFAULT set a
+ *	fault goes straight to the exception fixup, and the ordinary
+ *	rep movs copy takes over up to the end of that page.
+ *
+ *	At boot we time both ways of copying a buffer bigger than the L2
+ *	cache, and only switch the streaming copies on if they win.
+ */
+
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+
+#include <asm/i387.h>
+#include <asm/hardirq.h>
+#include <asm/uaccess.h>
+
+/*
+ * Transfers of at least this many bytes use the streaming copies.
+ * ~0 until the boot time calibration has run, or if it decided they
+ * don't pay off.
+ */
+unsigned long sse2_copy_threshold = ~0UL;
+
+static long sse2_copy_setup __initdata = -1;
+
+static int __init sse2_copy_param(char *str)
+{
+	sse2_copy_setup = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+__setup("sse2copy=", sse2_copy_param);
+
+/*
+ * Copy "blocks" 64 byte blocks, "to" must be 16 byte aligned.  Returns
+ * the number of blocks left when one of the accesses faulted.
+ */
+static inline unsigned long sse2_copy_blocks(void *to, const void *from,
+					     unsigned long blocks)
+{
+	int d0, d1;
+
+	__asm__ __volatile__(
+		"	testl %0,%0\n"
+		"	jz 3f\n"
+		"1:	prefetchnta 320(%2)\n"
+		"2:	movdqu (%2),%%xmm0\n"
+		"4:	movdqu 16(%2),%%xmm1\n"
+		"5:	movdqu 32(%2),%%xmm2\n"
+		"6:	movdqu 48(%2),%%xmm3\n"
+		"7:	movntdq %%xmm0,(%1)\n"
+		"8:	movntdq %%xmm1,16(%1)\n"
+		"9:	movntdq %%xmm2,32(%1)\n"
+		"10:	movntdq %%xmm3,48(%1)\n"
+		"	addl $64,%2\n"
+		"	addl $64,%1\n"
+		"	decl %0\n"
+		"	jnz 1b\n"
+		"3:	sfence\n"
+		".section __ex_table,\"a\"\n"
+		"	.align 4\n"
+		"	.long 2b,3b\n"
+		"	.long 4b,3b\n"
+		"	.long 5b,3b\n"
+		"	.long 6b,3b\n"
+		"	.long 7b,3b\n"
+		"	.long 8b,3b\n"
+		"	.long 9b,3b\n"
+		"	.long 10b,3b\n"
+		".previous"
+		: "=r" (blocks), "=&r" (d0), "=&r" (d1)
+		: "0" (blocks), "1" (to), "2" (from)
+		: "memory");
+	return blocks;
+}
+
+void *_sse2_memcpy(void *to, const void *from, size_t len)
+{
+	size_t head = -(unsigned long) to & 15;
+	size_t body;
+
+	if (in_interrupt() || len < head + 64)
+		return __memcpy(to, from, len);
+
+	body = (len - head) & ~63UL;
+	__memcpy(to, from, head);
+	kernel_fpu_begin();
+	sse2_copy_blocks(to + head, from + head, body >> 6);
+	kernel_fpu_end();
+	__memcpy(to + head + body, from + head + body, len - head - body);
+	return to;
+}
+
+/*
+ * Stream "n" bytes, a multiple of 64, of a user copy.  Returns the
+ * number of bytes not copied: non-zero if we stopped on a fault.
+ */
+static unsigned long sse2_copy_user_blocks(void *to, const void *from,
+					   unsigned long n)
+{
+	unsigned long left;
+
+	kernel_fpu_begin();
+	current->flags |= PF_NOFAULT;
+	left = sse2_copy_blocks(to, from, n >> 6);
+	current->flags &= ~PF_NOFAULT;
+	kernel_fpu_end();
+
+	return left << 6;
+}
+
+/*
+ * Both of these follow the __copy_to_user()/__copy_from_user()
+ * conventions: no access_ok() check, and the number of bytes that
+ * could not be copied is returned.  A faulting copy from user space
+ * zeroes the rest of the kernel buffer.
+ *
+ * The unaligned head, the tail and whatever page a streaming copy
+ * faulted on are done with the ordinary copy, which may sleep.
+ */
+unsigned long __sse2_copy_to_user(void *to, const void *from, unsigned long n)
+{
+	if (in_interrupt()) {
+		__copy_user(to, from, n);
+		return n;
+	}
+
+	while (n) {
+		unsigned long chunk = -(unsigned long) to & 15;
+		unsigned long left;
+
+		if (!chunk && n >= 64) {
+			left = sse2_copy_user_blocks(to, from, n & ~63UL);
+			chunk = (n & ~63UL) - left;
+			to += chunk;
+			from += chunk;
+			n -= chunk;
+			if (!left)
+				continue;
+			chunk = PAGE_SIZE - ((unsigned long) to & ~PAGE_MASK);
+		} else if (!chunk)
+			chunk = n;
+		if (chunk > n)
+			chunk = n;
+
+		left = chunk;
+		__copy_user(to, from, left);
+		if (left)
+			return n - chunk + left;
+		to += chunk;
+		from += chunk;
+		n -= chunk;
+	}
+	return 0;
+}
+
+unsigned long __sse2_copy_from_user(void *to, const void *from, unsigned long n)
+{
+	if (in_interrupt()) {
+		__copy_user_zeroing(to, from, n);
+		return n;
+	}
+
+	while (n) {
+		unsigned long chunk = -(unsigned long) to & 15;
+		unsigned long left;
+
+		if (!chunk && n >= 64) {
+			left = sse2_copy_user_blocks(to, from, n & ~63UL);
+			chunk = (n & ~63UL) - left;
+			to += chunk;
+			from += chunk;
+			n -= chunk;
+			if (!left)
+				continue;
+			chunk = PAGE_SIZE - ((unsigned long) from & ~PAGE_MASK);
+		} else if (!chunk)
+			chunk = n;
+		if (chunk > n)
+			chunk = n;
+
+		left = chunk;
+		__copy_user_zeroing(to, from, left);
+		if (left) {
+			memset(to + chunk, 0, n - chunk);
+			return n - chunk + left;
+		}
+		to += chunk;
+		from += chunk;
+		n -= chunk;
+	}
+	return 0;
+}
+
+/*
+ * Boot time calibration, in the style of calibrate_xor_block(): see
+ * how many times each routine can copy a buffer bigger than the L2
+ * cache within a jiffy.
+ */
+#define BENCH_ORDER	8
+#define BENCH_SIZE	(PAGE_SIZE << BENCH_ORDER)
+
+static void * __init rep_movs_copy(void *to, const void *from, size_t len)
+{
+	return __memcpy(to, from, len);
+}
+
+static int __init do_copy_speed(const char *name,
+	void *(*copy)(void *, const void *, size_t), void *b1, void *b2)
+{
+	int speed;
+	unsigned long now;
+	int i, count, max;
+
+	max = 0;
+	for (i = 0; i < 5; i++) {
+		now = jiffies;
+		count = 0;
+		while (jiffies == now) {
+			mb();
+			copy(b1, b2, BENCH_SIZE);
+			mb();
+			count++;
+			mb();
+		}
+		if (count > max)
+			max = count;
+	}
+
+	speed = max * (HZ * (BENCH_SIZE / 1024));
+	printk("   %-10s: %5d.%03d MB/sec\n", name, speed / 1000, speed % 1000);
+	return speed;
+}
+
+static int __init sse2_copy_init(void)
+{
+	void *b1, *b2;
+	int rep, sse2;
+
+	if (!cpu_has_fxsr || !cpu_has_xmm || !cpu_has_sse2 || !sse2_copy_setup)
+		return 0;
+
+	b1 = (void *) __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	b2 = (void *) __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	if (!b1 || !b2)
+		goto out;
+
+	printk(KERN_INFO "i386: measuring large copy speed\n");
+	rep = do_copy_speed("rep movs", rep_movs_copy, b1, b2);
+	sse2 = do_copy_speed("sse2", _sse2_memcpy, b1, b2);
+
+	if (sse2_copy_setup > 0)
+		sse2_copy_threshold = sse2_copy_setup;
+	else if (sse2 > rep) {
+		/* Anything bigger than the L2 cache would flush it anyway */
+		sse2_copy_threshold = 256 * 1024;
+		if (boot_cpu_data.x86_cache_size > 0)
+			sse2_copy_threshold = boot_cpu_data.x86_cache_size * 1024;
+	}
+	if (sse2_copy_threshold != ~0UL)
+		printk(KERN_INFO "i386: streaming copies from %lu bytes up\n",
+		       sse2_copy_threshold);
+out:
+	if (b1)
+		free_pages((unsigned long) b1, BENCH_ORDER);
+	if (b2)
+		free_pages((unsigned long) b2, BENCH_ORDER);
+	return 0;
+}
+
+__initcall(sse2_copy_init);
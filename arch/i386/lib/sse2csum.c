@@ -0,0 +1,384 @@
+/*
+ *	SSE2 checksumming
+ *
+ *	csum_partial() and csum_partial_copy_generic() add 32 bit words
+ *	with adcl, one at a time, and the carry chain makes that slow on
+ *	newer CPUs.  Here the words are widened to 64 bits and added two
+ *	at a time with paddq, so no carries are lost and there is nothing
+ *	to chain; the lanes are folded back at the end.
+ *
+ *	checksum.S jumps here for packets of csum_sse2_threshold bytes or
+ *	more.  We may be called from interrupts, so rather than using
+ *	kernel_fpu_begin() we save and restore the XMM registers we use,
+ *	just like the RAID5 xor code.  The unaligned head and the tail,
+ *	as well as anything odd, still go to the old routines.
+ *
+ *	Nothing is switched on until the boot time checks below have
+ *	compared both versions over all alignments and a range of lengths,
+ *	and measured which is faster.
+ */
+
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+
+#include <asm/uaccess.h>
+#include <net/checksum.h>
+
+/*
+ * Packets of at least this many bytes are checksummed here, see the
+ * entry points in checksum.S.  Off until sse2_csum_init() has run.
+ */
+int csum_sse2_threshold = 0x7fffffff;
+
+/* The old routines, behind the length check in checksum.S */
+asmlinkage unsigned int __csum_partial(const unsigned char *buff, int len,
+				       unsigned int sum);
+asmlinkage unsigned int __csum_partial_copy_generic(const char *src, char *dst,
+				int len, int sum, int *src_err_ptr, int *dst_err_ptr);
+
+#define XMMS_SAVE				\
+	__asm__ __volatile__ ( 			\
+		"movl %%cr0,%0		;\n\t"	\
+		"clts			;\n\t"	\
+		"movups %%xmm0,(%1)	;\n\t"	\
+		"movups %%xmm1,0x10(%1)	;\n\t"	\
+		"movups %%xmm2,0x20(%1)	;\n\t"	\
+		"movups %%xmm3,0x30(%1)	;\n\t"	\
+		: "=&r" (cr0)			\
+		: "r" (xmm_save) 		\
+		: "memory")
+
+#define XMMS_RESTORE				\
+	__asm__ __volatile__ ( 			\
+		"movups (%1),%%xmm0	;\n\t"	\
+		"movups 0x10(%1),%%xmm1	;\n\t"	\
+		"movups 0x20(%1),%%xmm2	;\n\t"	\
+		"movups 0x30(%1),%%xmm3	;\n\t"	\
+		"movl 	%0,%%cr0	;\n\t"	\
+		:				\
+		: "r" (cr0), "r" (xmm_save)	\
+		: "memory")
+
+/*
+ * Add the four words in %xmm2 into the two 64 bit lanes of %xmm0,
+ * %xmm1 is zero.
+ */
+#define ADD16					\
+	"	movdqa %%xmm2,%%xmm3		;\n"	\
+	"	punpckldq %%xmm1,%%xmm2		;\n"	\
+	"	punpckhdq %%xmm1,%%xmm3		;\n"	\
+	"	paddq %%xmm3,%%xmm2		;\n"	\
+	"	paddq %%xmm2,%%xmm0		;\n"
+
+static inline unsigned int csum_fold64(u64 sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return sum;
+}
+
+/*
+ * Checksum "blocks" 64 byte blocks at 16 byte aligned "buff".
+ */
+static unsigned int csum_sse2_blocks(const unsigned char *buff, int blocks)
+{
+	unsigned long cr0;
+	char xmm_save[16*4];
+	u64 lanes[2];
+	int d0, d1;
+
+	XMMS_SAVE;
+	__asm__ __volatile__(
+		"	pxor %%xmm0,%%xmm0		;\n"
+		"	pxor %%xmm1,%%xmm1		;\n"
+		"1:	prefetcht0 256(%1)		;\n"
+		"	movdqa (%1),%%xmm2		;\n"
+		ADD16
+		"	movdqa 16(%1),%%xmm2		;\n"
+		ADD16
+		"	movdqa 32(%1),%%xmm2		;\n"
+		ADD16
+		"	movdqa 48(%1),%%xmm2		;\n"
+		ADD16
+		"	addl $64,%1			;\n"
+		"	decl %0				;\n"
+		"	jnz 1b				;\n"
+		"	movdqu %%xmm0,(%4)		;\n"
+		: "=r" (d0), "=r" (d1)
+		: "0" (blocks), "1" (buff), "r" (lanes)
+		: "memory");
+	XMMS_RESTORE;
+
+	return csum_fold64(lanes[0] + lanes[1]);
+}
+
+/*
+ * The same while copying to "dst".  Returns the number of blocks left
+ * if a user access faulted, *sum is only valid when that is 0.
+ */
+static int csum_copy_sse2_blocks(const char *src, char *dst, int blocks,
+				 unsigned int *sum)
+{
+	unsigned long cr0;
+	char xmm_save[16*4];
+	u64 lanes[2];
+	int d0, d1;
+
+	XMMS_SAVE;
+	__asm__ __volatile__(
+		"	pxor %%xmm0,%%xmm0		;\n"
+		"	pxor %%xmm1,%%xmm1		;\n"
+		"	testl %0,%0			;\n"
+		"	jz 10f				;\n"
+		"1:	prefetcht0 256(%1)		;\n"
+		"2:	movdqa (%1),%%xmm2		;\n"
+		"3:	movdqu %%xmm2,(%2)		;\n"
+		ADD16
+		"4:	movdqa 16(%1),%%xmm2		;\n"
+		"5:	movdqu %%xmm2,16(%2)		;\n"
+		ADD16
+		"6:	movdqa 32(%1),%%xmm2		;\n"
+		"7:	movdqu %%xmm2,32(%2)		;\n"
+		ADD16
+		"8:	movdqa 48(%1),%%xmm2		;\n"
+		"9:	movdqu %%xmm2,48(%2)		;\n"
+		ADD16
+		"	addl $64,%1			;\n"
+		"	addl $64,%2			;\n"
+		"	decl %0				;\n"
+		"	jnz 1b				;\n"
+		"10:	movdqu %%xmm0,(%6)		;\n"
+		".section __ex_table,\"a\"\n"
+		"	.align 4\n"
+		"	.long 2b,10b\n"
+		"	.long 3b,10b\n"
+		"	.long 4b,10b\n"
+		"	.long 5b,10b\n"
+		"	.long 6b,10b\n"
+		"	.long 7b,10b\n"
+		"	.long 8b,10b\n"
+		"	.long 9b,10b\n"
+		".previous"
+		: "=r" (blocks), "=r" (d0), "=r" (d1)
+		: "0" (blocks), "1" (src), "2" (dst), "r" (lanes)
+		: "memory");
+	XMMS_RESTORE;
+
+	*sum = csum_fold64(lanes[0] + lanes[1]);
+	return blocks;
+}
+
+/*
+ * The length check in checksum.S jumps here, the arguments are those
+ * of csum_partial().  An odd buffer would need the partial sums byte
+ * swapped; it never happens with real packets, so leave it alone.
+ */
+asmlinkage unsigned int csum_partial_sse2(const unsigned char *buff, int len,
+					  unsigned int sum)
+{
+	int head = -(unsigned long) buff & 15;
+	int blocks;
+
+	if (((unsigned long) buff & 1) || len < head + 64)
+		return __csum_partial(buff, len, sum);
+
+	blocks = (len - head) >> 6;
+	sum = __csum_partial(buff, head, sum);
+	sum = csum_add(sum, csum_sse2_blocks(buff + head, blocks));
+	head += blocks << 6;
+	return __csum_partial(buff + head, len - head, sum);
+}
+
+/*
+ * The same for csum_partial_copy_generic().  A user copy must not sleep
+ * on a fault while we hold the XMM registers, so it runs with
+ * PF_NOFAULT.  Should anything fault we start over with the old
+ * routine, which sets the error and zeroes the destination as usual.
+ */
+asmlinkage unsigned int csum_partial_copy_sse2(const char *src, char *dst,
+				int len, int sum, int *src_err_ptr, int *dst_err_ptr)
+{
+	int head = -(unsigned long) src & 15;
+	int blocks, left, err = 0;
+	int *src_err = src_err_ptr ? &err : NULL;
+	int *dst_err = dst_err_ptr ? &err : NULL;
+	unsigned int res, block_sum;
+
+	if (((unsigned long) src & 1) || len < head + 64)
+		goto slow;
+
+	blocks = (len - head) >> 6;
+	res = __csum_partial_copy_generic(src, dst, head, sum, src_err, dst_err);
+	if (err)
+		goto slow;
+
+	if (src_err_ptr || dst_err_ptr) {
+		current->flags |= PF_NOFAULT;
+		left = csum_copy_sse2_blocks(src + head, dst + head, blocks,
+					     &block_sum);
+		current->flags &= ~PF_NOFAULT;
+	} else
+		left = csum_copy_sse2_blocks(src + head, dst + head, blocks,
+					     &block_sum);
+	if (left)
+		goto slow;
+
+	res = csum_add(res, block_sum);
+	head += blocks << 6;
+	res = __csum_partial_copy_generic(src + head, dst + head, len - head,
+					  res, src_err, dst_err);
+	if (!err)
+		return res;
+slow:
+	return __csum_partial_copy_generic(src, dst, len, sum,
+					   src_err_ptr, dst_err_ptr);
+}
+
+/*
+ * Boot time verification and benchmark.  Both versions are run over
+ * every source alignment mod 16 and all lengths up to CHECK_SHORT, then
+ * a spread of lengths up to a page, and must agree on the checksum and
+ * the copied data.  After that we count, as calibrate_xor_block() does,
+ * how many packets each manages in a jiffy.
+ */
+#define CHECK_ORDER	2
+#define CHECK_SHORT	320
+#define CHECK_STEP	53
+
+/* Partial sums are only equal modulo 0xffff, with 0xffff == 0 */
+static unsigned int __init csum_fold16(unsigned int sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return sum == 0xffff ? 0 : sum;
+}
+
+static int __init csum_sse2_check(unsigned char *b1, unsigned char *b2)
+{
+	unsigned int seed = 0x12345678, a, b;
+	int align, len, err = 0;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE * 2; i++) {
+		seed = seed * 1103515245 + 12345;
+		b1[i] = seed >> 16;
+	}
+
+	for (align = 0; align < 16; align++) {
+		for (len = 0; len <= PAGE_SIZE; ) {
+			const unsigned char *src = b1 + align;
+			unsigned char *dst = b2 + ((align * 7) & 15);
+
+			a = __csum_partial(src, len, len * 0x01010101);
+			b = csum_partial_sse2(src, len, len * 0x01010101);
+			if (csum_fold16(a) != csum_fold16(b))
+				goto bad;
+
+			memset(dst, 0, len);
+			b = csum_partial_copy_sse2(src, dst, len, len * 0x01010101,
+						   &err, NULL);
+			if (err || csum_fold16(a) != csum_fold16(b) ||
+			    memcmp(src, dst, len))
+				goto bad;
+
+			len += len < CHECK_SHORT ? 1 : CHECK_STEP;
+		}
+	}
+	return 0;
+
+bad:
+	printk(KERN_ERR "i386: sse2 checksum mismatch at alignment %d, "
+	       "length %d\n", align, len);
+	return -1;
+}
+
+static int __init do_csum_speed(const char *name,
+	unsigned int (*csum)(const unsigned char *, int, unsigned int),
+	void *buf, int len)
+{
+	unsigned long now;
+	int i, count, max;
+
+	max = 0;
+	for (i = 0; i < 5; i++) {
+		now = jiffies;
+		count = 0;
+		while (jiffies == now) {
+			mb();
+			csum(buf, len, 0);
+			mb();
+			count++;
+			mb();
+		}
+		if (count > max)
+			max = count;
+	}
+
+	if (name) {
+		int speed = max * (HZ * len / 1024);
+
+		printk("   %-10s: %5d.%03d MB/sec\n", name,
+		       speed / 1000, speed % 1000);
+	}
+	return max;
+}
+
+static unsigned int __init csum_copy_i386(const unsigned char *buf, int len,
+					  unsigned int sum)
+{
+	return __csum_partial_copy_generic(buf, (char *) buf + PAGE_SIZE, len,
+					   sum, NULL, NULL);
+}
+
+static unsigned int __init csum_copy_sse2(const unsigned char *buf, int len,
+					  unsigned int sum)
+{
+	return csum_partial_copy_sse2(buf, (char *) buf + PAGE_SIZE, len,
+				      sum, NULL, NULL);
+}
+
+static int __init sse2_csum_init(void)
+{
+	unsigned char *b1, *b2;
+	int len;
+
+	if (!cpu_has_fxsr || !cpu_has_xmm || !cpu_has_sse2)
+		return 0;
+
+	b1 = (unsigned char *) __get_free_pages(GFP_KERNEL, CHECK_ORDER);
+	if (!b1)
+		return 0;
+	b2 = b1 + PAGE_SIZE * 2;
+
+	if (csum_sse2_check(b1, b2))
+		goto out;
+
+	printk(KERN_INFO "i386: measuring checksumming speed\n");
+	do_csum_speed("i386", __csum_partial, b1, PAGE_SIZE);
+	do_csum_speed("sse2", csum_partial_sse2, b1, PAGE_SIZE);
+	do_csum_speed("i386+copy", csum_copy_i386, b1, PAGE_SIZE);
+	do_csum_speed("sse2+copy", csum_copy_sse2, b1, PAGE_SIZE);
+
+	/*
+	 * Saving the registers costs something, so find the shortest
+	 * packet that is still faster.
+	 */
+	for (len = 256; len <= PAGE_SIZE; len <<= 1) {
+		if (do_csum_speed(NULL, csum_partial_sse2, b1, len) >
+		    do_csum_speed(NULL, __csum_partial, b1, len)) {
+			csum_sse2_threshold = len;
+			printk(KERN_INFO "i386: sse2 checksums from %d bytes up\n",
+			       len);
+			break;
+		}
+	}
+out:
+	free_pages((unsigned long) b1, CHECK_ORDER);
+	return 0;
+}
+
+__initcall(sse2_csum_init);
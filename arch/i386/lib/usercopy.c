@@ -45,8 +45,11 @@ unsigned long
 __generic_copy_to_user(void *to, const void *from, unsigned long n)
 {
 	prefetch(from);
-	if (access_ok(VERIFY_WRITE, to, n))
+	if (access_ok(VERIFY_WRITE, to, n)) {
+		if (n >= sse2_copy_threshold)
+			return __sse2_copy_to_user(to, from, n);
 		__copy_user(to,from,n);
+	}
 	return n;
 }
 
@@ -54,9 +57,11 @@ unsigned long
 __generic_copy_from_user(void *to, const void *from, unsigned long n)
 {
 	prefetchw(to);
-	if (access_ok(VERIFY_READ, from, n))
+	if (access_ok(VERIFY_READ, from, n)) {
+		if (n >= sse2_copy_threshold)
+			return __sse2_copy_from_user(to, from, n);
 		__copy_user_zeroing(to,from,n);
-	else
+	} else
 		memset(to, 0, n);
 	return n;
 }
@@ -177,10 +177,11 @@ asmlinkage void do_page_fault(struct pt_regs *regs, unsigned long error_code)
 	info.si_code = SEGV_MAPERR;
 
 	/*
-	 * If we're in an interrupt or have no user
-	 * context, we must not take the fault..
+	 * If we're in an interrupt, have no user context or are
+	 * in a section that can't sleep (like a copy borrowing the
+	 * FPU registers), we must not take the fault..
 	 */
-	if (in_interrupt() || !mm)
+	if (in_interrupt() || !mm || (tsk->flags & PF_NOFAULT))
 		goto no_context;
 
 	down_read(&mm->mmap_sem);
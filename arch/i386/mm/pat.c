@@ -0,0 +1,118 @@
+/*
+ * arch/i386/mm/pat.c
+ *
+ * Page Attribute Table support.
+ *
+ * The only other way to get write-combining on x86 is a variable MTRR,
+ * and there are only eight of those for the whole machine (fewer once
+ * the BIOS has taken its share).  With the PAT we can pick the memory
+ * type per page instead, so any number of framebuffers and device
+ * apertures can be mapped write-combining.
+ *
+ * We keep the power-on layout of the table except for entry 1, which
+ * is changed from write-through to write-combining.  A pte with just
+ * _PAGE_PWT set then selects WC, while the PCD/PWT combinations the
+ * rest of the kernel uses keep their old meaning.  Nothing sets the
+ * PAT bit in a pte, so the Pentium II/III errata on the upper half of
+ * the table don't affect us.
+ */
+
+#include <linux/config.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <asm/processor.h>
+#include <asm/system.h>
+#include <asm/msr.h>
+#include <asm/pgtable.h>
+
+/* PAT memory types */
+#define PAT_UC		0x00	/* uncached */
+#define PAT_WC		0x01	/* write-combining */
+#define PAT_WT		0x04	/* write-through */
+#define PAT_WP		0x05	/* write-protected */
+#define PAT_WB		0x06	/* write-back */
+#define PAT_UC_MINUS	0x07	/* uncached, but MTRR WC may override */
+
+#define PAT(x, y)	((unsigned long long)PAT_##y << ((x) * 8))
+
+/* Set when every CPU has been switched to our table */
+int pat_wc_enabled;
+
+static int pat_disabled __initdata = 0;
+
+static int __init nopat_setup(char *str)
+{
+	pat_disabled = 1;
+	return 1;
+}
+__setup("nopat", nopat_setup);
+
+/*
+ * Load our table into this CPU's PAT.  The SDM asks for the same
+ * dance as for an MTRR update: caches off and flushed, global pages
+ * off, and the TLBs flushed on both sides of the write.
+ */
+static void __init pat_load(void)
+{
+	unsigned long long pat;
+	unsigned long flags, cr0, cr4 = 0;
+
+	pat = PAT(0, WB) | PAT(1, WC) | PAT(2, UC_MINUS) | PAT(3, UC) |
+	      PAT(4, WB) | PAT(5, WC) | PAT(6, UC_MINUS) | PAT(7, UC);
+
+	__save_flags(flags);
+	__cli();
+
+	if (cpu_has_pge) {
+		cr4 = read_cr4();
+		write_cr4(cr4 & ~X86_CR4_PGE);
+	}
+	cr0 = read_cr0();
+	wbinvd();
+	write_cr0(cr0 | 0x40000000);
+	wbinvd();
+
+	wrmsr(MSR_IA32_CR_PAT, (unsigned long) pat, (unsigned long) (pat >> 32));
+
+	wbinvd();
+	__flush_tlb();
+	write_cr0(cr0);
+	if (cpu_has_pge)
+		write_cr4(cr4);
+
+	__restore_flags(flags);
+}
+
+/*
+ * Called from cpu_init() on every CPU as it comes up, before any
+ * driver gets to create a mapping.  The boot CPU decides whether we
+ * use the PAT at all; a secondary CPU without one switches it off
+ * again, since the table has to be the same everywhere.
+ *
+ * Like the rest of cpu_init(), this goes by the feature flags head.S
+ * has just read from this CPU into boot_cpu_data (none if it has no
+ * CPUID at all).
+ */
+void __init pat_init(void)
+{
+	int has_pat = cpu_has_pat;
+
+	if (!smp_processor_id()) {
+		if (!has_pat || pat_disabled)
+			return;
+		pat_wc_enabled = 1;
+		printk(KERN_INFO "PAT: write-combining mappings enabled\n");
+	} else if (!pat_wc_enabled) {
+		return;
+	} else if (!has_pat) {
+		printk(KERN_WARNING "PAT: CPU#%d has no PAT, "
+			"write-combining mappings disabled\n", smp_processor_id());
+		pat_wc_enabled = 0;
+		return;
+	}
+	pat_load();
+}
+
+EXPORT_SYMBOL(pat_wc_enabled);
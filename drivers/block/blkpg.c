@@ -266,6 +266,14 @@ int blk_ioctl(kdev_t dev, unsigned int cmd, unsigned long arg)
 		case BLKELVSET:
 			return blkelvset_ioctl(&blk_get_queue(dev)->elevator,
 					       (blkelv_ioctl_arg_t *) arg);
+		case BLKELVNAME:
+			return blkelvname_ioctl(&blk_get_queue(dev)->elevator,
+						(char *) arg);
+		case BLKELVSELECT:
+			if (!capable(CAP_SYS_ADMIN))
+				return -EACCES;
+			return blkelvselect_ioctl(blk_get_queue(dev),
+						  (const char *) arg);
 
 		case BLKBSZGET:
 			/* get the logical block size (cf. BLKSSZGET) */
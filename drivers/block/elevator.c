@@ -14,6 +14,9 @@
  *   an existing request
  * - elevator_dequeue_fn, called when a request is taken off the active list
  *
+ * Deadline and anticipatory elevators, selectable per queue at runtime
+ * with BLKELVSELECT or at boot with "elevator=".
+ *
  * 20082000 Dave Jones <davej@suse.de> :
  * Removed tests for max-bomb-segments, which was breaking elvtune
  *  when run without -bN
@@ -25,6 +28,7 @@
 #include <linux/elevator.h>
 #include <linux/blk.h>
 #include <linux/module.h>
+#include <linux/init.h>
 #include <asm/uaccess.h>
 
 /*
@@ -180,6 +184,268 @@ int elevator_noop_merge(request_queue_t *q, struct request **req,
 
 void elevator_noop_merge_req(struct request *req, struct request *next) {}
 
+/*
+ * Would bh go between rq and next, the following request of the same
+ * direction (NULL if rq is the last one), in a one way sweep over the
+ * disk?
+ */
+static inline int deadline_in_between(struct buffer_head *bh,
+				      struct request *rq, struct request *next)
+{
+	if (rq->rq_dev != bh->b_rdev)
+		return 0;
+	if (!next || next->rq_dev != rq->rq_dev)
+		return bh->b_rsector > rq->sector;
+	if (next->sector > rq->sector)
+		return bh->b_rsector > rq->sector && bh->b_rsector < next->sector;
+
+	/* the sweep starts over between rq and next */
+	return bh->b_rsector > rq->sector || bh->b_rsector < next->sector;
+}
+
+/*
+ * The deadline elevator keeps the queue as all the reads, sorted, then
+ * all the writes, sorted.  Reads going ahead of writes is what keeps
+ * them from starving behind a big writeout; the fifo expiry times are
+ * what keep either from starving behind the sort order.
+ *
+ * Anything that is not a plain read or write is a barrier.
+ */
+int elevator_deadline_merge(request_queue_t *q, struct request **req,
+			    struct list_head * head,
+			    struct buffer_head *bh, int rw,
+			    int max_sectors)
+{
+	struct list_head *entry = &q->queue_head;
+	unsigned int count = bh->b_size >> 9;
+	struct request *__rq, *next = NULL, *last = NULL;
+
+	while ((entry = entry->prev) != head) {
+		__rq = blkdev_entry_to_request(entry);
+
+		if (!blk_fs_request(__rq) || __rq->waiting) {
+			head = entry;
+			break;
+		}
+		if (__rq->cmd != rw) {
+			/* we are past the writes, a write goes after this */
+			if (rw == WRITE) {
+				head = entry;
+				break;
+			}
+			continue;
+		}
+		if (__rq->rq_dev == bh->b_rdev &&
+		    __rq->nr_sectors + count <= max_sectors) {
+			if (__rq->sector + __rq->nr_sectors == bh->b_rsector) {
+				*req = __rq;
+				return ELEVATOR_BACK_MERGE;
+			} else if (__rq->sector - count == bh->b_rsector) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+		if (!*req && deadline_in_between(bh, __rq, next))
+			*req = __rq;
+		if (!last)
+			last = __rq;
+		next = __rq;
+	}
+
+	/*
+	 * Nowhere in the sort order: a write goes to the back of the
+	 * queue, a read after the last read or, if there is none, in front
+	 * of everything that may still be reordered.  Passing the list head
+	 * itself back as the request to insert after is fine, only ->queue
+	 * gets looked at.
+	 */
+	if (!*req && rw == READ)
+		*req = last ? last : blkdev_entry_to_request(head);
+	return ELEVATOR_NO_MERGE;
+}
+
+static inline unsigned long deadline_expire(elevator_t *elevator, int rw)
+{
+	return elevator_request_latency(elevator, rw) * HZ / 1000;
+}
+
+/*
+ * If the oldest read, or failing that the oldest write, has expired,
+ * make it the next request the driver gets.  Returns 1 if there is an
+ * expired request at the head of the queue.
+ *
+ * The fifos only hold requests still on the queue: drivers take them
+ * off with blkdev_dequeue_request().  Special requests (drive commands
+ * and the like, anything but READ and WRITE) are put where they are
+ * for a reason, so an expired request never passes one of them.
+ */
+static int deadline_check_expired(request_queue_t *q)
+{
+	elevator_t *elevator = &q->elevator;
+	struct list_head *head = &q->queue_head, *entry;
+	struct request *rq = NULL;
+	int rw, held = 0;
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		struct list_head *fifo = &elevator->fifo[rw];
+		struct request *__rq;
+
+		if (list_empty(fifo))
+			continue;
+		__rq = list_entry(fifo->next, struct request, fifo);
+		if (time_before(jiffies, __rq->start_time + deadline_expire(elevator, rw)))
+			continue;
+		rq = __rq;
+		break;
+	}
+	if (!rq)
+		return 0;
+
+	if (q->head_active && !q->plugged) {
+		head = head->next;
+		if (head == &rq->queue)
+			return 1;
+	}
+	for (entry = head->next; entry != &rq->queue; entry = entry->next) {
+		struct request *__rq = blkdev_entry_to_request(entry);
+
+		if (!blk_fs_request(__rq)) {
+			head = entry;
+			held = 1;
+		}
+	}
+	if (head->next != &rq->queue) {
+		list_del(&rq->queue);
+		list_add(&rq->queue, head);
+	}
+	return !held;
+}
+
+int elevator_deadline_add_req(request_queue_t *q, struct request *rq)
+{
+	list_add_tail(&rq->fifo, &q->elevator.fifo[rq->cmd]);
+	deadline_check_expired(q);
+	return 0;
+}
+
+void elevator_deadline_completed_req(request_queue_t *q, struct request *rq)
+{
+	deadline_check_expired(q);
+}
+
+/*
+ * Anticipatory scheduling: a process reading a file usually submits
+ * its next read only once the previous one has completed.  If the
+ * driver moved on to the writes, or another reader's requests, in that
+ * moment, the head would have to come back for every single read.  So
+ * after a read completes we leave the queue plugged for a few
+ * milliseconds if there is other work that would take the disk away;
+ * a read close to the one just completed ends the wait and goes first.
+ *
+ * antic_score follows how often that pays off: a wait that runs out
+ * lowers it, a read that comes in time raises it, whether or not we
+ * waited for it.  At zero we stop waiting until it has picked up again.
+ */
+#define ANTIC_EXPIRE	((10 * HZ + 999) / 1000)	/* 10ms, at least a tick */
+#define ANTIC_CLOSE	2048				/* sectors */
+#define ANTIC_SCORE_MAX	8
+
+static inline int antic_close(elevator_t *elevator, struct request *rq)
+{
+	unsigned long dist;
+
+	if (rq->cmd != READ || rq->rq_dev != elevator->antic_dev)
+		return 0;
+	if (rq->sector >= elevator->antic_sector)
+		dist = rq->sector - elevator->antic_sector;
+	else
+		dist = elevator->antic_sector - rq->sector;
+	return dist <= ANTIC_CLOSE;
+}
+
+static void antic_timeout(unsigned long data)
+{
+	elevator_t *elevator = (elevator_t *) data;
+	request_queue_t *q = list_entry(elevator, request_queue_t, elevator);
+	unsigned long flags;
+	int unplug = 0;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (elevator->antic_status) {
+		elevator->antic_status = 0;
+		if (elevator->antic_score)
+			elevator->antic_score--;
+		unplug = 1;
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	if (unplug)
+		generic_unplug_device(q);
+}
+
+/*
+ * Returns 1 if the queue should be run right away.
+ */
+int elevator_antic_add_req(request_queue_t *q, struct request *rq)
+{
+	elevator_t *elevator = &q->elevator;
+
+	list_add_tail(&rq->fifo, &elevator->fifo[rq->cmd]);
+
+	if (!antic_close(elevator, rq) ||
+	    time_after(jiffies, elevator->antic_stamp + ANTIC_EXPIRE)) {
+		deadline_check_expired(q);
+		return 0;
+	}
+
+	if (elevator->antic_score < ANTIC_SCORE_MAX)
+		elevator->antic_score++;
+	if (!elevator->antic_status)
+		return 0;
+
+	/*
+	 * What we were waiting for.  The queue is still plugged, so
+	 * nothing is active and it can go right to the front.
+	 */
+	elevator->antic_status = 0;
+	del_timer(&elevator->antic_timer);
+	if (q->plugged) {
+		list_del(&rq->queue);
+		list_add(&rq->queue, &q->queue_head);
+	}
+	deadline_check_expired(q);
+	return 1;
+}
+
+void elevator_antic_completed_req(request_queue_t *q, struct request *rq)
+{
+	elevator_t *elevator = &q->elevator;
+	struct request *next;
+
+	if (!blk_fs_request(rq) || rq->cmd != READ) {
+		deadline_check_expired(q);
+		return;
+	}
+
+	/* end_that_request_first() has moved ->sector past the data */
+	elevator->antic_dev = rq->rq_dev;
+	elevator->antic_sector = rq->sector;
+	elevator->antic_stamp = jiffies;
+
+	if (deadline_check_expired(q) || list_empty(&q->queue_head))
+		return;
+	if (q->plugged || !elevator->antic_score)
+		return;
+
+	next = blkdev_entry_next_request(&q->queue_head);
+	if (antic_close(elevator, next))
+		return;
+
+	elevator->antic_status = 1;
+	q->plugged = 1;
+	mod_timer(&elevator->antic_timer, jiffies + ANTIC_EXPIRE);
+}
+
 int blkelvget_ioctl(elevator_t * elevator, blkelv_ioctl_arg_t * arg)
 {
 	blkelv_ioctl_arg_t output;
@@ -212,10 +478,140 @@ int blkelvset_ioctl(elevator_t * elevator, const blkelv_ioctl_arg_t * arg)
 	return 0;
 }
 
+int blkelvname_ioctl(elevator_t * elevator, char * arg)
+{
+	request_queue_t *q = list_entry(elevator, request_queue_t, elevator);
+	char name[ELV_NAME_MAX];
+
+	if (!blk_queue_has_elevator(q))
+		return -EINVAL;
+	memset(name, 0, sizeof(name));
+	strncpy(name, elevator->elevator_name, ELV_NAME_MAX - 1);
+	if (copy_to_user(arg, name, sizeof(name)))
+		return -EFAULT;
+
+	return 0;
+}
+
+int blkelvselect_ioctl(request_queue_t * q, const char * arg)
+{
+	char name[ELV_NAME_MAX];
+
+	if (copy_from_user(name, arg, sizeof(name)))
+		return -EFAULT;
+	name[ELV_NAME_MAX - 1] = '\0';
+
+	return elevator_select(q, name);
+}
+
+static int elevator_lookup(const char *name, elevator_t *type)
+{
+	if (!strcmp(name, "linus"))
+		*type = ELEVATOR_LINUS;
+	else if (!strcmp(name, "noop"))
+		*type = ELEVATOR_NOOP;
+	else if (!strcmp(name, "deadline"))
+		*type = ELEVATOR_DEADLINE;
+	else if (!strcmp(name, "anticipatory"))
+		*type = ELEVATOR_ANTICIPATORY;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+static char chosen_elevator[ELV_NAME_MAX] = "linus";
+
+static int __init elevator_setup(char *str)
+{
+	elevator_t type;
+
+	if (elevator_lookup(str, &type))
+		printk(KERN_WARNING "elevator: unknown elevator %s\n", str);
+	else
+		strncpy(chosen_elevator, str, ELV_NAME_MAX - 1);
+	return 1;
+}
+__setup("elevator=", elevator_setup);
+
+/*
+ * The elevator blk_init_queue() gives a new queue: linus, unless
+ * another one was asked for with "elevator=" at boot.
+ */
+elevator_t elevator_default(void)
+{
+	elevator_t type;
+
+	if (elevator_lookup(chosen_elevator, &type))
+		type = ELEVATOR_LINUS;
+	return type;
+}
+
+/*
+ * Switch q over to another elevator, with requests possibly queued.
+ * The deadline elevators pick up what is on the queue in queue order,
+ * which is as close to the order of arrival as we can get.
+ */
+int elevator_select(request_queue_t *q, const char *name)
+{
+	elevator_t *elevator = &q->elevator;
+	elevator_t type;
+	struct list_head *entry;
+	unsigned long flags;
+	int rw, unplug = 0;
+
+	if (!blk_queue_has_elevator(q) || elevator_lookup(name, &type))
+		return -EINVAL;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (elevator->antic_status) {
+		elevator->antic_status = 0;
+		del_timer(&elevator->antic_timer);
+		unplug = 1;
+	}
+	for (rw = READ; rw <= WRITE; rw++)
+		while (!list_empty(&elevator->fifo[rw]))
+			list_del_init(elevator->fifo[rw].next);
+
+	elevator->read_latency			= type.read_latency;
+	elevator->write_latency			= type.write_latency;
+	elevator->elevator_merge_fn		= type.elevator_merge_fn;
+	elevator->elevator_merge_req_fn		= type.elevator_merge_req_fn;
+	elevator->elevator_add_req_fn		= type.elevator_add_req_fn;
+	elevator->elevator_completed_req_fn	= type.elevator_completed_req_fn;
+	elevator->elevator_name			= type.elevator_name;
+	elevator->antic_score			= ANTIC_SCORE_MAX / 2;
+
+	if (elevator->elevator_add_req_fn) {
+		for (entry = q->queue_head.next; entry != &q->queue_head; entry = entry->next) {
+			struct request *rq = blkdev_entry_to_request(entry);
+
+			if (blk_fs_request(rq) && rq->fifo.next)
+				list_add_tail(&rq->fifo, &elevator->fifo[rq->cmd]);
+		}
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	if (unplug)
+		generic_unplug_device(q);
+	return 0;
+}
+
 void elevator_init(elevator_t * elevator, elevator_t type)
 {
 	static unsigned int queue_ID;
 
 	*elevator = type;
 	elevator->queue_ID = queue_ID++;
+
+	INIT_LIST_HEAD(&elevator->fifo[READ]);
+	INIT_LIST_HEAD(&elevator->fifo[WRITE]);
+	init_timer(&elevator->antic_timer);
+	elevator->antic_timer.function = antic_timeout;
+	elevator->antic_timer.data = (unsigned long) elevator;
+	elevator->antic_score = ANTIC_SCORE_MAX / 2;
+}
+
+void elevator_exit(elevator_t * elevator)
+{
+	del_timer_sync(&elevator->antic_timer);
 }
@@ -35,6 +35,13 @@
 static struct gendisk *gendisk_array[MAX_BLKDEV];
 static rwlock_t gendisk_lock = RW_LOCK_UNLOCKED;
 
+/*
+ * The minor_shift each major was last registered with, read without
+ * the lock by bdflush_queue().  del_gendisk() leaves it alone, so that
+ * a device keeps its bdflush queue while its driver comes and goes.
+ */
+unsigned char gendisk_minor_shift[MAX_BLKDEV];
+
 EXPORT_SYMBOL(gendisk_head);
 
 
@@ -67,6 +74,7 @@ add_gendisk(struct gendisk *gp)
 		}
 	}
 	gendisk_array[gp->major] = gp;
+	gendisk_minor_shift[gp->major] = gp->minor_shift;
 	gp->next = gendisk_head;
 	gendisk_head = gp;
 out:
@@ -228,6 +236,49 @@ struct seq_operations partitions_op = {
 	.stop		= part_stop,
 	.show		= part_show,
 };
+
+#ifdef CONFIG_BLK_STATS
+/*
+ * /proc/diskstats: one line for every disk and partition, in the format
+ * iostat(1) expects, followed by the read and then the write latency
+ * histogram (see DISK_HIST_SLOTS).  Times are in milliseconds.
+ */
+static int diskstats_show(struct seq_file *s, void *v)
+{
+	struct gendisk *gp = v;
+	char buf[64];
+	int n, i;
+
+	for (n = 0; n < (gp->nr_real << gp->minor_shift); n++) {
+		struct hd_struct *hd = &gp->part[n];
+
+		if (!hd->nr_sects)
+			continue;
+		disk_round_stats(hd);
+		seq_printf(s, "%4d %4d %s %u %u %u %u %u %u %u %u %u %u %u",
+			   gp->major, n, disk_name(gp, n, buf),
+			   hd->rd_ios, hd->rd_merges,
+			   hd->rd_sectors, MSEC(hd->rd_ticks),
+			   hd->wr_ios, hd->wr_merges,
+			   hd->wr_sectors, MSEC(hd->wr_ticks),
+			   hd->ios_in_flight, MSEC(hd->io_ticks),
+			   MSEC(hd->aveq));
+		for (i = 0; i < DISK_HIST_SLOTS; i++)
+			seq_printf(s, " %u", hd->rd_hist[i]);
+		for (i = 0; i < DISK_HIST_SLOTS; i++)
+			seq_printf(s, " %u", hd->wr_hist[i]);
+		seq_putc(s, '\n');
+	}
+	return 0;
+}
+
+struct seq_operations diskstats_op = {
+	.start		= part_start,
+	.next		= part_next,
+	.stop		= part_stop,
+	.show		= diskstats_show,
+};
+#endif /* CONFIG_BLK_STATS */
 #endif
 
 extern int blk_dev_init(void);
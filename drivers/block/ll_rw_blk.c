@@ -31,6 +31,7 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/bio.h>
 
 /*
  * MAC Floppy IWM hooks
@@ -181,6 +182,7 @@ void blk_cleanup_queue(request_queue_t * q)
 	int count = q->nr_requests;
 
 	count -= __blk_cleanup_queue(&q->rq);
+	elevator_exit(&q->elevator);
 
 	if (count)
 		printk("blk_cleanup_queue: leaked requests (%d)\n", count);
@@ -219,6 +221,27 @@ void blk_queue_headactive(request_queue_t * q, int active)
 	q->head_active = active;
 }
 
+/**
+ * blk_queue_lock - give a request queue a lock of its own
+ * @q:       The queue which this applies to.
+ * @lock:    The spinlock to protect it with.
+ *
+ * Description:
+ *    By default every queue is protected by the global io_request_lock,
+ *    which is also what the request function of a driver is called with.
+ *    A driver that protects its own state with a lock of its own can pass
+ *    that lock here, and then I/O to its devices no longer contends with
+ *    I/O to everybody else's.  Queues whose request functions look at
+ *    each other (several drives on one controller, say) must share one
+ *    lock.
+ *
+ *    Must be called before there is any I/O on the queue.
+ **/
+void blk_queue_lock(request_queue_t * q, spinlock_t * lock)
+{
+	q->queue_lock = lock;
+}
+
 /**
  * blk_queue_throttle_sectors - indicates you will call sector throttling funcs
  * @q:       The queue which this applies to.
@@ -381,6 +404,11 @@ static void generic_plug_device(request_queue_t *q, kdev_t dev)
  */
 static inline void __generic_unplug_device(request_queue_t *q)
 {
+	if (q->elevator.antic_status) {
+		/* run from elsewhere: stop waiting for a close read */
+		q->elevator.antic_status = 0;
+		del_timer(&q->elevator.antic_timer);
+	}
 	if (q->plugged) {
 		q->plugged = 0;
 		if (!list_empty(&q->queue_head))
@@ -393,9 +421,9 @@ void generic_unplug_device(void *data)
 	request_queue_t *q = (request_queue_t *) data;
 	unsigned long flags;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(q->queue_lock, flags);
 	__generic_unplug_device(q);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(q->queue_lock, flags);
 }
 
 /** blk_grow_request_list
@@ -419,7 +447,7 @@ int blk_grow_request_list(request_queue_t *q, int nr_requests, int max_queue_sec
 	 * this causes system hangs during boot.
 	 * As a temporary fix, make the function non-blocking.
 	 */
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(q->queue_lock, flags);
 	while (q->nr_requests < nr_requests) {
 		struct request *rq;
 
@@ -450,7 +478,7 @@ int blk_grow_request_list(request_queue_t *q, int nr_requests, int max_queue_sec
  	BUG_ON(!q->batch_sectors);
  	atomic_set(&q->nr_sectors, 0);
 
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(q->queue_lock, flags);
 	return q->nr_requests;
 }
 
@@ -479,11 +507,10 @@ static void blk_init_free_list(request_queue_t *q)
  	blk_grow_request_list(q, nr_requests, max_queue_sectors);
 
  	init_waitqueue_head(&q->wait_for_requests);
-
-	spin_lock_init(&q->queue_lock);
 }
 
 static int __make_request(request_queue_t * q, int rw, struct buffer_head * bh);
+static void end_bio_split_bh_io(struct buffer_head *bh, int uptodate);
 
 /**
  * blk_init_queue  - prepare a request queue for use with a block device
@@ -506,8 +533,9 @@ static int __make_request(request_queue_t * q, int rw, struct buffer_head * bh);
  *    requests on the queue, it is responsible for arranging that the requests
  *    get dealt with eventually.
  *
- *    A global spin lock $io_request_lock must be held while manipulating the
- *    requests on the request queue.
+ *    The queue lock, $q->queue_lock, must be held while manipulating the
+ *    requests on the request queue.  It is the global $io_request_lock
+ *    unless the driver sets another one with blk_queue_lock().
  *
  *    The request on the head of the queue is by default assumed to be
  *    potentially active, and it is not considered for re-ordering or merging
@@ -520,8 +548,9 @@ static int __make_request(request_queue_t * q, int rw, struct buffer_head * bh);
  **/
 void blk_init_queue(request_queue_t * q, request_fn_proc * rfn)
 {
+	q->queue_lock = &io_request_lock;
 	INIT_LIST_HEAD(&q->queue_head);
-	elevator_init(&q->elevator, ELEVATOR_LINUS);
+	elevator_init(&q->elevator, elevator_default());
 	blk_init_free_list(q);
 	q->request_fn     	= rfn;
 	q->back_merge_fn       	= ll_back_merge_fn;
@@ -546,9 +575,19 @@ void blk_init_queue(request_queue_t * q, request_fn_proc * rfn)
 	blk_queue_bounce_limit(q, BLK_BOUNCE_HIGH);
 }
 
+/*
+ * Only queues that go through __make_request() use their elevator.
+ * Stacking drivers with their own make_request_fn may never have had
+ * one set up.
+ */
+int blk_queue_has_elevator(request_queue_t * q)
+{
+	return q->make_request_fn == __make_request;
+}
+
 #define blkdev_free_rq(list) list_entry((list)->next, struct request, queue);
 /*
- * Get a free request. io_request_lock must be held and interrupts
+ * Get a free request. The queue lock must be held and interrupts
  * disabled on the way in.  Returns NULL if there are no free requests.
  */
 static struct request *get_request(request_queue_t *q, int rw)
@@ -581,6 +620,7 @@ static struct request *get_request(request_queue_t *q, int rw)
 		rq->cmd = rw;
 		rq->special = NULL;
 		rq->q = q;
+		INIT_LIST_HEAD(&rq->fifo);
 	}
 
 	return rq;
@@ -639,15 +679,15 @@ static struct request *__get_request_wait(request_queue_t *q, int rw)
 
 	do {
 		set_current_state(TASK_UNINTERRUPTIBLE);
-		spin_lock_irq(&io_request_lock);
+		spin_lock_irq(q->queue_lock);
 		if (blk_oversized_queue(q) || q->rq.count == 0) {
 			__generic_unplug_device(q);
-			spin_unlock_irq(&io_request_lock);
+			spin_unlock_irq(q->queue_lock);
 			schedule();
-			spin_lock_irq(&io_request_lock);
+			spin_lock_irq(q->queue_lock);
 		}
 		rq = get_request(q, rw);
-		spin_unlock_irq(&io_request_lock);
+		spin_unlock_irq(q->queue_lock);
 	} while (rq == NULL);
 	remove_wait_queue(&q->wait_for_requests, &wait);
 	current->state = TASK_RUNNING;
@@ -797,6 +837,18 @@ static void account_io_start(struct hd_struct *hd, struct request *req,
 		up_ios(hd);
 }
 
+static inline int disk_hist_slot(unsigned long ticks)
+{
+	unsigned long ms = ticks * 1000 / HZ;
+	int slot = 0;
+
+	while (ms && slot < DISK_HIST_SLOTS - 1) {
+		ms >>= 1;
+		slot++;
+	}
+	return slot;
+}
+
 static void account_io_end(struct hd_struct *hd, struct request *req)
 {
 	unsigned long duration = jiffies - req->start_time;
@@ -804,10 +856,12 @@ static void account_io_end(struct hd_struct *hd, struct request *req)
 	case READ:
 		hd->rd_ticks += duration;
 		hd->rd_ios++;
+		hd->rd_hist[disk_hist_slot(duration)]++;
 		break;
 	case WRITE:
 		hd->wr_ticks += duration;
 		hd->wr_ios++;
+		hd->wr_hist[disk_hist_slot(duration)]++;
 		break;
 	}
 	down_ios(hd);
@@ -846,23 +900,44 @@ void req_finished_io(struct request *req)
 		account_io_end(hd2, req);
 }
 EXPORT_SYMBOL(req_finished_io);
+
+/*
+ * For devices with their own make_request function, which never see a
+ * request (md, for one): count an I/O and its sectors as it is
+ * submitted.  There is no completion to time, so the in-flight, busy
+ * and latency figures stay at zero.  Called without any lock held; a
+ * lost update between CPUs only costs us a count.
+ */
+void disk_stat_io(struct hd_struct *hd, int rw, int sectors)
+{
+	if (rw == WRITE) {
+		hd->wr_ios++;
+		hd->wr_sectors += sectors;
+	} else {
+		hd->rd_ios++;
+		hd->rd_sectors += sectors;
+	}
+}
+EXPORT_SYMBOL(disk_stat_io);
 #endif /* CONFIG_BLK_STATS */
 
 /*
  * add-request adds a request to the linked list.
- * io_request_lock is held and interrupts disabled, as we muck with the
+ * The queue lock is held and interrupts disabled, as we muck with the
  * request queue list.
  *
  * By this point, req->cmd is always either READ/WRITE, never READA,
  * which is important for drive_stat_acct() above.
+ *
+ * Returns 1 if the elevator wants the queue run now, plugged or not.
  */
-static inline void add_request(request_queue_t * q, struct request * req,
-			       struct list_head *insert_here)
+static inline int add_request(request_queue_t * q, struct request * req,
+			      struct list_head *insert_here)
 {
 	drive_stat_acct(req->rq_dev, req->cmd, req->nr_sectors, 1);
 
 	if (!q->plugged && q->head_active && insert_here == &q->queue_head) {
-		spin_unlock_irq(&io_request_lock);
+		spin_unlock_irq(q->queue_lock);
 		BUG();
 	}
 
@@ -871,10 +946,14 @@ static inline void add_request(request_queue_t * q, struct request * req,
 	 * inserted at elevator_merge time
 	 */
 	list_add(&req->queue, insert_here);
+
+	if (q->elevator.elevator_add_req_fn)
+		return q->elevator.elevator_add_req_fn(q, req);
+	return 0;
 }
 
 /*
- * Must be called with io_request_lock held and interrupts disabled
+ * Must be called with the queue lock held and interrupts disabled
  */
 void blkdev_release_request(struct request *req)
 {
@@ -891,6 +970,8 @@ void blkdev_release_request(struct request *req)
 		struct request_list *rl = &q->rq;
 		int oversized_batch = 0;
 
+		elevator_fifo_del(req);
+
 		if (q->can_throttle)
 			oversized_batch = blk_oversized_queue_batch(q);
 		rl->count++;
@@ -1009,6 +1090,10 @@ static int __make_request(request_queue_t * q, int rw,
 #if 0	/* bread() misinterprets failed READA attempts as IO errors on SMP */
 			rw_ahead = 1;
 #endif
+			/* submit_bio() gives stacking drivers buffer_heads
+			   that cope with it, also once remapped */
+			if (bh->b_end_io == end_bio_split_bh_io)
+				rw_ahead = 1;
 			rw = READ;	/* drop into READ */
 		case READ:
 		case WRITE:
@@ -1045,7 +1130,7 @@ static int __make_request(request_queue_t * q, int rw,
 	 * Now we acquire the request spinlock, we have to be mega careful
 	 * not to schedule or do something nonatomic
 	 */
-	spin_lock_irq(&io_request_lock);
+	spin_lock_irq(q->queue_lock);
 
 again:
 	insert_here = head->prev;
@@ -1125,7 +1210,8 @@ get_rq:
 		 */
 		if (rw_ahead) {
 			if (q->rq.count < q->batch_requests || blk_oversized_queue_batch(q)) {
-				spin_unlock_irq(&io_request_lock);
+				spin_unlock_irq(q->queue_lock);
+				clear_bit(BH_Uptodate, &bh->b_state);
 				goto end_io;
 			}
 			req = get_request(q, rw);
@@ -1134,10 +1220,10 @@ get_rq:
 		} else {
 			req = get_request(q, rw);
 			if (req == NULL) {
-				spin_unlock_irq(&io_request_lock);
+				spin_unlock_irq(q->queue_lock);
 				freereq = __get_request_wait(q, rw);
 				head = &q->queue_head;
-				spin_lock_irq(&io_request_lock);
+				spin_lock_irq(q->queue_lock);
 				should_wake = 1;
 				goto again;
 			}
@@ -1162,7 +1248,8 @@ get_rq:
 	req_new_io(req, 0, count);
 	blk_started_io(count);
 	blk_started_sectors(req, count);
-	add_request(q, req, insert_here);
+	if (add_request(q, req, insert_here))
+		sync = 1;
 out:
 	if (freereq)
 		blkdev_release_request(freereq);
@@ -1170,13 +1257,179 @@ out:
 		get_request_wait_wakeup(q, rw);
 	if (sync)
 		__generic_unplug_device(q);
-	spin_unlock_irq(&io_request_lock);
+	spin_unlock_irq(q->queue_lock);
 	return 0;
 end_io:
 	bh->b_end_io(bh, test_bit(BH_Uptodate, &bh->b_state));
 	return 0;
 }
 
+/*
+ * Queue a chain of buffer_heads for consecutive sectors, linked through
+ * b_reqnext, as submit_bio() builds them.  Only the first one has to go
+ * through the elevator: the rest are appended straight to its request
+ * for as long as the request limits allow, and then the next one starts
+ * a new round.
+ *
+ * Like __make_request(), READA doesn't wait for a free request; what
+ * is left of the chain then fails.
+ */
+static void __make_chain_request(request_queue_t * q, int rw,
+				 struct buffer_head * bh)
+{
+	int max_segments = MAX_SEGMENTS;
+	int max_sectors = get_max_sectors(bh->b_rdev);
+	elevator_t *elevator = &q->elevator;
+	struct request *req, *freereq = NULL;
+	struct list_head *head, *insert_here;
+	struct buffer_head *next, *failed = NULL;
+	int latency, el_ret, count, should_wake = 0, unplug = 0;
+	int rw_ahead = 0;
+
+	if (rw == READA) {
+		rw = READ;
+		rw_ahead = 1;
+	}
+	latency = elevator_request_latency(elevator, rw);
+
+	spin_lock_irq(q->queue_lock);
+	while (bh) {
+		next = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		count = bh->b_size >> 9;
+		head = &q->queue_head;
+again:
+		insert_here = head->prev;
+		req = NULL;
+
+		if (list_empty(head)) {
+			q->plug_device_fn(q, bh->b_rdev); /* is atomic */
+			goto get_rq;
+		} else if (q->head_active && !q->plugged)
+			head = head->next;
+
+		el_ret = elevator->elevator_merge_fn(q, &req, head, bh, rw, max_sectors);
+		if (el_ret == ELEVATOR_BACK_MERGE) {
+			if (q->back_merge_fn(q, req, bh, max_segments)) {
+				req->bhtail->b_reqnext = bh;
+				req->bhtail = bh;
+				req->nr_sectors = req->hard_nr_sectors += count;
+				blk_started_io(count);
+				blk_started_sectors(req, count);
+				drive_stat_acct(req->rq_dev, req->cmd, count, 0);
+				req_new_io(req, 1, count);
+				goto append;
+			}
+			insert_here = &req->queue;
+		} else if (el_ret == ELEVATOR_FRONT_MERGE)
+			insert_here = req->queue.prev;
+		else if (req)
+			insert_here = &req->queue;
+
+get_rq:
+		if (freereq) {
+			req = freereq;
+			freereq = NULL;
+		} else if (rw_ahead && (q->rq.count < q->batch_requests ||
+					blk_oversized_queue_batch(q))) {
+			bh->b_reqnext = next;
+			failed = bh;
+			break;
+		} else if ((req = get_request(q, rw)) == NULL) {
+			spin_unlock_irq(q->queue_lock);
+			freereq = __get_request_wait(q, rw);
+			head = &q->queue_head;
+			spin_lock_irq(q->queue_lock);
+			should_wake = 1;
+			goto again;
+		}
+
+		req->elevator_sequence = latency;
+		req->cmd = rw;
+		req->errors = 0;
+		req->hard_sector = req->sector = bh->b_rsector;
+		req->hard_nr_sectors = req->nr_sectors = count;
+		req->current_nr_sectors = req->hard_cur_sectors = count;
+		req->nr_segments = 1;
+		req->nr_hw_segments = 1;
+		req->buffer = bh->b_data;
+		req->waiting = NULL;
+		req->bh = bh;
+		req->bhtail = bh;
+		req->rq_dev = bh->b_rdev;
+		req->start_time = jiffies;
+		req_new_io(req, 0, count);
+		blk_started_io(count);
+		blk_started_sectors(req, count);
+		unplug |= add_request(q, req, insert_here);
+
+append:
+		count = 0;
+		while ((bh = next) != NULL) {
+			if (req->nr_sectors + (bh->b_size >> 9) > max_sectors)
+				break;
+			if (!q->back_merge_fn(q, req, bh, max_segments))
+				break;
+			next = bh->b_reqnext;
+			bh->b_reqnext = NULL;
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+			req->nr_sectors = req->hard_nr_sectors += bh->b_size >> 9;
+			count += bh->b_size >> 9;
+		}
+		if (count) {
+			blk_started_io(count);
+			blk_started_sectors(req, count);
+			drive_stat_acct(req->rq_dev, req->cmd, count, 0);
+			req_new_io(req, 1, count);
+		}
+		attempt_back_merge(q, req, max_sectors, max_segments);
+	}
+	if (freereq)
+		blkdev_release_request(freereq);
+	if (should_wake)
+		get_request_wait_wakeup(q, rw);
+	if (unplug)
+		__generic_unplug_device(q);
+	spin_unlock_irq(q->queue_lock);
+
+	while ((bh = failed) != NULL) {
+		failed = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_end_io(bh, 0);
+	}
+}
+
+/*
+ * Is the I/O past the end of the device?  Only checked when the size
+ * is known.
+ */
+static int beyond_end_of_device(kdev_t dev, int rw, unsigned long sector,
+				unsigned int count)
+{
+	int major = MAJOR(dev);
+	int minorsize = 0;
+
+	if (blk_size[major])
+		minorsize = blk_size[major][MINOR(dev)];
+	if (minorsize) {
+		unsigned long maxsector = (minorsize << 1) + 1;
+
+		if (maxsector < count || maxsector - count < sector) {
+			/* This may well happen - the kernel calls bread()
+			   without checking the size of the device, e.g.,
+			   when mounting a device. */
+			printk(KERN_INFO
+			       "attempt to access beyond end of device\n");
+			printk(KERN_INFO "%s: rw=%d, want=%ld, limit=%d\n",
+			       kdevname(dev), rw,
+			       (sector + count)>>1, minorsize);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /**
  * generic_make_request: hand a buffer head to it's device driver for I/O
  * @rw:  READ, WRITE, or READA - what sort of I/O is desired.
@@ -1213,37 +1466,17 @@ end_io:
  * */
 void generic_make_request (int rw, struct buffer_head * bh)
 {
-	int major = MAJOR(bh->b_rdev);
-	int minorsize = 0;
 	request_queue_t *q;
 
 	if (!bh->b_end_io)
 		BUG();
 
 	/* Test device size, when known. */
-	if (blk_size[major])
-		minorsize = blk_size[major][MINOR(bh->b_rdev)];
-	if (minorsize) {
-		unsigned long maxsector = (minorsize << 1) + 1;
-		unsigned long sector = bh->b_rsector;
-		unsigned int count = bh->b_size >> 9;
-
-		if (maxsector < count || maxsector - count < sector) {
-			/* Yecch */
-			bh->b_state &= ~(1 << BH_Dirty);
-
-			/* This may well happen - the kernel calls bread()
-			   without checking the size of the device, e.g.,
-			   when mounting a device. */
-			printk(KERN_INFO
-			       "attempt to access beyond end of device\n");
-			printk(KERN_INFO "%s: rw=%d, want=%ld, limit=%d\n",
-			       kdevname(bh->b_rdev), rw,
-			       (sector + count)>>1, minorsize);
-
-			bh->b_end_io(bh, 0);
-			return;
-		}
+	if (beyond_end_of_device(bh->b_rdev, rw, bh->b_rsector, bh->b_size >> 9)) {
+		/* Yecch */
+		bh->b_state &= ~(1 << BH_Dirty);
+		bh->b_end_io(bh, 0);
+		return;
 	}
 
 	/*
@@ -1320,6 +1553,236 @@ void submit_bh(int rw, struct buffer_head * bh)
 	}
 }
 
+/**
+ * bio_alloc: allocate a bio
+ * @gfp_mask: allocation flags
+ * @nr_vecs: number of page ranges it should be able to hold
+ *
+ * The buffer_heads the drivers will see come with it, so that
+ * submit_bio() doesn't have to allocate anything.
+ */
+struct bio *bio_alloc(int gfp_mask, int nr_vecs)
+{
+	struct bio *bio;
+
+	if (nr_vecs < 1 || nr_vecs > BIO_MAX_VECS)
+		BUG();
+
+	bio = kmalloc(sizeof(*bio) + nr_vecs * (sizeof(struct bio_vec) +
+			sizeof(struct buffer_head)), gfp_mask);
+	if (!bio)
+		return NULL;
+
+	memset(bio, 0, sizeof(*bio));
+	bio->bi_max_vecs = nr_vecs;
+	bio->bi_bh = (struct buffer_head *) (bio + 1);
+	bio->bi_io_vec = (struct bio_vec *) (bio->bi_bh + nr_vecs);
+	return bio;
+}
+
+void bio_put(struct bio *bio)
+{
+	kfree(bio);
+}
+
+/**
+ * bio_add_page: add a page range to a bio
+ * @bio: the bio
+ * @page: the page
+ * @len: length of the range, a multiple of 512 bytes
+ * @offset: where in the page it starts
+ *
+ * Returns the number of bytes added, which is 0 once the bio is full.
+ * A range that continues the last one in the same page is merged
+ * with it; submit_bio() cuts it up into blocks again where needed.
+ */
+int bio_add_page(struct bio *bio, struct page *page, unsigned int len,
+		 unsigned int offset)
+{
+	struct bio_vec *bv = bio->bi_io_vec + bio->bi_vcnt - 1;
+
+	if ((len & 511) || offset + len > PAGE_SIZE)
+		BUG();
+
+	if (bio->bi_vcnt && bv->bv_page == page &&
+	    bv->bv_offset + bv->bv_len == offset) {
+		bv->bv_len += len;
+	} else {
+		if (bio->bi_vcnt == bio->bi_max_vecs)
+			return 0;
+		bv++;
+		bv->bv_page = page;
+		bv->bv_len = len;
+		bv->bv_offset = offset;
+		bio->bi_vcnt++;
+	}
+	bio->bi_size += len;
+	return len;
+}
+
+static void end_bio_io(struct bio *bio, int uptodate)
+{
+	if (!uptodate)
+		clear_bit(BIO_UPTODATE, &bio->bi_flags);
+	if (atomic_dec_and_test(&bio->bi_remaining))
+		bio->bi_end_io(bio, test_bit(BIO_UPTODATE, &bio->bi_flags));
+}
+
+static void end_bio_bh_io(struct buffer_head *bh, int uptodate)
+{
+	end_bio_io(bh->b_private, uptodate);
+}
+
+static void end_bio_split_bh_io(struct buffer_head *bh, int uptodate)
+{
+	struct bio *bio = bh->b_private;
+
+	kmem_cache_free(bh_cachep, bh);
+	end_bio_io(bio, uptodate);
+}
+
+/*
+ * Stacking drivers (md, lvm, loop, ...) expect every buffer_head to be
+ * one block: b_size a power of two and b_rsector aligned to it, as
+ * the buffer cache hands them out.  A bio vec may be anything from 512
+ * bytes to a page, so cut the bio up into blocks of the device's soft
+ * block size, or of the largest smaller size that it is aligned to.
+ */
+static void submit_bio_stacked(int rw, struct bio *bio)
+{
+	kdev_t dev = bio->bi_dev;
+	unsigned long sector = bio->bi_sector;
+	struct buffer_head *bh;
+	int i, size = BLOCK_SIZE;
+	unsigned int offset;
+
+	if (blksize_size[MAJOR(dev)] && blksize_size[MAJOR(dev)][MINOR(dev)])
+		size = blksize_size[MAJOR(dev)][MINOR(dev)];
+	while (size > 512 && (sector & ((size >> 9) - 1)))
+		size >>= 1;
+	for (i = 0; i < bio->bi_vcnt; i++) {
+		struct bio_vec *bv = bio->bi_io_vec + i;
+
+		while (size > 512 && ((bv->bv_len | bv->bv_offset) & (size - 1)))
+			size >>= 1;
+	}
+
+	/* held until the last block has been submitted */
+	atomic_set(&bio->bi_remaining, 1);
+
+	for (i = 0; i < bio->bi_vcnt; i++) {
+		struct bio_vec *bv = bio->bi_io_vec + i;
+
+		for (offset = 0; offset < bv->bv_len; offset += size) {
+			bh = kmem_cache_alloc(bh_cachep, SLAB_NOIO);
+			if (!bh) {
+				clear_bit(BIO_UPTODATE, &bio->bi_flags);
+				goto out;
+			}
+			memset(bh, 0, sizeof(*bh));
+			bh->b_size = size;
+			set_bh_page(bh, bv->bv_page, bv->bv_offset + offset);
+			bh->b_this_page = bh;
+			init_waitqueue_head(&bh->b_wait);
+			atomic_set(&bh->b_count, 1);
+			bh->b_dev = bh->b_rdev = dev;
+			bh->b_blocknr = sector / (size >> 9);
+			bh->b_rsector = sector;
+			bh->b_state = (1 << BH_Mapped) | (1 << BH_Lock) |
+				      (1 << BH_Req) | (1 << BH_Uptodate);
+			bh->b_end_io = end_bio_split_bh_io;
+			bh->b_private = bio;
+			atomic_inc(&bio->bi_remaining);
+			generic_make_request(rw, bh);
+			sector += size >> 9;
+		}
+	}
+out:
+	end_bio_io(bio, test_bit(BIO_UPTODATE, &bio->bi_flags));
+}
+
+/**
+ * submit_bio: submit a bio to the block device for I/O
+ * @rw: %READ, %WRITE or %READA
+ * @bio: the bio, with bi_dev, bi_sector and bi_end_io filled in
+ *
+ * bi_end_io gets called once when the I/O on all of the bio is done,
+ * with a zero second argument if any of it failed.  It may be called
+ * before submit_bio() returns.
+ */
+void submit_bio(int rw, struct bio *bio)
+{
+	unsigned long sector = bio->bi_sector;
+	int nr = bio->bi_vcnt;
+	int count = bio->bi_size >> 9;
+	struct buffer_head *bh, *first = NULL, **tail = &first;
+	request_queue_t *q;
+	int i;
+
+	if (!nr || !bio->bi_end_io)
+		BUG();
+
+	if (beyond_end_of_device(bio->bi_dev, rw, sector, count)) {
+		bio->bi_end_io(bio, 0);
+		return;
+	}
+	q = blk_get_queue(bio->bi_dev);
+	if (!q) {
+		printk(KERN_ERR "submit_bio: Trying to access nonexistent "
+		       "block-device %s (%ld)\n", kdevname(bio->bi_dev), sector);
+		bio->bi_end_io(bio, 0);
+		return;
+	}
+
+	set_bit(BIO_UPTODATE, &bio->bi_flags);
+
+	switch (rw) {
+		case WRITE:
+			kstat.pgpgout += count;
+			break;
+		default:
+			kstat.pgpgin += count;
+			break;
+	}
+
+	if (q->make_request_fn != __make_request) {
+		submit_bio_stacked(rw, bio);
+		return;
+	}
+
+	/*
+	 * Straight to a request queue: one buffer_head per vec, bounced
+	 * first where needed, as we can't sleep once the queue is locked.
+	 */
+	atomic_set(&bio->bi_remaining, nr);
+	for (i = 0; i < nr; i++) {
+		struct bio_vec *bv = bio->bi_io_vec + i;
+
+		bh = bio->bi_bh + i;
+		memset(bh, 0, sizeof(*bh));
+		bh->b_size = bv->bv_len;
+		set_bh_page(bh, bv->bv_page, bv->bv_offset);
+		bh->b_this_page = bh;
+		init_waitqueue_head(&bh->b_wait);
+		atomic_set(&bh->b_count, 1);
+		bh->b_dev = bh->b_rdev = bio->bi_dev;
+		/* vecs needn't be block sized or aligned: as md does for
+		   its own buffer_heads, b_blocknr is the sector */
+		bh->b_blocknr = sector;
+		bh->b_rsector = sector;
+		bh->b_state = (1 << BH_Mapped) | (1 << BH_Lock) |
+			      (1 << BH_Req) | (1 << BH_Uptodate);
+		bh->b_end_io = end_bio_bh_io;
+		bh->b_private = bio;
+		sector += bv->bv_len >> 9;
+
+		bh = blk_queue_bounce(q, rw, bh);
+		*tail = bh;
+		tail = &bh->b_reqnext;
+	}
+	__make_chain_request(q, rw, first);
+}
+
 /**
  * ll_rw_block: low-level access to block devices
  * @rw: whether to %READ or %WRITE or maybe %READA (readahead)
@@ -1493,6 +1956,7 @@ extern int laptop_mode;
 void end_that_request_last(struct request *req)
 {
 	struct completion *waiting = req->waiting;
+	request_queue_t *q = req->q;
 
 	/*
 	 * schedule the writeout of pending dirty data when the disk is idle
@@ -1501,6 +1965,8 @@ void end_that_request_last(struct request *req)
 		mod_timer(&writeback_timer, jiffies + 5 * HZ);
 
 	req_finished_io(req);
+	if (q && q->elevator.elevator_completed_req_fn)
+		q->elevator.elevator_completed_req_fn(q, req);
 	blkdev_release_request(req);
 	if (waiting)
 		complete(waiting);
@@ -1636,9 +2102,15 @@ EXPORT_SYMBOL(blk_init_queue);
 EXPORT_SYMBOL(blk_get_queue);
 EXPORT_SYMBOL(blk_cleanup_queue);
 EXPORT_SYMBOL(blk_queue_headactive);
+EXPORT_SYMBOL(blk_queue_lock);
 EXPORT_SYMBOL(blk_queue_throttle_sectors);
 EXPORT_SYMBOL(blk_queue_make_request);
+EXPORT_SYMBOL(blk_queue_has_elevator);
 EXPORT_SYMBOL(generic_make_request);
+EXPORT_SYMBOL(bio_alloc);
+EXPORT_SYMBOL(bio_put);
+EXPORT_SYMBOL(bio_add_page);
+EXPORT_SYMBOL(submit_bio);
 EXPORT_SYMBOL(blkdev_release_request);
 EXPORT_SYMBOL(generic_unplug_device);
 EXPORT_SYMBOL(blk_queue_bounce_limit);
@@ -71,6 +71,7 @@
 #include <linux/smp_lock.h>
 #include <linux/swap.h>
 #include <linux/slab.h>
+#include <linux/iobuf.h>
 
 #include <asm/uaccess.h>
 
@@ -78,10 +79,14 @@
 
 #define MAJOR_NR LOOP_MAJOR
 
+#define LO_MAX_THREADS	16
+
 static int max_loop = 8;
+static int loop_threads = 1;
 static struct loop_device *loop_dev;
 static int *loop_sizes;
 static int *loop_blksizes;
+static int *loop_hardsizes;
 static devfs_handle_t devfs_handle;      /*  For the directory */
 
 /*
@@ -315,21 +320,179 @@ static inline unsigned long loop_get_iv(struct loop_device *lo,
 	return IV;
 }
 
-static int do_bh_filebacked(struct loop_device *lo, struct buffer_head *bh, int rw)
+/*
+ * Write back and drop what the page cache holds of the backing file.
+ * Direct I/O goes around the cache, so it has to be on disk before
+ * direct I/O reads it and gone before anybody could read it stale.
+ */
+static int lo_sync_cache(struct loop_device *lo)
+{
+	struct inode *inode = lo->lo_backing_file->f_dentry->d_inode;
+	struct address_space *mapping = inode->i_mapping;
+	int err;
+
+	down(&inode->i_sem);
+	err = filemap_fdatasync(mapping);
+	if (!err)
+		err = fsync_inode_data_buffers(inode);
+	if (!err)
+		err = filemap_fdatawait(mapping);
+	if (!err)
+		invalidate_inode_pages2(mapping);
+	up(&inode->i_sem);
+	return err;
+}
+
+/*
+ * The same for len bytes at pos only, after a buffer went the buffered
+ * way.  Pages dirty without buffers (mmap, or a filesystem that keeps
+ * none) have no ranged writeback here, so they take the whole file.
+ */
+static int lo_sync_range(struct loop_device *lo, loff_t pos, int len)
+{
+	struct inode *inode = lo->lo_backing_file->f_dentry->d_inode;
+	struct address_space *mapping = inode->i_mapping;
+	unsigned long index = pos >> PAGE_CACHE_SHIFT;
+	unsigned long end = (pos + len + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	int err;
+
+	down(&inode->i_sem);
+	err = generic_buffer_fdatasync(inode, index, end);
+	for ( ; !err && index < end; index++) {
+		struct page *page = find_lock_page(mapping, index);
+
+		if (!page)
+			continue;
+		if (PageDirty(page)) {
+			UnlockPage(page);
+			page_cache_release(page);
+			up(&inode->i_sem);
+			return lo_sync_cache(lo);
+		}
+		if (page->buffers)
+			block_invalidate_page(page);
+		ClearPageUptodate(page);
+		UnlockPage(page);
+		page_cache_release(page);
+	}
+	up(&inode->i_sem);
+	return err;
+}
+
+/*
+ * Transfer a buffer straight between its page and the disk blocks of
+ * the backing file.  -ENOTBLK means the filesystem can't, because the
+ * buffer isn't aligned to its blocks or a write would fill a hole.
+ */
+static int lo_direct_io(struct loop_device *lo, struct kiobuf *iobuf,
+			struct buffer_head *bh, int rw, loff_t pos)
+{
+	struct file *file = lo->lo_backing_file;
+	struct address_space *mapping = file->f_dentry->d_inode->i_mapping;
+	struct inode *inode = mapping->host;
+	int blkbits = inode->i_blkbits;
+	int ret;
+
+	if (!iobuf || ((pos | bh->b_size | bh_offset(bh)) & ((1 << blkbits) - 1)))
+		return -ENOTBLK;
+
+	iobuf->nr_pages = 1;
+	iobuf->maplist[0] = bh->b_page;
+	iobuf->offset = bh_offset(bh);
+	iobuf->length = bh->b_size;
+
+	/*
+	 * Inside i_size, generic_direct_IO() drops i_sem as soon as the
+	 * blocks are mapped, so the workers only queue up for the lookup.
+	 * Past it, i_sem would be held across the transfer, and a write
+	 * would have to extend the file: that goes the buffered way.
+	 */
+	down_read(&inode->i_alloc_sem);
+	down(&inode->i_sem);
+	if (pos + bh->b_size > inode->i_size)
+		ret = -ENOTBLK;
+	else if (mapping->a_ops->direct_fileIO)
+		ret = mapping->a_ops->direct_fileIO(rw, file, iobuf,
+						    pos >> blkbits, 1 << blkbits);
+	else
+		ret = mapping->a_ops->direct_IO(rw, inode, iobuf,
+						pos >> blkbits, 1 << blkbits);
+	up(&inode->i_sem);
+	up_read(&inode->i_alloc_sem);
+
+	iobuf->nr_pages = 0;
+	if (ret == bh->b_size)
+		return 0;
+	return ret == -ENOTBLK ? ret : -EIO;
+}
+
+static int do_bh_filebacked(struct loop_device *lo, struct kiobuf *iobuf,
+			    struct buffer_head *bh, int rw)
 {
 	loff_t pos;
 	int ret;
 
 	pos = ((loff_t) bh->b_rsector << 9) + lo->lo_offset;
 
+	if (lo->lo_flags & LO_FLAGS_DIRECT_IO) {
+		ret = lo_direct_io(lo, iobuf, bh, rw, pos);
+		if (ret != -ENOTBLK)
+			return ret;
+	}
+
 	if (rw == WRITE)
 		ret = lo_send(lo, bh, loop_get_bs(lo), pos);
 	else
 		ret = lo_receive(lo, bh, loop_get_bs(lo), pos);
 
+	if (!ret && (lo->lo_flags & LO_FLAGS_DIRECT_IO))
+		ret = lo_sync_range(lo, pos, bh->b_size);
+
 	return ret;
 }
 
+/*
+ * Use direct I/O if the backing file was opened with O_DIRECT, its
+ * filesystem can do it and no transfer function needs to see the data.
+ * The loop device then takes no blocks smaller than the backing
+ * filesystem's, as direct I/O couldn't do them.
+ */
+static void loop_update_dio(struct loop_device *lo)
+{
+	struct file *file = lo->lo_backing_file;
+	struct inode *inode = file->f_dentry->d_inode;
+	struct address_space_operations *aops = inode->i_mapping->a_ops;
+	int bsize = 1 << inode->i_blkbits;
+
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	loop_hardsizes[lo->lo_number] = 0;
+
+	if (!(lo->lo_flags & LO_FLAGS_DO_BMAP) || !(file->f_flags & O_DIRECT))
+		return;
+	if (!aops->direct_IO && !aops->direct_fileIO)
+		return;
+	if (lo->lo_encrypt_type != LO_CRYPT_NONE || (lo->lo_offset & (bsize - 1)))
+		return;
+	if (lo_sync_cache(lo))
+		return;
+
+	lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+	loop_hardsizes[lo->lo_number] = bsize;
+}
+
+/*
+ * Drop a reference to lo_pending.  The last one goes at tear-down once
+ * all I/O is done, and sends every worker home.
+ */
+static void loop_put_pending(struct loop_device *lo)
+{
+	int i;
+
+	if (atomic_dec_and_test(&lo->lo_pending))
+		for (i = 0; i < lo->lo_threads; i++)
+			up(&lo->lo_bh_mutex);
+}
+
 static void loop_end_io_transfer(struct buffer_head *bh, int uptodate);
 static void loop_put_buffer(struct buffer_head *bh)
 {
@@ -394,8 +557,7 @@ static void loop_end_io_transfer(struct buffer_head *bh, int uptodate)
 		struct buffer_head *rbh = bh->b_private;
 
 		rbh->b_end_io(rbh, uptodate);
-		if (atomic_dec_and_test(&lo->lo_pending))
-			up(&lo->lo_bh_mutex);
+		loop_put_pending(lo);
 		loop_put_buffer(bh);
 	} else
 		loop_add_bh(lo, bh);
@@ -519,8 +681,7 @@ static int loop_make_request(request_queue_t *q, int rw, struct buffer_head *rbh
 	return 0;
 
 err:
-	if (atomic_dec_and_test(&lo->lo_pending))
-		up(&lo->lo_bh_mutex);
+	loop_put_pending(lo);
 	loop_put_buffer(bh);
 out:
 	buffer_IO_error(rbh);
@@ -530,7 +691,8 @@ inactive:
 	goto out;
 }
 
-static inline void loop_handle_bh(struct loop_device *lo,struct buffer_head *bh)
+static inline void loop_handle_bh(struct loop_device *lo, struct kiobuf *iobuf,
+				  struct buffer_head *bh)
 {
 	int ret;
 
@@ -540,7 +702,7 @@ static inline void loop_handle_bh(struct loop_device *lo,struct buffer_head *bh)
 	if (lo->lo_flags & LO_FLAGS_DO_BMAP) {
 		int rw = !!test_and_clear_bit(BH_Dirty, &bh->b_state);
 
-		ret = do_bh_filebacked(lo, bh, rw);
+		ret = do_bh_filebacked(lo, iobuf, bh, rw);
 		bh->b_end_io(bh, !ret);
 	} else {
 		struct buffer_head *rbh = bh->b_private;
@@ -559,11 +721,16 @@ static inline void loop_handle_bh(struct loop_device *lo,struct buffer_head *bh)
  * to avoid blocking in our make_request_fn. it also does loop decrypting
  * on reads for block backed loop, as that is too heavy to do from
  * b_end_io context where irqs may be disabled.
+ *
+ * there are lo_threads of them, each taking buffers off lo_bh one at a
+ * time, so that a slow read of the backing file doesn't hold up
+ * everything queued behind it.
  */
 static int loop_thread(void *data)
 {
 	struct loop_device *lo = data;
 	struct buffer_head *bh;
+	struct kiobuf *iobuf;
 
 	daemonize();
 	exit_files(current);
@@ -576,10 +743,9 @@ static int loop_thread(void *data)
 	flush_signals(current);
 	spin_unlock_irq(&current->sigmask_lock);
 
-	spin_lock_irq(&lo->lo_lock);
-	lo->lo_state = Lo_bound;
-	atomic_inc(&lo->lo_pending);
-	spin_unlock_irq(&lo->lo_lock);
+	/* without one, direct I/O falls back to the page cache */
+	if (alloc_kiovec(1, &iobuf))
+		iobuf = NULL;
 
 	current->flags |= PF_NOIO;
 
@@ -602,16 +768,17 @@ static int loop_thread(void *data)
 			printk("loop: missing bh\n");
 			continue;
 		}
-		loop_handle_bh(lo, bh);
+		loop_handle_bh(lo, iobuf, bh);
 
 		/*
-		 * upped both for pending work and tear-down, lo_pending
-		 * will hit zero then
+		 * lo_pending hits zero here if we were the last one busy
+		 * at tear-down, the up()s will then see everybody out
 		 */
-		if (atomic_dec_and_test(&lo->lo_pending))
-			break;
+		loop_put_pending(lo);
 	}
 
+	if (iobuf)
+		free_kiovec(1, &iobuf);
 	up(&lo->lo_sem);
 	return 0;
 }
@@ -624,7 +791,7 @@ static int loop_set_fd(struct loop_device *lo, struct file *lo_file, kdev_t dev,
 	kdev_t		lo_device;
 	int		lo_flags = 0;
 	int		error;
-	int		bs;
+	int		bs, i;
 
 	MOD_INC_USE_COUNT;
 
@@ -683,18 +850,39 @@ static int loop_set_fd(struct loop_device *lo, struct file *lo_file, kdev_t dev,
 	figure_loop_size(lo);
 	lo->old_gfp_mask = inode->i_mapping->gfp_mask;
 	inode->i_mapping->gfp_mask &= ~(__GFP_IO|__GFP_FS);
+	loop_update_dio(lo);
 
 	bs = 0;
 	if (blksize_size[MAJOR(lo_device)])
 		bs = blksize_size[MAJOR(lo_device)][MINOR(lo_device)];
 	if (!bs)
 		bs = BLOCK_SIZE;
+	if (bs < loop_hardsizes[lo->lo_number])
+		bs = loop_hardsizes[lo->lo_number];
 
 	set_blocksize(dev, bs);
 
 	lo->lo_bh = lo->lo_bhtail = NULL;
-	kernel_thread(loop_thread, lo, CLONE_FS | CLONE_FILES | CLONE_SIGHAND);
-	down(&lo->lo_sem);
+	for (i = 0; i < loop_threads; i++) {
+		if (kernel_thread(loop_thread, lo,
+				  CLONE_FS | CLONE_FILES | CLONE_SIGHAND) < 0)
+			break;
+		down(&lo->lo_sem);
+	}
+	lo->lo_threads = i;
+	if (!i) {
+		inode->i_mapping->gfp_mask = lo->old_gfp_mask;
+		loop_hardsizes[lo->lo_number] = 0;
+		lo->lo_backing_file = NULL;
+		fput(file);
+		error = -EAGAIN;
+		goto out_putf;
+	}
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_state = Lo_bound;
+	atomic_inc(&lo->lo_pending);
+	spin_unlock_irq(&lo->lo_lock);
 
 	fput(file);
 	return 0;
@@ -740,6 +928,7 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 {
 	struct file *filp = lo->lo_backing_file;
 	int gfp = lo->old_gfp_mask;
+	int i;
 
 	if (lo->lo_state != Lo_bound)
 		return -ENXIO;
@@ -750,11 +939,12 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_state = Lo_rundown;
-	if (atomic_dec_and_test(&lo->lo_pending))
-		up(&lo->lo_bh_mutex);
+	loop_put_pending(lo);
 	spin_unlock_irq(&lo->lo_lock);
 
-	down(&lo->lo_sem);
+	for (i = 0; i < lo->lo_threads; i++)
+		down(&lo->lo_sem);
+	lo->lo_threads = 0;
 
 	lo->lo_backing_file = NULL;
 
@@ -769,6 +959,7 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 	memset(lo->lo_encrypt_key, 0, LO_KEY_SIZE);
 	memset(lo->lo_name, 0, LO_NAME_SIZE);
 	loop_sizes[lo->lo_number] = 0;
+	loop_hardsizes[lo->lo_number] = 0;
 	invalidate_bdev(bdev, 0);
 	filp->f_dentry->d_inode->i_mapping->gfp_mask = gfp;
 	lo->lo_state = Lo_unbound;
@@ -817,6 +1008,7 @@ static int loop_set_status(struct loop_device *lo, struct loop_info *arg)
 		lo->lo_key_owner = current->uid; 
 	}	
 	figure_loop_size(lo);
+	loop_update_dio(lo);
 	return 0;
 }
 
@@ -970,6 +1162,8 @@ static struct block_device_operations lo_fops = {
  */
 MODULE_PARM(max_loop, "i");
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices (1-256)");
+MODULE_PARM(loop_threads, "i");
+MODULE_PARM_DESC(loop_threads, "Worker threads per loop device (1-16)");
 MODULE_LICENSE("GPL");
 
 int loop_register_transfer(struct loop_func_table *funcs)
@@ -1010,6 +1204,11 @@ int __init loop_init(void)
 				    " 1 and 256), using default (8)\n");
 		max_loop = 8;
 	}
+	if ((loop_threads < 1) || (loop_threads > LO_MAX_THREADS)) {
+		printk(KERN_WARNING "loop: invalid loop_threads (must be between"
+				    " 1 and %d), using 1\n", LO_MAX_THREADS);
+		loop_threads = 1;
+	}
 
 	if (devfs_register_blkdev(MAJOR_NR, "loop", &lo_fops)) {
 		printk(KERN_WARNING "Unable to get major number %d for loop"
@@ -1030,6 +1229,10 @@ int __init loop_init(void)
 	if (!loop_blksizes)
 		goto out_blksizes;
 
+	loop_hardsizes = kmalloc(max_loop * sizeof(int), GFP_KERNEL);
+	if (!loop_hardsizes)
+		goto out_hardsizes;
+
 	blk_queue_make_request(BLK_DEFAULT_QUEUE(MAJOR_NR), loop_make_request);
 
 	for (i = 0; i < max_loop; i++) {
@@ -1044,8 +1247,10 @@ int __init loop_init(void)
 
 	memset(loop_sizes, 0, max_loop * sizeof(int));
 	memset(loop_blksizes, 0, max_loop * sizeof(int));
+	memset(loop_hardsizes, 0, max_loop * sizeof(int));
 	blk_size[MAJOR_NR] = loop_sizes;
 	blksize_size[MAJOR_NR] = loop_blksizes;
+	hardsect_size[MAJOR_NR] = loop_hardsizes;
 	for (i = 0; i < max_loop; i++)
 		register_disk(NULL, MKDEV(MAJOR_NR, i), 1, &lo_fops, 0);
 
@@ -1058,6 +1263,8 @@ int __init loop_init(void)
 	printk(KERN_INFO "loop: loaded (max %d devices)\n", max_loop);
 	return 0;
 
+out_hardsizes:
+	kfree(loop_blksizes);
 out_blksizes:
 	kfree(loop_sizes);
 out_sizes:
@@ -1073,9 +1280,13 @@ void loop_exit(void)
 	devfs_unregister(devfs_handle);
 	if (devfs_unregister_blkdev(MAJOR_NR, "loop"))
 		printk(KERN_WARNING "loop: cannot unregister blkdev\n");
+	blk_size[MAJOR_NR] = NULL;
+	blksize_size[MAJOR_NR] = NULL;
+	hardsect_size[MAJOR_NR] = NULL;
 	kfree(loop_dev);
 	kfree(loop_sizes);
 	kfree(loop_blksizes);
+	kfree(loop_hardsizes);
 }
 
 module_init(loop_init);
@@ -1089,4 +1300,12 @@ static int __init max_loop_setup(char *str)
 }
 
 __setup("max_loop=", max_loop_setup);
+
+static int __init loop_threads_setup(char *str)
+{
+	loop_threads = simple_strtol(str, NULL, 0);
+	return 1;
+}
+
+__setup("loop_threads=", loop_threads_setup);
 #endif
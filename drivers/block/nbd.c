@@ -28,6 +28,10 @@
  *   the transmit lock. <steve@chygwyn.com>
  * 02-10-11 Allow hung xmit to be aborted via SIGKILL & various fixes.
  *   <Paul.Clements@SteelEye.com> <James.Bottomley@SteelEye.com>
+ * Up to NBD_MAX_CONNS sockets per device: NBD_SET_SOCK adds one, every
+ *   NBD_DO_IT caller reads the replies of the next one, requests are
+ *   sent round robin to those with a reader and matched to replies by
+ *   handle per socket.
  *
  * possible FIXME: make set_sock / set_blksize / set_size / do_it one syscall
  * why not: would need verify_area and friends, would share yet another 
@@ -164,12 +168,12 @@ static int nbd_xmit(int send, struct socket *sock, char *buf, int size, int msg_
 
 #define FAIL( s ) { printk( KERN_ERR "NBD: " s "(result %d)\n", result ); goto error_out; }
 
-void nbd_send_req(struct nbd_device *lo, struct request *req)
+void nbd_send_req(struct nbd_conn *conn, struct request *req)
 {
 	int result = -1;
 	struct nbd_request request;
 	unsigned long size = req->nr_sectors << 9;
-	struct socket *sock = lo->sock;
+	struct socket *sock = conn->sock;
 
 	DEBUG("NBD: sending control, ");
 	request.magic = htonl(NBD_REQUEST_MAGIC);
@@ -178,9 +182,9 @@ void nbd_send_req(struct nbd_device *lo, struct request *req)
 	request.len = htonl(size);
 	memcpy(request.handle, &req, sizeof(req));
 
-	down(&lo->tx_lock);
+	down(&conn->tx_lock);
 
-	if (!sock || !lo->sock) {
+	if (!sock || !conn->sock) {
 		FAIL("Attempted sendmsg to closed socket\n");
 	}
 
@@ -198,15 +202,16 @@ void nbd_send_req(struct nbd_device *lo, struct request *req)
 			bh = bh->b_reqnext;
 		} while(bh);
 	}
-	up(&lo->tx_lock);
+	up(&conn->tx_lock);
 	return;
 
 error_out:
-	up(&lo->tx_lock);
+	up(&conn->tx_lock);
 	req->errors++;
 }
 
-static struct request *nbd_find_request(struct nbd_device *lo, char *handle)
+static struct request *nbd_find_request(struct nbd_device *lo,
+					struct nbd_conn *conn, char *handle)
 {
 	struct request *req;
 	struct list_head *tmp;
@@ -215,7 +220,7 @@ static struct request *nbd_find_request(struct nbd_device *lo, char *handle)
 	memcpy(&xreq, handle, sizeof(xreq));
 
 	spin_lock(&lo->queue_lock);
-	list_for_each(tmp, &lo->queue_head) {
+	list_for_each(tmp, &conn->queue_head) {
 		req = list_entry(tmp, struct request, queue);
 		if (req != xreq)
 			continue;
@@ -228,7 +233,8 @@ static struct request *nbd_find_request(struct nbd_device *lo, char *handle)
 }
 
 #define HARDFAIL( s ) { printk( KERN_ERR "NBD: " s "(result %d)\n", result ); lo->harderror = result; return NULL; }
-struct request *nbd_read_stat(struct nbd_device *lo)
+struct request *nbd_read_stat(struct nbd_device *lo, struct nbd_conn *conn,
+			      struct socket *sock)
 		/* NULL returned = something went wrong, inform userspace       */ 
 {
 	int result;
@@ -237,10 +243,10 @@ struct request *nbd_read_stat(struct nbd_device *lo)
 
 	DEBUG("reading control, ");
 	reply.magic = 0;
-	result = nbd_xmit(0, lo->sock, (char *) &reply, sizeof(reply), MSG_WAITALL);
+	result = nbd_xmit(0, sock, (char *) &reply, sizeof(reply), MSG_WAITALL);
 	if (result <= 0)
 		HARDFAIL("Recv control failed.");
-	req = nbd_find_request(lo, reply.handle);
+	req = nbd_find_request(lo, conn, reply.handle);
 	if (req == NULL)
 		HARDFAIL("Unexpected reply");
 
@@ -253,7 +259,7 @@ struct request *nbd_read_stat(struct nbd_device *lo)
 		struct buffer_head *bh = req->bh;
 		DEBUG("data, ");
 		do {
-			result = nbd_xmit(0, lo->sock, bh->b_data, bh->b_size, MSG_WAITALL);
+			result = nbd_xmit(0, sock, bh->b_data, bh->b_size, MSG_WAITALL);
 			if (result <= 0)
 				HARDFAIL("Recv data failed.");
 			bh = bh->b_reqnext;
@@ -268,12 +274,21 @@ struct request *nbd_read_stat(struct nbd_device *lo)
 	return req;
 }
 
-void nbd_do_it(struct nbd_device *lo)
+/*
+ * The socket is looked up once: conn->sock goes NULL as soon as the
+ * device is torn down, but the socket stays until the last NBD_DO_IT
+ * caller has left and the files are put.
+ */
+void nbd_do_it(struct nbd_device *lo, struct nbd_conn *conn)
 {
+	struct socket *sock = conn->sock;
 	struct request *req;
 
+	if (!sock)
+		return;
+
 	while (1) {
-		req = nbd_read_stat(lo);
+		req = nbd_read_stat(lo, conn, sock);
 
 		if (!req) {
 			printk(KERN_ALERT "req should never be null\n" );
@@ -300,6 +315,7 @@ void nbd_do_it(struct nbd_device *lo)
 void nbd_clear_que(struct nbd_device *lo)
 {
 	struct request *req;
+	int i;
 
 #ifdef PARANOIA
 	if (lo->magic != LO_MAGIC) {
@@ -307,20 +323,70 @@ void nbd_clear_que(struct nbd_device *lo)
 		return;
 	}
 #endif
-	do {
-		req = NULL;
-		spin_lock(&lo->queue_lock);
-		if (!list_empty(&lo->queue_head)) {
-			req = list_entry(lo->queue_head.next, struct request, queue);
-			list_del(&req->queue);
-		}
-		spin_unlock(&lo->queue_lock);
-		if (req) {
-			req->errors++;
-			nbd_end_request(req);
+	for (i = 0; i < NBD_MAX_CONNS; i++) {
+		struct nbd_conn *conn = &lo->conns[i];
+
+		do {
+			req = NULL;
+			spin_lock(&lo->queue_lock);
+			if (!list_empty(&conn->queue_head)) {
+				req = list_entry(conn->queue_head.next, struct request, queue);
+				list_del(&req->queue);
+			}
+			spin_unlock(&lo->queue_lock);
+			if (req) {
+				req->errors++;
+				nbd_end_request(req);
+			}
+		} while(req);
+	}
+}
+
+/*
+ * Stop sending on every socket of the device, and with @shutdown make
+ * the receivers of all of them give up too.
+ */
+static void nbd_clear_socks(struct nbd_device *lo, int shutdown)
+{
+	int i;
+
+	for (i = 0; i < NBD_MAX_CONNS; i++) {
+		struct nbd_conn *conn = &lo->conns[i];
+
+		down(&conn->tx_lock);
+		if (conn->sock && shutdown) {
+			printk(KERN_WARNING "nbd: shutting down socket\n");
+			conn->sock->ops->shutdown(conn->sock,
+				SEND_SHUTDOWN|RCV_SHUTDOWN);
 		}
-	} while(req);
+		conn->sock = NULL;
+		up(&conn->tx_lock);
+	}
+}
 
+/*
+ * Take the sockets away from the device, fail whatever was waiting for
+ * a reply on them and drop the files.
+ */
+static void nbd_release_socks(struct nbd_device *lo)
+{
+	struct file *files[NBD_MAX_CONNS];
+	int i, nr;
+
+	spin_lock(&lo->queue_lock);
+	nr = lo->nr_conns;
+	for (i = 0; i < nr; i++) {
+		files[i] = lo->conns[i].file;
+		lo->conns[i].file = NULL;
+	}
+	lo->nr_conns = 0;
+	lo->next_conn = 0;
+	spin_unlock(&lo->queue_lock);
+
+	nbd_clear_que(lo);
+	for (i = 0; i < nr; i++)
+		if (files[i])
+			fput(files[i]);
 }
 
 /*
@@ -338,6 +404,7 @@ static void do_nbd_request(request_queue_t * q)
 	struct request *req;
 	int dev = 0;
 	struct nbd_device *lo;
+	struct nbd_conn *conn;
 
 	while (!QUEUE_EMPTY) {
 		req = CURRENT;
@@ -351,7 +418,7 @@ static void do_nbd_request(request_queue_t * q)
 			FAIL("Minor too big.");		/* Probably can not happen */
 #endif
 		lo = &nbd_dev[dev];
-		if (!lo->file)
+		if (!lo->nr_conns)
 			FAIL("Request when not-ready.");
 		if ((req->cmd == WRITE) && (lo->flags & NBD_READ_ONLY))
 			FAIL("Write on read-only");
@@ -365,7 +432,7 @@ static void do_nbd_request(request_queue_t * q)
 		spin_unlock_irq(&io_request_lock);
 
 		spin_lock(&lo->queue_lock);
-		if (!lo->file) {
+		if (!lo->nr_conns) {
 			spin_unlock(&lo->queue_lock);
 			printk(KERN_ERR "nbd: failed between accept and semaphore, file lost\n");
 			req->errors++;
@@ -374,10 +441,17 @@ static void do_nbd_request(request_queue_t * q)
 			continue;
 		}
 
-		list_add_tail(&req->queue, &lo->queue_head);
+		/*
+		 * Only to sockets somebody reads the replies of: receivers
+		 * take conns[] in order.  Until the first NBD_DO_IT the
+		 * first socket queues them up for its reader, as a single
+		 * socket device always did.
+		 */
+		conn = &lo->conns[lo->next_conn++ % max(lo->receivers, 1)];
+		list_add_tail(&req->queue, &conn->queue_head);
 		spin_unlock(&lo->queue_lock);
 
-		nbd_send_req(lo, req);
+		nbd_send_req(conn, req);
 		if (req->errors) {
 			printk(KERN_ERR "nbd: nbd_send_req failed\n");
 			spin_lock(&lo->queue_lock);
@@ -405,7 +479,8 @@ static int nbd_ioctl(struct inode *inode, struct file *file,
 		     unsigned int cmd, unsigned long arg)
 {
 	struct nbd_device *lo;
-	int dev, error, temp;
+	struct nbd_conn *conn;
+	int dev, error, temp, last;
 	struct request sreq ;
 
 	/* Anyone capable of this syscall can do *real bad* things */
@@ -423,39 +498,37 @@ static int nbd_ioctl(struct inode *inode, struct file *file,
 	case NBD_DISCONNECT:
 	        printk("NBD_DISCONNECT\n");
                 sreq.cmd=2 ; /* shutdown command */
-                if (!lo->sock) return -EINVAL;
-                nbd_send_req(lo, &sreq);
+                if (!lo->conns[0].sock) return -EINVAL;
+                nbd_send_req(&lo->conns[0], &sreq);
                 return 0 ;
  
 	case NBD_CLEAR_SOCK:
 		error = 0;
-		down(&lo->tx_lock);
-		lo->sock = NULL;
-		up(&lo->tx_lock);
+		nbd_clear_socks(lo, 0);
+		nbd_release_socks(lo);
 		spin_lock(&lo->queue_lock);
-		file = lo->file;
-		lo->file = NULL;
+		for (temp = 0; temp < NBD_MAX_CONNS; temp++)
+			if (!list_empty(&lo->conns[temp].queue_head))
+				error = -EBUSY;
 		spin_unlock(&lo->queue_lock);
-		nbd_clear_que(lo);
-		spin_lock(&lo->queue_lock);
-		if (!list_empty(&lo->queue_head)) {
+		if (error)
 			printk(KERN_ERR "nbd: disconnect: some requests are in progress -> please try again.\n");
-			error = -EBUSY;
-		}
-		spin_unlock(&lo->queue_lock);
-		if (file)
-			fput(file);
 		return error;
 	case NBD_SET_SOCK:
-		if (lo->file)
+		/* sockets can only be added before anybody runs NBD_DO_IT */
+		if (lo->nr_conns == NBD_MAX_CONNS || lo->receivers)
 			return -EBUSY;
 		error = -EINVAL;
 		file = fget(arg);
 		if (file) {
 			inode = file->f_dentry->d_inode;
 			/* N.B. Should verify that it's a socket */
-			lo->file = file;
-			lo->sock = &inode->u.socket_i;
+			conn = &lo->conns[lo->nr_conns];
+			conn->file = file;
+			conn->sock = &inode->u.socket_i;
+			spin_lock(&lo->queue_lock);
+			lo->nr_conns++;
+			spin_unlock(&lo->queue_lock);
 			error = 0;
 		}
 		return error;
@@ -481,47 +554,46 @@ static int nbd_ioctl(struct inode *inode, struct file *file,
 		nbd_sizes[dev] = nbd_bytesizes[dev] >> BLOCK_SIZE_BITS;
 		return 0;
 	case NBD_DO_IT:
-		if (!lo->file)
-			return -EINVAL;
-		nbd_do_it(lo);
+		/* every caller reads the replies of the next socket */
+		spin_lock(&lo->queue_lock);
+		if (lo->receivers >= lo->nr_conns) {
+			spin_unlock(&lo->queue_lock);
+			return lo->nr_conns ? -EBUSY : -EINVAL;
+		}
+		conn = &lo->conns[lo->receivers++];
+		spin_unlock(&lo->queue_lock);
+
+		nbd_do_it(lo, conn);
 		/* on return tidy up in case we have a signal */
-		/* Forcibly shutdown the socket causing all listeners
-		 * to error
+		/* Forcibly shutdown the sockets causing all listeners
+		 * to error, one lost connection takes the device down
 		 *
 		 * FIXME: This code is duplicated from sys_shutdown, but
 		 * there should be a more generic interface rather than
 		 * calling socket ops directly here */
-		down(&lo->tx_lock);
-		if (lo->sock) {
-			printk(KERN_WARNING "nbd: shutting down socket\n");
-			lo->sock->ops->shutdown(lo->sock,
-				SEND_SHUTDOWN|RCV_SHUTDOWN);
-			lo->sock = NULL;
-		}
-		up(&lo->tx_lock);
+		nbd_clear_socks(lo, 1);
 		spin_lock(&lo->queue_lock);
-		file = lo->file;
-		lo->file = NULL;
+		last = !--lo->receivers;
 		spin_unlock(&lo->queue_lock);
-		nbd_clear_que(lo);
-		printk(KERN_WARNING "nbd: queue cleared\n");
-		if (file)
-			fput(file);
+		if (last) {
+			nbd_release_socks(lo);
+			printk(KERN_WARNING "nbd: queue cleared\n");
+		}
 		return lo->harderror;
 	case NBD_CLEAR_QUE:
-		down(&lo->tx_lock);
-		if (lo->sock) {
-			up(&lo->tx_lock);
+		if (lo->nr_conns)
 			return 0; /* probably should be error, but that would
 				   * break "nbd-client -d", so just return 0 */
-		}
-		up(&lo->tx_lock);
 		nbd_clear_que(lo);
 		return 0;
 #ifdef PARANOIA
 	case NBD_PRINT_DEBUG:
-		printk(KERN_INFO "NBD device %d: next = %p, prev = %p. Global: in %d, out %d\n",
-		       dev, lo->queue_head.next, lo->queue_head.prev, requests_in, requests_out);
+		for (temp = 0; temp < lo->nr_conns; temp++)
+			printk(KERN_INFO "NBD device %d socket %d: next = %p, prev = %p.\n",
+			       dev, temp, lo->conns[temp].queue_head.next,
+			       lo->conns[temp].queue_head.prev);
+		printk(KERN_INFO "NBD device %d: Global: in %d, out %d\n",
+		       dev, requests_in, requests_out);
 		return 0;
 #endif
 	case BLKGETSIZE:
@@ -585,13 +657,23 @@ static int __init nbd_init(void)
 	blk_init_queue(BLK_DEFAULT_QUEUE(MAJOR_NR), do_nbd_request);
 	blk_queue_headactive(BLK_DEFAULT_QUEUE(MAJOR_NR), 0);
 	for (i = 0; i < MAX_NBD; i++) {
+		int j;
+
 		nbd_dev[i].refcnt = 0;
-		nbd_dev[i].file = NULL;
+		nbd_dev[i].nr_conns = 0;
+		nbd_dev[i].receivers = 0;
+		nbd_dev[i].next_conn = 0;
 		nbd_dev[i].magic = LO_MAGIC;
 		nbd_dev[i].flags = 0;
 		spin_lock_init(&nbd_dev[i].queue_lock);
-		INIT_LIST_HEAD(&nbd_dev[i].queue_head);
-		init_MUTEX(&nbd_dev[i].tx_lock);
+		for (j = 0; j < NBD_MAX_CONNS; j++) {
+			struct nbd_conn *conn = &nbd_dev[i].conns[j];
+
+			conn->sock = NULL;
+			conn->file = NULL;
+			INIT_LIST_HEAD(&conn->queue_head);
+			init_MUTEX(&conn->tx_lock);
+		}
 		nbd_blksizes[i] = 1024;
 		nbd_blksize_bits[i] = 10;
 		nbd_bytesizes[i] = ((u64)0x7ffffc00) << 10; /* 2TB */
@@ -187,6 +187,15 @@ static int mmap_mem(struct file * file, struct vm_area_struct * vma)
 {
 	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
 
+#ifdef pgprot_writecombine
+	/*
+	 * Device memory can be mapped write-combining on request (see
+	 * ioctl_mem).  Never RAM: the kernel maps that cached already.
+	 */
+	if (file->private_data && offset >= __pa(high_memory))
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	else
+#endif
 	/*
 	 * Accessing memory above the top the kernel knows about or
 	 * through a file pointer that was marked O_SYNC will be
@@ -620,11 +629,31 @@ static int mmap_kmem(struct file * file, struct vm_area_struct * vma)
 #define open_mem	open_port
 #define open_kmem	open_mem
 
+/*
+ * MEMIOC_WRITE_COMBINE with a non-zero argument asks for the mappings
+ * of device memory made through this file to be write-combining, for
+ * X servers and the like streaming into a frame buffer.
+ */
+static int ioctl_mem(struct inode * inode, struct file * file,
+		     unsigned int cmd, unsigned long arg)
+{
+	switch (cmd) {
+#ifdef pgprot_writecombine
+	case MEMIOC_WRITE_COMBINE:
+		file->private_data = (void *) (arg != 0);
+		return 0;
+#endif
+	default:
+		return -ENOTTY;
+	}
+}
+
 static struct file_operations mem_fops = {
 	llseek:		memory_lseek,
 	read:		read_mem,
 	write:		write_mem,
 	mmap:		mmap_mem,
+	ioctl:		ioctl_mem,
 	open:		open_mem,
 };
 
@@ -15,6 +15,7 @@
 #include <linux/raw.h>
 #include <linux/capability.h>
 #include <linux/smp_lock.h>
+#include <linux/aio.h>
 #include <asm/uaccess.h>
 
 #define dprintk(x...) 
@@ -31,6 +32,8 @@ static ssize_t rw_raw_dev(int rw, struct file *, char *, size_t, loff_t *);
 
 ssize_t	raw_read(struct file *, char *, size_t, loff_t *);
 ssize_t	raw_write(struct file *, const char *, size_t, loff_t *);
+ssize_t	raw_aio_read(struct kiocb *, char *, size_t, loff_t);
+ssize_t	raw_aio_write(struct kiocb *, const char *, size_t, loff_t);
 int	raw_open(struct inode *, struct file *);
 int	raw_release(struct inode *, struct file *);
 int	raw_ctl_ioctl(struct inode *, struct file *, unsigned int, unsigned long);
@@ -40,6 +43,8 @@ int	raw_ioctl(struct inode *, struct file *, unsigned int, unsigned long);
 static struct file_operations raw_fops = {
 	read:		raw_read,
 	write:		raw_write,
+	aio_read:	raw_aio_read,
+	aio_write:	raw_aio_write,
 	open:		raw_open,
 	release:	raw_release,
 	ioctl:		raw_ioctl,
@@ -284,6 +289,19 @@ ssize_t	raw_write(struct file *filp, const char *buf,
 	return rw_raw_dev(WRITE, filp, (char *) buf, size, offp);
 }
 
+static ssize_t raw_aio_rw(int rw, struct kiocb *, char *, size_t, loff_t);
+
+ssize_t	raw_aio_read(struct kiocb *iocb, char *buf, size_t size, loff_t pos)
+{
+	return raw_aio_rw(READ, iocb, buf, size, pos);
+}
+
+ssize_t	raw_aio_write(struct kiocb *iocb, const char *buf, size_t size,
+		      loff_t pos)
+{
+	return raw_aio_rw(WRITE, iocb, (char *) buf, size, pos);
+}
+
 #define SECTOR_BITS 9
 #define SECTOR_SIZE (1U << SECTOR_BITS)
 #define SECTOR_MASK (SECTOR_SIZE - 1)
@@ -402,3 +420,53 @@ ssize_t	rw_raw_dev(int rw, struct file *filp, char *buf,
  out:	
 	return err;
 }
+
+/*
+ * io_submit() entry: transfers that fit in one kiobuf are started here
+ * and complete through aio_complete().  Bigger ones are done by
+ * rw_raw_dev() before io_submit() returns.
+ */
+static ssize_t raw_aio_rw(int rw, struct kiocb *iocb, char *buf,
+			  size_t size, loff_t pos)
+{
+	struct file	*filp = iocb->ki_filp;
+	int		minor = MINOR(filp->f_dentry->d_inode->i_rdev);
+	kdev_t		dev;
+	unsigned long	blocknr, blocks, limit;
+	int		sector_size, sector_bits, sector_mask;
+	int		err, i;
+
+	if (size > (KIO_MAX_ATOMIC_IO << 10))
+		return -ENOTBLK;
+
+	dev = to_kdev_t(raw_devices[minor].binding->bd_dev);
+	sector_size = raw_devices[minor].sector_size;
+	sector_bits = raw_devices[minor].sector_bits;
+	sector_mask = sector_size - 1;
+
+	if (blk_size[MAJOR(dev)])
+		limit = (((loff_t) blk_size[MAJOR(dev)][MINOR(dev)]) << BLOCK_SIZE_BITS) >> sector_bits;
+	else
+		limit = INT_MAX;
+
+	if ((pos & sector_mask) || (size & sector_mask))
+		return -EINVAL;
+	if (!size)
+		return 0;
+	blocknr = pos >> sector_bits;
+	if (blocknr >= limit)
+		return -ENXIO;
+	blocks = size >> sector_bits;
+	if (blocks > limit - blocknr)
+		blocks = limit - blocknr;
+
+	err = aio_kiobuf_map(iocb, rw, buf, blocks << sector_bits, NULL);
+	if (err)
+		return err;
+	for (i = 0; i < blocks; i++)
+		iocb->ki_iobuf->blocks[i] = blocknr++;
+
+	aio_kiobuf_submitted(iocb, brw_kiovec(rw, 1, &iocb->ki_iobuf, dev,
+					      iocb->ki_iobuf->blocks, sector_size));
+	return -EIOCBQUEUED;
+}
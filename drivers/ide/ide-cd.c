@@ -549,7 +549,7 @@ static int ide_cdrom_end_request (ide_drive_t *drive, int uptodate)
 	unsigned long flags;
 	int ret = 1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
 
 	/*
@@ -568,7 +568,7 @@ static int ide_cdrom_end_request (ide_drive_t *drive, int uptodate)
 		end_that_request_last(rq);
 		ret = 0;
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return ret;
 }
 
@@ -1372,7 +1372,7 @@ static void cdrom_attempt_remerge(ide_drive_t *drive, struct request *rq)
 	struct request *nxt;
 	unsigned long flags;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 
 	while (1) {
 		entry = rq->queue.next;
@@ -1389,7 +1389,7 @@ static void cdrom_attempt_remerge(ide_drive_t *drive, struct request *rq)
 			break;
 	}
 
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 }
 
 /* Fix up a possibly partially-processed request so that we can
@@ -534,7 +534,7 @@ static int idefloppy_end_request (ide_drive_t *drive, int uptodate)
 	unsigned long flags;
 	int ret = 1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
 
 	/*
@@ -553,7 +553,7 @@ static int idefloppy_end_request (ide_drive_t *drive, int uptodate)
 		end_that_request_last(rq);
 		ret = 0;
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return ret;
 }
 
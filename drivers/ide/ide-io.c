@@ -71,7 +71,7 @@ int ide_end_request (ide_drive_t *drive, int uptodate)
 	unsigned long flags;
 	int ret = 1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
 
 	/*
@@ -91,7 +91,7 @@ int ide_end_request (ide_drive_t *drive, int uptodate)
 		ret = 0;
 	}
 
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return ret;
 }
 
@@ -117,9 +117,9 @@ void ide_end_drive_cmd (ide_drive_t *drive, u8 stat, u8 err)
 	unsigned long flags;
 	struct request *rq;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 
 	switch(rq->cmd) {
 		case IDE_DRIVE_CMD:
@@ -186,11 +186,11 @@ void ide_end_drive_cmd (ide_drive_t *drive, u8 stat, u8 err)
 		default:
 			break;
 	}
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	blkdev_dequeue_request(rq);
 	HWGROUP(drive)->rq = NULL;
 	end_that_request_last(rq);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 }
 
 EXPORT_SYMBOL(ide_end_drive_cmd);
@@ -699,7 +699,7 @@ repeat:
 
 /*
  * Issue a new request to a drive from hwgroup
- * Caller must have already done spin_lock_irqsave(&io_request_lock, ..);
+ * Caller must have already done spin_lock_irqsave(&ide_lock, ..);
  *
  * A hwgroup is a serialized group of IDE interfaces.  Usually there is
  * exactly one hwif (interface) per hwgroup, but buggy controllers (eg. CMD640)
@@ -711,8 +711,11 @@ repeat:
  * possibly along with many other devices.  This is especially common in
  * PCI-based systems with off-board IDE controller cards.
  *
- * The IDE driver uses the single global io_request_lock spinlock to protect
+ * The IDE driver uses the single global ide_lock spinlock to protect
  * access to the request queues, and to protect the hwgroup->busy flag.
+ * It is the queue lock of every IDE drive, so the block layer holds it
+ * when it calls do_ide_request(), but I/O on other block devices does
+ * not contend with it.
  *
  * The first thread into the driver for a particular hwgroup sets the
  * hwgroup->busy flag to indicate that this hwgroup is now active,
@@ -727,7 +730,7 @@ repeat:
  * will start the next request from the queue.  If no more work remains,
  * the driver will clear the hwgroup->busy flag and exit.
  *
- * The io_request_lock (spinlock) is used to protect all access to the
+ * The ide_lock (spinlock) is used to protect all access to the
  * hwgroup->busy flag, but is otherwise not needed for most processing in
  * the driver.  This makes the driver much more friendlier to shared IRQs
  * than previous designs, while remaining 100% (?) SMP safe and capable.
@@ -817,11 +820,11 @@ void ide_do_request (ide_hwgroup_t *hwgroup, int masked_irq)
 		 */
 		if (hwif->irq != masked_irq)
 			disable_irq_nosync(hwif->irq);
-		spin_unlock(&io_request_lock);
+		spin_unlock(&ide_lock);
 		local_irq_enable();
 			/* allow other IRQs while we start this request */
 		startstop = ide_start_request(drive, rq);
-		spin_lock_irq(&io_request_lock);
+		spin_lock_irq(&ide_lock);
 		if (hwif->irq != masked_irq)
 			enable_irq(hwif->irq);
 		if (startstop == ide_stopped)
@@ -930,7 +933,7 @@ void ide_timer_expiry (unsigned long data)
  	unsigned long	flags;
 	unsigned long	wait = -1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 
 	if ((handler = hwgroup->handler) == NULL) {
 		/*
@@ -961,7 +964,7 @@ void ide_timer_expiry (unsigned long data)
 					/* reset timer */
 					hwgroup->timer.expires  = jiffies + wait;
 					add_timer(&hwgroup->timer);
-					spin_unlock_irqrestore(&io_request_lock, flags);
+					spin_unlock_irqrestore(&ide_lock, flags);
 					return;
 				}
 			}
@@ -971,7 +974,7 @@ void ide_timer_expiry (unsigned long data)
 			 * the handler() function, which means we need to
 			 * globally mask the specific IRQ:
 			 */
-			spin_unlock(&io_request_lock);
+			spin_unlock(&ide_lock);
 			hwif  = HWIF(drive);
 #if DISABLE_IRQ_NOSYNC
 			disable_irq_nosync(hwif->irq);
@@ -999,14 +1002,14 @@ void ide_timer_expiry (unsigned long data)
 				}
 			}
 			drive->service_time = jiffies - drive->service_start;
-			spin_lock_irq(&io_request_lock);
+			spin_lock_irq(&ide_lock);
 			enable_irq(hwif->irq);
 			if (startstop == ide_stopped)
 				hwgroup->busy = 0;
 		}
 	}
 	ide_do_request(hwgroup, IDE_NO_IRQ);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 }
 
 EXPORT_SYMBOL(ide_timer_expiry);
@@ -1105,11 +1108,11 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 	ide_handler_t *handler;
 	ide_startstop_t startstop;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	hwif = hwgroup->hwif;
 
 	if (!ide_ack_intr(hwif)) {
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return;
 	}
 
@@ -1145,7 +1148,7 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 			(void) hwif->INB(hwif->io_ports[IDE_STATUS_OFFSET]);
 #endif /* CONFIG_BLK_DEV_IDEPCI */
 		}
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return;
 	}
 	drive = hwgroup->drive;
@@ -1154,7 +1157,7 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 		 * This should NEVER happen, and there isn't much
 		 * we could do about it here.
 		 */
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return;
 	}
 	if (!drive_is_ready(drive)) {
@@ -1165,7 +1168,7 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 		 * their status register is up to date.  Hopefully we have
 		 * enough advance overhead that the latter isn't a problem.
 		 */
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return;
 	}
 	if (!hwgroup->busy) {
@@ -1174,14 +1177,14 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 	}
 	hwgroup->handler = NULL;
 	del_timer(&hwgroup->timer);
-	spin_unlock(&io_request_lock);
+	spin_unlock(&ide_lock);
 
 	if (drive->unmask)
 		local_irq_enable();
 
 	/* service this interrupt, may set handler for next interrupt */
 	startstop = handler(drive);
-	spin_lock_irq(&io_request_lock);
+	spin_lock_irq(&ide_lock);
 
 	/*
 	 * Note that handler() may have set things up for another
@@ -1200,7 +1203,7 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 				"on exit\n", drive->name);
 		}
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 }
 
 EXPORT_SYMBOL(ide_intr);
@@ -1298,7 +1301,7 @@ int ide_do_drive_cmd (ide_drive_t *drive, struct request *rq, ide_action_t actio
 	rq->rq_dev = MKDEV(major,(drive->select.b.unit)<<PARTN_BITS);
 	if (action == ide_wait)
 		rq->waiting = &wait;
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	if (blk_queue_empty(q) || action == ide_preempt) {
 		if (action == ide_preempt)
 			hwgroup->rq = NULL;
@@ -1310,7 +1313,7 @@ int ide_do_drive_cmd (ide_drive_t *drive, struct request *rq, ide_action_t actio
 	}
 	list_add(&rq->queue, queue_head);
 	ide_do_request(hwgroup, IDE_NO_IRQ);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	if (action == ide_wait) {
 		/* wait for it to be serviced */
 		wait_for_completion(&wait);
@@ -981,6 +981,7 @@ static void ide_init_queue(ide_drive_t *drive)
 
 	q->queuedata = HWGROUP(drive);
 	blk_init_queue(q, do_ide_request);
+	blk_queue_lock(q, &ide_lock);
 	blk_queue_throttle_sectors(q, 1);
 }
 
@@ -1016,7 +1017,7 @@ int init_irq (ide_hwif_t *hwif)
 #ifndef __IRQ_HELL_SPIN
 	save_and_cli(flags);
 #else
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 #endif
 
 	hwif->hwgroup = NULL;
@@ -1058,7 +1059,7 @@ int init_irq (ide_hwif_t *hwif)
 #ifndef __IRQ_HELL_SPIN
 			restore_flags(flags);
 #else
-			spin_unlock_irqrestore(&io_request_lock, flags);
+			spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 			return 1;
 		}
@@ -1099,7 +1100,7 @@ int init_irq (ide_hwif_t *hwif)
 #ifndef __IRQ_HELL_SPIN
 			restore_flags(flags);
 #else
-			spin_unlock_irqrestore(&io_request_lock, flags);
+			spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 			return 1;
 		}
@@ -1133,7 +1134,7 @@ int init_irq (ide_hwif_t *hwif)
 #ifndef __IRQ_HELL_SPIN
 	restore_flags(flags);
 #else
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 
 #if !defined(__mc68000__) && !defined(CONFIG_APUS) && !defined(__sparc__)
@@ -1326,13 +1327,6 @@ int hwif_init (ide_hwif_t *hwif)
 	read_ahead[hwif->major] = 8;	/* (4kB) */
 	hwif->present = 1;	/* success */
 
-#if (DEBUG_SPINLOCK > 0)
-{
-	static int done = 0;
-	if (!done++)
-		printk("io_request_lock is %p\n", &io_request_lock);    /* FIXME */
-}
-#endif
 	return hwif->present;
 }
 
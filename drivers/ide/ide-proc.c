@@ -151,7 +151,7 @@ static int proc_ide_write_config
 #ifndef __PROC_HELL
 	save_flags(flags);	/* all CPUs */
 #else
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 #endif
 	do {
 		const char *p;
@@ -164,28 +164,28 @@ static int proc_ide_write_config
 #ifndef __PROC_HELL
 			cli();	/* all CPUs; ensure all writes are done together */
 #else
-			spin_lock_irqsave(&io_request_lock, flags);
+			spin_lock_irqsave(&ide_lock, flags);
 #endif
 			while (mygroup->busy ||
 			       (mategroup && mategroup->busy)) {
 #ifndef __PROC_HELL
 				sti();	/* all CPUs */
 #else
-				spin_unlock_irqrestore(&io_request_lock, flags);
+				spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 				if (time_after(jiffies, timeout)) {
 					printk("/proc/ide/%s/config: channel(s) busy, cannot write\n", hwif->name);
 #ifndef __PROC_HELL
 					restore_flags(flags);	/* all CPUs */
 #else
-					spin_unlock_irqrestore(&io_request_lock, flags);
+					spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 					return -EBUSY;
 				}
 #ifndef __PROC_HELL
 				cli();	/* all CPUs */
 #else
-				spin_lock_irqsave(&io_request_lock, flags);
+				spin_lock_irqsave(&ide_lock, flags);
 #endif
 			}
 		}
@@ -272,7 +272,7 @@ static int proc_ide_write_config
 #ifndef __PROC_HELL
 						restore_flags(flags);	/* all CPUs */
 #else
-						spin_unlock_irqrestore(&io_request_lock, flags);
+						spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 						printk("proc_ide_write_config: error writing %s at bus %02x dev %02x reg 0x%x value 0x%x\n",
 							msg, dev->bus->number, dev->devfn, reg, val);
@@ -318,14 +318,14 @@ static int proc_ide_write_config
 #ifndef __PROC_HELL
 	restore_flags(flags);	/* all CPUs */
 #else
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 	return count;
 parse_error:
 #ifndef __PROC_HELL
 	restore_flags(flags);	/* all CPUs */
 #else
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 #endif
 	printk("parse error\n");
 	return xx_xx_parse_error(start, startn, msg);
@@ -2757,7 +2757,7 @@ static int idetape_do_end_request (ide_drive_t *drive, int uptodate)
 	unsigned long flags;
 	int ret = 1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
 
 	/*
@@ -2776,7 +2776,7 @@ static int idetape_do_end_request (ide_drive_t *drive, int uptodate)
 		end_that_request_last(rq);
 		ret = 0;
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return ret;
 }
 
@@ -6406,14 +6406,14 @@ static int idetape_cleanup (ide_drive_t *drive)
 	int minor = tape->minor;
 	unsigned long flags;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	if (test_bit(IDETAPE_BUSY, &tape->flags) || drive->usage ||
 	    tape->first_stage != NULL || tape->merge_stage_size) {
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return 1;
 	}
 	idetape_chrdevs[minor].drive = NULL;
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	DRIVER(drive)->busy = 0;
 	(void) ide_unregister_subdriver(drive);
 	drive->driver_data = NULL;
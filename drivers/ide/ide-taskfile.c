@@ -353,9 +353,9 @@ void ide_end_taskfile (ide_drive_t *drive, u8 stat, u8 err)
 	ide_task_t *args;
 	task_ioreg_t command;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	args = (ide_task_t *) rq->special;
 
 	command = args->tfRegister[IDE_COMMAND_OFFSET];
@@ -393,11 +393,11 @@ void ide_end_taskfile (ide_drive_t *drive, u8 stat, u8 err)
 		args->posthandler(drive, args);
 #endif
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	blkdev_dequeue_request(rq);
 	HWGROUP(drive)->rq = NULL;
 	end_that_request_last(rq);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 }
 
 EXPORT_SYMBOL(ide_end_taskfile);
@@ -939,10 +939,10 @@ ide_startstop_t task_mulout_intr (ide_drive_t *drive)
 #ifndef ALTERNATE_STATE_DIAGRAM_MULTI_OUT
 	if (HWGROUP(drive)->handler != NULL) {
 		unsigned long lflags;
-		spin_lock_irqsave(&io_request_lock, lflags);
+		spin_lock_irqsave(&ide_lock, lflags);
 		HWGROUP(drive)->handler = NULL;
 		del_timer(&HWGROUP(drive)->timer);
-		spin_unlock_irqrestore(&io_request_lock, lflags);
+		spin_unlock_irqrestore(&ide_lock, lflags);
 	}
 #endif /* ALTERNATE_STATE_DIAGRAM_MULTI_OUT */
 
@@ -1398,11 +1398,11 @@ int ide_diag_taskfile (ide_drive_t *drive, ide_task_t *args, unsigned long data_
 	rq->rq_dev = MKDEV(major,(drive->select.b.unit)<<PARTN_BITS);
 	rq->waiting = &wait;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	queue_head = queue_head->prev;
 	list_add(&rq->queue, queue_head);
 	ide_do_request(hwgroup, 0);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 
 	wait_for_completion(&wait);	/* wait for it to be serviced */
 	return rq->errors ? -EIO : 0;	/* return -EIO if errors */
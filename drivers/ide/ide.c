@@ -197,6 +197,14 @@ ide_hwif_t ide_hwifs[MAX_HWIFS];	/* master data repository */
 
 EXPORT_SYMBOL(ide_hwifs);
 
+/*
+ * Protects the request queues and hwgroups of all the IDE drives, in
+ * place of io_request_lock.
+ */
+spinlock_t ide_lock __cacheline_aligned = SPIN_LOCK_UNLOCKED;
+
+EXPORT_SYMBOL(ide_lock);
+
 ide_devices_t *idedisk;
 ide_devices_t *idecd;
 ide_devices_t *idefloppy;
@@ -464,14 +472,14 @@ int ide_revalidate_disk (kdev_t i_rdev)
 	major = MAJOR(i_rdev);
 	minor = drive->select.b.unit << PARTN_BITS;
 	hwgroup = HWGROUP(drive);
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	if (drive->busy || (drive->usage > 1)) {
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return -EBUSY;
 	};
 	drive->busy = 1;
 	MOD_INC_USE_COUNT;
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 
 	for (p = 0; p < (1<<PARTN_BITS); ++p) {
 		if (drive->part[p].nr_sects > 0) {
@@ -678,7 +686,7 @@ static int ide_prepare_tristate(ide_drive_t *our_drive)
 		
 	if (!hwif->present)
 		BUG();
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	
 	/* Abort if anything is busy */
 	for (unit = 0; unit < MAX_DRIVES; ++unit) {
@@ -709,11 +717,11 @@ static int ide_prepare_tristate(ide_drive_t *our_drive)
 		goto abort_fix;
 	/* Drive shutdown sequence done */
 	/* Prevent new opens ?? */
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	/*
 	 * Flush kernel side caches, and dump the /proc files
 	 */
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	for (unit = 0; unit < MAX_DRIVES; ++unit) {
 		drive = &hwif->drives[unit];
 		if (!drive->present)
@@ -730,7 +738,7 @@ static int ide_prepare_tristate(ide_drive_t *our_drive)
 		destroy_proc_ide_drives(hwif);
 #endif
 	}
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	our_drive->usage++;
 	for (i = 0; i < MAX_DRIVES; ++i) {
 		drive = &hwif->drives[i];
@@ -748,13 +756,13 @@ static int ide_prepare_tristate(ide_drive_t *our_drive)
 		/* Safe to clear now */
 		drive->dead = 0;
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return 0;
 
 abort_fix:
 	our_drive->usage++;
 abort:
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return -EBUSY;
 }
 
@@ -842,7 +850,7 @@ int ide_unregister (unsigned int index)
 	if (index >= MAX_HWIFS)
 		BUG();
 		
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	hwif = &ide_hwifs[index];
 	if (!hwif->present)
 		goto abort;
@@ -860,7 +868,7 @@ int ide_unregister (unsigned int index)
 	/*
 	 * All clear?  Then blow away the buffer cache
 	 */
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	for (unit = 0; unit < MAX_DRIVES; ++unit) {
 		drive = &hwif->drives[unit];
 		if (!drive->present)
@@ -878,7 +886,7 @@ int ide_unregister (unsigned int index)
 #endif
 	}
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	hwgroup = hwif->hwgroup;
 
 	/*
@@ -1086,11 +1094,11 @@ int ide_unregister (unsigned int index)
 	hwif->no_dsc			= old_hwif.no_dsc;
 
 	hwif->hwif_data			= old_hwif.hwif_data;
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return 0;
 
 abort:
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return 1;
 	
 }
@@ -1416,7 +1424,7 @@ int ide_read_setting (ide_drive_t *drive, ide_settings_t *setting)
 	unsigned long	flags;
 
 	if ((setting->rw & SETTING_READ)) {
-		spin_lock_irqsave(&io_request_lock, flags);
+		spin_lock_irqsave(&ide_lock, flags);
 		switch(setting->data_type) {
 			case TYPE_BYTE:
 				val = *((u8 *) setting->data);
@@ -1429,7 +1437,7 @@ int ide_read_setting (ide_drive_t *drive, ide_settings_t *setting)
 				val = *((u32 *) setting->data);
 				break;
 		}
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 	}
 	return val;
 }
@@ -1439,11 +1447,11 @@ int ide_spin_wait_hwgroup (ide_drive_t *drive)
 	ide_hwgroup_t *hwgroup = HWGROUP(drive);
 	unsigned long timeout = jiffies + (3 * HZ);
 
-	spin_lock_irq(&io_request_lock);
+	spin_lock_irq(&ide_lock);
 
 	while (hwgroup->busy) {
 		unsigned long lflags;
-		spin_unlock_irq(&io_request_lock);
+		spin_unlock_irq(&ide_lock);
 		local_irq_set(lflags);
 		if (time_after(jiffies, timeout)) {
 			local_irq_restore(lflags);
@@ -1451,7 +1459,7 @@ int ide_spin_wait_hwgroup (ide_drive_t *drive)
 			return -EBUSY;
 		}
 		local_irq_restore(lflags);
-		spin_lock_irq(&io_request_lock);
+		spin_lock_irq(&ide_lock);
 	}
 	return 0;
 }
@@ -1506,7 +1514,7 @@ int ide_write_setting (ide_drive_t *drive, ide_settings_t *setting, int val)
 				*p = val;
 			break;
 	}
-	spin_unlock_irq(&io_request_lock);
+	spin_unlock_irq(&ide_lock);
 	return 0;
 }
 
@@ -1894,7 +1902,7 @@ static int ide_ioctl (struct inode *inode, struct file *file,
 			 *	spot if we miss one somehow
 			 */
 
-			spin_lock_irqsave(&io_request_lock, flags);
+			spin_lock_irqsave(&ide_lock, flags);
 			
 			DRIVER(drive)->abort(drive, "drive reset");
 			if(HWGROUP(drive)->handler)
@@ -1904,7 +1912,7 @@ static int ide_ioctl (struct inode *inode, struct file *file,
 			   drop the lock. Reset will clear the busy */
 			   
 			HWGROUP(drive)->busy = 1;
-			spin_unlock_irqrestore(&io_request_lock, flags);
+			spin_unlock_irqrestore(&ide_lock, flags);
 
 			(void) ide_do_reset(drive);
 			if (drive->suspend_reset) {
@@ -2835,16 +2843,16 @@ int ide_register_subdriver (ide_drive_t *drive, ide_driver_t *driver, int versio
 	
 	BUG_ON(drive->driver == NULL);
 	
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	if (version != IDE_SUBDRIVER_VERSION || !drive->present ||
 	    drive->driver != &idedefault_driver || drive->busy || drive->usage) {
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		return 1;
 	}
 	drive->driver = driver;
 	setup_driver_defaults(drive);
 	printk("%s: attached %s driver.\n", drive->name, driver->name);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	if (drive->autotune != 2) {
 		/* DMA timings and setup moved to ide-probe.c */
 		if (!driver->supports_dma && HWIF(drive)->ide_dma_off_quietly)
@@ -2871,9 +2879,9 @@ int ide_unregister_subdriver (ide_drive_t *drive)
 	unsigned long flags;
 
 	down(&ide_setting_sem);	
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	if (drive->usage || drive->busy || DRIVER(drive)->busy) {
-		spin_unlock_irqrestore(&io_request_lock, flags);
+		spin_unlock_irqrestore(&ide_lock, flags);
 		up(&ide_setting_sem);
 		return 1;
 	}
@@ -2884,7 +2892,7 @@ int ide_unregister_subdriver (ide_drive_t *drive)
 	drive->driver = &idedefault_driver;
 	setup_driver_defaults(drive);
 	auto_remove_settings(drive);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	up(&ide_setting_sem);
 	return 0;
 }
@@ -265,7 +265,7 @@ static void ht_set_prefetch(ide_drive_t *drive, u8 state)
 	unsigned long flags;
 	int t = HT_PREFETCH_MODE << 8;
 	
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	
 	/*
 	 *  Prefetch mode and unmask irq seems to conflict
@@ -279,7 +279,7 @@ static void ht_set_prefetch(ide_drive_t *drive, u8 state)
 		drive->no_unmask = 0;
 	}
 	
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	
 #ifdef DEBUG
 	printk("ht6560b: drive %s prefetch mode %sabled\n", drive->name, (state ? "en" : "dis"));
@@ -300,12 +300,12 @@ static void tune_ht6560b (ide_drive_t *drive, u8 pio)
 	
 	timing = ht_pio2timings(drive, pio);
 	
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	
 	drive->drive_data &= 0xff00;
 	drive->drive_data |= timing;
 	
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	
 #ifdef DEBUG
 	printk("ht6560b: drive %s tuned to pio mode %#x timing=%#x\n", drive->name, pio, timing);
@@ -92,7 +92,7 @@ int lvm_snapshot_fill_COW_page(vg_t *, lv_t *);
 int lvm_snapshot_COW(kdev_t, ulong, ulong, ulong, vg_t * vg, lv_t *);
 int lvm_snapshot_remap_block(kdev_t *, ulong *, ulong, lv_t *);
 void lvm_snapshot_release(lv_t *);
-int lvm_write_COW_table_block(vg_t *, lv_t *);
+int lvm_write_COW_table_block(vg_t *, lv_t *, int);
 void lvm_hash_link(lv_block_exception_t *, kdev_t, ulong, lv_t *);
 int lvm_snapshot_alloc_hash_table(lv_t *);
 void lvm_drop_snapshot(vg_t * vg, lv_t *, const char *);
@@ -45,6 +45,9 @@
  *    26/07/2002 - removed conditional list_move macro because we will
  *                 discontinue LVM1 before 2.6 anyway
  *    27/08/2003 - fixed unsafe list handling in lvm_find_exception_table() [HM]
+ *    14/10/2003 - copy runs of adjacent chunks in one go and write their
+ *                 COW table entries together
+ *               - exception hash table grows with the number of exceptions
  *
  */
 
@@ -70,8 +73,16 @@ extern int lvm_blocksizes[];
 void lvm_snapshot_release(lv_t *);
 
 static int _write_COW_table_block(vg_t * vg, lv_t * lv, int idx,
-				  const char **reason);
+				  int flush, const char **reason);
 static void _disable_snapshot(vg_t * vg, lv_t * lv);
+static void lvm_snapshot_grow_hash_table(lv_t * lv);
+
+/* most chunks copied by one lvm_snapshot_COW() */
+#define LVM_SNAPSHOT_COW_BATCH	8
+
+/* exception hash: initial buckets, exceptions per bucket before growing */
+#define LVM_SNAPSHOT_MIN_BUCKETS	64
+#define LVM_SNAPSHOT_HASH_LOAD		2
 
 
 static inline int __brw_kiovec(int rw, int nr, struct kiobuf *iovec[],
@@ -325,16 +336,19 @@ int lvm_snapshot_fill_COW_page(vg_t * vg, lv_t * lv_snap)
 
 
 /*
- * writes a COW exception table sector to disk (HM)
+ * writes the COW exception table entries from first on to disk (HM)
  *
  * We need to hold a write lock on lv_snap->lv_lock.
  */
-int lvm_write_COW_table_block(vg_t * vg, lv_t * lv_snap)
+int lvm_write_COW_table_block(vg_t * vg, lv_t * lv_snap, int first)
 {
-	int r;
+	int r = 0, idx, last = lv_snap->lv_remap_ptr - 1;
 	const char *err;
-	if ((r = _write_COW_table_block(vg, lv_snap,
-					lv_snap->lv_remap_ptr - 1, &err)))
+
+	for (idx = first; idx <= last && !r; idx++)
+		r = _write_COW_table_block(vg, lv_snap, idx, idx == last,
+					   &err);
+	if (r)
 		lvm_drop_snapshot(vg, lv_snap, err);
 	return r;
 }
@@ -346,6 +360,11 @@ int lvm_write_COW_table_block(vg_t * vg, lv_t * lv_snap)
  * if there is no exception storage space free any longer --> release snapshot.
  *
  * this routine gets called for each _first_ write to a physical chunk.
+ * The chunks following it are copied along, as long as they are in the
+ * same extent on both sides, have not been copied yet and fit in the
+ * iobuf: writes usually go on where they left off, and copying a run of
+ * chunks costs one seek each way instead of one per chunk.  The new
+ * exceptions start at the lv_remap_ptr found on entry.
  *
  * We need to hold a write lock on lv_snap->lv_lock.  It is assumed that
  * lv->lv_block_exception is non-NULL (checked by lvm_snapshot_remap_block())
@@ -366,7 +385,8 @@ int lvm_snapshot_COW(kdev_t org_phys_dev,
 	struct kiobuf *iobuf = lv_snap->lv_iobuf;
 	unsigned long *blocks = iobuf->blocks;
 	int blksize_snap, blksize_org, min_blksize, max_blksize;
-	int max_sectors, nr_sectors;
+	int max_sectors, nr_sectors, nr_chunks, max_chunks, i;
+	lv_block_exception_t *be = lv_snap->lv_block_exception;
 
 	/* check if we are out of snapshot space */
 	if (idx >= lv_snap->lv_remap_end)
@@ -402,8 +422,31 @@ int lvm_snapshot_COW(kdev_t org_phys_dev,
 	if (chunk_size % (max_blksize >> 9))
 		goto fail_blksize;
 
+	/*
+	 * Find the run of chunks to copy, no more than the iobuf holds.
+	 * Only copy ahead for a sequential writer, one that faults on the
+	 * chunk right after the last one we copied; anybody else would
+	 * just fill up the snapshot with chunks that never get written.
+	 */
+	max_chunks = min(LVM_SNAPSHOT_COW_BATCH, KIO_MAX_SECTORS / chunk_size);
+	if (!idx || be[idx - 1].rdev_org != org_phys_dev ||
+	    be[idx - 1].rsector_org + chunk_size != org_start)
+		max_chunks = 1;
+	for (nr_chunks = 1; nr_chunks < max_chunks; nr_chunks++) {
+		unsigned long next = org_start + nr_chunks * chunk_size;
+
+		if (idx + nr_chunks >= lv_snap->lv_remap_end ||
+		    next + chunk_size > org_pe_start + vg->pe_size ||
+		    be[idx + nr_chunks].rdev_new != snap_phys_dev ||
+		    be[idx + nr_chunks].rsector_new !=
+		    snap_start + nr_chunks * chunk_size ||
+		    lvm_find_exception_table(org_phys_dev, next, lv_snap))
+			break;
+	}
+
 	/* Don't change org_start, we need it to fill in the exception table */
 	phys_start = org_start;
+	chunk_size *= nr_chunks;
 
 	while (chunk_size) {
 		nr_sectors = min(chunk_size, max_sectors);
@@ -435,18 +478,22 @@ int lvm_snapshot_COW(kdev_t org_phys_dev,
 
 #ifdef DEBUG_SNAPSHOT
 	/* invalidate the logical snapshot buffer cache */
-	invalidate_snap_cache(virt_start, lv_snap->lv_chunk_size,
+	invalidate_snap_cache(virt_start, lv_snap->lv_chunk_size * nr_chunks,
 			      lv_snap->lv_dev);
 #endif
 
-	/* the original chunk is now stored on the snapshot volume
+	/* the original chunks are now stored on the snapshot volume
 	   so update the execption table */
-	lv_snap->lv_block_exception[idx].rdev_org = org_phys_dev;
-	lv_snap->lv_block_exception[idx].rsector_org = org_start;
+	for (i = 0; i < nr_chunks; i++) {
+		be[idx + i].rdev_org = org_phys_dev;
+		be[idx + i].rsector_org =
+		    org_start + i * lv_snap->lv_chunk_size;
 
-	lvm_hash_link(lv_snap->lv_block_exception + idx,
-		      org_phys_dev, org_start, lv_snap);
-	lv_snap->lv_remap_ptr = idx + 1;
+		lvm_hash_link(be + idx + i, org_phys_dev,
+			      be[idx + i].rsector_org, lv_snap);
+	}
+	lv_snap->lv_remap_ptr = idx + nr_chunks;
+	lvm_snapshot_grow_hash_table(lv_snap);
 	if (lv_snap->lv_snapshot_use_rate > 0) {
 		if (lv_snap->lv_remap_ptr * 100 / lv_snap->lv_remap_end >=
 		    lv_snap->lv_snapshot_use_rate)
@@ -522,34 +569,86 @@ static int calc_max_buckets(void)
 	return mem;
 }
 
-int lvm_snapshot_alloc_hash_table(lv_t * lv)
+/*
+ * The exception hash table starts out sized for the exceptions already
+ * there and doubles as the snapshot fills up, up to one bucket per
+ * exception or 2% of memory.  Returns a power of two.
+ */
+static unsigned long calc_hash_buckets(lv_t * lv)
 {
-	int err;
-	unsigned long buckets, max_buckets, size;
-	struct list_head *hash;
+	unsigned long buckets = 1, max_buckets, want;
 
-	buckets = lv->lv_remap_end;
-	max_buckets = calc_max_buckets();
-	buckets = min(buckets, max_buckets);
-	while (buckets & (buckets - 1))
-		buckets &= (buckets - 1);
+	max_buckets = min((unsigned long) lv->lv_remap_end,
+			  (unsigned long) calc_max_buckets());
+	want = max((unsigned long) lv->lv_remap_ptr,
+		   (unsigned long) LVM_SNAPSHOT_MIN_BUCKETS);
+	while (buckets < want && (buckets << 1) <= max_buckets)
+		buckets <<= 1;
 
-	size = buckets * sizeof(struct list_head);
+	return buckets;
+}
 
-	err = -ENOMEM;
-	hash = vmalloc(size);
-	lv->lv_snapshot_hash_table = hash;
+static struct list_head *_alloc_hash_table(lv_t * lv,
+					   unsigned long buckets, int gfp)
+{
+	unsigned long size = buckets * sizeof(struct list_head);
+	struct list_head *hash;
 
+	hash = __vmalloc(size, gfp | __GFP_HIGHMEM, PAGE_KERNEL);
 	if (!hash)
-		goto out;
-	lv->lv_snapshot_hash_table_size = size;
+		return NULL;
 
+	lv->lv_snapshot_hash_table = hash;
+	lv->lv_snapshot_hash_table_size = size;
 	lv->lv_snapshot_hash_mask = buckets - 1;
 	while (buckets--)
 		INIT_LIST_HEAD(hash + buckets);
-	err = 0;
-      out:
-	return err;
+
+	return hash;
+}
+
+int lvm_snapshot_alloc_hash_table(lv_t * lv)
+{
+	lv->lv_snapshot_hash_table = NULL;
+	if (!_alloc_hash_table(lv, calc_hash_buckets(lv), GFP_KERNEL))
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Rehash into a larger table once there are more than
+ * LVM_SNAPSHOT_HASH_LOAD exceptions per bucket.  We are in the middle
+ * of a COW, so the allocation mustn't recurse into I/O; if it fails we
+ * keep the old table and try again on the next COW.
+ *
+ * GFP_NOIO only covers the pages of the table itself: vmalloc()
+ * allocates its page tables and vm_struct with GFP_KERNEL.  PF_NOIO
+ * keeps those from writing back to get memory, too.
+ *
+ * We need to hold a write lock on lv->lv_lock.
+ */
+static void lvm_snapshot_grow_hash_table(lv_t * lv)
+{
+	struct list_head *old = lv->lv_snapshot_hash_table, *new;
+	unsigned long buckets = lv->lv_snapshot_hash_mask + 1;
+	unsigned long noio = current->flags & PF_NOIO;
+	lv_block_exception_t *be = lv->lv_block_exception;
+	int e;
+
+	if (lv->lv_remap_ptr <= buckets * LVM_SNAPSHOT_HASH_LOAD ||
+	    calc_hash_buckets(lv) <= buckets)
+		return;
+
+	current->flags |= PF_NOIO;
+	new = _alloc_hash_table(lv, calc_hash_buckets(lv), GFP_NOIO);
+	current->flags = (current->flags & ~PF_NOIO) | noio;
+	if (!new)
+		return;
+
+	for (e = 0; e < lv->lv_remap_ptr; e++)
+		lvm_hash_link(be + e, be[e].rdev_org, be[e].rsector_org, lv);
+	vfree(old);
 }
 
 int lvm_snapshot_alloc(lv_t * lv_snap)
@@ -623,8 +722,12 @@ void lvm_snapshot_release(lv_t * lv)
 }
 
 
+/*
+ * Store exception idx in the COW table block and write the block out,
+ * unless flush is 0 and the next entry goes into the same block.
+ */
 static int _write_COW_table_block(vg_t * vg, lv_t * lv_snap,
-				  int idx, const char **reason)
+				  int idx, int flush, const char **reason)
 {
 	int blksize_snap;
 	int end_of_table;
@@ -685,6 +788,11 @@ static int _write_COW_table_block(vg_t * vg, lv_t * lv_snap,
 	lv_COW_table[idx_COW_table].pv_snap_rsector =
 	    cpu_to_le64(be->rsector_new);
 
+	end_of_table = idx % COW_entries_per_pe == COW_entries_per_pe - 1;
+	if (!flush && !end_of_table &&
+	    idx_COW_table % COW_entries_per_block != COW_entries_per_block - 1)
+		goto out;
+
 	COW_table_iobuf->length = blksize_snap;
 	/* COW_table_iobuf->nr_pages = 1; */
 
@@ -693,7 +801,6 @@ static int _write_COW_table_block(vg_t * vg, lv_t * lv_snap,
 		goto fail_raw_write;
 
 	/* initialization of next COW exception table block with zeroes */
-	end_of_table = idx % COW_entries_per_pe == COW_entries_per_pe - 1;
 	if (idx_COW_table % COW_entries_per_block ==
 	    COW_entries_per_block - 1 || end_of_table) {
 		/* don't go beyond the end */
@@ -750,7 +857,7 @@ static void _disable_snapshot(vg_t * vg, lv_t * lv)
 	const char *err;
 	lv->lv_block_exception[0].rsector_org =
 	    LVM_SNAPSHOT_DROPPED_SECTOR;
-	if (_write_COW_table_block(vg, lv, 0, &err) < 0) {
+	if (_write_COW_table_block(vg, lv, 0, 1, &err) < 0) {
 		printk(KERN_ERR "%s -- couldn't disable snapshot: %s\n",
 		       lvm_name, err);
 	}
@@ -1177,15 +1177,17 @@ static int lvm_user_bmap(struct inode *inode, struct lv_bmap *user_result)
 static void __remap_snapshot(kdev_t rdev, ulong rsector,
 			     ulong pe_start, lv_t * lv, vg_t * vg)
 {
+	int idx;
 
 	/* copy a chunk from the origin to a snapshot device */
 	down_write(&lv->lv_lock);
+	idx = lv->lv_remap_ptr;
 
 	/* we must redo lvm_snapshot_remap_block in order to avoid a
 	   race condition in the gap where no lock was held */
 	if (!lvm_snapshot_remap_block(&rdev, &rsector, pe_start, lv) &&
 	    !lvm_snapshot_COW(rdev, rsector, pe_start, rsector, vg, lv))
-		lvm_write_COW_table_block(vg, lv);
+		lvm_write_COW_table_block(vg, lv, idx);
 
 	up_write(&lv->lv_lock);
 }
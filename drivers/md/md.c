@@ -176,8 +176,10 @@ static int md_make_request(request_queue_t *q, int rw, struct buffer_head * bh)
 {
 	mddev_t *mddev = kdev_to_mddev(bh->b_rdev);
 
-	if (mddev && mddev->pers)
+	if (mddev && mddev->pers) {
+		disk_stat_io(&md_hd_struct[mdidx(mddev)], rw, bh->b_size >> 9);
 		return mddev->pers->make_request(mddev, rw, bh);
+	}
 	else {
 		buffer_IO_error(bh);
 		return 0;
@@ -479,8 +481,8 @@ static void bh_complete(struct buffer_head *bh, int uptodate)
 	complete((struct completion*)bh->b_private);
 }
 
-static int sync_page_io(kdev_t dev, unsigned long sector, int size,
-			struct page *page, int rw)
+int sync_page_io(kdev_t dev, unsigned long sector, int size,
+		 struct page *page, int rw)
 {
 	struct buffer_head bh;
 	struct completion event;
@@ -1512,7 +1514,7 @@ static int analyze_sbs(mddev_t * mddev)
 	}
 
 	if ((sb->state != (1 << MD_SB_CLEAN)) && ((sb->level == 1) ||
-			(sb->level == 4) || (sb->level == 5)))
+			(sb->level == 4) || (sb->level == 5) || (sb->level == 6)))
 		printk(NOT_CLEAN_IGNORE, mdidx(mddev));
 
 	return 0;
@@ -1581,6 +1583,9 @@ static int device_size_calculation(mddev_t * mddev)
 		case 5:
 			data_disks = sb->raid_disks-1;
 			break;
+		case 6:
+			data_disks = sb->raid_disks-2;
+			break;
 		default:
 			printk(UNKNOWN_LEVEL, mdidx(mddev), sb->level);
 			goto abort;
@@ -1589,7 +1594,8 @@ static int device_size_calculation(mddev_t * mddev)
 		md_size[mdidx(mddev)] = sb->size * data_disks;
 
 	readahead = MD_READAHEAD;
-	if ((sb->level == 0) || (sb->level == 4) || (sb->level == 5)) {
+	if ((sb->level == 0) || (sb->level == 4) || (sb->level == 5) ||
+			(sb->level == 6)) {
 		readahead = (mddev->sb->chunk_size>>PAGE_SHIFT) * 4 * data_disks;
 		if (readahead < data_disks * (MAX_SECTORS>>(PAGE_SHIFT-9))*2)
 			readahead = data_disks * (MAX_SECTORS>>(PAGE_SHIFT-9))*2;
@@ -4116,6 +4122,7 @@ MD_EXPORT_SYMBOL(md_error);
 MD_EXPORT_SYMBOL(md_do_sync);
 MD_EXPORT_SYMBOL(md_sync_acct);
 MD_EXPORT_SYMBOL(md_done_sync);
+MD_EXPORT_SYMBOL(sync_page_io);
 MD_EXPORT_SYMBOL(md_recover_arrays);
 MD_EXPORT_SYMBOL(md_register_thread);
 MD_EXPORT_SYMBOL(md_unregister_thread);
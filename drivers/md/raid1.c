@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/config.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/raid/raid1.h>
 #include <asm/atomic.h>
 
@@ -388,6 +389,253 @@ static void inline sync_request_done (unsigned long sector, raid1_conf_t *conf)
 	spin_unlock_irqrestore(&conf->segment_lock, flags);
 }
 
+/*
+ * Write-intent bitmap handling, see raid1.h for the layout.
+ */
+#define RAID1_BITMAP_SWEEP	(5*HZ)
+
+/* Is dev one of the mirrors we are writing to? */
+static int raid1_bitmap_mirror(raid1_conf_t *conf, kdev_t dev)
+{
+	int i;
+
+	for (i = 0; i < MD_SB_DISKS; i++)
+		if (conf->mirrors[i].operational && conf->mirrors[i].dev == dev)
+			return 1;
+	return 0;
+}
+
+/*
+ * Write the bitmap, with chunk marked if it is not -1, to every
+ * operational mirror.  Called with bitmap_sem held.  A mirror which
+ * misses a bitmap update cannot be trusted to have the bits that
+ * matter, so it is failed like on any other write error.
+ */
+static void raid1_bitmap_write(raid1_conf_t *conf, int chunk)
+{
+	mddev_t *mddev = conf->mddev;
+	raid1_bitmap_super_t *bsb = page_address(conf->bitmap_page);
+	unsigned long *bits = (unsigned long *)
+			((char *)bsb + RAID1_BITMAP_HDR_BYTES);
+	__u64 ev = md_event(mddev->sb);
+	struct md_list_head *tmp;
+	mdk_rdev_t *rdev;
+
+	memcpy(bits, conf->bitmap, RAID1_BITMAP_CHUNKS / 8);
+	if (chunk >= 0)
+		set_bit(chunk, bits);
+	bsb->events_lo = (__u32) ev;
+	bsb->events_hi = (__u32) (ev >> 32);
+
+	ITERATE_RDEV(mddev,rdev,tmp) {
+		if (rdev->faulty || !raid1_bitmap_mirror(conf, rdev->dev))
+			continue;
+		if (!sync_page_io(rdev->dev,
+				  (rdev->sb_offset << 1) + RAID1_BITMAP_OFFSET,
+				  RAID1_BITMAP_BYTES, conf->bitmap_page, WRITE)) {
+			printk(KERN_ERR "raid1: %s: write-intent bitmap "
+			       "update failed\n", partition_name(rdev->dev));
+			md_error(mddev, rdev->dev);
+		}
+	}
+	conf->bitmap_events = ev;
+}
+
+/*
+ * Called before a write to sector is started.  Only the first write to
+ * a clean chunk (or the first after a superblock update) waits for the
+ * bitmap to reach the disks.
+ */
+static void raid1_bitmap_startwrite(raid1_conf_t *conf, unsigned long sector)
+{
+	int chunk = sector >> conf->bitmap_shift;
+	unsigned long flags;
+
+	md_spin_lock_irqsave(&conf->bitmap_lock, flags);
+	conf->bitmap_count[chunk]++;
+	clear_bit(chunk, conf->bitmap_idle);
+	md_spin_unlock_irqrestore(&conf->bitmap_lock, flags);
+
+	if (test_bit(chunk, conf->bitmap) &&
+	    conf->bitmap_events == md_event(conf->mddev->sb))
+		return;
+
+	down(&conf->bitmap_sem);
+	if (!test_bit(chunk, conf->bitmap) ||
+	    conf->bitmap_events != md_event(conf->mddev->sb)) {
+		raid1_bitmap_write(conf, chunk);
+		set_bit(chunk, conf->bitmap);
+	}
+	up(&conf->bitmap_sem);
+}
+
+static void raid1_bitmap_endwrite(raid1_conf_t *conf, unsigned long sector)
+{
+	unsigned long flags;
+
+	md_spin_lock_irqsave(&conf->bitmap_lock, flags);
+	conf->bitmap_count[sector >> conf->bitmap_shift]--;
+	md_spin_unlock_irqrestore(&conf->bitmap_lock, flags);
+}
+
+/*
+ * Run by raid1d every RAID1_BITMAP_SWEEP.  A chunk with no writes in
+ * flight is marked idle on one sweep and cleared on the next, if no
+ * write came in between: writes tend to come back to the same place,
+ * and every clear costs a bitmap write, as does setting the bit again.
+ * Nothing is cleared while a mirror is missing or being resynced, as
+ * the bits are all that tells us what it will need.
+ */
+static void raid1_bitmap_sweep(raid1_conf_t *conf)
+{
+	int chunk, cleared = 0;
+
+	down(&conf->bitmap_sem);
+	md_spin_lock_irq(&conf->bitmap_lock);
+	if (conf->working_disks == conf->raid_disks && !conf->resync_mirrors)
+		for (chunk = 0; chunk < conf->bitmap_chunks; chunk++) {
+			if (!test_bit(chunk, conf->bitmap) ||
+			    conf->bitmap_count[chunk])
+				continue;
+			if (test_and_set_bit(chunk, conf->bitmap_idle)) {
+				clear_bit(chunk, conf->bitmap);
+				cleared++;
+			}
+		}
+	md_spin_unlock_irq(&conf->bitmap_lock);
+
+	if (cleared || conf->bitmap_events != md_event(conf->mddev->sb))
+		raid1_bitmap_write(conf, -1);
+	up(&conf->bitmap_sem);
+}
+
+static void raid1_bitmap_timeout(unsigned long data)
+{
+	raid1_conf_t *conf = (raid1_conf_t *) data;
+
+	conf->bitmap_sweep = 1;
+	md_wakeup_thread(conf->thread);
+	mod_timer(&conf->bitmap_timer, jiffies + RAID1_BITMAP_SWEEP);
+}
+
+/*
+ * Read the bitmap back from every operational mirror after an unclean
+ * shutdown, merging the bits.  Returns 0 if any mirror's copy is not
+ * one we can trust, in which case the whole mirror has to be resynced.
+ */
+static int raid1_bitmap_load(raid1_conf_t *conf)
+{
+	mddev_t *mddev = conf->mddev;
+	mdp_super_t *sb = mddev->sb;
+	raid1_bitmap_super_t *bsb = page_address(conf->bitmap_page);
+	unsigned long *bits = (unsigned long *)
+			((char *)bsb + RAID1_BITMAP_HDR_BYTES);
+	__u64 ev = md_event(sb);
+	struct md_list_head *tmp;
+	mdk_rdev_t *rdev;
+	int i, found = 0;
+
+	ITERATE_RDEV(mddev,rdev,tmp) {
+		if (rdev->faulty || !raid1_bitmap_mirror(conf, rdev->dev))
+			continue;
+		if (!sync_page_io(rdev->dev,
+				  (rdev->sb_offset << 1) + RAID1_BITMAP_OFFSET,
+				  RAID1_BITMAP_BYTES, conf->bitmap_page, READ))
+			goto invalid;
+		if (bsb->magic != RAID1_BITMAP_MAGIC ||
+		    bsb->set_uuid0 != sb->set_uuid0 ||
+		    bsb->set_uuid1 != sb->set_uuid1 ||
+		    bsb->set_uuid2 != sb->set_uuid2 ||
+		    bsb->set_uuid3 != sb->set_uuid3 ||
+		    bsb->events_lo != (__u32) ev ||
+		    bsb->events_hi != (__u32) (ev >> 32) ||
+		    bsb->chunk_shift != conf->bitmap_shift ||
+		    bsb->chunks != conf->bitmap_chunks)
+			goto invalid;
+		for (i = 0; i < RAID1_BITMAP_CHUNKS / BITS_PER_LONG; i++)
+			conf->bitmap[i] |= bits[i];
+		found++;
+	}
+	return found;
+
+invalid:
+	printk(KERN_INFO "raid1: %s: no usable write-intent bitmap\n",
+	       partition_name(rdev->dev));
+	memset(conf->bitmap, 0, RAID1_BITMAP_CHUNKS / 8);
+	return 0;
+}
+
+static void raid1_bitmap_free(raid1_conf_t *conf)
+{
+	if (conf->bitmap_page)
+		__free_page(conf->bitmap_page);
+	if (conf->bitmap)
+		kfree(conf->bitmap);
+	if (conf->bitmap_idle)
+		kfree(conf->bitmap_idle);
+	if (conf->bitmap_count)
+		vfree(conf->bitmap_count);
+	conf->bitmap_page = NULL;
+	conf->bitmap = conf->bitmap_idle = NULL;
+	conf->bitmap_count = NULL;
+}
+
+/*
+ * Size the chunks so that the array fits in the bitmap, and set up the
+ * in-memory state.  The bits themselves are loaded, if at all, by
+ * raid1_bitmap_load(); the header is filled in afterwards.
+ */
+static int raid1_bitmap_init(raid1_conf_t *conf)
+{
+	mdp_super_t *sb = conf->mddev->sb;
+	unsigned long sectors = sb->size << 1;
+	int shift = RAID1_BITMAP_MIN_SHIFT;
+
+	while (((sectors - 1) >> shift) >= RAID1_BITMAP_CHUNKS)
+		shift++;
+	conf->bitmap_shift = shift;
+	conf->bitmap_chunks = ((sectors - 1) >> shift) + 1;
+
+	conf->bitmap_page = alloc_page(GFP_KERNEL);
+	conf->bitmap = kmalloc(RAID1_BITMAP_CHUNKS / 8, GFP_KERNEL);
+	conf->bitmap_idle = kmalloc(RAID1_BITMAP_CHUNKS / 8, GFP_KERNEL);
+	conf->bitmap_count = vmalloc(conf->bitmap_chunks *
+				     sizeof(unsigned short));
+	if (!conf->bitmap_page || !conf->bitmap || !conf->bitmap_idle ||
+	    !conf->bitmap_count) {
+		raid1_bitmap_free(conf);
+		return -ENOMEM;
+	}
+	memset(conf->bitmap, 0, RAID1_BITMAP_CHUNKS / 8);
+	memset(conf->bitmap_idle, 0, RAID1_BITMAP_CHUNKS / 8);
+	memset(conf->bitmap_count, 0,
+	       conf->bitmap_chunks * sizeof(unsigned short));
+
+	init_MUTEX(&conf->bitmap_sem);
+	conf->bitmap_lock = MD_SPIN_LOCK_UNLOCKED;
+	init_timer(&conf->bitmap_timer);
+	conf->bitmap_timer.function = raid1_bitmap_timeout;
+	conf->bitmap_timer.data = (unsigned long) conf;
+	return 0;
+}
+
+static void raid1_bitmap_header(raid1_conf_t *conf)
+{
+	mdp_super_t *sb = conf->mddev->sb;
+	raid1_bitmap_super_t *bsb = page_address(conf->bitmap_page);
+
+	memset(bsb, 0, RAID1_BITMAP_HDR_BYTES);
+	bsb->magic = RAID1_BITMAP_MAGIC;
+	bsb->set_uuid0 = sb->set_uuid0;
+	bsb->set_uuid1 = sb->set_uuid1;
+	bsb->set_uuid2 = sb->set_uuid2;
+	bsb->set_uuid3 = sb->set_uuid3;
+	bsb->chunk_shift = conf->bitmap_shift;
+	bsb->chunks = conf->bitmap_chunks;
+	/* force a write before the first write is trusted to it */
+	conf->bitmap_events = md_event(sb) - 1;
+}
+
 /*
  * raid1_end_bh_io() is called when we have finished servicing a mirrored
  * operation and are ready to return a success/failure code to the buffer
@@ -396,8 +644,11 @@ static void inline sync_request_done (unsigned long sector, raid1_conf_t *conf)
 static void raid1_end_bh_io (struct raid1_bh *r1_bh, int uptodate)
 {
 	struct buffer_head *bh = r1_bh->master_bh;
+	raid1_conf_t *conf = mddev_to_conf(r1_bh->mddev);
 
-	io_request_done(bh->b_rsector, mddev_to_conf(r1_bh->mddev),
+	if (r1_bh->cmd == WRITE && conf->bitmap)
+		raid1_bitmap_endwrite(conf, bh->b_rsector);
+	io_request_done(bh->b_rsector, conf,
 			test_bit(R1BH_SyncPhase, &r1_bh->state));
 
 	bh->b_end_io(bh, uptodate);
@@ -464,10 +715,14 @@ void raid1_end_request (struct buffer_head *bh, int uptodate)
  * in array and when new read requests come, the disk which last
  * position is nearest to the request, is chosen.
  *
+ * A read which starts where some mirror's last read ended continues a
+ * sequential stream and stays on that mirror, whichever it is, so that
+ * several streams can each keep a disk of their own instead of being
+ * dragged around by the nearest-head search.
+ *
  * TODO: now if there are 2 mirrors in the same 2 devices, performance
  * degrades dramatically because position is mirror, not device based.
- * This should be changed to be device based. Also atomic sequential
- * reads should be somehow balanced.
+ * This should be changed to be device based.
  */
 
 static int raid1_read_balance (raid1_conf_t *conf, struct buffer_head *bh)
@@ -478,6 +733,7 @@ static int raid1_read_balance (raid1_conf_t *conf, struct buffer_head *bh)
 	int disk = new_disk;
 	unsigned long new_distance;
 	unsigned long current_distance;
+	int i;
 	
 	/*
 	 * Check if it is sane at all to balance
@@ -513,11 +769,21 @@ static int raid1_read_balance (raid1_conf_t *conf, struct buffer_head *bh)
 	/* now disk == new_disk == starting point for search */
 	
 	/*
-	 * Don't touch anything for sequential reads.
+	 * Don't touch anything for sequential reads, on any mirror.
 	 */
 
 	if (this_sector == conf->mirrors[new_disk].head_position)
 		goto rb_out;
+
+	for (i = 0; i < conf->raid_disks; i++) {
+		if (!conf->mirrors[i].operational ||
+		    conf->mirrors[i].write_only ||
+		    this_sector != conf->mirrors[i].head_position)
+			continue;
+		new_disk = i;
+		conf->sect_count = 0;
+		goto rb_out;
+	}
 	
 	/*
 	 * If reads have been done only on a single disk
@@ -605,6 +871,9 @@ static int raid1_make_request (mddev_t *mddev, int rw,
 	if (rw == READA)
 		rw = READ;
 
+	if (rw == WRITE && conf->bitmap)
+		raid1_bitmap_startwrite(conf, bh->b_rsector);
+
 	r1_bh = raid1_alloc_r1bh (conf);
 
 	spin_lock_irq(&conf->segment_lock);
@@ -1174,6 +1443,11 @@ static void raid1d (void *data)
 	if (mddev->sb_dirty)
 		md_update_sb(mddev);
 
+	if (conf->bitmap && conf->bitmap_sweep) {
+		conf->bitmap_sweep = 0;
+		raid1_bitmap_sweep(conf);
+	}
+
 	for (;;) {
 		md_spin_lock_irqsave(&retry_list_lock, flags);
 		r1_bh = raid1_retry_list;
@@ -1308,6 +1582,11 @@ static void raid1syncd (void *data)
 		 */
 		conf->resync_mirrors = 0;
 	}
+	/*
+	 * Whatever happened, the bitmap no longer tells which chunks
+	 * are out of sync: any later resync has to do all of them.
+	 */
+	conf->bitmap_resync = 0;
 
 	close_sync(conf);
 
@@ -1315,6 +1594,20 @@ static void raid1syncd (void *data)
 	raid1_shrink_buffers(conf);
 }
 
+/*
+ * A spare being rebuilt holds nothing yet, the bitmap says nothing
+ * about it.
+ */
+static int raid1_spare_syncing(raid1_conf_t *conf)
+{
+	int i;
+
+	for (i = 0; i < MD_SB_DISKS; i++)
+		if (conf->mirrors[i].operational && conf->mirrors[i].write_only)
+			return 1;
+	return 0;
+}
+
 /*
  * perform a "sync" on one "block"
  *
@@ -1396,6 +1689,23 @@ static int raid1_sync_request (mddev_t *mddev, unsigned long sector_nr)
 		if (conf->cnt_ready || conf->cnt_active)
 			MD_BUG();
 	}
+	if (conf->bitmap_resync && !raid1_spare_syncing(conf) &&
+	    !test_bit(sector_nr >> conf->bitmap_shift, conf->bitmap)) {
+		/*
+		 * Nothing was being written here: skip the rest of the
+		 * chunk.  md_do_sync() adds what we return to
+		 * recovery_active, so account for it as done already.
+		 */
+		unsigned long next = ((sector_nr >> conf->bitmap_shift) + 1)
+						<< conf->bitmap_shift;
+		unsigned long max_sectors = mddev->sb->size << 1;
+
+		spin_unlock_irq(&conf->segment_lock);
+		if (next > max_sectors)
+			next = max_sectors;
+		md_done_sync(mddev, next - sector_nr, 1);
+		return next - sector_nr;
+	}
 	while (sector_nr >= conf->start_pending) {
 		PRINTK("wait .. sect=%lu start_active=%d ready=%d pending=%d future=%d, cnt_done=%d active=%d ready=%d pending=%d future=%d\n",
 			sector_nr, conf->start_active, conf->start_ready, conf->start_pending, conf->start_future,
@@ -1548,6 +1858,12 @@ static void end_sync_write(struct buffer_head *bh, int uptodate)
 #define START_RESYNC KERN_WARNING \
 "raid1: raid set md%d not clean; reconstructing mirrors\n"
 
+#define START_BITMAP_RESYNC KERN_WARNING \
+"raid1: raid set md%d not clean; reconstructing chunks marked in the bitmap\n"
+
+#define NO_BITMAP KERN_WARNING \
+"raid1: couldn't allocate write-intent bitmap for md%d\n"
+
 static int raid1_run (mddev_t *mddev)
 {
 	raid1_conf_t *conf;
@@ -1732,6 +2048,13 @@ static int raid1_run (mddev_t *mddev)
 		}
 	}
 
+	/*
+	 * A non-persistent array has no superblock area at the end of
+	 * the mirrors to keep the bitmap in.
+	 */
+	if (!sb->not_persistent && raid1_bitmap_init(conf))
+		printk(NO_BITMAP, mdidx(mddev));
+
 	if (!start_recovery && !(sb->state & (1 << MD_SB_CLEAN)) &&
 	    (conf->working_disks > 1)) {
 		const char * name = "raid1syncd";
@@ -1742,10 +2065,18 @@ static int raid1_run (mddev_t *mddev)
 			goto out_free_conf;
 		}
 
-		printk(START_RESYNC, mdidx(mddev));
+		if (conf->bitmap && raid1_bitmap_load(conf)) {
+			printk(START_BITMAP_RESYNC, mdidx(mddev));
+			conf->bitmap_resync = 1;
+		} else
+			printk(START_RESYNC, mdidx(mddev));
 		conf->resync_mirrors = 1;
 		md_wakeup_thread(conf->resync_thread);
 	}
+	if (conf->bitmap) {
+		raid1_bitmap_header(conf);
+		mod_timer(&conf->bitmap_timer, jiffies + RAID1_BITMAP_SWEEP);
+	}
 
 	/*
 	 * Regenerate the "device is in sync with the raid set" bit for
@@ -1773,6 +2104,7 @@ static int raid1_run (mddev_t *mddev)
 	return 0;
 
 out_free_conf:
+	raid1_bitmap_free(conf);
 	raid1_shrink_r1bh(conf);
 	raid1_shrink_bh(conf);
 	raid1_shrink_buffers(conf);
@@ -1793,6 +2125,8 @@ out:
 #undef SPARE
 #undef NONE_OPERATIONAL
 #undef ARRAY_IS_ACTIVE
+#undef START_BITMAP_RESYNC
+#undef NO_BITMAP
 
 static int raid1_stop_resync (mddev_t *mddev)
 {
@@ -1831,9 +2165,12 @@ static int raid1_stop (mddev_t *mddev)
 {
 	raid1_conf_t *conf = mddev_to_conf(mddev);
 
+	if (conf->bitmap)
+		del_timer_sync(&conf->bitmap_timer);
 	md_unregister_thread(conf->thread);
 	if (conf->resync_thread)
 		md_unregister_thread(conf->resync_thread);
+	raid1_bitmap_free(conf);
 	raid1_shrink_r1bh(conf);
 	raid1_shrink_bh(conf);
 	raid1_shrink_buffers(conf);
@@ -20,6 +20,7 @@
 #include <linux/module.h>
 #include <linux/locks.h>
 #include <linux/slab.h>
+#include <linux/sysctl.h>
 #include <linux/raid/raid5.h>
 #include <asm/bitops.h>
 #include <asm/atomic.h>
@@ -31,7 +32,10 @@ static mdk_personality_t raid5_personality;
  */
 
 #define NR_STRIPES		256
+#define MIN_NR_STRIPES		16
+#define MAX_NR_STRIPES		32768
 #define	IO_THRESHOLD		1
+#define STRIPE_BATCH_DELAY	(HZ/200 + 1)
 #define HASH_PAGES		1
 #define HASH_PAGES_ORDER	0
 #define NR_HASH			(HASH_PAGES * PAGE_SIZE / sizeof(struct stripe_head *))
@@ -59,6 +63,14 @@ static mdk_personality_t raid5_personality;
 
 static void print_raid5_conf (raid5_conf_t *conf);
 
+/*
+ * The number of stripes every array keeps, /proc/sys/dev/raid/stripe_cache_size.
+ * Writing it resizes the cache of all running arrays.
+ */
+static int raid5_stripe_cache_size = NR_STRIPES;
+static LIST_HEAD(raid5_confs);
+static DECLARE_MUTEX(raid5_confs_sem);
+
 static inline void __release_stripe(raid5_conf_t *conf, struct stripe_head *sh)
 {
 	if (atomic_dec_and_test(&sh->count)) {
@@ -67,9 +79,11 @@ static inline void __release_stripe(raid5_conf_t *conf, struct stripe_head *sh)
 		if (atomic_read(&conf->active_stripes)==0)
 			BUG();
 		if (test_bit(STRIPE_HANDLE, &sh->state)) {
-			if (test_bit(STRIPE_DELAYED, &sh->state))
+			if (test_bit(STRIPE_DELAYED, &sh->state)) {
+				if (!test_and_set_bit(STRIPE_BATCHING, &sh->state))
+					sh->delayed_since = jiffies;
 				list_add_tail(&sh->lru, &conf->delayed_list);
-			else
+			} else
 				list_add_tail(&sh->lru, &conf->handle_list);
 			md_wakeup_thread(conf->thread);
 		} else {
@@ -81,7 +95,7 @@ static inline void __release_stripe(raid5_conf_t *conf, struct stripe_head *sh)
 			list_add_tail(&sh->lru, &conf->inactive_list);
 			atomic_dec(&conf->active_stripes);
 			if (!conf->inactive_blocked ||
-			    atomic_read(&conf->active_stripes) < (NR_STRIPES*3/4))
+			    atomic_read(&conf->active_stripes) < (conf->max_nr_stripes*3/4))
 				wake_up(&conf->wait_for_stripe);
 		}
 	}
@@ -303,7 +317,7 @@ static struct stripe_head *get_active_stripe(raid5_conf_t *conf, unsigned long s
 				conf->inactive_blocked = 1;
 				wait_event_lock_irq(conf->wait_for_stripe,
 						    !list_empty(&conf->inactive_list) &&
-						    (atomic_read(&conf->active_stripes) < (NR_STRIPES *3/4)
+						    (atomic_read(&conf->active_stripes) < (conf->max_nr_stripes *3/4)
 						     || !conf->inactive_blocked),
 						    conf->device_lock);
 				conf->inactive_blocked = 0;
@@ -374,6 +388,83 @@ static void shrink_stripes(raid5_conf_t *conf, int num)
 	}
 }
 
+/*
+ * Bring the cache of a running array to 'size' stripes.  Stripes
+ * are only taken away once they are idle, so this may have to wait
+ * for I/O in flight.
+ */
+static int resize_stripes(raid5_conf_t *conf, int size)
+{
+	struct stripe_head *sh;
+
+	while (conf->max_nr_stripes < size) {
+		if (grow_stripes(conf, 1, GFP_KERNEL))
+			return -ENOMEM;
+		conf->max_nr_stripes++;
+	}
+	while (conf->max_nr_stripes > size) {
+		md_spin_lock_irq(&conf->device_lock);
+		wait_event_lock_irq(conf->wait_for_stripe,
+				    !list_empty(&conf->inactive_list),
+				    conf->device_lock);
+		sh = get_free_stripe(conf);
+		atomic_dec(&conf->active_stripes);
+		conf->max_nr_stripes--;
+		md_spin_unlock_irq(&conf->device_lock);
+
+		shrink_buffers(sh, conf->raid_disks);
+		kfree(sh);
+	}
+	return 0;
+}
+
+static int raid5_stripe_cache_handler(ctl_table *table, int write,
+				      struct file *filp, void *buffer,
+				      size_t *lenp)
+{
+	struct list_head *tmp;
+	int err;
+
+	down(&raid5_confs_sem);
+	err = proc_dointvec_minmax(table, write, filp, buffer, lenp);
+	if (!err && write)
+		list_for_each(tmp, &raid5_confs) {
+			raid5_conf_t *conf = list_entry(tmp, raid5_conf_t,
+							all_confs);
+			err = resize_stripes(conf, raid5_stripe_cache_size);
+			if (err) {
+				printk(KERN_ERR "raid5: md%d: could only grow the stripe cache to %d\n",
+				       mdidx(conf->mddev), conf->max_nr_stripes);
+				break;
+			}
+		}
+	up(&raid5_confs_sem);
+	return err;
+}
+
+static int raid5_min_nr_stripes = MIN_NR_STRIPES;
+static int raid5_max_nr_stripes = MAX_NR_STRIPES;
+
+static struct ctl_table_header *raid5_table_header;
+
+static ctl_table raid5_table[] = {
+	{DEV_RAID_STRIPE_CACHE_SIZE, "stripe_cache_size",
+	 &raid5_stripe_cache_size, sizeof(int), 0644, NULL,
+	 &raid5_stripe_cache_handler, &sysctl_intvec, NULL,
+	 &raid5_min_nr_stripes, &raid5_max_nr_stripes},
+	{0}
+};
+
+static ctl_table raid5_dir_table[] = {
+	{DEV_RAID, "raid", NULL, 0, 0555, raid5_table},
+	{0}
+};
+
+static ctl_table raid5_root_table[] = {
+	{CTL_DEV, "dev", NULL, 0, 0555, raid5_dir_table},
+	{0}
+};
+
 
 static void raid5_end_read_request (struct buffer_head * bh, int uptodate)
 {
@@ -1159,21 +1250,49 @@ static void handle_stripe(struct stripe_head *sh)
 		}
 }
 
+/*
+ * Stripes which were delayed only very recently are left alone for a
+ * little while, in the hope that the rest of the stripe gets written
+ * and parity can be computed without reading anything.  The timer
+ * makes raid5d look at them again once that time is up.
+ */
 static inline void raid5_activate_delayed(raid5_conf_t *conf)
 {
 	if (atomic_read(&conf->preread_active_stripes) < IO_THRESHOLD) {
-		while (!list_empty(&conf->delayed_list)) {
-			struct list_head *l = conf->delayed_list.next;
+		struct list_head *l, *n;
+		unsigned long expires = 0;
+		int waiting = 0;
+
+		list_for_each_safe(l, n, &conf->delayed_list) {
 			struct stripe_head *sh;
 			sh = list_entry(l, struct stripe_head, lru);
+			if (test_bit(STRIPE_BATCHING, &sh->state) &&
+			    !conf->inactive_blocked &&
+			    time_before(jiffies, sh->delayed_since + STRIPE_BATCH_DELAY)) {
+				if (!waiting++ || time_before(sh->delayed_since + STRIPE_BATCH_DELAY, expires))
+					expires = sh->delayed_since + STRIPE_BATCH_DELAY;
+				continue;
+			}
 			list_del_init(l);
 			clear_bit(STRIPE_DELAYED, &sh->state);
+			clear_bit(STRIPE_BATCHING, &sh->state);
 			if (!test_and_set_bit(STRIPE_PREREAD_ACTIVE, &sh->state))
 				atomic_inc(&conf->preread_active_stripes);
 			list_add_tail(&sh->lru, &conf->handle_list);
 		}
+		if (waiting && (!timer_pending(&conf->delay_timer) ||
+				time_before(expires, conf->delay_timer.expires)))
+			mod_timer(&conf->delay_timer, expires);
 	}
 }
+
+static void raid5_delay_timeout(unsigned long data)
+{
+	raid5_conf_t *conf = (raid5_conf_t *)data;
+
+	md_wakeup_thread(conf->thread);
+}
+
 static void raid5_unplug_device(void *data)
 {
 	raid5_conf_t *conf = (raid5_conf_t *)data;
@@ -1284,25 +1403,18 @@ static int raid5_sync_request (mddev_t *mddev, unsigned long sector_nr)
 }
 
 /*
- * This is our raid5 kernel thread.
- *
- * We scan the hash table for stripes which can be handled now.
- * During the scan, completed stripes are saved for us by the interrupt
- * handler, so that they will not have to wait for our next wakeup.
+ * Take stripes off handle_list until it is empty.  raid5d and the
+ * workers all run this; whoever takes a stripe while there are more
+ * waiting kicks the next worker, so on SMP the parity of several
+ * stripes is computed at the same time.
  */
-static void raid5d (void *data)
+static void raid5_handle_list(raid5_conf_t *conf)
 {
 	struct stripe_head *sh;
-	raid5_conf_t *conf = data;
-	mddev_t *mddev = conf->mddev;
 	int handled;
 
-	PRINTK("+++ raid5d active\n");
-
 	handled = 0;
 
-	if (mddev->sb_dirty)
-		md_update_sb(mddev);
 	md_spin_lock_irq(&conf->device_lock);
 	while (1) {
 		struct list_head *first;
@@ -1323,6 +1435,8 @@ static void raid5d (void *data)
 		atomic_inc(&sh->count);
 		if (atomic_read(&sh->count)!= 1)
 			BUG();
+		if (conf->nr_workers && !list_empty(&conf->handle_list))
+			md_wakeup_thread(conf->workers[conf->next_worker++ % conf->nr_workers]);
 		md_spin_unlock_irq(&conf->device_lock);
 		
 		handled++;
@@ -1334,10 +1448,46 @@ static void raid5d (void *data)
 	PRINTK("%d stripes handled\n", handled);
 
 	md_spin_unlock_irq(&conf->device_lock);
+}
+
+/*
+ * This is our raid5 kernel thread.
+ *
+ * We scan the hash table for stripes which can be handled now.
+ * During the scan, completed stripes are saved for us by the interrupt
+ * handler, so that they will not have to wait for our next wakeup.
+ */
+static void raid5d (void *data)
+{
+	raid5_conf_t *conf = data;
+	mddev_t *mddev = conf->mddev;
+
+	PRINTK("+++ raid5d active\n");
+
+	if (mddev->sb_dirty)
+		md_update_sb(mddev);
+	raid5_handle_list(conf);
 
 	PRINTK("--- raid5d inactive\n");
 }
 
+static void raid5_worker (void *data)
+{
+	raid5_handle_list(data);
+}
+
+static void raid5_stop_workers(raid5_conf_t *conf)
+{
+	while (conf->nr_workers) {
+		mdk_thread_t *thread = conf->workers[conf->nr_workers - 1];
+
+		md_spin_lock_irq(&conf->device_lock);
+		conf->nr_workers--;
+		md_spin_unlock_irq(&conf->device_lock);
+		md_unregister_thread(thread);
+	}
+}
+
 /*
  * Private kernel thread for parity reconstruction after an unclean
  * shutdown. Reconstruction on spare drives in case of a failed drive
@@ -1405,6 +1555,10 @@ static int raid5_run (mddev_t *mddev)
 	conf->plug_tq.sync = 0;
 	conf->plug_tq.routine = &raid5_unplug_device;
 	conf->plug_tq.data = conf;
+	init_timer(&conf->delay_timer);
+	conf->delay_timer.function = raid5_delay_timeout;
+	conf->delay_timer.data = (unsigned long)conf;
+	INIT_LIST_HEAD(&conf->all_confs);
 
 	PRINTK("raid5_run(md%d) called.\n", mdidx(mddev));
 
@@ -1501,7 +1655,7 @@ static int raid5_run (mddev_t *mddev)
 	conf->chunk_size = sb->chunk_size;
 	conf->level = sb->level;
 	conf->algorithm = sb->layout;
-	conf->max_nr_stripes = NR_STRIPES;
+	conf->max_nr_stripes = raid5_stripe_cache_size;
 
 #if 0
 	for (i = 0; i < conf->raid_disks; i++) {
@@ -1539,6 +1693,16 @@ static int raid5_run (mddev_t *mddev)
 		}
 	}
 
+	while (conf->nr_workers < smp_num_cpus - 1) {
+		const char * name = "raid5w";
+		mdk_thread_t *thread;
+
+		thread = md_register_thread(raid5_worker, conf, name);
+		if (!thread)
+			break;
+		conf->workers[conf->nr_workers++] = thread;
+	}
+
 	memory = conf->max_nr_stripes * (sizeof(struct stripe_head) +
 		 conf->raid_disks * ((sizeof(struct buffer_head) + PAGE_SIZE))) / 1024;
 	if (grow_stripes(conf, conf->max_nr_stripes, GFP_KERNEL)) {
@@ -1587,11 +1751,16 @@ static int raid5_run (mddev_t *mddev)
 		md_recover_arrays();
 	print_raid5_conf(conf);
 
+	down(&raid5_confs_sem);
+	list_add(&conf->all_confs, &raid5_confs);
+	up(&raid5_confs_sem);
+
 	/* Ok, everything is just fine now */
 	return (0);
 abort:
 	if (conf) {
 		print_raid5_conf(conf);
+		raid5_stop_workers(conf);
 		if (conf->stripe_hashtbl)
 			free_pages((unsigned long) conf->stripe_hashtbl,
 							HASH_PAGES_ORDER);
@@ -1643,9 +1812,15 @@ static int raid5_stop (mddev_t *mddev)
 {
 	raid5_conf_t *conf = (raid5_conf_t *) mddev->private;
 
+	down(&raid5_confs_sem);
+	list_del(&conf->all_confs);
+	up(&raid5_confs_sem);
+
 	if (conf->resync_thread)
 		md_unregister_thread(conf->resync_thread);
+	raid5_stop_workers(conf);
 	md_unregister_thread(conf->thread);
+	del_timer_sync(&conf->delay_timer);
 	shrink_stripes(conf, conf->max_nr_stripes);
 	free_pages((unsigned long) conf->stripe_hashtbl, HASH_PAGES_ORDER);
 	kfree(conf);
@@ -2024,11 +2199,17 @@ static mdk_personality_t raid5_personality=
 
 static int md__init raid5_init (void)
 {
-	return register_md_personality (RAID5, &raid5_personality);
+	int err;
+
+	err = register_md_personality (RAID5, &raid5_personality);
+	if (!err)
+		raid5_table_header = register_sysctl_table(raid5_root_table, 1);
+	return err;
 }
 
 static void raid5_exit (void)
 {
+	unregister_sysctl_table(raid5_table_header);
 	unregister_md_personality (RAID5);
 }
 
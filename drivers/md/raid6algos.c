@@ -0,0 +1,182 @@
+/*
+ * raid6algos.c : Multiple Devices driver for Linux
+ *
+ * Galois field tables and the choice of a RAID-6 syndrome routine.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * (for example /usr/src/linux/COPYING); if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/raid/raid6.h>
+
+u8 raid6_gfmul[256][256];
+u8 raid6_gfexp[256];
+u8 raid6_gfinv[256];
+u8 raid6_gfexi[256];
+void *raid6_empty_zero_page;
+
+struct raid6_calls raid6_call;
+
+static u8 __init gfmul(u8 a, u8 b)
+{
+	u8 v = 0;
+
+	while (b) {
+		if (b & 1)
+			v ^= a;
+		a = (a << 1) ^ (a & 0x80 ? 0x1d : 0);
+		b >>= 1;
+	}
+	return v;
+}
+
+static u8 __init gfpow(u8 a, int b)
+{
+	u8 v = 1;
+
+	while (b--)
+		v = gfmul(v, a);
+	return v;
+}
+
+int __init raid6_init_tables(void)
+{
+	int i, j;
+	u8 v;
+
+	raid6_empty_zero_page = (void *) get_zeroed_page(GFP_KERNEL);
+	if (!raid6_empty_zero_page)
+		return -ENOMEM;
+
+	for (i = 0; i < 256; i++)
+		for (j = 0; j < 256; j++)
+			raid6_gfmul[i][j] = gfmul(i, j);
+
+	/* raid6_gfexp[255] would be g^0 again; it is never used */
+	v = 1;
+	for (i = 0; i < 256; i++) {
+		raid6_gfexp[i] = v;
+		v = gfmul(v, 2);
+		if (v == 1)
+			v = 0;
+	}
+
+	/* x^-1 == x^254, and 0 maps to 0 */
+	for (i = 0; i < 256; i++)
+		raid6_gfinv[i] = gfpow(i, 254);
+
+	for (i = 0; i < 256; i++)
+		raid6_gfexi[i] = raid6_gfinv[raid6_gfexp[i] ^ 1];
+
+	return 0;
+}
+
+void raid6_free_tables(void)
+{
+	free_page((unsigned long) raid6_empty_zero_page);
+}
+
+extern const struct raid6_calls raid6_intx1;
+extern const struct raid6_calls raid6_intx2;
+extern const struct raid6_calls raid6_mmxx1;
+extern const struct raid6_calls raid6_mmxx2;
+extern const struct raid6_calls raid6_sse1x1;
+extern const struct raid6_calls raid6_sse1x2;
+extern const struct raid6_calls raid6_sse2x1;
+extern const struct raid6_calls raid6_sse2x2;
+
+const struct raid6_calls * const raid6_algos[] = {
+	&raid6_intx1,
+	&raid6_intx2,
+#if defined(__i386__)
+	&raid6_mmxx1,
+	&raid6_mmxx2,
+	&raid6_sse1x1,
+	&raid6_sse1x2,
+	&raid6_sse2x1,
+	&raid6_sse2x2,
+#endif
+	NULL
+};
+
+#define RAID6_BENCH_DISKS	8
+
+/*
+ * Pick the fastest routine the CPU can run, by counting how many
+ * syndromes of a RAID6_BENCH_DISKS stripe each manages in a jiffy,
+ * the same way calibrate_xor_block() times the XOR templates.
+ */
+int __init raid6_select_algo(void)
+{
+	const struct raid6_calls * const *algo;
+	const struct raid6_calls *best = NULL;
+	void *dptrs[RAID6_BENCH_DISKS];
+	char *buf;
+	int i, best_speed = 0;
+
+	buf = (char *) md__get_free_pages(GFP_KERNEL, 3);
+	if (!buf) {
+		printk(KERN_ERR "raid6: Yikes!  No memory available.\n");
+		return -ENOMEM;
+	}
+	/* Data pages with something other than zeroes in them */
+	for (i = 0; i < RAID6_BENCH_DISKS - 2; i++) {
+		dptrs[i] = buf + i*PAGE_SIZE;
+		memset(dptrs[i], 0x5a + 3*i, PAGE_SIZE);
+	}
+	dptrs[i] = buf + i*PAGE_SIZE;		/* P */
+	dptrs[i+1] = buf + (i+1)*PAGE_SIZE;	/* Q */
+
+	printk(KERN_INFO "raid6: measuring syndrome speed\n");
+	sti();
+
+	for (algo = raid6_algos; *algo; algo++) {
+		unsigned long now;
+		int count, max = 0, speed;
+
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+
+		for (i = 0; i < 5; i++) {
+			now = jiffies;
+			while (jiffies == now)
+				mb();
+			now = jiffies;
+			count = 0;
+			while (jiffies == now) {
+				mb();
+				(*algo)->gen_syndrome(RAID6_BENCH_DISKS,
+						      PAGE_SIZE, dptrs);
+				mb();
+				count++;
+			}
+			if (count > max)
+				max = count;
+		}
+		/* data bytes per second, in kB */
+		speed = max * (HZ * (RAID6_BENCH_DISKS-2) * PAGE_SIZE / 1024);
+		printk("   %-8s: %5d.%03d MB/sec\n", (*algo)->name,
+		       speed / 1000, speed % 1000);
+		if (!best || speed > best_speed) {
+			best = *algo;
+			best_speed = speed;
+		}
+	}
+
+	free_pages((unsigned long) buf, 3);
+
+	raid6_call = *best;
+	raid6_call.speed = best_speed;
+	printk("raid6: using algorithm %s (%d.%03d MB/sec)\n", best->name,
+	       best_speed / 1000, best_speed % 1000);
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * raid6int.c : Multiple Devices driver for Linux
+ *
+ * RAID-6 syndrome calculation in plain C, a machine word at a time.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * (for example /usr/src/linux/COPYING); if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/raid/raid6.h>
+
+#define NSIZE	sizeof(unsigned long)
+
+/* The byte x in every byte of a word */
+#define NBYTES(x)	((~0UL / 0xff) * (x))
+
+/* Multiply every byte of a word by {02} */
+static inline unsigned long SHLBYTE(unsigned long v)
+{
+	return (v << 1) & NBYTES(0xfe);
+}
+
+/* 0xff in every byte whose top bit is set, 0x00 in the others */
+static inline unsigned long MASK(unsigned long v)
+{
+	v &= NBYTES(0x80);
+	return (v << 1) - (v >> 7);
+}
+
+/*
+ * Q is evaluated with Horner's rule from the highest data disk down,
+ * so every step is one multiplication by {02}: shift each byte left
+ * and reduce the ones which overflowed with 0x1d.
+ */
+static void raid6_int1_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	unsigned long wd0, wq0, wp0, w10, w20;
+
+	z0 = disks - 3;		/* highest data disk */
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	for (d = 0; d < bytes; d += NSIZE) {
+		wq0 = wp0 = *(unsigned long *)&dptr[z0][d];
+		for (z = z0-1; z >= 0; z--) {
+			wd0 = *(unsigned long *)&dptr[z][d];
+			wp0 ^= wd0;
+			w20 = MASK(wq0) & NBYTES(0x1d);
+			w10 = SHLBYTE(wq0);
+			wq0 = w10 ^ w20 ^ wd0;
+		}
+		*(unsigned long *)&p[d] = wp0;
+		*(unsigned long *)&q[d] = wq0;
+	}
+}
+
+static void raid6_int2_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	unsigned long wd0, wq0, wp0, w10, w20;
+	unsigned long wd1, wq1, wp1, w11, w21;
+
+	z0 = disks - 3;
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	for (d = 0; d < bytes; d += 2*NSIZE) {
+		wq0 = wp0 = *(unsigned long *)&dptr[z0][d];
+		wq1 = wp1 = *(unsigned long *)&dptr[z0][d+NSIZE];
+		for (z = z0-1; z >= 0; z--) {
+			wd0 = *(unsigned long *)&dptr[z][d];
+			wd1 = *(unsigned long *)&dptr[z][d+NSIZE];
+			wp0 ^= wd0;
+			wp1 ^= wd1;
+			w20 = MASK(wq0) & NBYTES(0x1d);
+			w21 = MASK(wq1) & NBYTES(0x1d);
+			w10 = SHLBYTE(wq0);
+			w11 = SHLBYTE(wq1);
+			wq0 = w10 ^ w20 ^ wd0;
+			wq1 = w11 ^ w21 ^ wd1;
+		}
+		*(unsigned long *)&p[d] = wp0;
+		*(unsigned long *)&p[d+NSIZE] = wp1;
+		*(unsigned long *)&q[d] = wq0;
+		*(unsigned long *)&q[d+NSIZE] = wq1;
+	}
+}
+
+const struct raid6_calls raid6_intx1 = {
+	gen_syndrome:	raid6_int1_gen_syndrome,
+	valid:		NULL,		/* always works */
+	name:		"intx1",
+};
+
+const struct raid6_calls raid6_intx2 = {
+	gen_syndrome:	raid6_int2_gen_syndrome,
+	valid:		NULL,
+	name:		"intx2",
+};
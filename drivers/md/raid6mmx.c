@@ -0,0 +1,133 @@
+/*
+ * raid6mmx.c : Multiple Devices driver for Linux
+ *
+ * RAID-6 syndrome calculation using MMX.
+ *
+ * Multiplying by {02} is done bytewise: pcmpgtb against zero gives
+ * 0xff for every byte with the top bit set, paddb shifts each byte
+ * left, and the mask picks where 0x1d has to be added back in.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * (for example /usr/src/linux/COPYING); if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if defined(__i386__)
+
+#include <linux/kernel.h>
+#include <linux/raid/raid6.h>
+#include "raid6x86.h"
+
+const struct raid6_mmx_constants raid6_mmx_constants = {
+	0x1d1d1d1d1d1d1d1dULL,
+};
+
+static int raid6_have_mmx(void)
+{
+	return cpu_has_mmx;
+}
+
+static void raid6_mmx1_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	raid6_mmx_save_t sa;
+
+	z0 = disks - 3;		/* highest data disk */
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	raid6_before_mmx(&sa);
+
+	__asm__ __volatile__ ("movq %0,%%mm0" : : "m" (raid6_mmx_constants.x1d));
+	__asm__ __volatile__ ("pxor %mm5,%mm5");	/* zero */
+
+	for (d = 0; d < bytes; d += 8) {
+		__asm__ __volatile__ ("movq %0,%%mm2" : : "m" (dptr[z0][d]));	/* P */
+		__asm__ __volatile__ ("movq %mm2,%mm4");			/* Q */
+		for (z = z0-1; z >= 0; z--) {
+			__asm__ __volatile__ ("movq %0,%%mm6" : : "m" (dptr[z][d]));
+			__asm__ __volatile__ ("pcmpgtb %mm4,%mm5");
+			__asm__ __volatile__ ("paddb %mm4,%mm4");
+			__asm__ __volatile__ ("pand %mm0,%mm5");
+			__asm__ __volatile__ ("pxor %mm5,%mm4");
+			__asm__ __volatile__ ("pxor %mm5,%mm5");
+			__asm__ __volatile__ ("pxor %mm6,%mm2");
+			__asm__ __volatile__ ("pxor %mm6,%mm4");
+		}
+		__asm__ __volatile__ ("movq %%mm2,%0" : "=m" (p[d]));
+		__asm__ __volatile__ ("movq %%mm4,%0" : "=m" (q[d]));
+	}
+
+	raid6_after_mmx(&sa);
+}
+
+/* Two quadwords at a time, to keep both MMX pipes busy */
+static void raid6_mmx2_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	raid6_mmx_save_t sa;
+
+	z0 = disks - 3;
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	raid6_before_mmx(&sa);
+
+	__asm__ __volatile__ ("movq %0,%%mm0" : : "m" (raid6_mmx_constants.x1d));
+	__asm__ __volatile__ ("pxor %mm5,%mm5");
+	__asm__ __volatile__ ("pxor %mm7,%mm7");
+
+	for (d = 0; d < bytes; d += 16) {
+		__asm__ __volatile__ ("movq %0,%%mm2" : : "m" (dptr[z0][d]));
+		__asm__ __volatile__ ("movq %0,%%mm3" : : "m" (dptr[z0][d+8]));
+		__asm__ __volatile__ ("movq %mm2,%mm4");
+		__asm__ __volatile__ ("movq %mm3,%mm6");
+		for (z = z0-1; z >= 0; z--) {
+			__asm__ __volatile__ ("pcmpgtb %mm4,%mm5");
+			__asm__ __volatile__ ("pcmpgtb %mm6,%mm7");
+			__asm__ __volatile__ ("paddb %mm4,%mm4");
+			__asm__ __volatile__ ("paddb %mm6,%mm6");
+			__asm__ __volatile__ ("pand %mm0,%mm5");
+			__asm__ __volatile__ ("pand %mm0,%mm7");
+			__asm__ __volatile__ ("pxor %mm5,%mm4");
+			__asm__ __volatile__ ("pxor %mm7,%mm6");
+			__asm__ __volatile__ ("movq %0,%%mm5" : : "m" (dptr[z][d]));
+			__asm__ __volatile__ ("movq %0,%%mm7" : : "m" (dptr[z][d+8]));
+			__asm__ __volatile__ ("pxor %mm5,%mm2");
+			__asm__ __volatile__ ("pxor %mm7,%mm3");
+			__asm__ __volatile__ ("pxor %mm5,%mm4");
+			__asm__ __volatile__ ("pxor %mm7,%mm6");
+			__asm__ __volatile__ ("pxor %mm5,%mm5");
+			__asm__ __volatile__ ("pxor %mm7,%mm7");
+		}
+		__asm__ __volatile__ ("movq %%mm2,%0" : "=m" (p[d]));
+		__asm__ __volatile__ ("movq %%mm3,%0" : "=m" (p[d+8]));
+		__asm__ __volatile__ ("movq %%mm4,%0" : "=m" (q[d]));
+		__asm__ __volatile__ ("movq %%mm6,%0" : "=m" (q[d+8]));
+	}
+
+	raid6_after_mmx(&sa);
+}
+
+const struct raid6_calls raid6_mmxx1 = {
+	gen_syndrome:	raid6_mmx1_gen_syndrome,
+	valid:		raid6_have_mmx,
+	name:		"mmxx1",
+};
+
+const struct raid6_calls raid6_mmxx2 = {
+	gen_syndrome:	raid6_mmx2_gen_syndrome,
+	valid:		raid6_have_mmx,
+	name:		"mmxx2",
+};
+
+#endif /* __i386__ */
@@ -0,0 +1,162 @@
+/*
+ * raid6recov.c : Multiple Devices driver for Linux
+ *
+ * RAID-6 recovery of two failed blocks, and a self-test of it.
+ *
+ * A missing data block together with P is rebuilt from Q alone; two
+ * missing data blocks need both syndromes.  A missing P or Q is just
+ * computed again and needs nothing from here.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * (for example /usr/src/linux/COPYING); if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/raid/raid6.h>
+
+/* Rebuild data blocks faila and failb, faila < failb */
+void raid6_2data_recov(int disks, size_t bytes, int faila, int failb,
+		       void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	u8 px, qx, db;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/*
+	 * Compute the syndromes with zeroes for the missing blocks,
+	 * using the missing blocks themselves to hold the new P and Q.
+	 */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/*
+	 * Now P + Pxy = A + B and Q + Qxy = g^a A + g^b B, so
+	 * B = (g^(b-a) + 1)^-1 (P + Pxy) + (g^a + g^b)^-1 (Q + Qxy).
+	 */
+	pbmul = raid6_gfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_gfmul[raid6_gfinv[raid6_gfexp[faila]^raid6_gfexp[failb]]];
+
+	while (bytes--) {
+		px    = *p ^ *dp;
+		qx    = qmul[*q ^ *dq];
+		*dq++ = db = pbmul[px] ^ qx;	/* B */
+		*dp++ = db ^ px;		/* A */
+		p++; q++;
+	}
+}
+
+/* Rebuild data block faila and P */
+void raid6_datap_recov(int disks, size_t bytes, int faila, void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* The missing block holds Q as it would be without it */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* A = g^-a (Q + Qx), and P gets A added back in */
+	qmul = raid6_gfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	while (bytes--) {
+		*p++ ^= *dq = qmul[*q ^ *dq];
+		q++; dq++;
+	}
+}
+
+#define RAID6_TEST_DISKS	8
+#define RAID6_TEST_SIZE		1024
+
+/*
+ * Fill a stripe with a pattern, wipe every possible pair of blocks
+ * and check that they come back.  Run when the personality is
+ * registered, so a broken syndrome routine never gets near real data.
+ */
+int __init raid6_recov_selftest(void)
+{
+	void *dptrs[RAID6_TEST_DISKS];
+	u8 *buf, *ref;
+	int i, j, a, b, err = 0;
+
+	/* The stripe, then a copy of it to compare with */
+	buf = (u8 *) __get_free_pages(GFP_KERNEL, 2);
+	if (!buf)
+		return -ENOMEM;
+	ref = buf + RAID6_TEST_DISKS * RAID6_TEST_SIZE;
+
+	for (i = 0; i < RAID6_TEST_DISKS; i++)
+		dptrs[i] = buf + i * RAID6_TEST_SIZE;
+	for (i = 0; i < RAID6_TEST_DISKS - 2; i++)
+		for (j = 0; j < RAID6_TEST_SIZE; j++)
+			buf[i * RAID6_TEST_SIZE + j] = i * 67 + j * 13 + (j >> 8);
+	raid6_call.gen_syndrome(RAID6_TEST_DISKS, RAID6_TEST_SIZE, dptrs);
+	memcpy(ref, buf, RAID6_TEST_DISKS * RAID6_TEST_SIZE);
+
+	for (a = 0; a < RAID6_TEST_DISKS - 1 && !err; a++)
+		for (b = a + 1; b < RAID6_TEST_DISKS && !err; b++) {
+			memset(dptrs[a], 0xf0, RAID6_TEST_SIZE);
+			memset(dptrs[b], 0xba, RAID6_TEST_SIZE);
+
+			if (b == RAID6_TEST_DISKS - 1) {
+				/* Q is lost: get the other block back from P */
+				if (a < RAID6_TEST_DISKS - 2) {
+					memset(dptrs[a], 0, RAID6_TEST_SIZE);
+					for (i = 0; i < RAID6_TEST_DISKS - 1; i++)
+						if (i != a)
+							for (j = 0; j < RAID6_TEST_SIZE; j++)
+								((u8 *)dptrs[a])[j] ^= ((u8 *)dptrs[i])[j];
+				}
+				raid6_call.gen_syndrome(RAID6_TEST_DISKS,
+							RAID6_TEST_SIZE, dptrs);
+			} else if (b == RAID6_TEST_DISKS - 2)
+				raid6_datap_recov(RAID6_TEST_DISKS,
+						  RAID6_TEST_SIZE, a, dptrs);
+			else
+				raid6_2data_recov(RAID6_TEST_DISKS,
+						  RAID6_TEST_SIZE, a, b, dptrs);
+
+			if (memcmp(ref, buf, RAID6_TEST_DISKS * RAID6_TEST_SIZE)) {
+				printk(KERN_ERR "raid6: %s: self-test failed to "
+				       "recover blocks %d and %d\n",
+				       raid6_call.name, a, b);
+				err = -EIO;
+			}
+		}
+	if (!err)
+		printk(KERN_INFO "raid6: recovery self-test passed\n");
+
+	free_pages((unsigned long) buf, 2);
+	return err;
+}
@@ -0,0 +1,147 @@
+/*
+ * raid6sse2.c : Multiple Devices driver for Linux
+ *
+ * RAID-6 syndrome calculation using SSE2: the arithmetic of
+ * raid6mmx.c on 16 bytes at a time in the XMM registers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * (for example /usr/src/linux/COPYING); if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if defined(__i386__)
+
+#include <linux/kernel.h>
+#include <linux/raid/raid6.h>
+#include "raid6x86.h"
+
+static const struct raid6_sse_constants {
+	u64 x1d[2];
+} raid6_sse_constants __attribute__((aligned(16))) = {
+	{ 0x1d1d1d1d1d1d1d1dULL, 0x1d1d1d1d1d1d1d1dULL },
+};
+
+static int raid6_have_sse2(void)
+{
+	return cpu_has_mmx && cpu_has_xmm && cpu_has_sse2;
+}
+
+/* The pages are page aligned, so movdqa/movntdq can be used on them */
+static void raid6_sse21_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	raid6_sse_save_t sa;
+
+	z0 = disks - 3;		/* highest data disk */
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	raid6_before_sse(&sa);
+
+	__asm__ __volatile__ ("movdqa %0,%%xmm0" : : "m" (raid6_sse_constants.x1d[0]));
+	__asm__ __volatile__ ("pxor %xmm5,%xmm5");	/* zero */
+
+	for (d = 0; d < bytes; d += 16) {
+		__asm__ __volatile__ ("prefetchnta %0" : : "m" (dptr[z0][d]));
+		__asm__ __volatile__ ("movdqa %0,%%xmm2" : : "m" (dptr[z0][d]));	/* P */
+		__asm__ __volatile__ ("prefetchnta %0" : : "m" (dptr[z0-1][d]));
+		__asm__ __volatile__ ("movdqa %xmm2,%xmm4");			/* Q */
+		__asm__ __volatile__ ("movdqa %0,%%xmm6" : : "m" (dptr[z0-1][d]));
+		for (z = z0-2; z >= 0; z--) {
+			__asm__ __volatile__ ("prefetchnta %0" : : "m" (dptr[z][d]));
+			__asm__ __volatile__ ("pcmpgtb %xmm4,%xmm5");
+			__asm__ __volatile__ ("paddb %xmm4,%xmm4");
+			__asm__ __volatile__ ("pand %xmm0,%xmm5");
+			__asm__ __volatile__ ("pxor %xmm5,%xmm4");
+			__asm__ __volatile__ ("pxor %xmm5,%xmm5");
+			__asm__ __volatile__ ("pxor %xmm6,%xmm2");
+			__asm__ __volatile__ ("pxor %xmm6,%xmm4");
+			__asm__ __volatile__ ("movdqa %0,%%xmm6" : : "m" (dptr[z][d]));
+		}
+		__asm__ __volatile__ ("pcmpgtb %xmm4,%xmm5");
+		__asm__ __volatile__ ("paddb %xmm4,%xmm4");
+		__asm__ __volatile__ ("pand %xmm0,%xmm5");
+		__asm__ __volatile__ ("pxor %xmm5,%xmm4");
+		__asm__ __volatile__ ("pxor %xmm5,%xmm5");
+		__asm__ __volatile__ ("pxor %xmm6,%xmm2");
+		__asm__ __volatile__ ("pxor %xmm6,%xmm4");
+
+		__asm__ __volatile__ ("movntdq %%xmm2,%0" : "=m" (p[d]));
+		__asm__ __volatile__ ("movntdq %%xmm4,%0" : "=m" (q[d]));
+	}
+
+	raid6_after_sse(&sa);	/* includes the sfence */
+}
+
+static void raid6_sse22_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+	raid6_sse_save_t sa;
+
+	z0 = disks - 3;
+	p = dptr[z0+1];
+	q = dptr[z0+2];
+
+	raid6_before_sse(&sa);
+
+	__asm__ __volatile__ ("movdqa %0,%%xmm0" : : "m" (raid6_sse_constants.x1d[0]));
+	__asm__ __volatile__ ("pxor %xmm5,%xmm5");
+	__asm__ __volatile__ ("pxor %xmm7,%xmm7");
+
+	/* We uniformly assume a single prefetch covers at least 32 bytes */
+	for (d = 0; d < bytes; d += 32) {
+		__asm__ __volatile__ ("prefetchnta %0" : : "m" (dptr[z0][d]));
+		__asm__ __volatile__ ("movdqa %0,%%xmm2" : : "m" (dptr[z0][d]));
+		__asm__ __volatile__ ("movdqa %0,%%xmm3" : : "m" (dptr[z0][d+16]));
+		__asm__ __volatile__ ("movdqa %xmm2,%xmm4");
+		__asm__ __volatile__ ("movdqa %xmm3,%xmm6");
+		for (z = z0-1; z >= 0; z--) {
+			__asm__ __volatile__ ("prefetchnta %0" : : "m" (dptr[z][d]));
+			__asm__ __volatile__ ("pcmpgtb %xmm4,%xmm5");
+			__asm__ __volatile__ ("pcmpgtb %xmm6,%xmm7");
+			__asm__ __volatile__ ("paddb %xmm4,%xmm4");
+			__asm__ __volatile__ ("paddb %xmm6,%xmm6");
+			__asm__ __volatile__ ("pand %xmm0,%xmm5");
+			__asm__ __volatile__ ("pand %xmm0,%xmm7");
+			__asm__ __volatile__ ("pxor %xmm5,%xmm4");
+			__asm__ __volatile__ ("pxor %xmm7,%xmm6");
+			__asm__ __volatile__ ("movdqa %0,%%xmm5" : : "m" (dptr[z][d]));
+			__asm__ __volatile__ ("movdqa %0,%%xmm7" : : "m" (dptr[z][d+16]));
+			__asm__ __volatile__ ("pxor %xmm5,%xmm2");
+			__asm__ __volatile__ ("pxor %xmm7,%xmm3");
+			__asm__ __volatile__ ("pxor %xmm5,%xmm4");
+			__asm__ __volatile__ ("pxor %xmm7,%xmm6");
+			__asm__ __volatile__ ("pxor %xmm5,%xmm5");
+			__asm__ __volatile__ ("pxor %xmm7,%xmm7");
+		}
+		__asm__ __volatile__ ("movntdq %%xmm2,%0" : "=m" (p[d]));
+		__asm__ __volatile__ ("movntdq %%xmm3,%0" : "=m" (p[d+16]));
+		__asm__ __volatile__ ("movntdq %%xmm4,%0" : "=m" (q[d]));
+		__asm__ __volatile__ ("movntdq %%xmm6,%0" : "=m" (q[d+16]));
+	}
+
+	raid6_after_sse(&sa);
+}
+
+const struct raid6_calls raid6_sse2x1 = {
+	gen_syndrome:	raid6_sse21_gen_syndrome,
+	valid:		raid6_have_sse2,
+	name:		"sse2x1",
+};
+
+const struct raid6_calls raid6_sse2x2 = {
+	gen_syndrome:	raid6_sse22_gen_syndrome,
+	valid:		raid6_have_sse2,
+	name:		"sse2x2",
+};
+
+#endif /* __i386__ */
@@ -0,0 +1,93 @@
+/*
+ * raid6x86.h
+ *
+ * Borrowing the FPU and SSE registers for the RAID-6 syndrome code,
+ * the same way include/asm-i386/xor.h does for RAID-5.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#ifndef _RAID6X86_H
+#define _RAID6X86_H
+
+#if defined(__i386__)
+
+#include <linux/sched.h>
+#include <asm/processor.h>
+#include <asm/system.h>
+
+typedef struct {
+	char fsave[108];
+} raid6_mmx_save_t;
+
+typedef struct {
+	char xmm[8*16];
+	unsigned long cr0;
+} raid6_sse_save_t;
+
+static inline void raid6_before_mmx(raid6_mmx_save_t *s)
+{
+	if (!(current->flags & PF_USEDFPU))
+		__asm__ __volatile__ ("clts");
+	__asm__ __volatile__ ("fsave %0; fwait" : "=m" (s->fsave[0]));
+}
+
+static inline void raid6_after_mmx(raid6_mmx_save_t *s)
+{
+	__asm__ __volatile__ ("frstor %0" : : "m" (s->fsave[0]));
+	if (!(current->flags & PF_USEDFPU))
+		stts();
+}
+
+/* The SSE code only uses %xmm0-%xmm7 */
+static inline void raid6_before_sse(raid6_sse_save_t *s)
+{
+	__asm__ __volatile__ (
+		"movl %%cr0,%0		;\n\t"
+		"clts			;\n\t"
+		"movups %%xmm0,(%1)	;\n\t"
+		"movups %%xmm1,0x10(%1)	;\n\t"
+		"movups %%xmm2,0x20(%1)	;\n\t"
+		"movups %%xmm3,0x30(%1)	;\n\t"
+		"movups %%xmm4,0x40(%1)	;\n\t"
+		"movups %%xmm5,0x50(%1)	;\n\t"
+		"movups %%xmm6,0x60(%1)	;\n\t"
+		"movups %%xmm7,0x70(%1)	;\n\t"
+		: "=&r" (s->cr0)
+		: "r" (s->xmm)
+		: "memory");
+}
+
+static inline void raid6_after_sse(raid6_sse_save_t *s)
+{
+	__asm__ __volatile__ (
+		"sfence			;\n\t"
+		"movups (%1),%%xmm0	;\n\t"
+		"movups 0x10(%1),%%xmm1	;\n\t"
+		"movups 0x20(%1),%%xmm2	;\n\t"
+		"movups 0x30(%1),%%xmm3	;\n\t"
+		"movups 0x40(%1),%%xmm4	;\n\t"
+		"movups 0x50(%1),%%xmm5	;\n\t"
+		"movups 0x60(%1),%%xmm6	;\n\t"
+		"movups 0x70(%1),%%xmm7	;\n\t"
+		"movl	%0,%%cr0	;\n\t"
+		:
+		: "r" (s->cr0), "r" (s->xmm)
+		: "memory");
+}
+
+/*
+ * The MMX routines and the SSE ones working on MMX registers (sse1)
+ * share this constant: the reduction polynomial in every byte.
+ */
+struct raid6_mmx_constants {
+	u64 x1d;
+};
+extern const struct raid6_mmx_constants raid6_mmx_constants;
+
+#endif /* __i386__ */
+
+#endif /* _RAID6X86_H */
@@ -1741,7 +1741,7 @@ ahc_linux_register_host(struct ahc_softc *ahc, Scsi_Host_Template *template)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,5,0)
 	scsi_assign_lock(host, &ahc->platform_data->spin_lock);
 #elif AHC_SCSI_HAS_HOST_LOCK != 0
-	host->lock = &ahc->platform_data->spin_lock;
+	scsi_assign_lock(host, &ahc->platform_data->spin_lock);
 #endif
 	ahc->platform_data->host = host;
 	host->can_queue = AHC_MAX_QUEUE;
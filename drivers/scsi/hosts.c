@@ -180,6 +180,8 @@ struct Scsi_Host * scsi_register(Scsi_Host_Template * tpnt, int j){
     next_scsi_host++;
     retval->host_queue = NULL;
     init_waitqueue_head(&retval->host_wait);
+    spin_lock_init(&retval->default_lock);
+    retval->host_lock = &io_request_lock;
     retval->resetting = 0;
     retval->last_reset = 0;
     retval->irq = 0;
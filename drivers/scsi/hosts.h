@@ -333,6 +333,8 @@ struct Scsi_Host
                                           this is true. */
     wait_queue_head_t       host_wait;
     Scsi_Host_Template    * hostt;
+    spinlock_t            * host_lock;  /* see scsi_assign_lock() */
+    spinlock_t              default_lock;
     atomic_t                host_active; /* commands checked out */
     volatile unsigned short host_busy;   /* commands actually active on low-level */
     volatile unsigned short host_failed; /* commands that failed. */
@@ -492,6 +494,25 @@ static inline void scsi_set_pci_device(struct Scsi_Host *SHpnt,
 	SHpnt->pci_dev = pdev;
 }
 
+/*
+ * Tells drivers shared with other trees that scsi_assign_lock() and
+ * host_lock are available.
+ */
+#define SCSI_HAS_HOST_LOCK
+
+/*
+ * The host lock is held around queuecommand() and is the queue lock of
+ * every device on the host.  It is io_request_lock unless the driver
+ * moves the host onto a lock of its own, usually &SHpnt->default_lock,
+ * by calling this from its detect routine.  The driver must then take
+ * that lock, not io_request_lock, in its interrupt handler and wherever
+ * else it used to serialize against the midlayer.
+ */
+static inline void scsi_assign_lock(struct Scsi_Host *SHpnt, spinlock_t *lock)
+{
+	SHpnt->host_lock = lock;
+}
+
 
 /*
  * Prototypes for functions/data in scsi_scan.c
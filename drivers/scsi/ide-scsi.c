@@ -294,7 +294,7 @@ static int idescsi_do_end_request (ide_drive_t *drive, int uptodate)
 	unsigned long flags;
 	int ret = 1;
 
-	spin_lock_irqsave(&io_request_lock, flags);
+	spin_lock_irqsave(&ide_lock, flags);
 	rq = HWGROUP(drive)->rq;
 
 	/*
@@ -313,7 +313,7 @@ static int idescsi_do_end_request (ide_drive_t *drive, int uptodate)
 		end_that_request_last(rq);
 		ret = 0;
 	}
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(&ide_lock, flags);
 	return ret;
 }
 
@@ -357,9 +357,9 @@ static int idescsi_end_request (ide_drive_t *drive, int uptodate)
 			} else printk("\n");
 		}
 	}
-	spin_lock_irqsave(&io_request_lock, flags);	
+	spin_lock_irqsave(pc->scsi_cmd->host->host_lock, flags);	
 	pc->done(pc->scsi_cmd);
-	spin_unlock_irqrestore(&io_request_lock, flags);
+	spin_unlock_irqrestore(pc->scsi_cmd->host->host_lock, flags);
 	idescsi_free_bh(rq->bh);
 	kfree(pc);
 	kfree(rq);
@@ -1089,9 +1089,9 @@ int idescsi_queue (Scsi_Cmnd *cmd, void (*done)(Scsi_Cmnd *))
 	rq->special = pc;
 	rq->bh = idescsi_dma_bh(drive, pc);
 	rq->cmd = IDESCSI_PC_RQ;
-	spin_unlock_irq(&io_request_lock);
+	spin_unlock_irq(cmd->host->host_lock);
 	(void) ide_do_drive_cmd(drive, rq, ide_end);
-	spin_lock_irq(&io_request_lock);
+	spin_lock_irq(cmd->host->host_lock);
 	return 0;
 abort:
 	if (pc) kfree(pc);
@@ -1126,14 +1126,14 @@ int idescsi_reset (Scsi_Cmnd *cmd, unsigned int resetflags)
 	   doesn't restart too early */ 
 	   
 	HWGROUP(drive)->busy = 1;
-	spin_unlock_irq(&io_request_lock);
+	spin_unlock_irq(cmd->host->host_lock);
 	
 	/* Apply the mallet of re-education firmly to the drive */
 	ide_do_reset(drive);
 
 	/* At this point the reset state machine is running and
 	   its termination will kick off the next command */	
-	spin_lock_irq(&io_request_lock);
+	spin_lock_irq(cmd->host->host_lock);
 	return SCSI_RESET_SUCCESS;
 #endif	
 }
@@ -588,6 +588,7 @@ fb_mmap(struct file *file, struct vm_area_struct * vma)
 	struct fb_var_screeninfo var;
 	unsigned long start;
 	u32 len;
+	int mmio = 0;
 #endif
 
 	if (vma->vm_pgoff > (~0UL >> PAGE_SHIFT))
@@ -628,6 +629,7 @@ fb_mmap(struct file *file, struct vm_area_struct * vma)
 		}
 		start = fix.mmio_start;
 		len = PAGE_ALIGN((start & ~PAGE_MASK)+fix.mmio_len);
+		mmio = 1;
 	}
 	unlock_kernel();
 	start &= PAGE_MASK;
@@ -659,7 +661,15 @@ fb_mmap(struct file *file, struct vm_area_struct * vma)
 	pgprot_val(vma->vm_page_prot) |= _PAGE_NO_CACHE|_PAGE_GUARDED;
 #elif defined(__alpha__)
 	/* Caching is off in the I/O space quadrant by design.  */
-#elif defined(__i386__) || defined(__x86_64__)
+#elif defined(__i386__)
+	/* The frame buffer proper can be write-combined, registers not */
+	if (boot_cpu_data.x86 > 3) {
+		if (mmio)
+			pgprot_val(vma->vm_page_prot) |= _PAGE_PCD;
+		else
+			vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	}
+#elif defined(__x86_64__)
 	if (boot_cpu_data.x86 > 3)
 		pgprot_val(vma->vm_page_prot) |= _PAGE_PCD;
 #elif defined(__arm__) || defined(__mips__)
@@ -0,0 +1,838 @@
+/*
+ *	linux/fs/aio.c
+ *
+ *	Asynchronous I/O: io_setup(), io_submit(), io_getevents(),
+ *	io_cancel() and io_destroy().
+ *
+ *	A context is a ring of completion events mapped into the process,
+ *	plus the requests that have been submitted but have not completed.
+ *	A request only takes a ring slot while it is in flight, and never
+ *	more requests are in flight than there are free slots, so the ring
+ *	cannot overflow.
+ *
+ *	Whether a request really runs in the background is up to the file:
+ *	f_op->aio_read and aio_write start the I/O and return -EIOCBQUEUED.
+ *	O_DIRECT files and raw devices do that for anything that fits in a
+ *	kiobuf.  Everything else is done with plain read and write before
+ *	io_submit() returns, and its event is posted right away.
+ *
+ *	Completions are posted from process context only: kiobuf I/O
+ *	finishes in an interrupt and hands the rest over to keventd.
+ */
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/iobuf.h>
+#include <linux/time.h>
+#include <linux/module.h>
+#include <linux/aio.h>
+
+#include <asm/uaccess.h>
+#include <asm/kmap_types.h>
+
+int aio_nr;			/* requests all contexts together can queue */
+int aio_max_nr = 0x10000;	/* /proc/sys/fs/aio-max-nr */
+static spinlock_t aio_nr_lock = SPIN_LOCK_UNLOCKED;
+
+static kmem_cache_t *kiocb_cachep;
+static kmem_cache_t *kioctx_cachep;
+
+#define AIO_EVENTS_PER_PAGE	(PAGE_SIZE / sizeof(struct io_event))
+#define AIO_EVENTS_FIRST_PAGE	((PAGE_SIZE - sizeof(struct aio_ring)) / sizeof(struct io_event))
+#define AIO_EVENTS_OFFSET	(AIO_EVENTS_PER_PAGE - AIO_EVENTS_FIRST_PAGE)
+
+static inline struct io_event *aio_ring_event(struct kioctx *ctx, unsigned nr,
+					      enum km_type km)
+{
+	struct io_event *events;
+
+	nr += AIO_EVENTS_OFFSET;
+	events = kmap_atomic(ctx->ring_pages[nr / AIO_EVENTS_PER_PAGE], km);
+	return events + nr % AIO_EVENTS_PER_PAGE;
+}
+
+static inline void put_aio_ring_event(struct io_event *event, enum km_type km)
+{
+	kunmap_atomic((void *)((unsigned long) event & PAGE_MASK), km);
+}
+
+/*
+ * Slots neither holding an event nor reserved for a request in flight.
+ * head belongs to user space, so don't trust it further than the
+ * modulo.
+ */
+static inline unsigned aio_ring_avail(struct kioctx *ctx, struct aio_ring *ring)
+{
+	return (ring->head + ctx->nr - 1 - ctx->tail) % ctx->nr;
+}
+
+static void aio_free_ring(struct kioctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->nr_pages; i++)
+		if (ctx->ring_pages[i])
+			put_page(ctx->ring_pages[i]);
+	kfree(ctx->ring_pages);
+}
+
+/*
+ * Map an anonymous area for the ring and pin its pages, so that
+ * completions can be posted without looking at the process' page
+ * tables.  The area isn't inherited across fork: the child would
+ * share the pages until one side wrote to them.
+ */
+static int aio_setup_ring(struct kioctx *ctx, unsigned nr_events)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	struct aio_ring *ring;
+	unsigned long size;
+	int nr_pages, got;
+
+	/* One slot always stays empty, to tell a full ring from an empty one */
+	nr_events++;
+
+	size = sizeof(struct aio_ring) + nr_events * sizeof(struct io_event);
+	nr_pages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	nr_events = ((nr_pages << PAGE_SHIFT) - sizeof(struct aio_ring)) /
+		    sizeof(struct io_event);
+
+	ctx->ring_pages = kmalloc(nr_pages * sizeof(struct page *), GFP_KERNEL);
+	if (!ctx->ring_pages)
+		return -ENOMEM;
+	memset(ctx->ring_pages, 0, nr_pages * sizeof(struct page *));
+	ctx->nr_pages = nr_pages;
+	ctx->mmap_size = nr_pages << PAGE_SHIFT;
+
+	down_write(&mm->mmap_sem);
+	ctx->user_id = do_mmap(NULL, 0, ctx->mmap_size, PROT_READ | PROT_WRITE,
+			       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (IS_ERR((void *) ctx->user_id)) {
+		up_write(&mm->mmap_sem);
+		kfree(ctx->ring_pages);
+		return ctx->user_id;
+	}
+	vma = find_vma(mm, ctx->user_id);
+	vma->vm_flags |= VM_DONTCOPY;
+	got = get_user_pages(current, mm, ctx->user_id, nr_pages, 1, 0,
+			     ctx->ring_pages, NULL);
+	if (got != nr_pages) {
+		do_munmap(mm, ctx->user_id, ctx->mmap_size);
+		up_write(&mm->mmap_sem);
+		aio_free_ring(ctx);
+		return -EAGAIN;
+	}
+	up_write(&mm->mmap_sem);
+
+	ctx->nr = nr_events;
+	ctx->tail = 0;
+
+	ring = kmap_atomic(ctx->ring_pages[0], KM_USER0);
+	ring->nr = nr_events;
+	ring->id = ~0U;
+	ring->head = ring->tail = 0;
+	ring->magic = AIO_RING_MAGIC;
+	ring->compat_features = AIO_RING_COMPAT_FEATURES;
+	ring->incompat_features = AIO_RING_INCOMPAT_FEATURES;
+	ring->header_length = sizeof(struct aio_ring);
+	kunmap_atomic(ring, KM_USER0);
+
+	return 0;
+}
+
+/*
+ * Take the ring out of the address space, unless user space already
+ * unmapped it and perhaps put something else there.
+ */
+static void aio_unmap_ring(struct kioctx *ctx)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+
+	down_write(&mm->mmap_sem);
+	vma = find_vma(mm, ctx->user_id);
+	if (vma && vma->vm_start == ctx->user_id && !vma->vm_file &&
+	    vma->vm_end == ctx->user_id + ctx->mmap_size)
+		do_munmap(mm, ctx->user_id, ctx->mmap_size);
+	up_write(&mm->mmap_sem);
+}
+
+static inline void get_ioctx(struct kioctx *ctx)
+{
+	atomic_inc(&ctx->users);
+}
+
+static void put_ioctx(struct kioctx *ctx)
+{
+	if (!atomic_dec_and_test(&ctx->users))
+		return;
+
+	aio_free_ring(ctx);
+	spin_lock(&aio_nr_lock);
+	aio_nr -= ctx->max_reqs;
+	spin_unlock(&aio_nr_lock);
+	kmem_cache_free(kioctx_cachep, ctx);
+}
+
+static struct kioctx *ioctx_alloc(unsigned nr_events)
+{
+	struct mm_struct *mm = current->mm;
+	struct kioctx *ctx;
+	int err;
+
+	if (nr_events > 0x10000000U / sizeof(struct io_event))
+		return ERR_PTR(-EINVAL);
+
+	spin_lock(&aio_nr_lock);
+	if (aio_nr + nr_events > aio_max_nr || aio_nr + nr_events < aio_nr) {
+		spin_unlock(&aio_nr_lock);
+		return ERR_PTR(-EAGAIN);
+	}
+	aio_nr += nr_events;
+	spin_unlock(&aio_nr_lock);
+
+	ctx = kmem_cache_alloc(kioctx_cachep, GFP_KERNEL);
+	if (!ctx) {
+		err = -ENOMEM;
+		goto out_nr;
+	}
+	memset(ctx, 0, sizeof(*ctx));
+	atomic_set(&ctx->users, 1);
+	init_waitqueue_head(&ctx->wait);
+	spin_lock_init(&ctx->ctx_lock);
+	INIT_LIST_HEAD(&ctx->active_reqs);
+	ctx->max_reqs = nr_events;
+
+	err = aio_setup_ring(ctx, nr_events);
+	if (err)
+		goto out_free;
+
+	write_lock(&mm->ioctx_list_lock);
+	ctx->next = mm->ioctx_list;
+	mm->ioctx_list = ctx;
+	write_unlock(&mm->ioctx_list_lock);
+
+	return ctx;
+
+out_free:
+	kmem_cache_free(kioctx_cachep, ctx);
+out_nr:
+	spin_lock(&aio_nr_lock);
+	aio_nr -= nr_events;
+	spin_unlock(&aio_nr_lock);
+	return ERR_PTR(err);
+}
+
+static struct kioctx *lookup_ioctx(unsigned long ctx_id)
+{
+	struct mm_struct *mm = current->mm;
+	struct kioctx *ctx;
+
+	read_lock(&mm->ioctx_list_lock);
+	for (ctx = mm->ioctx_list; ctx; ctx = ctx->next)
+		if (ctx->user_id == ctx_id && !ctx->dead) {
+			get_ioctx(ctx);
+			break;
+		}
+	read_unlock(&mm->ioctx_list_lock);
+
+	return ctx;
+}
+
+/*
+ * Requests in flight may have pinned user pages and hold files open,
+ * so whoever tears a context down waits for them.  There is nothing to
+ * cancel them with: block I/O can't be called back.
+ */
+static void wait_for_all_aios(struct kioctx *ctx)
+{
+	struct task_struct *tsk = current;
+	DECLARE_WAITQUEUE(wait, tsk);
+
+	if (!ctx->reqs_active)
+		return;
+
+	add_wait_queue(&ctx->wait, &wait);
+	set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+	while (ctx->reqs_active) {
+		run_task_queue(&tq_disk);
+		schedule();
+		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+	}
+	__set_task_state(tsk, TASK_RUNNING);
+	remove_wait_queue(&ctx->wait, &wait);
+}
+
+static void io_destroy(struct kioctx *ctx)
+{
+	struct mm_struct *mm = current->mm;
+	struct kioctx **tmp;
+	int was_dead;
+
+	write_lock(&mm->ioctx_list_lock);
+	was_dead = ctx->dead;
+	ctx->dead = 1;
+	for (tmp = &mm->ioctx_list; *tmp; tmp = &(*tmp)->next)
+		if (*tmp == ctx) {
+			*tmp = ctx->next;
+			break;
+		}
+	write_unlock(&mm->ioctx_list_lock);
+
+	/* Somebody else got here first */
+	if (was_dead)
+		return;
+
+	/* Kick anybody in io_getevents(), they'll see it's dead */
+	wake_up(&ctx->wait);
+	wait_for_all_aios(ctx);
+	aio_unmap_ring(ctx);
+	put_ioctx(ctx);		/* the reference of mm->ioctx_list */
+}
+
+/*
+ * Called from mmput() when the address space goes away.  The ring
+ * mappings go with it, so only the contexts have to be dropped.
+ */
+void exit_aio(struct mm_struct *mm)
+{
+	struct kioctx *ctx = mm->ioctx_list;
+
+	mm->ioctx_list = NULL;
+	while (ctx) {
+		struct kioctx *next = ctx->next;
+
+		ctx->dead = 1;
+		wait_for_all_aios(ctx);
+		put_ioctx(ctx);
+		ctx = next;
+	}
+}
+
+/*
+ * Allocate a request and reserve a ring slot for its completion.
+ * Returns NULL if the ring is already spoken for.
+ */
+static struct kiocb *aio_get_req(struct kioctx *ctx)
+{
+	struct aio_ring *ring;
+	struct kiocb *req;
+	int okay = 0;
+
+	req = kmem_cache_alloc(kiocb_cachep, GFP_KERNEL);
+	if (!req)
+		return NULL;
+	memset(req, 0, sizeof(*req));
+	req->ki_ctx = ctx;
+
+	spin_lock(&ctx->ctx_lock);
+	ring = kmap_atomic(ctx->ring_pages[0], KM_USER0);
+	if (ctx->reqs_active < aio_ring_avail(ctx, ring)) {
+		list_add(&req->ki_list, &ctx->active_reqs);
+		ctx->reqs_active++;
+		get_ioctx(ctx);
+		okay = 1;
+	}
+	kunmap_atomic(ring, KM_USER0);
+	spin_unlock(&ctx->ctx_lock);
+
+	if (!okay) {
+		kmem_cache_free(kiocb_cachep, req);
+		req = NULL;
+	}
+	return req;
+}
+
+/**
+ * aio_complete - post the completion event of a request
+ * @iocb: the request
+ * @res: result, the byte count or a negative error
+ * @res2: secondary result, usually 0
+ *
+ * Frees the request.  Must be called from process context.
+ */
+void aio_complete(struct kiocb *iocb, long res, long res2)
+{
+	struct kioctx *ctx = iocb->ki_ctx;
+	struct io_event *event;
+	struct aio_ring *ring;
+	unsigned tail;
+
+	spin_lock(&ctx->ctx_lock);
+
+	ring = kmap_atomic(ctx->ring_pages[0], KM_USER0);
+	tail = ctx->tail;
+	event = aio_ring_event(ctx, tail, KM_USER1);
+	if (++tail >= ctx->nr)
+		tail = 0;
+
+	event->obj = (u64)(unsigned long) iocb->ki_user_obj;
+	event->data = iocb->ki_user_data;
+	event->res = res;
+	event->res2 = res2;
+	put_aio_ring_event(event, KM_USER1);
+
+	/* The event has to be there before anybody sees the new tail */
+	smp_wmb();
+	ctx->tail = tail;
+	ring->tail = tail;
+	kunmap_atomic(ring, KM_USER0);
+
+	list_del(&iocb->ki_list);
+	ctx->reqs_active--;
+	spin_unlock(&ctx->ctx_lock);
+
+	wake_up(&ctx->wait);
+
+	fput(iocb->ki_filp);
+	kmem_cache_free(kiocb_cachep, iocb);
+	put_ioctx(ctx);
+}
+
+/*
+ * kiobuf based I/O.  The submitter maps the user buffer with
+ * aio_kiobuf_map(), starts the I/O with brw_kiovec() (directly or
+ * through direct_IO) and passes what that returned to
+ * aio_kiobuf_submitted().  Once the last bio is done, keventd unmaps
+ * the buffer, calls the submitter's done routine and posts the event.
+ */
+static void aio_kiobuf_done(void *data)
+{
+	struct kiocb *iocb = data;
+	struct kiobuf *iobuf = iocb->ki_iobuf;
+	ssize_t res = iocb->ki_res;
+
+	if (res >= 0 && iobuf->errno)
+		res = iobuf->errno;
+	if (iocb->ki_rw == READ && res > 0)
+		mark_dirty_kiobuf(iobuf, res);
+	aio_kiobuf_cancel(iocb);
+
+	if (iocb->ki_done)
+		iocb->ki_done(iocb);
+	aio_complete(iocb, res, 0);
+}
+
+static void aio_kiobuf_end_io(struct kiobuf *iobuf)
+{
+	struct kiocb *iocb = iobuf->private;
+
+	INIT_TQUEUE(&iocb->ki_tq, aio_kiobuf_done, iocb);
+	schedule_task(&iocb->ki_tq);
+}
+
+/**
+ * aio_kiobuf_map - map the user buffer of a request into a kiobuf
+ * @iocb: the request
+ * @rw: %READ or %WRITE
+ * @buf: user buffer
+ * @len: its length, which must fit in one kiobuf
+ * @done: called from keventd once the I/O has completed, or %NULL
+ *
+ * On success iocb->ki_iobuf is an asynchronous kiobuf (see iobuf.h)
+ * with one io_count held, which aio_kiobuf_submitted() drops.
+ */
+int aio_kiobuf_map(struct kiocb *iocb, int rw, char *buf, size_t len,
+		   void (*done)(struct kiocb *))
+{
+	struct kiobuf *iobuf;
+	int err;
+
+	err = alloc_kiovec(1, &iobuf);
+	if (err)
+		return err;
+	err = map_user_kiobuf(rw, iobuf, (unsigned long) buf, len);
+	if (err) {
+		free_kiovec(1, &iobuf);
+		return err;
+	}
+
+	iobuf->errno = 0;
+	iobuf->end_io = aio_kiobuf_end_io;
+	iobuf->private = iocb;
+	atomic_set(&iobuf->io_count, 1);
+
+	iocb->ki_rw = rw;
+	iocb->ki_iobuf = iobuf;
+	iocb->ki_done = done;
+	return 0;
+}
+
+/**
+ * aio_kiobuf_submitted - all I/O of a mapped request has been started
+ * @iocb: the request
+ * @res: the result of brw_kiovec(), or of whatever called it
+ *
+ * The request completes with @res once the I/O is done, or with an
+ * error if the I/O failed.
+ */
+void aio_kiobuf_submitted(struct kiocb *iocb, ssize_t res)
+{
+	iocb->ki_res = res;
+	end_kio_request(iocb->ki_iobuf, 1);
+}
+
+/**
+ * aio_kiobuf_cancel - undo aio_kiobuf_map()
+ * @iocb: the request
+ *
+ * Only for a request that has not started any I/O.
+ */
+void aio_kiobuf_cancel(struct kiocb *iocb)
+{
+	struct kiobuf *iobuf = iocb->ki_iobuf;
+
+	unmap_kiobuf(iobuf);
+	free_kiovec(1, &iobuf);
+	iocb->ki_iobuf = NULL;
+}
+
+static ssize_t aio_rw(int rw, struct kiocb *req, char *buf, size_t count,
+		      loff_t pos)
+{
+	struct file *file = req->ki_filp;
+	ssize_t ret = -ENOTBLK;
+
+	if (rw == READ) {
+		if (file->f_op->aio_read)
+			ret = file->f_op->aio_read(req, buf, count, pos);
+		if (ret == -ENOTBLK)
+			ret = file->f_op->read(file, buf, count, &pos);
+	} else {
+		if (file->f_op->aio_write)
+			ret = file->f_op->aio_write(req, buf, count, pos);
+		if (ret == -ENOTBLK)
+			ret = file->f_op->write(file, buf, count, &pos);
+	}
+	return ret;
+}
+
+static int io_submit_one(struct kioctx *ctx, struct iocb *user_iocb,
+			 struct iocb *iocb)
+{
+	struct kiocb *req;
+	struct file *file;
+	struct inode *inode;
+	char *buf = (char *)(unsigned long) iocb->aio_buf;
+	size_t count = iocb->aio_nbytes;
+	loff_t pos = iocb->aio_offset;
+	ssize_t ret;
+
+	/* enforce forwards compatibility on users */
+	if (iocb->aio_reserved1 || iocb->aio_reserved2 || iocb->aio_reserved3)
+		return -EINVAL;
+
+	/* prevent overflows */
+	if (iocb->aio_buf != (unsigned long) iocb->aio_buf ||
+	    iocb->aio_nbytes != count || (ssize_t) count < 0)
+		return -EINVAL;
+
+	file = fget(iocb->aio_fildes);
+	if (!file)
+		return -EBADF;
+	inode = file->f_dentry->d_inode;
+
+	switch (iocb->aio_lio_opcode) {
+	case IOCB_CMD_PREAD:
+		ret = -EBADF;
+		if (!(file->f_mode & FMODE_READ))
+			goto out_fput;
+		ret = -EINVAL;
+		if (!file->f_op || !file->f_op->read || pos < 0)
+			goto out_fput;
+		ret = -EFAULT;
+		if (!access_ok(VERIFY_WRITE, buf, count))
+			goto out_fput;
+		ret = locks_verify_area(FLOCK_VERIFY_READ, inode, file, pos, count);
+		if (ret)
+			goto out_fput;
+		break;
+	case IOCB_CMD_PWRITE:
+		ret = -EBADF;
+		if (!(file->f_mode & FMODE_WRITE))
+			goto out_fput;
+		ret = -EINVAL;
+		if (!file->f_op || !file->f_op->write || pos < 0)
+			goto out_fput;
+		ret = -EFAULT;
+		if (!access_ok(VERIFY_READ, buf, count))
+			goto out_fput;
+		ret = locks_verify_area(FLOCK_VERIFY_WRITE, inode, file, pos, count);
+		if (ret)
+			goto out_fput;
+		break;
+	case IOCB_CMD_FSYNC:
+	case IOCB_CMD_FDSYNC:
+		ret = -EINVAL;
+		if (!file->f_op || !file->f_op->fsync)
+			goto out_fput;
+		break;
+	case IOCB_CMD_NOOP:
+		break;
+	default:
+		ret = -EINVAL;
+		goto out_fput;
+	}
+
+	ret = put_user(0, &user_iocb->aio_key);
+	if (ret)
+		goto out_fput;
+
+	req = aio_get_req(ctx);
+	if (!req) {
+		ret = -EAGAIN;
+		goto out_fput;
+	}
+	req->ki_filp = file;
+	req->ki_user_obj = user_iocb;
+	req->ki_user_data = iocb->aio_data;
+
+	switch (iocb->aio_lio_opcode) {
+	case IOCB_CMD_PREAD:
+		ret = aio_rw(READ, req, buf, count, pos);
+		break;
+	case IOCB_CMD_PWRITE:
+		ret = aio_rw(WRITE, req, buf, count, pos);
+		break;
+	case IOCB_CMD_FSYNC:
+	case IOCB_CMD_FDSYNC:
+		down(&inode->i_sem);
+		ret = do_fsync(file, iocb->aio_lio_opcode == IOCB_CMD_FDSYNC);
+		up(&inode->i_sem);
+		break;
+	default:
+		ret = 0;
+	}
+
+	if (ret != -EIOCBQUEUED)
+		aio_complete(req, ret, 0);
+	return 0;
+
+out_fput:
+	fput(file);
+	return ret;
+}
+
+/* sys_io_setup:
+ *	Create a context able to take nr_events requests at a time and
+ *	store its id in *ctxp, which must be zero on entry.
+ */
+asmlinkage long sys_io_setup(unsigned nr_events, aio_context_t *ctxp)
+{
+	struct kioctx *ioctx;
+	unsigned long ctx;
+	long ret;
+
+	ret = get_user(ctx, ctxp);
+	if (ret)
+		return ret;
+	if (ctx || (int) nr_events <= 0)
+		return -EINVAL;
+
+	ioctx = ioctx_alloc(nr_events);
+	if (IS_ERR(ioctx))
+		return PTR_ERR(ioctx);
+
+	ret = put_user(ioctx->user_id, ctxp);
+	if (ret)
+		io_destroy(ioctx);
+	return ret;
+}
+
+/* sys_io_destroy:
+ *	Wait for the requests of a context to complete and free it.
+ */
+asmlinkage long sys_io_destroy(aio_context_t ctx)
+{
+	struct kioctx *ioctx = lookup_ioctx(ctx);
+
+	if (!ioctx)
+		return -EINVAL;
+	io_destroy(ioctx);
+	put_ioctx(ioctx);
+	return 0;
+}
+
+/* sys_io_submit:
+ *	Queue the nr iocbs pointed to by iocbpp.  Returns the number
+ *	queued, or an error if the first one couldn't be.
+ */
+asmlinkage long sys_io_submit(aio_context_t ctx_id, long nr,
+			      struct iocb **iocbpp)
+{
+	struct kioctx *ctx;
+	long ret = 0;
+	int i;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	ctx = lookup_ioctx(ctx_id);
+	if (!ctx)
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		struct iocb *user_iocb, tmp;
+
+		if (get_user(user_iocb, iocbpp + i)) {
+			ret = -EFAULT;
+			break;
+		}
+		if (copy_from_user(&tmp, user_iocb, sizeof(tmp))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = io_submit_one(ctx, user_iocb, &tmp);
+		if (ret)
+			break;
+	}
+
+	put_ioctx(ctx);
+	return i ? i : ret;
+}
+
+/* sys_io_cancel:
+ *	Nothing that gets queued can be called back once it has been
+ *	started, so this fails with -EAGAIN for a request that is still
+ *	in flight, and with -EINVAL for anything else.
+ */
+asmlinkage long sys_io_cancel(aio_context_t ctx_id, struct iocb *iocb,
+			      struct io_event *result)
+{
+	struct kioctx *ctx;
+	struct list_head *pos;
+	long ret = -EINVAL;
+
+	ctx = lookup_ioctx(ctx_id);
+	if (!ctx)
+		return -EINVAL;
+
+	spin_lock(&ctx->ctx_lock);
+	list_for_each(pos, &ctx->active_reqs)
+		if (list_entry(pos, struct kiocb, ki_list)->ki_user_obj == iocb) {
+			ret = -EAGAIN;
+			break;
+		}
+	spin_unlock(&ctx->ctx_lock);
+
+	put_ioctx(ctx);
+	return ret;
+}
+
+/* Take the event at the head of the ring, if there is one */
+static int aio_read_evt(struct kioctx *ctx, struct io_event *ent)
+{
+	struct aio_ring *ring;
+	unsigned head;
+	int ret = 0;
+
+	spin_lock(&ctx->ctx_lock);
+	ring = kmap_atomic(ctx->ring_pages[0], KM_USER0);
+	head = ring->head % ctx->nr;
+	if (head != ctx->tail) {
+		struct io_event *evp = aio_ring_event(ctx, head, KM_USER1);
+
+		*ent = *evp;
+		put_aio_ring_event(evp, KM_USER1);
+		ring->head = (head + 1) % ctx->nr;
+		ret = 1;
+	}
+	kunmap_atomic(ring, KM_USER0);
+	spin_unlock(&ctx->ctx_lock);
+
+	return ret;
+}
+
+/* sys_io_getevents:
+ *	Copy at least min_nr and at most nr events to the events array,
+ *	waiting for up to *timeout (forever if timeout is NULL) for the
+ *	first min_nr.  Returns the number of events copied.
+ */
+asmlinkage long sys_io_getevents(aio_context_t ctx_id, long min_nr, long nr,
+				 struct io_event *events,
+				 struct timespec *timeout)
+{
+	struct task_struct *tsk = current;
+	DECLARE_WAITQUEUE(wait, tsk);
+	struct kioctx *ctx;
+	struct io_event ent;
+	long left = MAX_SCHEDULE_TIMEOUT;
+	long ret = 0;
+	int i = 0;
+
+	if (min_nr < 0 || nr < 0 || min_nr > nr)
+		return -EINVAL;
+
+	if (timeout) {
+		struct timespec ts;
+
+		if (copy_from_user(&ts, timeout, sizeof(ts)))
+			return -EFAULT;
+		if (ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000L || ts.tv_sec < 0)
+			return -EINVAL;
+		left = timespec_to_jiffies(&ts) + (ts.tv_sec || ts.tv_nsec);
+	}
+
+	ctx = lookup_ioctx(ctx_id);
+	if (!ctx)
+		return -EINVAL;
+
+	add_wait_queue(&ctx->wait, &wait);
+	while (i < nr) {
+		set_task_state(tsk, TASK_INTERRUPTIBLE);
+		if (!aio_read_evt(ctx, &ent)) {
+			if (i >= min_nr || !left)
+				break;
+			if (ctx->dead) {
+				ret = -EINVAL;
+				break;
+			}
+			if (signal_pending(tsk)) {
+				ret = -EINTR;
+				break;
+			}
+			left = schedule_timeout(left);
+			continue;
+		}
+		__set_task_state(tsk, TASK_RUNNING);
+
+		if (copy_to_user(events + i, &ent, sizeof(ent))) {
+			ret = -EFAULT;
+			break;
+		}
+		i++;
+	}
+	__set_task_state(tsk, TASK_RUNNING);
+	remove_wait_queue(&ctx->wait, &wait);
+
+	put_ioctx(ctx);
+	return i ? i : ret;
+}
+
+static int __init aio_setup(void)
+{
+	kiocb_cachep = kmem_cache_create("kiocb", sizeof(struct kiocb),
+					 0, SLAB_HWCACHE_ALIGN, NULL, NULL);
+	kioctx_cachep = kmem_cache_create("kioctx", sizeof(struct kioctx),
+					  0, SLAB_HWCACHE_ALIGN, NULL, NULL);
+	if (!kiocb_cachep || !kioctx_cachep)
+		panic("Cannot create AIO SLAB caches");
+	return 0;
+}
+
+__initcall(aio_setup);
+
+EXPORT_SYMBOL(aio_complete);
+EXPORT_SYMBOL(aio_kiobuf_map);
+EXPORT_SYMBOL(aio_kiobuf_submitted);
+EXPORT_SYMBOL(aio_kiobuf_cancel);
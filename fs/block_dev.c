@@ -677,6 +677,8 @@ struct file_operations def_blk_fops = {
 	llseek:		block_llseek,
 	read:		generic_file_read,
 	write:		generic_file_write,
+	aio_read:	generic_file_aio_read,
+	aio_write:	generic_file_aio_write,
 	mmap:		generic_file_mmap,
 	fsync:		block_fsync,
 	ioctl:		blkdev_ioctl,
@@ -40,6 +40,7 @@
 #include <linux/vmalloc.h>
 #include <linux/blkdev.h>
 #include <linux/sysrq.h>
+#include <linux/sysctl.h>
 #include <linux/file.h>
 #include <linux/init.h>
 #include <linux/quotaops.h>
@@ -47,6 +48,7 @@
 #include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/completion.h>
+#include <linux/bio.h>
 
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -58,7 +60,10 @@
 					     number of unused buffer heads */
 
 /* Anti-deadlock ordering:
- *	lru_list_lock > hash_table_lock > unused_list_lock
+ *	queue lru_lock > hash lock > inode_buffers_lock, unused_list_lock
+ *
+ * Several lru_locks are only ever taken in ascending order, by
+ * lock_page_queues(), and so are several hash locks, by lock_hash().
  */
 
 #define BH_ENTRY(list) list_entry((list), struct buffer_head, b_inode_buffers)
@@ -69,15 +74,188 @@
 static unsigned int bh_hash_mask;
 static unsigned int bh_hash_shift;
 static struct buffer_head **hash_table;
-static rwlock_t hash_table_lock = RW_LOCK_UNLOCKED;
 
-static struct buffer_head *lru_list[NR_LIST];
+/* After several hours of tedious analysis, the following hash
+ * function won.  Do not mess with it... -DaveM
+ */
+#define _hashfn(dev,block)	\
+	((((dev)<<(bh_hash_shift - 6)) ^ ((dev)<<(bh_hash_shift - 9))) ^ \
+	 (((block)<<(bh_hash_shift - 6)) ^ ((block) >> 13) ^ \
+	  ((block) << (bh_hash_shift - 12))))
+#define hash(dev,block) hash_table[(_hashfn(HASHDEV(dev),block) & bh_hash_mask)]
+
+/*
+ * The hash chains are covered by an array of locks instead of a single
+ * one, each lock taking every NR_BH_HASH_LOCKS'th chain.  The buffers
+ * of a page are mostly on different chains, so whole-page operations
+ * lock a set of them with lock_hash().
+ */
+#define NR_BH_HASH_LOCKS	32	/* no more than BITS_PER_LONG */
+
+static struct bh_hash_lock {
+	rwlock_t lock;
+} ____cacheline_aligned_in_smp bh_hash_locks[NR_BH_HASH_LOCKS] = {
+	[0 ... NR_BH_HASH_LOCKS - 1] = { RW_LOCK_UNLOCKED }
+};
+
+static inline int bh_hash_nr(kdev_t dev, unsigned long block)
+{
+	return (_hashfn(HASHDEV(dev), block) & bh_hash_mask) %
+		NR_BH_HASH_LOCKS;
+}
+
+static inline rwlock_t *bh_hash_lock(kdev_t dev, unsigned long block)
+{
+	return &bh_hash_locks[bh_hash_nr(dev, block)].lock;
+}
+
+/* The hash locks of all the buffers on a page, as a set */
+static unsigned long page_hash_locks(struct buffer_head *head)
+{
+	struct buffer_head *bh = head;
+	unsigned long mask = 0;
+
+	do {
+		mask |= 1UL << bh_hash_nr(bh->b_dev, bh->b_blocknr);
+		bh = bh->b_this_page;
+	} while (bh != head);
+	return mask;
+}
+
+/* Write-lock a set of hash locks, in ascending order */
+static void lock_hash(unsigned long mask)
+{
+	int i;
+
+	for (i = 0; mask; i++, mask >>= 1)
+		if (mask & 1)
+			write_lock(&bh_hash_locks[i].lock);
+}
+
+static void unlock_hash(unsigned long mask)
+{
+	int i;
+
+	for (i = 0; mask; i++, mask >>= 1)
+		if (mask & 1)
+			write_unlock(&bh_hash_locks[i].lock);
+}
+
+/*
+ * The LRU lists are split up by device (see bdflush_queue()).  Every
+ * part has its own lock, so that filesystems on different disks don't
+ * all serialize on one, and its own bdflush thread, so that a device
+ * with a full request queue only holds up writeback to the devices
+ * sharing its thread.
+ *
+ * A buffer goes on the queue of its b_dev when it is first filed, and
+ * stays there (b_flushq) until it is taken off the lists again; b_dev
+ * doesn't change in between.  lock_bh_queue() finds and locks it.
+ */
+#define NR_BDFLUSH_MAX	32	/* no more than BITS_PER_LONG */
+
+struct bdflush_queue {
+	spinlock_t lru_lock;		/* protects the lists */
+	struct buffer_head *lru[NR_LIST];	/* oldest first */
+	int nr[NR_LIST];
+	unsigned long size[NR_LIST];
+	int kupdate;			/* wakeup_kupdate() was called */
+	int flush;			/* wakeup_bdflush() was called */
+	wait_queue_head_t wait;		/* the thread sleeps here */
+} ____cacheline_aligned;
+
+static struct bdflush_queue bdflush_queues[NR_BDFLUSH_MAX];
+int nr_bdflush = 16;
+
+static int __init bdflush_threads_setup(char *str)
+{
+	nr_bdflush = simple_strtoul(str, NULL, 0);
+	if (nr_bdflush < 1)
+		nr_bdflush = 1;
+	if (nr_bdflush > NR_BDFLUSH_MAX)
+		nr_bdflush = NR_BDFLUSH_MAX;
+	return 1;
+}
+__setup("bdflush_threads=", bdflush_threads_setup);
+
+/*
+ * Partitions of a disk share its queue.  Devices without a gendisk,
+ * or with one but no partitions (md, loop, nbd and the like), get a
+ * queue per minor, as each of them may sit on different disks.  The
+ * shift is the one add_gendisk() last recorded for the major, so this
+ * takes no lock and doesn't change when a disk is unregistered.
+ */
+int bdflush_queue(kdev_t dev)
+{
+	int minor = MINOR(dev) >> gendisk_minor_shift[MAJOR(dev)];
+
+	return (MAJOR(dev) * 7 + minor) % nr_bdflush;
+}
+
+/* The queue the buffer is on, or would be filed on */
+static inline int bh_queue_nr(struct buffer_head *bh)
+{
+	if (bh->b_next_free)
+		return bh->b_flushq;
+	return bdflush_queue(bh->b_dev);
+}
+
+static struct bdflush_queue *lock_bh_queue(struct buffer_head *bh)
+{
+	struct bdflush_queue *q;
+
+	for (;;) {
+		q = bdflush_queues + bh_queue_nr(bh);
+		spin_lock(&q->lru_lock);
+		if (q == bdflush_queues + bh_queue_nr(bh))
+			return q;
+		spin_unlock(&q->lru_lock);
+	}
+}
+
+static void unlock_queues(unsigned long mask)
+{
+	int i;
+
+	for (i = 0; mask; i++, mask >>= 1)
+		if (mask & 1)
+			spin_unlock(&bdflush_queues[i].lru_lock);
+}
+
+static unsigned long page_queues(struct buffer_head *head)
+{
+	struct buffer_head *bh = head;
+	unsigned long mask = 0;
+
+	do {
+		mask |= 1UL << bh_queue_nr(bh);
+		bh = bh->b_this_page;
+	} while (bh != head);
+	return mask;
+}
+
+/*
+ * Lock the queues of all the buffers on a page, in ascending order.
+ * That's almost always a single one.  Returns the set that was locked.
+ */
+static unsigned long lock_page_queues(struct buffer_head *head)
+{
+	unsigned long locked;
+	int i;
 
-static spinlock_cacheline_t lru_list_lock_cacheline = {SPIN_LOCK_UNLOCKED};
-#define lru_list_lock  lru_list_lock_cacheline.lock
+	for (;;) {
+		locked = page_queues(head);
+		for (i = 0; i < nr_bdflush; i++)
+			if (locked & (1UL << i))
+				spin_lock(&bdflush_queues[i].lru_lock);
+		if (!(page_queues(head) & ~locked))
+			return locked;
+		unlock_queues(locked);
+	}
+}
 
-static int nr_buffers_type[NR_LIST];
-static unsigned long size_buffers_type[NR_LIST];
+/* Protects the inode dirty buffer lists (b_inode_buffers) */
+static spinlock_t inode_buffers_lock = SPIN_LOCK_UNLOCKED;
 
 static struct buffer_head * unused_list;
 static int nr_unused_buffer_heads;
@@ -93,7 +271,6 @@ static void __refile_buffer(struct buffer_head *);
  */
 int laptop_mode;
 
-static DECLARE_WAIT_QUEUE_HEAD(kupdate_wait);
 
 /* This is used by some architectures to estimate available memory. */
 atomic_t buffermem_pages = ATOMIC_INIT(0);
@@ -130,12 +307,12 @@ union bdflush_param {
 int bdflush_min[N_PARAM] = {  0,  1,    0,   0,  0,   1*HZ,   0, 0, 0};
 int bdflush_max[N_PARAM] = {100,50000, 20000, 20000,10000*HZ, 10000*HZ, 100, 100, 0};
 
-static inline int write_buffer_delay(struct buffer_head *bh)
+static inline int write_buffer_delay(struct bdflush_queue *q, struct buffer_head *bh)
 {
 	struct page *page = bh->b_page;
 
 	if (!TryLockPage(page)) {
-		spin_unlock(&lru_list_lock);
+		spin_unlock(&q->lru_lock);
 		unlock_buffer(bh);
 		page->mapping->a_ops->writepage(page);
 		return 1;
@@ -241,19 +418,19 @@ static void write_locked_buffers(struct buffer_head **array, unsigned int count)
 /*
  * Write some buffers from the head of the dirty queue.
  *
- * This must be called with the LRU lock held, and will
+ * This must be called with the queue's LRU lock held, and will
  * return without it!
  */
 #define NRSYNC (32)
-static int write_some_buffers(kdev_t dev)
+static int write_some_buffers(struct bdflush_queue *q, kdev_t dev)
 {
 	struct buffer_head *next;
 	struct buffer_head *array[NRSYNC];
 	unsigned int count;
 	int nr;
 
-	next = lru_list[BUF_DIRTY];
-	nr = nr_buffers_type[BUF_DIRTY];
+	next = q->lru[BUF_DIRTY];
+	nr = q->nr[BUF_DIRTY];
 	count = 0;
 	while (next && --nr >= 0) {
 		struct buffer_head * bh = next;
@@ -264,7 +441,7 @@ static int write_some_buffers(kdev_t dev)
 		if (test_and_set_bit(BH_Lock, &bh->b_state))
 			continue;
 		if (buffer_delay(bh)) {
-			if (write_buffer_delay(bh)) {
+			if (write_buffer_delay(q, bh)) {
 				if (count)
 					write_locked_buffers(array, count);
 				return -EAGAIN;
@@ -276,14 +453,14 @@ static int write_some_buffers(kdev_t dev)
 			if (count < NRSYNC)
 				continue;
 
-			spin_unlock(&lru_list_lock);
+			spin_unlock(&q->lru_lock);
 			write_locked_buffers(array, count);
 			return -EAGAIN;
 		}
 		unlock_buffer(bh);
 		__refile_buffer(bh);
 	}
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&q->lru_lock);
 
 	if (count)
 		write_locked_buffers(array, count);
@@ -291,28 +468,34 @@ static int write_some_buffers(kdev_t dev)
 }
 
 /*
- * Write out all buffers on the dirty list.
+ * Write out all buffers on the dirty lists.
  */
 static void write_unlocked_buffers(kdev_t dev)
 {
-	do
-		spin_lock(&lru_list_lock);
-	while (write_some_buffers(dev));
+	struct bdflush_queue *q;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++) {
+		if (dev != NODEV && q != bdflush_queues + bdflush_queue(dev))
+			continue;
+		do
+			spin_lock(&q->lru_lock);
+		while (write_some_buffers(q, dev));
+	}
 }
 
 /*
  * Wait for a buffer on the proper list.
  *
- * This must be called with the LRU lock held, and
+ * This must be called with the queue's LRU lock held, and
  * will return with it released.
  */
-static int wait_for_buffers(kdev_t dev, int index, int refile)
+static int wait_for_buffers(struct bdflush_queue *q, kdev_t dev, int index, int refile)
 {
 	struct buffer_head * next;
 	int nr;
 
-	next = lru_list[index];
-	nr = nr_buffers_type[index];
+	next = q->lru[index];
+	nr = q->nr[index];
 	while (next && --nr >= 0) {
 		struct buffer_head *bh = next;
 		next = bh->b_next_free;
@@ -326,20 +509,26 @@ static int wait_for_buffers(kdev_t dev, int index, int refile)
 			continue;
 
 		get_bh(bh);
-		spin_unlock(&lru_list_lock);
+		spin_unlock(&q->lru_lock);
 		wait_on_buffer (bh);
 		put_bh(bh);
 		return -EAGAIN;
 	}
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&q->lru_lock);
 	return 0;
 }
 
 static int wait_for_locked_buffers(kdev_t dev, int index, int refile)
 {
-	do {
-		spin_lock(&lru_list_lock);
-	} while (wait_for_buffers(dev, index, refile));
+	struct bdflush_queue *q;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++) {
+		if (dev != NODEV && q != bdflush_queues + bdflush_queue(dev))
+			continue;
+		do {
+			spin_lock(&q->lru_lock);
+		} while (wait_for_buffers(q, dev, index, refile));
+	}
 	return 0;
 }
 
@@ -457,47 +646,37 @@ int file_fsync(struct file *filp, struct dentry *dentry, int datasync)
 asmlinkage long sys_fsync(unsigned int fd)
 {
 	struct file * file;
-	struct dentry * dentry;
 	struct inode * inode;
-	int ret, err;
+	int ret;
 
 	ret = -EBADF;
 	file = fget(fd);
 	if (!file)
 		goto out;
 
-	dentry = file->f_dentry;
-	inode = dentry->d_inode;
-
-	ret = -EINVAL;
-	if (!file->f_op || !file->f_op->fsync) {
-		/* Why?  We can still call filemap_fdatasync */
-		goto out_putf;
-	}
+	inode = file->f_dentry->d_inode;
 
 	/* We need to protect against concurrent writers.. */
 	down(&inode->i_sem);
-	ret = filemap_fdatasync(inode->i_mapping);
-	err = file->f_op->fsync(file, dentry, 0);
-	if (err && !ret)
-		ret = err;
-	err = filemap_fdatawait(inode->i_mapping);
-	if (err && !ret)
-		ret = err;
+	ret = do_fsync(file, 0);
 	up(&inode->i_sem);
 
-out_putf:
 	fput(file);
 out:
 	return ret;
 }
 
-int do_fdatasync(struct file *file)
+/*
+ * Write out the data of a file and, unless @datasync, all of its
+ * metadata.  The caller holds i_sem.
+ */
+int do_fsync(struct file *file, int datasync)
 {
 	int ret, err;
 	struct dentry *dentry;
 	struct inode *inode;
 
+	/* Why?  We can still call filemap_fdatasync */
 	if (unlikely(!file->f_op || !file->f_op->fsync))
 		return -EINVAL;
 	
@@ -505,7 +684,7 @@ int do_fdatasync(struct file *file)
 	inode = dentry->d_inode;
 
 	ret = filemap_fdatasync(inode->i_mapping);
-	err = file->f_op->fsync(file, dentry, 1);
+	err = file->f_op->fsync(file, dentry, datasync);
 	if (err && !ret)
 		ret = err;
 	err = filemap_fdatawait(inode->i_mapping);
@@ -514,6 +693,11 @@ int do_fdatasync(struct file *file)
 	return ret;
 }
 
+int do_fdatasync(struct file *file)
+{
+	return do_fsync(file, 1);
+}
+
 asmlinkage long sys_fdatasync(unsigned int fd)
 {
 	struct file * file;
@@ -535,15 +719,6 @@ out:
 	return ret;
 }
 
-/* After several hours of tedious analysis, the following hash
- * function won.  Do not mess with it... -DaveM
- */
-#define _hashfn(dev,block)	\
-	((((dev)<<(bh_hash_shift - 6)) ^ ((dev)<<(bh_hash_shift - 9))) ^ \
-	 (((block)<<(bh_hash_shift - 6)) ^ ((block) >> 13) ^ \
-	  ((block) << (bh_hash_shift - 12))))
-#define hash(dev,block) hash_table[(_hashfn(HASHDEV(dev),block) & bh_hash_mask)]
-
 static inline void __insert_into_hash_list(struct buffer_head *bh)
 {
 	struct buffer_head **head = &hash(bh->b_dev, bh->b_blocknr);
@@ -568,12 +743,16 @@ static __inline__ void __hash_unlink(struct buffer_head *bh)
 	}
 }
 
-static void __insert_into_lru_list(struct buffer_head * bh, int blist)
+static void __insert_into_lru_list(struct buffer_head * bh, int nr, int blist)
 {
-	struct buffer_head **bhp = &lru_list[blist];
+	struct bdflush_queue *q = bdflush_queues + nr;
+	struct buffer_head **bhp;
 
 	if (bh->b_prev_free || bh->b_next_free) BUG();
 
+	bh->b_flushq = nr;
+	bhp = &q->lru[blist];
+
 	if(!*bhp) {
 		*bhp = bh;
 		bh->b_prev_free = bh;
@@ -582,8 +761,8 @@ static void __insert_into_lru_list(struct buffer_head * bh, int blist)
 	bh->b_prev_free = (*bhp)->b_prev_free;
 	(*bhp)->b_prev_free->b_next_free = bh;
 	(*bhp)->b_prev_free = bh;
-	nr_buffers_type[blist]++;
-	size_buffers_type[blist] += bh->b_size;
+	q->nr[blist]++;
+	q->size[blist] += bh->b_size;
 }
 
 static void __remove_from_lru_list(struct buffer_head * bh)
@@ -591,23 +770,25 @@ static void __remove_from_lru_list(struct buffer_head * bh)
 	struct buffer_head *next = bh->b_next_free;
 	if (next) {
 		struct buffer_head *prev = bh->b_prev_free;
+		struct bdflush_queue *q = bdflush_queues + bh->b_flushq;
 		int blist = bh->b_list;
+		struct buffer_head **bhp = &q->lru[blist];
 
 		prev->b_next_free = next;
 		next->b_prev_free = prev;
-		if (lru_list[blist] == bh) {
+		if (*bhp == bh) {
 			if (next == bh)
 				next = NULL;
-			lru_list[blist] = next;
+			*bhp = next;
 		}
 		bh->b_next_free = NULL;
 		bh->b_prev_free = NULL;
-		nr_buffers_type[blist]--;
-		size_buffers_type[blist] -= bh->b_size;
+		q->nr[blist]--;
+		q->size[blist] -= bh->b_size;
 	}
 }
 
-/* must be called with both the hash_table_lock and the lru_list_lock
+/* must be called with both the hash lock and the queue's lru_lock
    held */
 static void __remove_from_queues(struct buffer_head *bh)
 {
@@ -617,18 +798,21 @@ static void __remove_from_queues(struct buffer_head *bh)
 
 static void remove_from_queues(struct buffer_head *bh)
 {
-	spin_lock(&lru_list_lock);
-	write_lock(&hash_table_lock);
+	struct bdflush_queue *q = lock_bh_queue(bh);
+	rwlock_t *hash_lock = bh_hash_lock(bh->b_dev, bh->b_blocknr);
+
+	write_lock(hash_lock);
 	__remove_from_queues(bh);
-	write_unlock(&hash_table_lock);	
-	spin_unlock(&lru_list_lock);
+	write_unlock(hash_lock);
+	spin_unlock(&q->lru_lock);
 }
 
 struct buffer_head * get_hash_table(kdev_t dev, int block, int size)
 {
 	struct buffer_head *bh, **p = &hash(dev, block);
+	rwlock_t *hash_lock = bh_hash_lock(dev, block);
 
-	read_lock(&hash_table_lock);
+	read_lock(hash_lock);
 
 	for (;;) {
 		bh = *p;
@@ -645,22 +829,22 @@ struct buffer_head * get_hash_table(kdev_t dev, int block, int size)
 		break;
 	}
 
-	read_unlock(&hash_table_lock);
+	read_unlock(hash_lock);
 	return bh;
 }
 
 void buffer_insert_list(struct buffer_head *bh, struct list_head *list)
 {
-	spin_lock(&lru_list_lock);
+	spin_lock(&inode_buffers_lock);
 	if (buffer_attached(bh))
 		list_del(&bh->b_inode_buffers);
 	set_buffer_attached(bh);
 	list_add_tail(&bh->b_inode_buffers, list);
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&inode_buffers_lock);
 }
 
 /*
- * The caller must have the lru_list lock before calling the 
+ * The caller must have the inode_buffers_lock before calling the 
  * remove_inode_queue functions.
  */
 static void __remove_inode_queue(struct buffer_head *bh)
@@ -679,9 +863,9 @@ int inode_has_buffers(struct inode *inode)
 {
 	int ret;
 	
-	spin_lock(&lru_list_lock);
+	spin_lock(&inode_buffers_lock);
 	ret = !list_empty(&inode->i_dirty_buffers) || !list_empty(&inode->i_dirty_data_buffers);
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&inode_buffers_lock);
 	
 	return ret;
 }
@@ -723,15 +907,18 @@ void invalidate_bdev(struct block_device *bdev, int destroy_dirty_buffers)
 	int i, nlist, slept;
 	struct buffer_head * bh, * bh_next;
 	kdev_t dev = to_kdev_t(bdev->bd_dev);	/* will become bdev */
+	struct bdflush_queue *q = bdflush_queues + bdflush_queue(dev);
+	rwlock_t *hash_lock;
 
  retry:
 	slept = 0;
-	spin_lock(&lru_list_lock);
+	spin_lock(&q->lru_lock);
 	for(nlist = 0; nlist < NR_LIST; nlist++) {
-		bh = lru_list[nlist];
+		bh = q->lru[nlist];
+		i = q->nr[nlist];
 		if (!bh)
 			continue;
-		for (i = nr_buffers_type[nlist]; i > 0 ; bh = bh_next, i--) {
+		for ( ; i > 0 ; bh = bh_next, i--) {
 			bh_next = bh->b_next_free;
 
 			/* Another device? */
@@ -742,14 +929,15 @@ void invalidate_bdev(struct block_device *bdev, int destroy_dirty_buffers)
 				continue;
 			if (buffer_locked(bh)) {
 				get_bh(bh);
-				spin_unlock(&lru_list_lock);
+				spin_unlock(&q->lru_lock);
 				wait_on_buffer(bh);
 				slept = 1;
-				spin_lock(&lru_list_lock);
+				spin_lock(&q->lru_lock);
 				put_bh(bh);
 			}
 
-			write_lock(&hash_table_lock);
+			hash_lock = bh_hash_lock(bh->b_dev, bh->b_blocknr);
+			write_lock(hash_lock);
 			/* All buffers in the lru lists are mapped */
 			if (!buffer_mapped(bh))
 				BUG();
@@ -757,18 +945,20 @@ void invalidate_bdev(struct block_device *bdev, int destroy_dirty_buffers)
 				printk("invalidate: dirty buffer\n");
 			if (!atomic_read(&bh->b_count)) {
 				if (destroy_dirty_buffers || !buffer_dirty(bh)) {
+					spin_lock(&inode_buffers_lock);
 					remove_inode_queue(bh);
+					spin_unlock(&inode_buffers_lock);
 				}
 			} else if (!bdev->bd_openers)
 				printk("invalidate: busy buffer\n");
 
-			write_unlock(&hash_table_lock);
+			write_unlock(hash_lock);
 			if (slept)
 				goto out;
 		}
 	}
 out:
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&q->lru_lock);
 	if (slept)
 		goto retry;
 
@@ -787,7 +977,7 @@ void __invalidate_buffers(kdev_t dev, int destroy_dirty_buffers)
 
 static void free_more_memory(void)
 {
-	balance_dirty();
+	balance_dirty(NODEV);
 	wakeup_bdflush();
 	try_to_free_pages(GFP_NOIO);
 	run_task_queue(&tq_disk);
@@ -894,7 +1084,7 @@ int fsync_buffers_list(struct list_head *list)
 	
 	INIT_LIST_HEAD(&tmp);
 	
-	spin_lock(&lru_list_lock);
+	spin_lock(&inode_buffers_lock);
 
 	while (!list_empty(list)) {
 		bh = BH_ENTRY(list->next);
@@ -906,7 +1096,7 @@ int fsync_buffers_list(struct list_head *list)
 			list_add(&bh->b_inode_buffers, &tmp);
 			if (buffer_dirty(bh)) {
 				get_bh(bh);
-				spin_unlock(&lru_list_lock);
+				spin_unlock(&inode_buffers_lock);
 			/*
 			 * Wait I/O completion before submitting
 			 * the buffer, to be sure the write will
@@ -918,7 +1108,7 @@ int fsync_buffers_list(struct list_head *list)
 				wait_on_buffer(bh);
 				write_buffer(bh);
 				brelse(bh);
-				spin_lock(&lru_list_lock);
+				spin_lock(&inode_buffers_lock);
 			}
 		}
 	}
@@ -927,15 +1117,15 @@ int fsync_buffers_list(struct list_head *list)
 		bh = BH_ENTRY(tmp.prev);
 		remove_inode_queue(bh);
 		get_bh(bh);
-		spin_unlock(&lru_list_lock);
+		spin_unlock(&inode_buffers_lock);
 		wait_on_buffer(bh);
 		if (!buffer_uptodate(bh))
 			err = -EIO;
 		brelse(bh);
-		spin_lock(&lru_list_lock);
+		spin_lock(&inode_buffers_lock);
 	}
 	
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&inode_buffers_lock);
 	err2 = osync_buffers_list(list);
 
 	if (err)
@@ -960,24 +1150,24 @@ static int osync_buffers_list(struct list_head *list)
 	struct list_head *p;
 	int err = 0;
 
-	spin_lock(&lru_list_lock);
+	spin_lock(&inode_buffers_lock);
 	
  repeat:
 	list_for_each_prev(p, list) {
 		bh = BH_ENTRY(p);
 		if (buffer_locked(bh)) {
 			get_bh(bh);
-			spin_unlock(&lru_list_lock);
+			spin_unlock(&inode_buffers_lock);
 			wait_on_buffer(bh);
 			if (!buffer_uptodate(bh))
 				err = -EIO;
 			brelse(bh);
-			spin_lock(&lru_list_lock);
+			spin_lock(&inode_buffers_lock);
 			goto repeat;
 		}
 	}
 
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&inode_buffers_lock);
 	return err;
 }
 
@@ -990,12 +1180,12 @@ void invalidate_inode_buffers(struct inode *inode)
 {
 	struct list_head * entry;
 	
-	spin_lock(&lru_list_lock);
+	spin_lock(&inode_buffers_lock);
 	while ((entry = inode->i_dirty_buffers.next) != &inode->i_dirty_buffers)
 		remove_inode_queue(BH_ENTRY(entry));
 	while ((entry = inode->i_dirty_data_buffers.next) != &inode->i_dirty_data_buffers)
 		remove_inode_queue(BH_ENTRY(entry));
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&inode_buffers_lock);
 }
 
 
@@ -1025,6 +1215,82 @@ struct buffer_head * getblk(kdev_t dev, int block, int size)
 	}
 }
 
+/*
+ * How much each task has dirtied lately, and everybody together.  The
+ * counts are halved every DIRTY_RATE_PERIOD, so they follow the rate
+ * of dirtying rather than the total.  dirtied_lock keeps the global
+ * one and its stamp together; a task's own needs no lock.
+ */
+#define DIRTY_RATE_PERIOD	HZ
+
+static unsigned long nr_dirtied, dirtied_stamp;
+static spinlock_t dirtied_lock = SPIN_LOCK_UNLOCKED;
+
+static inline void dirty_rate_decay(unsigned long *nr, unsigned long *stamp)
+{
+	unsigned long periods = (jiffies - *stamp) / DIRTY_RATE_PERIOD;
+
+	if (periods) {
+		*nr = periods < BITS_PER_LONG ? *nr >> periods : 0;
+		*stamp += periods * DIRTY_RATE_PERIOD;
+	}
+}
+
+static inline void count_dirtied(void)
+{
+	dirty_rate_decay(&current->nr_dirtied, &current->dirtied_stamp);
+	current->nr_dirtied++;
+	spin_lock(&dirtied_lock);
+	dirty_rate_decay(&nr_dirtied, &dirtied_stamp);
+	nr_dirtied++;
+	spin_unlock(&dirtied_lock);
+}
+
+/*
+ * The dirty limit of the current task, somewhere between the soft and
+ * the hard limit: the larger its share of the recent dirtying, the
+ * closer to the soft one.  A bulk writer thus has to write back its
+ * own mess long before a task that dirties the odd buffer gets held up.
+ * A task that is the only one dirtying has nobody to make room for,
+ * and gets the hard limit as before.
+ */
+static unsigned long task_dirty_limit(unsigned long soft, unsigned long hard)
+{
+	unsigned long share, mine, all, range;
+
+	if (hard <= soft)
+		return hard;
+
+	dirty_rate_decay(&current->nr_dirtied, &current->dirtied_stamp);
+	mine = current->nr_dirtied;
+	spin_lock(&dirtied_lock);
+	dirty_rate_decay(&nr_dirtied, &dirtied_stamp);
+	all = nr_dirtied;
+	spin_unlock(&dirtied_lock);
+	if (mine >= all)
+		return hard;
+	while (all >= (1UL << 20)) {
+		mine >>= 1;
+		all >>= 1;
+	}
+	share = (mine << 10) / all;
+
+	/* (hard - soft) * share / 1024, without overflowing */
+	range = hard - soft;
+	return hard - (range >> 10) * share - ((range & 1023) * share >> 10);
+}
+
+/* Size of the dirty lists in pages, without taking any locks */
+static unsigned long dirty_buffer_pages(void)
+{
+	struct bdflush_queue *q;
+	unsigned long size = 0;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++)
+		size += q->size[BUF_DIRTY];
+	return size >> PAGE_SHIFT;
+}
+
 /* -1 -> no need to flush
     0 -> async flush
     1 -> sync flush (wait for I/O completion) */
@@ -1032,7 +1298,7 @@ static int balance_dirty_state(void)
 {
 	unsigned long dirty, tot, hard_dirty_limit, soft_dirty_limit;
 
-	dirty = size_buffers_type[BUF_DIRTY] >> PAGE_SHIFT;
+	dirty = dirty_buffer_pages();
 	tot = nr_free_buffer_pages();
 
 	dirty *= 100;
@@ -1041,7 +1307,9 @@ static int balance_dirty_state(void)
 
 	/* First, check for the "real" dirty limit. */
 	if (dirty > soft_dirty_limit) {
-		if (dirty > hard_dirty_limit && !(current->flags & PF_NOIO))
+		if (current->flags & PF_NOIO)
+			return 0;
+		if (dirty > task_dirty_limit(soft_dirty_limit, hard_dirty_limit))
 			return 1;
 		return 0;
 	}
@@ -1053,7 +1321,7 @@ static int bdflush_stop(void)
 {
 	unsigned long dirty, tot, dirty_limit;
 
-	dirty = size_buffers_type[BUF_DIRTY] >> PAGE_SHIFT;
+	dirty = dirty_buffer_pages();
 	tot = nr_free_buffer_pages();
 
 	dirty *= 100;
@@ -1064,14 +1332,28 @@ static int bdflush_stop(void)
 	return 1;
 }
 
+/*
+ * The queue with the most dirty buffers, for those that have to help
+ * out without a device of their own.
+ */
+static struct bdflush_queue *busiest_bdflush_queue(void)
+{
+	struct bdflush_queue *q, *busiest = bdflush_queues;
+
+	for (q = bdflush_queues + 1; q < bdflush_queues + nr_bdflush; q++)
+		if (q->nr[BUF_DIRTY] > busiest->nr[BUF_DIRTY])
+			busiest = q;
+	return busiest;
+}
+
 /*
  * if a new dirty buffer is created we need to balance bdflush.
  *
- * in the future we might want to make bdflush aware of different
- * pressures on different devices - thus the (currently unused)
- * 'dev' parameter.
+ * A writer that is over its limit writes back from the queue of the
+ * device it dirtied, so that it is throttled by that device and not
+ * by some other one that happens to have more dirty buffers.
  */
-void balance_dirty(void)
+void balance_dirty(kdev_t dev)
 {
 	int state = balance_dirty_state();
 
@@ -1086,8 +1368,14 @@ void balance_dirty(void)
 	 * This will throttle heavy writers.
 	 */
 	if (state > 0) {
-		spin_lock(&lru_list_lock);
-		write_some_buffers(NODEV);
+		struct bdflush_queue *q;
+
+		if (dev == NODEV)
+			q = busiest_bdflush_queue();
+		else
+			q = bdflush_queues + bdflush_queue(dev);
+		spin_lock(&q->lru_lock);
+		write_some_buffers(q, NODEV);
 	}
 }
 EXPORT_SYMBOL(balance_dirty);
@@ -1096,6 +1384,7 @@ inline void __mark_dirty(struct buffer_head *bh)
 {
 	bh->b_flushtime = jiffies + bdf_prm.b_un.age_buffer;
 	refile_buffer(bh);
+	count_dirtied();
 }
 
 /* atomic version, the user must call balance_dirty() by hand
@@ -1112,7 +1401,7 @@ void mark_buffer_dirty(struct buffer_head *bh)
 		if (block_dump)
 			printk("%s: dirtied buffer\n", current->comm);
 		__mark_dirty(bh);
-		balance_dirty();
+		balance_dirty(bh->b_dev);
 	}
 }
 
@@ -1131,6 +1420,9 @@ EXPORT_SYMBOL(get_buffer_flushtime);
 /*
  * A buffer may need to be moved from one buffer list to another
  * (e.g. in case it is not shared any more). Handle this.
+ *
+ * Called with the lru_lock of the buffer's queue held; it stays on
+ * the same queue.
  */
 static void __refile_buffer(struct buffer_head *bh)
 {
@@ -1140,19 +1432,25 @@ static void __refile_buffer(struct buffer_head *bh)
 	if (buffer_dirty(bh))
 		dispose = BUF_DIRTY;
 	if (dispose != bh->b_list) {
+		int nr = bh_queue_nr(bh);
+
 		__remove_from_lru_list(bh);
 		bh->b_list = dispose;
-		if (dispose == BUF_CLEAN)
+		if (dispose == BUF_CLEAN) {
+			spin_lock(&inode_buffers_lock);
 			remove_inode_queue(bh);
-		__insert_into_lru_list(bh, dispose);
+			spin_unlock(&inode_buffers_lock);
+		}
+		__insert_into_lru_list(bh, nr, dispose);
 	}
 }
 
 void refile_buffer(struct buffer_head *bh)
 {
-	spin_lock(&lru_list_lock);
+	struct bdflush_queue *q = lock_bh_queue(bh);
+
 	__refile_buffer(bh);
-	spin_unlock(&lru_list_lock);
+	spin_unlock(&q->lru_lock);
 }
 
 /*
@@ -1753,7 +2051,7 @@ static int __block_commit_write(struct inode *inode, struct page *page,
 	}
 
 	if (need_balance_dirty)
-		balance_dirty();
+		balance_dirty(head->b_dev);
 	/*
 	 * is this a partial write that happened to make all buffers
 	 * uptodate then we can optimize away a bogus readpage() for
@@ -2085,7 +2383,7 @@ int block_truncate_page(struct address_space *mapping, loff_t from, get_block_t
 	if (!atomic_set_buffer_dirty(bh)) {
 		__mark_dirty(bh);
 		buffer_insert_inode_data_queue(bh, inode);
-		balance_dirty();
+		balance_dirty(bh->b_dev);
 	}
 
 	err = 0;
@@ -2252,63 +2550,69 @@ int generic_direct_IO(int rw, struct inode * inode, struct kiobuf * iobuf, unsig
 }
 
 /*
- * IO completion routine for a buffer_head being used for kiobuf IO: we
+ * IO completion routine for a bio being used for kiobuf IO: we
  * can't dispatch the kiobuf callback until io_count reaches 0.  
  */
 
-static void end_buffer_io_kiobuf(struct buffer_head *bh, int uptodate)
+static void end_bio_io_kiobuf(struct bio *bio, int uptodate)
 {
-	struct kiobuf *kiobuf;
-	
-	mark_buffer_uptodate(bh, uptodate);
+	end_kio_request(bio->bi_private, uptodate);
+}
 
-	kiobuf = bh->b_private;
-	end_kio_request(kiobuf, uptodate);
-	unlock_buffer(bh);
+/* Nobody waits for the bios of an asynchronous kiobuf */
+static void end_bio_io_kiobuf_async(struct bio *bio, int uptodate)
+{
+	struct kiobuf *iobuf = bio->bi_private;
+
+	bio_put(bio);
+	end_kio_request(iobuf, uptodate);
 }
 
 /*
- * For brw_kiovec: submit a set of buffer_head temporary IOs and wait
- * for them to complete.  Clean up the buffer_heads afterwards.  
+ * For brw_kiovec: wait for a list of bios to complete and free them.
+ * Returns the amount of IO done before the first error.
  */
 
-static int wait_kio(int rw, int nr, struct buffer_head *bh[], int size)
+static int wait_kio(struct bio *bio)
 {
-	int iosize, err;
-	int i;
-	struct buffer_head *tmp;
+	int iosize = 0, err = 0;
+	struct bio *next;
 
-	iosize = 0;
-	err = 0;
-
-	for (i = nr; --i >= 0; ) {
-		iosize += size;
-		tmp = bh[i];
-		wait_on_buffer(tmp);
-		
-		if (!buffer_uptodate(tmp)) {
-			/* We are traversing bh'es in reverse order so
-                           clearing iosize on error calculates the
-                           amount of IO before the first error. */
-			iosize = 0;
+	for (; bio; bio = next) {
+		next = bio->bi_next;
+		kiobuf_wait_for_io(bio->bi_private); /* wake-one */
+		if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
 			err = -EIO;
-		}
+		else if (!err)
+			iosize += bio->bi_size;
+		bio_put(bio);
 	}
-	
+
 	if (iosize)
 		return iosize;
 	return err;
 }
 
+static inline void submit_kio(int rw, struct bio *bio)
+{
+	atomic_inc(&((struct kiobuf *) bio->bi_private)->io_count);
+	submit_bio(rw, bio);
+}
+
 /*
  * Start I/O on a physical range of kernel memory, defined by a vector
  * of kiobuf structs (much like a user-space iovec list).
  *
- * The kiobuf must already be locked for IO.  IO is submitted
- * asynchronously: you need to check page->locked and page->uptodate.
+ * The kiobuf must already be locked for IO.  Runs of consecutive
+ * blocks go down as one bio each, so the driver sees large requests.
  *
  * It is up to the caller to make sure that there are enough blocks
  * passed in to completely map the iobufs to disk.
+ *
+ * Asynchronous kiobufs (see iobuf.h) are not waited for: the return
+ * value is the number of bytes submitted, and errors in the I/O itself
+ * show up in iobuf->errno when end_io is called.  All of the kiovec
+ * must be asynchronous or none of it.
  */
 
 int brw_kiovec(int rw, int nr, struct kiobuf *iovec[], 
@@ -2320,12 +2624,13 @@ int brw_kiovec(int rw, int nr, struct kiobuf *iovec[],
 	int		i;
 	int		bufind;
 	int		pageind;
-	int		bhind;
+	int		blocks;
 	int		offset;
-	unsigned long	blocknr;
+	int		async;
+	unsigned long	blocknr, next_block = 0;
 	struct kiobuf *	iobuf = NULL;
 	struct page *	map;
-	struct buffer_head *tmp, **bhs = NULL;
+	struct bio	*bio = NULL, *bios = NULL, **tail = &bios;
 
 	if (!nr)
 		return 0;
@@ -2336,24 +2641,29 @@ int brw_kiovec(int rw, int nr, struct kiobuf *iovec[],
 	for (i = 0; i < nr; i++) {
 		iobuf = iovec[i];
 		if ((iobuf->offset & (size-1)) ||
-		    (iobuf->length & (size-1)))
+		    (iobuf->length & (size-1)) || (size & 511))
 			return -EINVAL;
 		if (!iobuf->nr_pages)
 			panic("brw_kiovec: iobuf not initialised");
 	}
+	async = iovec[0]->end_io != NULL;
 
 	/* 
 	 * OK to walk down the iovec doing page IO on each page we find. 
 	 */
-	bufind = bhind = transferred = err = 0;
+	bufind = blocks = transferred = err = 0;
 	for (i = 0; i < nr; i++) {
 		iobuf = iovec[i];
 		offset = iobuf->offset;
 		length = iobuf->length;
 		iobuf->errno = 0;
-		if (!bhs)
-			bhs = iobuf->bh;
-		
+
+		/* bios complete to one kiobuf each */
+		if (bio) {
+			submit_kio(rw, bio);
+			bio = NULL;
+		}
+
 		for (pageind = 0; pageind < iobuf->nr_pages; pageind++) {
 			map  = iobuf->maplist[pageind];
 			if (!map) {
@@ -2375,36 +2685,51 @@ int brw_kiovec(int rw, int nr, struct kiobuf *iovec[],
 					} else
 						BUG();
 				}
-				tmp = bhs[bhind++];
 
-				tmp->b_size = size;
-				set_bh_page(tmp, map, offset);
-				tmp->b_this_page = tmp;
-
-				init_buffer(tmp, end_buffer_io_kiobuf, iobuf);
-				tmp->b_dev = dev;
-				tmp->b_blocknr = blocknr;
-				tmp->b_state = (1 << BH_Mapped) | (1 << BH_Lock) | (1 << BH_Req);
+				if (bio && (blocknr != next_block ||
+					    !bio_add_page(bio, map, size, offset))) {
+					submit_kio(rw, bio);
+					bio = NULL;
+				}
+				if (!bio) {
+					bio = bio_alloc(GFP_NOIO, BIO_MAX_VECS);
+					if (!bio) {
+						err = -ENOMEM;
+						goto finished;
+					}
+					bio->bi_dev = dev;
+					bio->bi_sector = blocknr * (size >> 9);
+					bio->bi_private = iobuf;
+					bio_add_page(bio, map, size, offset);
+					if (async) {
+						bio->bi_end_io = end_bio_io_kiobuf_async;
+					} else {
+						bio->bi_end_io = end_bio_io_kiobuf;
+						*tail = bio;
+						tail = &bio->bi_next;
+					}
+				}
+				next_block = blocknr + 1;
 
-				if (rw == WRITE) {
-					set_bit(BH_Uptodate, &tmp->b_state);
-					clear_bit(BH_Dirty, &tmp->b_state);
-				} else
-					set_bit(BH_Uptodate, &tmp->b_state);
+				if (async) {
+					transferred += size;
+					goto skip_block;
+				}
 
-				atomic_inc(&iobuf->io_count);
-				submit_bh(rw, tmp);
 				/* 
 				 * Wait for IO if we have got too much 
 				 */
-				if (bhind >= KIO_MAX_SECTORS) {
-					kiobuf_wait_for_io(iobuf); /* wake-one */
-					err = wait_kio(rw, bhind, bhs, size);
+				if (++blocks >= KIO_MAX_SECTORS) {
+					submit_kio(rw, bio);
+					bio = NULL;
+					err = wait_kio(bios);
+					bios = NULL;
+					tail = &bios;
 					if (err >= 0)
 						transferred += err;
 					else
 						goto finished;
-					bhind = 0;
+					blocks = 0;
 				}
 
 			skip_block:
@@ -2419,22 +2744,63 @@ int brw_kiovec(int rw, int nr, struct kiobuf *iovec[],
 		} /* End of page loop */		
 	} /* End of iovec loop */
 
+ finished:
 	/* Is there any IO still left to submit? */
-	if (bhind) {
-		kiobuf_wait_for_io(iobuf); /* wake-one */
-		err = wait_kio(rw, bhind, bhs, size);
-		if (err >= 0)
-			transferred += err;
+	if (bio)
+		submit_kio(rw, bio);
+	if (bios) {
+		i = wait_kio(bios);
+		if (i >= 0)
+			transferred += i;
 		else
-			goto finished;
+			err = i;
 	}
 
- finished:
 	if (transferred)
 		return transferred;
 	return err;
 }
 
+static void end_bio_io_page(struct bio *bio, int uptodate)
+{
+	struct page *page = bio->bi_private;
+
+	if (!uptodate)
+		SetPageError(page);
+	else if (!PageError(page))
+		SetPageUptodate(page);
+	UnlockPage(page);
+	bio_put(bio);
+}
+
+/*
+ * brw_page() for a page that maps to consecutive blocks, like all swap
+ * pages on a partition: one bio, and no buffer_heads left on the page.
+ * Returns non-zero if the page has to go the buffer_head way instead.
+ */
+static int brw_page_bio(int rw, struct page *page, kdev_t dev, int b[], int size)
+{
+	struct bio *bio;
+	int i;
+
+	for (i = 1; i < PAGE_SIZE / size; i++)
+		if (b[i] != b[0] + i)
+			return 1;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return 1;
+	bio->bi_dev = dev;
+	bio->bi_sector = (unsigned long) b[0] * (size >> 9);
+	bio->bi_end_io = end_bio_io_page;
+	bio->bi_private = page;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+
+	submit_bio(rw, bio);
+	wakeup_page_waiters(page);
+	return 0;
+}
+
 /*
  * Start I/O on a page.
  * This function expects the page to be locked and may return
@@ -2454,6 +2820,9 @@ int brw_page(int rw, struct page *page, kdev_t dev, int b[], int size)
 	if (!PageLocked(page))
 		panic("brw_page: page not locked for I/O");
 
+	if (!page->buffers && !brw_page_bio(rw, page, dev, b, size))
+		return 0;
+
 	if (!page->buffers)
 		create_empty_buffers(page, dev, size);
 	head = bh = page->buffers;
@@ -2566,13 +2935,21 @@ static void hash_page_buffers(struct page *page, kdev_t dev, int block, int size
 {
 	struct buffer_head *head = page->buffers;
 	struct buffer_head *bh = head;
+	unsigned long hash_locks = 0;
 	unsigned int uptodate;
+	int i;
 
 	uptodate = 1 << BH_Mapped;
 	if (Page_Uptodate(page))
 		uptodate |= 1 << BH_Uptodate;
 
-	write_lock(&hash_table_lock);
+	i = 0;
+	do {
+		hash_locks |= 1UL << bh_hash_nr(dev, block + i++);
+		bh = bh->b_this_page;
+	} while (bh != head);
+
+	lock_hash(hash_locks);
 	do {
 		if (!(bh->b_state & (1 << BH_Mapped))) {
 			init_buffer(bh, NULL, NULL);
@@ -2588,7 +2965,7 @@ static void hash_page_buffers(struct page *page, kdev_t dev, int block, int size
 		block++;
 		bh = bh->b_this_page;
 	} while (bh != head);
-	write_unlock(&hash_table_lock);
+	unlock_hash(hash_locks);
 }
 
 /*
@@ -2733,10 +3110,13 @@ static int sync_page_buffers(struct buffer_head *head)
 int try_to_free_buffers(struct page * page, unsigned int gfp_mask)
 {
 	struct buffer_head * tmp, * bh = page->buffers;
+	unsigned long queues, hash_locks;
 
 cleaned_buffers_try_again:
-	spin_lock(&lru_list_lock);
-	write_lock(&hash_table_lock);
+	queues = lock_page_queues(bh);
+	/* the page is locked, so the buffers can't be (re)hashed under us */
+	hash_locks = page_hash_locks(bh);
+	lock_hash(hash_locks);
 	tmp = bh;
 	do {
 		if (buffer_busy(tmp))
@@ -2744,6 +3124,7 @@ cleaned_buffers_try_again:
 		tmp = tmp->b_this_page;
 	} while (tmp != bh);
 
+	spin_lock(&inode_buffers_lock);
 	spin_lock(&unused_list_lock);
 	tmp = bh;
 
@@ -2761,6 +3142,7 @@ cleaned_buffers_try_again:
 		__put_unused_buffer_head(p);
 	} while (tmp != bh);
 	spin_unlock(&unused_list_lock);
+	spin_unlock(&inode_buffers_lock);
 
 	/* Wake up anyone waiting for buffer heads */
 	wake_up(&buffer_wait);
@@ -2768,14 +3150,14 @@ cleaned_buffers_try_again:
 	/* And free the page */
 	page->buffers = NULL;
 	page_cache_release(page);
-	write_unlock(&hash_table_lock);
-	spin_unlock(&lru_list_lock);
+	unlock_hash(hash_locks);
+	unlock_queues(queues);
 	return 1;
 
 busy_buffer_page:
 	/* Uhhuh, start writeback so that we don't end up with all dirty pages */
-	write_unlock(&hash_table_lock);
-	spin_unlock(&lru_list_lock);
+	unlock_hash(hash_locks);
+	unlock_queues(queues);
 	gfp_mask = pf_gfp_mask(gfp_mask);
 	if (gfp_mask & __GFP_IO) {
 		if ((gfp_mask & __GFP_HIGHIO) || !PageHighMem(page)) {
@@ -2799,7 +3181,8 @@ void show_buffers(void)
 #ifdef CONFIG_SMP
 	struct buffer_head * bh;
 	int delalloc = 0, found = 0, locked = 0, dirty = 0, used = 0, lastused = 0;
-	int nlist;
+	int nlist, q;
+	unsigned long size;
 	static char *buf_types[NR_LIST] = { "CLEAN", "LOCKED", "DIRTY", };
 #endif
 
@@ -2810,37 +3193,49 @@ void show_buffers(void)
 		(page_cache_size - atomic_read(&buffermem_pages)) << (PAGE_SHIFT-10));
 
 #ifdef CONFIG_SMP /* trylock does nothing on UP and so we could deadlock */
-	if (!spin_trylock(&lru_list_lock))
-		return;
+	for (q = 0; q < nr_bdflush; q++) {
+		if (!spin_trylock(&bdflush_queues[q].lru_lock)) {
+			unlock_queues((1UL << q) - 1);
+			return;
+		}
+	}
 	for(nlist = 0; nlist < NR_LIST; nlist++) {
+		int tmp = 0;
+
 		delalloc = found = locked = dirty = used = lastused = 0;
-		bh = lru_list[nlist];
-		if(!bh) continue;
+		size = 0;
+		for (q = 0; q < nr_bdflush; q++) {
+			struct buffer_head *head = bdflush_queues[q].lru[nlist];
 
-		do {
-			found++;
-			if (buffer_locked(bh))
-				locked++;
-			if (buffer_dirty(bh))
-				dirty++;
-			if (buffer_delay(bh))
-				delalloc++;
-			if (atomic_read(&bh->b_count))
-				used++, lastused = found;
-			bh = bh->b_next_free;
-		} while (bh != lru_list[nlist]);
-		{
-			int tmp = nr_buffers_type[nlist];
-			if (found != tmp)
-				printk("%9s: BUG -> found %d, reported %d\n",
-				       buf_types[nlist], found, tmp);
+			tmp += bdflush_queues[q].nr[nlist];
+			size += bdflush_queues[q].size[nlist];
+			bh = head;
+			if(!bh) continue;
+
+			do {
+				found++;
+				if (buffer_locked(bh))
+					locked++;
+				if (buffer_dirty(bh))
+					dirty++;
+				if (buffer_delay(bh))
+					delalloc++;
+				if (atomic_read(&bh->b_count))
+					used++, lastused = found;
+				bh = bh->b_next_free;
+			} while (bh != head);
 		}
+		if (!found)
+			continue;
+		if (found != tmp)
+			printk("%9s: BUG -> found %d, reported %d\n",
+			       buf_types[nlist], found, tmp);
 		printk("%9s: %d buffers, %lu kbyte, %d used (last=%d), "
 		       "%d locked, %d dirty %d delay\n",
-		       buf_types[nlist], found, size_buffers_type[nlist]>>10,
+		       buf_types[nlist], found, size>>10,
 		       used, lastused, locked, dirty, delalloc);
 	}
-	spin_unlock(&lru_list_lock);
+	unlock_queues(~0UL >> (BITS_PER_LONG - nr_bdflush));
 #endif
 }
 
@@ -2894,62 +3289,88 @@ void __init buffer_init(unsigned long mempages)
 		hash_table[i] = NULL;
 
 	/* Setup lru lists. */
-	for(i = 0; i < NR_LIST; i++)
-		lru_list[i] = NULL;
+	for (i = 0; i < NR_BDFLUSH_MAX; i++) {
+		spin_lock_init(&bdflush_queues[i].lru_lock);
+		init_waitqueue_head(&bdflush_queues[i].wait);
+	}
 
 }
 
 
 /* ====================== bdflush support =================== */
 
-/* This is a simple kernel daemon, whose job it is to provide a dynamic
- * response to dirty buffers.  Once this process is activated, we write back
- * a limited number of buffers to the disks and then go back to sleep again.
+/* These are simple kernel daemons, whose job it is to provide a dynamic
+ * response to dirty buffers.  Once one is activated, it writes back a
+ * limited number of buffers from its queue to the disks and then goes back
+ * to sleep again.  Every bdf_prm.b_un.interval they also do what kupdate
+ * used to, for their own queue.
  */
 
-DECLARE_WAIT_QUEUE_HEAD(bdflush_wait);
-
 void wakeup_bdflush(void)
 {
-	wake_up_interruptible(&bdflush_wait);
+	struct bdflush_queue *q;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++)
+		if (q->nr[BUF_DIRTY]) {
+			q->flush = 1;
+			wake_up_interruptible(&q->wait);
+		}
 }
 
 void wakeup_kupdate(void)
 {
-	if (waitqueue_active(&kupdate_wait))
-		wake_up(&kupdate_wait);
+	struct bdflush_queue *q;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++) {
+		q->kupdate = 1;
+		wake_up_interruptible(&q->wait);
+	}
+}
+
+/*
+ * With an interval of 0 the threads sleep until they are needed, so
+ * a new interval has to be brought to their notice.
+ */
+static void bdflush_params_changed(void)
+{
+	struct bdflush_queue *q;
+
+	for (q = bdflush_queues; q < bdflush_queues + nr_bdflush; q++)
+		wake_up_interruptible(&q->wait);
 }
 
 /* 
  * Here we attempt to write back old buffers.  We also try to flush inodes 
  * and supers as well, since this function is essentially "update", and 
  * otherwise there would be no way of ensuring that these quantities ever 
- * get written back.  Ideally, we would have a timestamp on the inodes
- * and superblocks so that we could write back only the old ones as well
+ * get written back.  Inodes are written once they are as old as a buffer
+ * would be; superblocks are left to the first queue.
  */
 
-static int sync_old_buffers(void)
+static void sync_old_buffers(struct bdflush_queue *q)
 {
+	int nr = q - bdflush_queues;
+
 	lock_kernel();
-	sync_unlocked_inodes();
-	sync_supers(0, 0);
+	sync_old_inodes(nr, laptop_mode ? 0 : bdf_prm.b_un.age_buffer);
+	if (!nr)
+		sync_supers(0, 0);
 	unlock_kernel();
 
 	for (;;) {
 		struct buffer_head *bh;
 
-		spin_lock(&lru_list_lock);
-		bh = lru_list[BUF_DIRTY];
+		spin_lock(&q->lru_lock);
+		bh = q->lru[BUF_DIRTY];
 		if (!bh)
 			break;
 		if (time_before(jiffies, bh->b_flushtime) && !laptop_mode)
 			break;
-		if (write_some_buffers(NODEV))
+		if (write_some_buffers(q, NODEV))
 			continue;
-		return 0;
+		return;
 	}
-	spin_unlock(&lru_list_lock);
-	return 0;
+	spin_unlock(&q->lru_lock);
 }
 
 int block_sync_page(struct page *page)
@@ -2998,6 +3419,7 @@ asmlinkage long sys_bdflush(int func, long data)
 
 			if (data >= bdflush_min[i] && data <= bdflush_max[i]) {
 				bdf_prm.data[i] = data;
+				bdflush_params_changed();
 				return 0;
 			}
 		}
@@ -3011,14 +3433,31 @@ asmlinkage long sys_bdflush(int func, long data)
 	return 0;
 }
 
+/* /proc/sys/vm/bdflush */
+int bdflush_proc_dointvec(ctl_table *table, int write, struct file *filp,
+			  void *buffer, size_t *lenp)
+{
+	int ret = proc_dointvec_minmax(table, write, filp, buffer, lenp);
+
+	if (write && !ret)
+		bdflush_params_changed();
+	return ret;
+}
+
 /*
- * This is the actual bdflush daemon itself. It used to be started from
- * the syscall above, but now we launch it ourselves internally with
- * kernel_thread(...)  directly after the first thread in init/main.c
+ * This is the actual bdflush daemon itself, one per queue.  It used to be
+ * started from the syscall above, but now we launch them ourselves
+ * internally with kernel_thread(...)  directly after the first thread in
+ * init/main.c.  They replace the old bdflush and kupdated pair, which
+ * wrote back every device from a single thread.
  */
-int bdflush(void *startup)
+static DECLARE_COMPLETION(bdflush_startup);
+
+static int bdflush(void *data)
 {
+	struct bdflush_queue *q = data;
 	struct task_struct *tsk = current;
+	unsigned long next_kupdate = jiffies + bdf_prm.b_un.interval;
 
 	/*
 	 *	We have a bare-bones task_struct, and really should fill
@@ -3028,7 +3467,7 @@ int bdflush(void *startup)
 
 	tsk->session = 1;
 	tsk->pgrp = 1;
-	strcpy(tsk->comm, "bdflush");
+	sprintf(tsk->comm, "bdflush/%d", (int) (q - bdflush_queues));
 
 	/* avoid getting signals */
 	spin_lock_irq(&tsk->sigmask_lock);
@@ -3037,7 +3476,7 @@ int bdflush(void *startup)
 	recalc_sigpending(tsk);
 	spin_unlock_irq(&tsk->sigmask_lock);
 
-	complete((struct completion *)startup);
+	complete(&bdflush_startup);
 
 	/*
 	 * FIXME: The ndirty logic here is wrong.  It's supposed to
@@ -3050,93 +3489,60 @@ int bdflush(void *startup)
 	 * amount of memory in the machine.
 	 */
 	for (;;) {
+		DECLARE_WAITQUEUE(wait, tsk);
 		int ndirty = bdf_prm.b_un.ndirty;
+		int interval = bdf_prm.b_un.interval;
+		long timeout = MAX_SCHEDULE_TIMEOUT;
 
 		CHECK_EMERGENCY_SYNC
 
+		/* kupdate: an interval of 0 means only when asked to */
+		if (q->kupdate || (interval && time_after_eq(jiffies, next_kupdate))) {
+			q->kupdate = 0;
+			next_kupdate = jiffies + interval;
+			sync_old_buffers(q);
+			if (laptop_mode && q == bdflush_queues)
+				fsync_dev(NODEV);
+			run_task_queue(&tq_disk);
+		}
+
+		q->flush = 0;
 		while (ndirty > 0) {
-			spin_lock(&lru_list_lock);
-			if (!write_some_buffers(NODEV))
+			spin_lock(&q->lru_lock);
+			if (!write_some_buffers(q, NODEV))
 				break;
 			ndirty -= NRSYNC;
 		}
-		if (ndirty > 0 || bdflush_stop())
-			interruptible_sleep_on(&bdflush_wait);
-	}
-}
-
-/*
- * This is the kernel update daemon. It was used to live in userspace
- * but since it's need to run safely we want it unkillable by mistake.
- * You don't need to change your userspace configuration since
- * the userspace `update` will do_exit(0) at the first sys_bdflush().
- */
-int kupdate(void *startup)
-{
-	struct task_struct * tsk = current;
-	int interval;
-
-	tsk->session = 1;
-	tsk->pgrp = 1;
-	strcpy(tsk->comm, "kupdated");
-
-	/* sigstop and sigcont will stop and wakeup kupdate */
-	spin_lock_irq(&tsk->sigmask_lock);
-	sigfillset(&tsk->blocked);
-	siginitsetinv(&current->blocked, sigmask(SIGCONT) | sigmask(SIGSTOP));
-	recalc_sigpending(tsk);
-	spin_unlock_irq(&tsk->sigmask_lock);
-
-	complete((struct completion *)startup);
-
-	for (;;) {
-		DECLARE_WAITQUEUE(wait, tsk);
-
-		add_wait_queue(&kupdate_wait, &wait);
+		if (ndirty <= 0 && !bdflush_stop())
+			continue;
 
-		/* update interval */
-		interval = bdf_prm.b_un.interval;
 		if (interval) {
-			tsk->state = TASK_INTERRUPTIBLE;
-			schedule_timeout(interval);
-		} else {
-			tsk->state = TASK_STOPPED;
-			schedule(); /* wait for SIGCONT */
-		}
-		remove_wait_queue(&kupdate_wait, &wait);
-		/* check for sigstop */
-		if (signal_pending(tsk)) {
-			int sig, stopped = 0;
-			struct siginfo info;
-
-			spin_lock_irq(&tsk->sigmask_lock);
-			sig = dequeue_signal(&current->blocked, &info);
-			if (sig == SIGSTOP)
-				stopped = 1;
-			spin_unlock_irq(&tsk->sigmask_lock);
-			if (stopped) {
-				tsk->state = TASK_STOPPED;
-				schedule(); /* wait for SIGCONT */
-			}
+			timeout = next_kupdate - jiffies;
+			if (timeout <= 0)
+				continue;
 		}
-#ifdef DEBUG
-		printk(KERN_DEBUG "kupdate() activated...\n");
-#endif
-		sync_old_buffers();
-		if (laptop_mode)
-			fsync_dev(NODEV);
-		run_task_queue(&tq_disk);
+		/*
+		 * A wakeup since the flush started was for buffers it
+		 * may have missed: go round again rather than sleep.
+		 */
+		add_wait_queue(&q->wait, &wait);
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!q->kupdate && !q->flush)
+			schedule_timeout(timeout);
+		__set_current_state(TASK_RUNNING);
+		remove_wait_queue(&q->wait, &wait);
 	}
 }
 
 static int __init bdflush_init(void)
 {
-	static struct completion startup __initdata = COMPLETION_INITIALIZER(startup);
+	int i;
 
-	kernel_thread(bdflush, &startup, CLONE_FS | CLONE_FILES | CLONE_SIGNAL);
-	wait_for_completion(&startup);
-	kernel_thread(kupdate, &startup, CLONE_FS | CLONE_FILES | CLONE_SIGNAL);
-	wait_for_completion(&startup);
+	for (i = 0; i < nr_bdflush; i++) {
+		kernel_thread(bdflush, bdflush_queues + i,
+			      CLONE_FS | CLONE_FILES | CLONE_SIGNAL);
+		wait_for_completion(&bdflush_startup);
+	}
 	return 0;
 }
 
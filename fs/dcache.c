@@ -49,27 +49,46 @@ static kmem_cache_t *dentry_cache;
 
 static unsigned int d_hash_mask;
 static unsigned int d_hash_shift;
-static struct list_head *dentry_hashtable;
+static struct hlist_head *dentry_hashtable;
 static LIST_HEAD(dentry_unused);
 
+/*
+ * d_move() takes a dentry off one hash chain and puts it on another,
+ * and a d_lookup() walking the old chain at that moment can miss the
+ * rest of it.  d_move_seq is odd while a move is in progress and is
+ * bumped again when it is done, so that a lookup which found nothing
+ * can tell whether it has to look again.  Changed under dcache_lock.
+ */
+static unsigned long d_move_seq;
+
 /* Statistics gathering. */
 struct dentry_stat_t dentry_stat = {0, 0, 45, 0,};
 
-/* no dcache_lock, please */
-static inline void d_free(struct dentry *dentry)
+static void d_callback(void *arg)
 {
-	if (dentry->d_op && dentry->d_op->d_release)
-		dentry->d_op->d_release(dentry);
+	struct dentry *dentry = arg;
+
 	if (dname_external(dentry)) 
 		kfree(dentry->d_name.name);
 	kmem_cache_free(dentry_cache, dentry); 
+}
+
+/*
+ * no dcache_lock, please.  The memory is freed only after a grace
+ * period, as d_lookup() may still be looking at the dentry.
+ */
+static inline void d_free(struct dentry *dentry)
+{
+	if (dentry->d_op && dentry->d_op->d_release)
+		dentry->d_op->d_release(dentry);
+	call_rcu(&dentry->d_rcu, d_callback, dentry);
 	dentry_stat.nr_dentry--;
 }
 
 /*
  * Release the dentry's inode, using the filesystem
  * d_iput() operation if defined.
- * Called with dcache_lock held, drops it.
+ * Called with dcache_lock and dentry->d_lock held, drops both.
  */
 static inline void dentry_iput(struct dentry * dentry)
 {
@@ -77,13 +96,16 @@ static inline void dentry_iput(struct dentry * dentry)
 	if (inode) {
 		dentry->d_inode = NULL;
 		list_del_init(&dentry->d_alias);
+		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
 		if (dentry->d_op && dentry->d_op->d_iput)
 			dentry->d_op->d_iput(dentry, inode);
 		else
 			iput(inode);
-	} else
+	} else {
+		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
+	}
 }
 
 /* 
@@ -124,9 +146,14 @@ repeat:
 	if (!atomic_dec_and_lock(&dentry->d_count, &dcache_lock))
 		return;
 
-	/* dput on a free dentry? */
-	if (!list_empty(&dentry->d_lru))
-		BUG();
+	/* d_lookup() may have picked it up again in the meantime */
+	spin_lock(&dentry->d_lock);
+	if (atomic_read(&dentry->d_count)) {
+		spin_unlock(&dentry->d_lock);
+		spin_unlock(&dcache_lock);
+		return;
+	}
+
 	/*
 	 * AV: ->d_delete() is _NOT_ allowed to block now.
 	 */
@@ -135,20 +162,28 @@ repeat:
 			goto unhash_it;
 	}
 	/* Unreachable? Get rid of it */
-	if (list_empty(&dentry->d_hash))
+	if (d_unhashed(dentry))
 		goto kill_it;
-	list_add(&dentry->d_lru, &dentry_unused);
-	dentry_stat.nr_unused++;
+	/* d_lookup() does not take dentries off the unused list */
+	if (list_empty(&dentry->d_lru)) {
+		list_add(&dentry->d_lru, &dentry_unused);
+		dentry_stat.nr_unused++;
+	}
+	spin_unlock(&dentry->d_lock);
 	spin_unlock(&dcache_lock);
 	return;
 
 unhash_it:
-	list_del_init(&dentry->d_hash);
+	__d_drop(dentry);
 
 kill_it: {
 		struct dentry *parent;
+		if (!list_empty(&dentry->d_lru)) {
+			list_del(&dentry->d_lru);
+			dentry_stat.nr_unused--;
+		}
 		list_del(&dentry->d_child);
-		/* drops the lock, at that point nobody can reach this dentry */
+		/* drops the locks, at that point nobody can reach this dentry */
 		dentry_iput(dentry);
 		parent = dentry->d_parent;
 		d_free(dentry);
@@ -177,7 +212,7 @@ int d_invalidate(struct dentry * dentry)
 	 * If it's already been dropped, return OK.
 	 */
 	spin_lock(&dcache_lock);
-	if (list_empty(&dentry->d_hash)) {
+	if (d_unhashed(dentry)) {
 		spin_unlock(&dcache_lock);
 		return 0;
 	}
@@ -201,14 +236,17 @@ int d_invalidate(struct dentry * dentry)
 	 * we might still populate it if it was a
 	 * working directory or similar).
 	 */
+	spin_lock(&dentry->d_lock);
 	if (atomic_read(&dentry->d_count) > 1) {
 		if (dentry->d_inode && S_ISDIR(dentry->d_inode->i_mode)) {
+			spin_unlock(&dentry->d_lock);
 			spin_unlock(&dcache_lock);
 			return -EBUSY;
 		}
 	}
 
-	list_del_init(&dentry->d_hash);
+	__d_drop(dentry);
+	spin_unlock(&dentry->d_lock);
 	spin_unlock(&dcache_lock);
 	return 0;
 }
@@ -218,7 +256,7 @@ int d_invalidate(struct dentry * dentry)
 static inline struct dentry * __dget_locked(struct dentry *dentry)
 {
 	atomic_inc(&dentry->d_count);
-	if (atomic_read(&dentry->d_count) == 1) {
+	if (!list_empty(&dentry->d_lru)) {
 		dentry_stat.nr_unused--;
 		list_del_init(&dentry->d_lru);
 	}
@@ -252,7 +290,7 @@ struct dentry * d_find_alias(struct inode *inode)
 		tmp = next;
 		next = tmp->next;
 		alias = list_entry(tmp, struct dentry, d_alias);
-		if (!list_empty(&alias->d_hash)) {
+		if (!d_unhashed(alias)) {
 			__dget_locked(alias);
 			spin_unlock(&dcache_lock);
 			return alias;
@@ -289,13 +327,14 @@ restart:
  * Throw away a dentry - free the inode, dput the parent.
  * This requires that the LRU list has already been
  * removed.
- * Called with dcache_lock, drops it and then regains.
+ * Called with dcache_lock and dentry->d_lock, drops both
+ * and then regains dcache_lock.
  */
 static inline void prune_one_dentry(struct dentry * dentry)
 {
 	struct dentry * parent;
 
-	list_del_init(&dentry->d_hash);
+	__d_drop(dentry);
 	list_del(&dentry->d_child);
 	dentry_iput(dentry);
 	parent = dentry->d_parent;
@@ -332,18 +371,22 @@ void prune_dcache(int count)
 		list_del_init(tmp);
 		dentry = list_entry(tmp, struct dentry, d_lru);
 
+		spin_lock(&dentry->d_lock);
+		/* Picked up by d_lookup() since it went on the list? */
+		if (atomic_read(&dentry->d_count)) {
+			spin_unlock(&dentry->d_lock);
+			dentry_stat.nr_unused--;
+			continue;
+		}
+
 		/* If the dentry was recently referenced, don't free it. */
 		if (dentry->d_vfs_flags & DCACHE_REFERENCED) {
 			dentry->d_vfs_flags &= ~DCACHE_REFERENCED;
 			list_add(&dentry->d_lru, &dentry_unused);
+			spin_unlock(&dentry->d_lock);
 			continue;
 		}
 		dentry_stat.nr_unused--;
-
-		/* Unused dentry with a count? */
-		if (atomic_read(&dentry->d_count))
-			BUG();
-
 		prune_one_dentry(dentry);
 		if (!--count)
 			break;
@@ -405,8 +448,11 @@ repeat:
 		dentry = list_entry(tmp, struct dentry, d_lru);
 		if (dentry->d_sb != sb)
 			continue;
-		if (atomic_read(&dentry->d_count))
+		spin_lock(&dentry->d_lock);
+		if (atomic_read(&dentry->d_count)) {
+			spin_unlock(&dentry->d_lock);
 			continue;
+		}
 		dentry_stat.nr_unused--;
 		list_del_init(tmp);
 		prune_one_dentry(dentry);
@@ -605,6 +651,7 @@ struct dentry * d_alloc(struct dentry * parent, const struct qstr *name)
 	str[name->len] = 0;
 
 	atomic_set(&dentry->d_count, 1);
+	spin_lock_init(&dentry->d_lock);
 	dentry->d_vfs_flags = 0;
 	dentry->d_flags = 0;
 	dentry->d_inode = NULL;
@@ -616,7 +663,7 @@ struct dentry * d_alloc(struct dentry * parent, const struct qstr *name)
 	dentry->d_op = NULL;
 	dentry->d_fsdata = NULL;
 	dentry->d_mounted = 0;
-	INIT_LIST_HEAD(&dentry->d_hash);
+	INIT_HLIST_NODE(&dentry->d_hash);
 	INIT_LIST_HEAD(&dentry->d_lru);
 	INIT_LIST_HEAD(&dentry->d_subdirs);
 	INIT_LIST_HEAD(&dentry->d_alias);
@@ -682,61 +729,87 @@ struct dentry * d_alloc_root(struct inode * root_inode)
 	return res;
 }
 
-static inline struct list_head * d_hash(struct dentry * parent, unsigned long hash)
+static inline struct hlist_head * d_hash(struct dentry * parent, unsigned long hash)
 {
 	hash += (unsigned long) parent / L1_CACHE_BYTES;
 	hash = hash ^ (hash >> D_HASHBITS);
 	return dentry_hashtable + (hash & D_HASHMASK);
 }
 
-/**
- * d_lookup - search for a dentry
- * @parent: parent dentry
- * @name: qstr of name we wish to find
- *
- * Searches the children of the parent dentry for the name in question. If
- * the dentry is found its reference count is incremented and the dentry
- * is returned. The caller must use d_put to free the entry when it has
- * finished using it. %NULL is returned on failure.
+/*
+ * Walk the hash chain without dcache_lock.  The hash and parent are
+ * only a quick filter; the candidate is checked again under its
+ * d_lock, which d_move() and the unhashing paths also take, before
+ * the name is compared and the reference taken.  Dentries are not
+ * freed under us (see d_free()), but one may be moved to another
+ * chain while we stand on it, in which case d_lookup() tries again.
  */
- 
-struct dentry * d_lookup(struct dentry * parent, struct qstr * name)
+static struct dentry * __d_lookup(struct dentry * parent, struct qstr * name)
 {
 	unsigned int len = name->len;
 	unsigned int hash = name->hash;
 	const unsigned char *str = name->name;
-	struct list_head *head = d_hash(parent,hash);
-	struct list_head *tmp;
+	struct hlist_head *head = d_hash(parent,hash);
+	struct hlist_node *node;
 
-	spin_lock(&dcache_lock);
-	tmp = head->next;
-	for (;;) {
-		struct dentry * dentry = list_entry(tmp, struct dentry, d_hash);
-		if (tmp == head)
-			break;
-		tmp = tmp->next;
+	hlist_for_each_rcu(node, head) {
+		struct dentry * dentry = hlist_entry(node, struct dentry, d_hash);
 		if (dentry->d_name.hash != hash)
 			continue;
 		if (dentry->d_parent != parent)
 			continue;
+
+		spin_lock(&dentry->d_lock);
+		if (dentry->d_parent != parent || d_unhashed(dentry))
+			goto next;
 		if (parent->d_op && parent->d_op->d_compare) {
 			if (parent->d_op->d_compare(parent, &dentry->d_name, name))
-				continue;
+				goto next;
 		} else {
 			if (dentry->d_name.len != len)
-				continue;
+				goto next;
 			if (memcmp(dentry->d_name.name, str, len))
-				continue;
+				goto next;
 		}
-		__dget_locked(dentry);
+		atomic_inc(&dentry->d_count);
 		dentry->d_vfs_flags |= DCACHE_REFERENCED;
-		spin_unlock(&dcache_lock);
+		spin_unlock(&dentry->d_lock);
 		return dentry;
+next:
+		spin_unlock(&dentry->d_lock);
 	}
-	spin_unlock(&dcache_lock);
 	return NULL;
 }
 
+/**
+ * d_lookup - search for a dentry
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ *
+ * Searches the children of the parent dentry for the name in question. If
+ * the dentry is found its reference count is incremented and the dentry
+ * is returned. The caller must use d_put to free the entry when it has
+ * finished using it. %NULL is returned on failure.
+ *
+ * Does not take dcache_lock.
+ */
+ 
+struct dentry * d_lookup(struct dentry * parent, struct qstr * name)
+{
+	struct dentry *dentry;
+	unsigned long seq;
+
+	do {
+		seq = d_move_seq;
+		smp_rmb();
+		dentry = __d_lookup(parent, name);
+		if (dentry)
+			break;
+		smp_rmb();
+	} while ((seq & 1) || seq != d_move_seq);
+	return dentry;
+}
+
 /**
  * d_validate - verify dentry provided from insecure source
  * @dentry: The dentry alleged to be valid child of @dparent
@@ -754,7 +827,8 @@ int d_validate(struct dentry *dentry, struct dentry *dparent)
 	unsigned long dent_addr = (unsigned long) dentry;
 	unsigned long min_addr = PAGE_OFFSET;
 	unsigned long align_mask = 0x0F;
-	struct list_head *base, *lhp;
+	struct hlist_head *base;
+	struct hlist_node *lhp;
 
 	if (dent_addr < min_addr)
 		goto out;
@@ -770,9 +844,9 @@ int d_validate(struct dentry *dentry, struct dentry *dparent)
 		goto out;
 
 	spin_lock(&dcache_lock);
-	lhp = base = d_hash(dparent, dentry->d_name.hash);
-	while ((lhp = lhp->next) != base) {
-		if (dentry == list_entry(lhp, struct dentry, d_hash)) {
+	base = d_hash(dparent, dentry->d_name.hash);
+	hlist_for_each(lhp, base) {
+		if (dentry == hlist_entry(lhp, struct dentry, d_hash)) {
 			__dget_locked(dentry);
 			spin_unlock(&dcache_lock);
 			return 1;
@@ -810,17 +884,19 @@ void d_delete(struct dentry * dentry)
 	 * Are we the only user?
 	 */
 	spin_lock(&dcache_lock);
+	spin_lock(&dentry->d_lock);
 	if (atomic_read(&dentry->d_count) == 1) {
 		dentry_iput(dentry);
 		return;
 	}
-	spin_unlock(&dcache_lock);
 
 	/*
 	 * If not, just drop the dentry and let dput
 	 * pick up the tab..
 	 */
-	d_drop(dentry);
+	__d_drop(dentry);
+	spin_unlock(&dentry->d_lock);
+	spin_unlock(&dcache_lock);
 }
 
 /**
@@ -832,10 +908,12 @@ void d_delete(struct dentry * dentry)
  
 void d_rehash(struct dentry * entry)
 {
-	struct list_head *list = d_hash(entry->d_parent, entry->d_name.hash);
-	if (!list_empty(&entry->d_hash)) BUG();
+	struct hlist_head *list = d_hash(entry->d_parent, entry->d_name.hash);
+	if (!d_unhashed(entry)) BUG();
 	spin_lock(&dcache_lock);
-	list_add(&entry->d_hash, list);
+	spin_lock(&entry->d_lock);
+	hlist_add_head_rcu(&entry->d_hash, list);
+	spin_unlock(&entry->d_lock);
 	spin_unlock(&dcache_lock);
 }
 
@@ -881,9 +959,9 @@ static inline void switch_names(struct dentry * dentry, struct dentry * target)
  * up under the name it got deleted rather than the name that
  * deleted it.
  *
- * Careful with the hash switch. The hash switch depends on
- * the fact that any list-entry can be a head of the list.
- * Think about it.
+ * Careful with the hash switch: d_lookup() may be walking either
+ * chain, see d_move_seq.  Both dentries are locked, so a lookup
+ * never sees the names or parents half switched.
  */
  
 /**
@@ -903,12 +981,19 @@ void d_move(struct dentry * dentry, struct dentry * target)
 		printk(KERN_WARNING "VFS: moving negative dcache entry\n");
 
 	spin_lock(&dcache_lock);
-	/* Move the dentry to the target hash queue */
-	list_del(&dentry->d_hash);
-	list_add(&dentry->d_hash, &target->d_hash);
+	d_move_seq++;
+	smp_wmb();
+	spin_lock(&dentry->d_lock);
+	spin_lock(&target->d_lock);
 
-	/* Unhash the target: dput() will then get rid of it */
-	list_del_init(&target->d_hash);
+	/* Move the dentry to the target hash queue */
+	__d_drop(dentry);
+	if (!d_unhashed(target)) {
+		hlist_add_head_rcu(&dentry->d_hash,
+			d_hash(target->d_parent, target->d_name.hash));
+		/* Unhash the target: dput() will then get rid of it */
+		hlist_del_rcu(&target->d_hash);
+	}
 
 	list_del(&dentry->d_child);
 	list_del(&target->d_child);
@@ -922,6 +1007,10 @@ void d_move(struct dentry * dentry, struct dentry * target)
 	/* And add them back to the (new) parent lists */
 	list_add(&target->d_child, &target->d_parent->d_subdirs);
 	list_add(&dentry->d_child, &dentry->d_parent->d_subdirs);
+	spin_unlock(&target->d_lock);
+	spin_unlock(&dentry->d_lock);
+	smp_wmb();
+	d_move_seq++;
 	spin_unlock(&dcache_lock);
 }
 
@@ -950,7 +1039,7 @@ char * __d_path(struct dentry *dentry, struct vfsmount *vfsmnt,
 
 	*--end = '\0';
 	buflen--;
-	if (!IS_ROOT(dentry) && list_empty(&dentry->d_hash)) {
+	if (!IS_ROOT(dentry) && d_unhashed(dentry)) {
 		buflen -= 10;
 		end -= 10;
 		memcpy(end, " (deleted)", 10);
@@ -1036,7 +1125,7 @@ asmlinkage long sys_getcwd(char *buf, unsigned long size)
 	error = -ENOENT;
 	/* Has the current directory has been unlinked? */
 	spin_lock(&dcache_lock);
-	if (pwd->d_parent == pwd || !list_empty(&pwd->d_hash)) {
+	if (pwd->d_parent == pwd || !d_unhashed(pwd)) {
 		unsigned long len;
 		char * cwd;
 
@@ -1174,7 +1263,7 @@ out:
 
 static void __init dcache_init(unsigned long mempages)
 {
-	struct list_head *d;
+	struct hlist_head *d;
 	unsigned long order;
 	unsigned int nr_hash;
 	int i;
@@ -1198,7 +1287,7 @@ static void __init dcache_init(unsigned long mempages)
 #if PAGE_SHIFT < 13
 	mempages >>= (13 - PAGE_SHIFT);
 #endif
-	mempages *= sizeof(struct list_head);
+	mempages *= sizeof(struct hlist_head);
 	for (order = 0; ((1UL << order) << PAGE_SHIFT) < mempages; order++)
 		;
 
@@ -1206,7 +1295,7 @@ static void __init dcache_init(unsigned long mempages)
 		unsigned long tmp;
 
 		nr_hash = (1UL << order) * PAGE_SIZE /
-			sizeof(struct list_head);
+			sizeof(struct hlist_head);
 		d_hash_mask = (nr_hash - 1);
 
 		tmp = nr_hash;
@@ -1214,7 +1303,7 @@ static void __init dcache_init(unsigned long mempages)
 		while ((tmp >>= 1UL) != 0UL)
 			d_hash_shift++;
 
-		dentry_hashtable = (struct list_head *)
+		dentry_hashtable = (struct hlist_head *)
 			__get_free_pages(GFP_ATOMIC, order);
 	} while (dentry_hashtable == NULL && --order >= 0);
 
@@ -1227,7 +1316,7 @@ static void __init dcache_init(unsigned long mempages)
 	d = dentry_hashtable;
 	i = nr_hash;
 	do {
-		INIT_LIST_HEAD(d);
+		INIT_HLIST_HEAD(d);
 		d++;
 		i--;
 	} while (i);
@@ -0,0 +1,807 @@
+/*
+ *  linux/fs/eventpoll.c
+ *
+ *  epoll_create(), epoll_ctl() and epoll_wait().
+ *
+ *  An epoll file holds a set of (file, fd) pairs.  When a file is added
+ *  we poll it once with a poll_table of our own, which puts an entry
+ *  with a callback on each of the file's wait queues instead of one that
+ *  wakes a task.  From then on a wake up on the file runs the callback,
+ *  which puts the item on the ready list; epoll_wait() looks at nothing
+ *  else, so its cost depends on the number of events, not on the size
+ *  of the set.
+ *
+ *  Locking:
+ *	epsem		serialises the teardown paths: the last fput() of a
+ *			file in some set, and the release of an epoll file.
+ *	ep->sem		taken for writing to change the set, and for
+ *			reading while events are handed to user space.
+ *	ep->lock	the ready list; taken from the wake up callbacks,
+ *			so with interrupts off.
+ */
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/cache.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/rwsem.h>
+#include <linux/eventpoll.h>
+#include <asm/uaccess.h>
+#include <asm/semaphore.h>
+
+#define EVENTPOLLFS_MAGIC	0x03111965
+
+/* The size hint of epoll_create() gives the number of hash chains */
+#define EP_MIN_HASH_BITS	4
+#define EP_MAX_HASH_BITS	16
+
+#define EP_MAX_EVENTS		(INT_MAX / sizeof(struct epoll_event))
+
+#define IS_FILE_EPOLL(f)	((f)->f_op == &eventpoll_fops)
+
+struct eventpoll {
+	spinlock_t lock;		/* rdllist */
+	struct rw_semaphore sem;
+	wait_queue_head_t wq;		/* sleepers in epoll_wait() */
+	wait_queue_head_t poll_wait;	/* poll() on the epoll file */
+	struct list_head rdllist;	/* items with an event pending */
+	unsigned int hashbits;
+	struct list_head *hash;		/* all items, by (file, fd) */
+};
+
+/* One per (file, fd) in a set */
+struct epitem {
+	struct list_head llink;		/* hash chain */
+	struct list_head rdllink;	/* ready list, or a transfer list */
+	struct list_head fllink;	/* file->f_ep_links */
+	struct list_head pwqlist;	/* our entries on the file's queues */
+	int nwait;			/* how many, -1 if one failed */
+	struct eventpoll *ep;
+	struct file *file;
+	int fd;
+	struct epoll_event event;	/* what user space asked for */
+	int intx;			/* rdllink is on a transfer list */
+	int rewake;			/* woken while intx was set */
+	int revents;			/* result of the transfer, -1 if none */
+};
+
+/* One wait queue entry of an item */
+struct eppoll_entry {
+	struct list_head llink;		/* epitem->pwqlist */
+	struct epitem *base;
+	wait_queue_t wait;
+	wait_queue_head_t *whead;
+};
+
+/* The poll_table used to hook an item into its file's wait queues */
+struct ep_pqueue {
+	poll_table pt;
+	struct epitem *epi;
+};
+
+static struct file_operations eventpoll_fops;
+
+static DECLARE_MUTEX(epsem);
+static kmem_cache_t *epi_cache, *pwq_cache;
+static struct vfsmount *eventpoll_mnt;
+
+static inline struct list_head *ep_hash_entry(struct eventpoll *ep,
+					      struct file *file, int fd)
+{
+	unsigned long h = (unsigned long) file / L1_CACHE_BYTES + fd;
+
+	h ^= h >> ep->hashbits;
+	return &ep->hash[h & ((1 << ep->hashbits) - 1)];
+}
+
+static int ep_alloc_hash(struct eventpoll *ep, int size)
+{
+	unsigned int i, bits = EP_MIN_HASH_BITS;
+
+	while (bits < EP_MAX_HASH_BITS && (1 << bits) < size)
+		bits++;
+	ep->hashbits = bits;
+	if ((sizeof(struct list_head) << bits) > PAGE_SIZE)
+		ep->hash = vmalloc(sizeof(struct list_head) << bits);
+	else
+		ep->hash = kmalloc(sizeof(struct list_head) << bits, GFP_KERNEL);
+	if (!ep->hash)
+		return -ENOMEM;
+	for (i = 0; i < (1 << bits); i++)
+		INIT_LIST_HEAD(&ep->hash[i]);
+	return 0;
+}
+
+static void ep_free_hash(struct eventpoll *ep)
+{
+	if ((sizeof(struct list_head) << ep->hashbits) > PAGE_SIZE)
+		vfree(ep->hash);
+	else
+		kfree(ep->hash);
+}
+
+/* Called with ep->sem held */
+static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
+{
+	struct list_head *head = ep_hash_entry(ep, file, fd), *lnk;
+	struct epitem *epi;
+
+	list_for_each(lnk, head) {
+		epi = list_entry(lnk, struct epitem, llink);
+		if (epi->file == file && epi->fd == fd)
+			return epi;
+	}
+	return NULL;
+}
+
+/*
+ * The wait queue callback: something happened on the file.  Queue the
+ * item, or if epoll_wait() is handing it out right now, tell it to put
+ * the item back when done.
+ */
+static int ep_poll_callback(wait_queue_t *wait, unsigned int mode, int sync)
+{
+	struct epitem *epi = list_entry(wait, struct eppoll_entry, wait)->base;
+	struct eventpoll *ep = epi->ep;
+	unsigned long flags;
+	int pwake = 0;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (epi->intx)
+		epi->rewake = 1;
+	else if (list_empty(&epi->rdllink))
+		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (waitqueue_active(&ep->wq))
+		wake_up(&ep->wq);
+	if (waitqueue_active(&ep->poll_wait))
+		pwake = 1;
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	if (pwake)
+		wake_up(&ep->poll_wait);
+	return 1;
+}
+
+static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
+				 poll_table *pt)
+{
+	struct epitem *epi = ((struct ep_pqueue *) pt)->epi;
+	struct eppoll_entry *pwq;
+
+	if (epi->nwait < 0)
+		return;
+	pwq = kmem_cache_alloc(pwq_cache, SLAB_KERNEL);
+	if (!pwq) {
+		epi->nwait = -1;
+		return;
+	}
+	init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
+	pwq->whead = whead;
+	pwq->base = epi;
+	add_wait_queue(whead, &pwq->wait);
+	list_add_tail(&pwq->llink, &epi->pwqlist);
+	epi->nwait++;
+}
+
+/* Once this returns, no callback will touch the item again */
+static void ep_unregister_pollwait(struct eventpoll *ep, struct epitem *epi)
+{
+	struct eppoll_entry *pwq;
+
+	while (!list_empty(&epi->pwqlist)) {
+		pwq = list_entry(epi->pwqlist.next, struct eppoll_entry, llink);
+		list_del(&pwq->llink);
+		remove_wait_queue(pwq->whead, &pwq->wait);
+		kmem_cache_free(pwq_cache, pwq);
+	}
+	epi->nwait = 0;
+}
+
+/* Queue an item the caller found ready, and wake up whoever waits on ep */
+static void ep_queue_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+	int pwake = 0;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (list_empty(&epi->rdllink)) {
+		list_add_tail(&epi->rdllink, &ep->rdllist);
+		if (waitqueue_active(&ep->wq))
+			wake_up(&ep->wq);
+		if (waitqueue_active(&ep->poll_wait))
+			pwake = 1;
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	if (pwake)
+		wake_up(&ep->poll_wait);
+}
+
+/* Called with ep->sem held for writing */
+static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
+		     struct file *tfile, int fd)
+{
+	struct epitem *epi;
+	struct ep_pqueue epq;
+	unsigned int revents;
+	unsigned long flags;
+
+	epi = kmem_cache_alloc(epi_cache, SLAB_KERNEL);
+	if (!epi)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&epi->llink);
+	INIT_LIST_HEAD(&epi->rdllink);
+	INIT_LIST_HEAD(&epi->fllink);
+	INIT_LIST_HEAD(&epi->pwqlist);
+	epi->nwait = 0;
+	epi->ep = ep;
+	epi->file = tfile;
+	epi->fd = fd;
+	epi->event = *event;
+	epi->intx = epi->rewake = 0;
+
+	/* Hook into the file's wait queues, and see what it has already */
+	epq.epi = epi;
+	poll_initwait(&epq.pt);
+	epq.pt.qproc = ep_ptable_queue_proc;
+	revents = tfile->f_op->poll(tfile, &epq.pt);
+	if (epi->nwait < 0) {
+		ep_unregister_pollwait(ep, epi);
+		/* A wakeup on the queues hooked so far may have queued it */
+		spin_lock_irqsave(&ep->lock, flags);
+		if (!list_empty(&epi->rdllink))
+			list_del_init(&epi->rdllink);
+		spin_unlock_irqrestore(&ep->lock, flags);
+		kmem_cache_free(epi_cache, epi);
+		return -ENOMEM;
+	}
+
+	spin_lock(&tfile->f_ep_lock);
+	list_add_tail(&epi->fllink, &tfile->f_ep_links);
+	spin_unlock(&tfile->f_ep_lock);
+
+	list_add(&epi->llink, ep_hash_entry(ep, tfile, fd));
+
+	if (revents & event->events)
+		ep_queue_ready(ep, epi);
+	return 0;
+}
+
+/* Called with ep->sem held for writing */
+static int ep_modify(struct eventpoll *ep, struct epitem *epi,
+		     struct epoll_event *event)
+{
+	epi->event = *event;
+
+	if (epi->file->f_op->poll(epi->file, NULL) & event->events)
+		ep_queue_ready(ep, epi);
+	return 0;
+}
+
+/* Called with ep->sem held for writing */
+static void ep_remove(struct eventpoll *ep, struct epitem *epi)
+{
+	struct file *file = epi->file;
+	unsigned long flags;
+
+	ep_unregister_pollwait(ep, epi);
+
+	spin_lock(&file->f_ep_lock);
+	if (!list_empty(&epi->fllink))
+		list_del_init(&epi->fllink);
+	spin_unlock(&file->f_ep_lock);
+
+	list_del(&epi->llink);
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (!list_empty(&epi->rdllink))
+		list_del_init(&epi->rdllink);
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	kmem_cache_free(epi_cache, epi);
+}
+
+/*
+ * Hand up to maxevents ready items to user space.  The items are taken
+ * off the ready list first, so that the files can be polled without
+ * ep->lock; a level triggered item that still has events goes back on
+ * it afterwards, as does any item that was woken in the meantime.
+ */
+static int ep_events_transfer(struct eventpoll *ep,
+			      struct epoll_event *events, int maxevents)
+{
+	struct list_head txlist, *lnk;
+	struct epitem *epi;
+	struct epoll_event ev;
+	unsigned long flags;
+	int eventcnt = 0, nr = 0, ricnt = 0, pwake = 0;
+
+	INIT_LIST_HEAD(&txlist);
+	down_read(&ep->sem);
+
+	spin_lock_irqsave(&ep->lock, flags);
+	while (!list_empty(&ep->rdllist) && nr < maxevents) {
+		epi = list_entry(ep->rdllist.next, struct epitem, rdllink);
+		list_del(&epi->rdllink);
+		list_add_tail(&epi->rdllink, &txlist);
+		epi->intx = 1;
+		epi->revents = -1;
+		nr++;
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	list_for_each(lnk, &txlist) {
+		epi = list_entry(lnk, struct epitem, rdllink);
+		epi->revents = epi->file->f_op->poll(epi->file, NULL) &
+			epi->event.events;
+		if (!epi->revents)
+			continue;
+		ev.events = epi->revents;
+		ev.data = epi->event.data;
+		if (__copy_to_user(&events[eventcnt], &ev, sizeof(ev))) {
+			/* Nothing was reported, so it stays ready */
+			epi->revents = -1;
+			if (!eventcnt)
+				eventcnt = -EFAULT;
+			break;
+		}
+		eventcnt++;
+	}
+
+	spin_lock_irqsave(&ep->lock, flags);
+	while (!list_empty(&txlist)) {
+		epi = list_entry(txlist.next, struct epitem, rdllink);
+		list_del_init(&epi->rdllink);
+		if (epi->rewake || epi->revents < 0 ||
+		    (epi->revents && !(epi->event.events & EPOLLET))) {
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+			ricnt++;
+		}
+		epi->intx = epi->rewake = 0;
+	}
+	if (ricnt) {
+		if (waitqueue_active(&ep->wq))
+			wake_up(&ep->wq);
+		if (waitqueue_active(&ep->poll_wait))
+			pwake = 1;
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	up_read(&ep->sem);
+
+	if (pwake)
+		wake_up(&ep->poll_wait);
+	return eventcnt;
+}
+
+static int ep_poll(struct eventpoll *ep, struct epoll_event *events,
+		   int maxevents, long timeout)
+{
+	wait_queue_t wait;
+	unsigned long flags;
+	long jtimeout;
+	int res, eavail;
+
+	if (timeout < 0 || timeout >= (MAX_SCHEDULE_TIMEOUT - 1000) / HZ)
+		jtimeout = MAX_SCHEDULE_TIMEOUT;
+	else
+		jtimeout = (timeout * HZ + 999) / 1000;
+
+retry:
+	res = 0;
+	spin_lock_irqsave(&ep->lock, flags);
+	if (list_empty(&ep->rdllist)) {
+		init_waitqueue_entry(&wait, current);
+		add_wait_queue(&ep->wq, &wait);
+		for (;;) {
+			set_current_state(TASK_INTERRUPTIBLE);
+			if (!list_empty(&ep->rdllist) || !jtimeout)
+				break;
+			if (signal_pending(current)) {
+				res = -EINTR;
+				break;
+			}
+			spin_unlock_irqrestore(&ep->lock, flags);
+			jtimeout = schedule_timeout(jtimeout);
+			spin_lock_irqsave(&ep->lock, flags);
+		}
+		remove_wait_queue(&ep->wq, &wait);
+		set_current_state(TASK_RUNNING);
+	}
+	eavail = !list_empty(&ep->rdllist);
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/*
+	 * The items may all have been spurious wake ups, or taken by
+	 * someone else: go back to sleep if there is time left.
+	 */
+	if (!res && eavail &&
+	    !(res = ep_events_transfer(ep, events, maxevents)) && jtimeout)
+		goto retry;
+	return res;
+}
+
+/* The epoll file itself is going away */
+static void ep_free(struct eventpoll *ep)
+{
+	struct list_head *head;
+	unsigned int i;
+
+	down(&epsem);
+
+	/* Stop the callbacks first, nothing can be queued after this */
+	for (i = 0; i < (1 << ep->hashbits); i++) {
+		struct list_head *lnk;
+
+		head = &ep->hash[i];
+		list_for_each(lnk, head)
+			ep_unregister_pollwait(ep,
+				list_entry(lnk, struct epitem, llink));
+	}
+
+	for (i = 0; i < (1 << ep->hashbits); i++) {
+		head = &ep->hash[i];
+		while (!list_empty(head))
+			ep_remove(ep, list_entry(head->next, struct epitem, llink));
+	}
+
+	up(&epsem);
+
+	ep_free_hash(ep);
+}
+
+/* The last fput() of a file that is still in some sets */
+void eventpoll_release_file(struct file *file)
+{
+	struct eventpoll *ep;
+	struct epitem *epi;
+
+	down(&epsem);
+	while (!list_empty(&file->f_ep_links)) {
+		epi = list_entry(file->f_ep_links.next, struct epitem, fllink);
+		ep = epi->ep;
+		down_write(&ep->sem);
+		ep_remove(ep, epi);
+		up_write(&ep->sem);
+	}
+	up(&epsem);
+}
+
+static int ep_eventpoll_close(struct inode *inode, struct file *file)
+{
+	struct eventpoll *ep = file->private_data;
+
+	if (ep) {
+		ep_free(ep);
+		kfree(ep);
+	}
+	return 0;
+}
+
+static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
+{
+	struct eventpoll *ep = file->private_data;
+	unsigned int pollflags = 0;
+	unsigned long flags;
+
+	poll_wait(file, &ep->poll_wait, wait);
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (!list_empty(&ep->rdllist))
+		pollflags = POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	return pollflags;
+}
+
+static struct file_operations eventpoll_fops = {
+	release:	ep_eventpoll_close,
+	poll:		ep_eventpoll_poll,
+};
+
+static int eventpollfs_delete_dentry(struct dentry *dentry)
+{
+	return 1;
+}
+
+static struct dentry_operations eventpollfs_dentry_operations = {
+	d_delete:	eventpollfs_delete_dentry,
+};
+
+static struct inode *ep_eventpoll_inode(void)
+{
+	struct inode *inode = new_inode(eventpoll_mnt->mnt_sb);
+
+	if (!inode)
+		return NULL;
+
+	inode->i_fop = &eventpoll_fops;
+
+	/* Never on the dirty list, as for pipes */
+	inode->i_state = I_DIRTY;
+	inode->i_mode = S_IRUSR | S_IWUSR;
+	inode->i_uid = current->fsuid;
+	inode->i_gid = current->fsgid;
+	inode->i_atime = inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+	inode->i_blksize = PAGE_SIZE;
+	return inode;
+}
+
+static int ep_getfd(struct eventpoll *ep)
+{
+	struct qstr this;
+	char name[32];
+	struct dentry *dentry;
+	struct inode *inode;
+	struct file *file;
+	int error, fd;
+
+	error = -ENFILE;
+	file = get_empty_filp();
+	if (!file)
+		goto out;
+
+	error = -ENOMEM;
+	inode = ep_eventpoll_inode();
+	if (!inode)
+		goto out_filp;
+
+	error = get_unused_fd();
+	if (error < 0)
+		goto out_inode;
+	fd = error;
+
+	error = -ENOMEM;
+	sprintf(name, "[%lu]", inode->i_ino);
+	this.name = name;
+	this.len = strlen(name);
+	this.hash = inode->i_ino;
+	dentry = d_alloc(eventpoll_mnt->mnt_sb->s_root, &this);
+	if (!dentry)
+		goto out_fd;
+	dentry->d_op = &eventpollfs_dentry_operations;
+	d_add(dentry, inode);
+
+	file->f_vfsmnt = mntget(eventpoll_mnt);
+	file->f_dentry = dentry;
+	file->f_pos = 0;
+	file->f_flags = O_RDONLY;
+	file->f_op = &eventpoll_fops;
+	file->f_mode = FMODE_READ;
+	file->f_version = 0;
+	file->private_data = ep;
+
+	fd_install(fd, file);
+	return fd;
+
+out_fd:
+	put_unused_fd(fd);
+out_inode:
+	iput(inode);
+out_filp:
+	put_filp(file);
+out:
+	return error;
+}
+
+/*
+ * sys_epoll_create:
+ *	Create an empty set.  size is a hint of how many files will be
+ *	in it, and sizes the hash table; it is not a limit.
+ */
+asmlinkage long sys_epoll_create(int size)
+{
+	struct eventpoll *ep;
+	int error;
+
+	if (size <= 0)
+		return -EINVAL;
+
+	ep = kmalloc(sizeof(struct eventpoll), GFP_KERNEL);
+	if (!ep)
+		return -ENOMEM;
+	memset(ep, 0, sizeof(*ep));
+	spin_lock_init(&ep->lock);
+	init_rwsem(&ep->sem);
+	init_waitqueue_head(&ep->wq);
+	init_waitqueue_head(&ep->poll_wait);
+	INIT_LIST_HEAD(&ep->rdllist);
+
+	error = ep_alloc_hash(ep, size);
+	if (error)
+		goto out_ep;
+
+	error = ep_getfd(ep);
+	if (error < 0)
+		goto out_hash;
+	return error;
+
+out_hash:
+	ep_free_hash(ep);
+out_ep:
+	kfree(ep);
+	return error;
+}
+
+/*
+ * sys_epoll_ctl:
+ *	Add fd to the set, take it out, or change the events asked for.
+ *	POLLERR and POLLHUP are always reported.  An epoll file cannot be
+ *	put into a set.
+ */
+asmlinkage long sys_epoll_ctl(int epfd, int op, int fd,
+			      struct epoll_event *event)
+{
+	struct file *file, *tfile;
+	struct eventpoll *ep;
+	struct epitem *epi;
+	struct epoll_event epds;
+	int error;
+
+	if (op != EPOLL_CTL_DEL &&
+	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
+		return -EFAULT;
+
+	error = -EBADF;
+	file = fget(epfd);
+	if (!file)
+		goto out;
+	tfile = fget(fd);
+	if (!tfile)
+		goto out_fput;
+
+	error = -EPERM;
+	if (!tfile->f_op || !tfile->f_op->poll)
+		goto out_tfput;
+
+	error = -EINVAL;
+	if (file == tfile || !IS_FILE_EPOLL(file) || IS_FILE_EPOLL(tfile))
+		goto out_tfput;
+
+	ep = file->private_data;
+	down_write(&ep->sem);
+
+	epi = ep_find(ep, tfile, fd);
+
+	error = -EINVAL;
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		if (!epi) {
+			epds.events |= POLLERR | POLLHUP;
+			error = ep_insert(ep, &epds, tfile, fd);
+		} else
+			error = -EEXIST;
+		break;
+	case EPOLL_CTL_DEL:
+		if (epi) {
+			ep_remove(ep, epi);
+			error = 0;
+		} else
+			error = -ENOENT;
+		break;
+	case EPOLL_CTL_MOD:
+		if (epi) {
+			epds.events |= POLLERR | POLLHUP;
+			error = ep_modify(ep, epi, &epds);
+		} else
+			error = -ENOENT;
+		break;
+	}
+
+	up_write(&ep->sem);
+
+out_tfput:
+	fput(tfile);
+out_fput:
+	fput(file);
+out:
+	return error;
+}
+
+/*
+ * sys_epoll_wait:
+ *	Wait up to timeout milliseconds (-1 for ever) for events on the
+ *	set, and return at most maxevents of them.
+ */
+asmlinkage long sys_epoll_wait(int epfd, struct epoll_event *events,
+			       int maxevents, int timeout)
+{
+	struct file *file;
+	int error;
+
+	if (maxevents <= 0 || maxevents > EP_MAX_EVENTS)
+		return -EINVAL;
+	if (verify_area(VERIFY_WRITE, events,
+			maxevents * sizeof(struct epoll_event)))
+		return -EFAULT;
+
+	file = fget(epfd);
+	if (!file)
+		return -EBADF;
+
+	error = -EINVAL;
+	if (IS_FILE_EPOLL(file))
+		error = ep_poll(file->private_data, events, maxevents, timeout);
+
+	fput(file);
+	return error;
+}
+
+/*
+ * eventpollfs is never mounted by user space; it only gives the epoll
+ * files an inode and a name, like pipefs does for pipes.
+ */
+static int eventpollfs_statfs(struct super_block *sb, struct statfs *buf)
+{
+	buf->f_type = EVENTPOLLFS_MAGIC;
+	buf->f_bsize = 1024;
+	buf->f_namelen = 255;
+	return 0;
+}
+
+static struct super_operations eventpollfs_ops = {
+	statfs:		eventpollfs_statfs,
+};
+
+static struct super_block *eventpollfs_read_super(struct super_block *sb,
+						  void *data, int silent)
+{
+	struct inode *root = new_inode(sb);
+
+	if (!root)
+		return NULL;
+	root->i_mode = S_IFDIR | S_IRUSR | S_IWUSR;
+	root->i_uid = root->i_gid = 0;
+	root->i_atime = root->i_mtime = root->i_ctime = CURRENT_TIME;
+	sb->s_blocksize = 1024;
+	sb->s_blocksize_bits = 10;
+	sb->s_magic = EVENTPOLLFS_MAGIC;
+	sb->s_op = &eventpollfs_ops;
+	sb->s_root = d_alloc(NULL, &(const struct qstr) { "eventpoll:", 10, 0 });
+	if (!sb->s_root) {
+		iput(root);
+		return NULL;
+	}
+	sb->s_root->d_sb = sb;
+	sb->s_root->d_parent = sb->s_root;
+	d_instantiate(sb->s_root, root);
+	return sb;
+}
+
+static DECLARE_FSTYPE(eventpoll_fs_type, "eventpollfs",
+		      eventpollfs_read_super, FS_NOMOUNT);
+
+static int __init eventpoll_init(void)
+{
+	int error;
+
+	epi_cache = kmem_cache_create("eventpoll_epi", sizeof(struct epitem),
+				      0, SLAB_HWCACHE_ALIGN, NULL, NULL);
+	pwq_cache = kmem_cache_create("eventpoll_pwq",
+				      sizeof(struct eppoll_entry),
+				      0, SLAB_HWCACHE_ALIGN, NULL, NULL);
+	if (!epi_cache || !pwq_cache)
+		panic("Cannot create eventpoll SLAB caches");
+
+	error = register_filesystem(&eventpoll_fs_type);
+	if (error)
+		return error;
+	eventpoll_mnt = kern_mount(&eventpoll_fs_type);
+	if (IS_ERR(eventpoll_mnt)) {
+		unregister_filesystem(&eventpoll_fs_type);
+		return PTR_ERR(eventpoll_mnt);
+	}
+	return 0;
+}
+
+__initcall(eventpoll_init);
@@ -23,6 +23,7 @@
 
 #include <linux/fs.h>
 #include <linux/ext2_fs.h>
+#include <linux/dirhash.h>
 #include <linux/pagemap.h>
 
 typedef struct ext2_dir_entry_2 ext2_dirent;
@@ -294,6 +295,184 @@ done:
 	return 0;
 }
 
+/*
+ * Hash-indexed directories, as built by ext3 or "e2fsck -D".  Block 0
+ * holds "." and "..", the latter covering the rest of the block, then
+ * a dx_root_info and a sorted array of (hash, block) pairs; with
+ * indirect_levels 1 those point at index nodes holding more pairs,
+ * behind an empty dirent that covers the block.  Entry 0 of each
+ * array keeps the limit and count where its hash would be.  A leaf
+ * entered with the low bit of its hash set continues names of the
+ * same hash from the leaf before it.
+ *
+ * ext2 only reads the index: ext2_add_link() drops EXT2_INDEX_FL when
+ * it changes the directory, since it doesn't keep the index up to
+ * date.  Until then a lookup need only search the one block the
+ * name hashes to.
+ */
+struct dx_entry {
+	__u32 hash;
+	__u32 block;
+};
+
+struct dx_countlimit {
+	__u16 limit;
+	__u16 count;
+};
+
+struct dx_root_info {
+	__u32 reserved_zero;
+	__u8 hash_version;
+	__u8 info_length;
+	__u8 indirect_levels;
+	__u8 unused_flags;
+};
+
+#define is_dx(dir) (EXT2_HAS_COMPAT_FEATURE(dir->i_sb, \
+				EXT2_FEATURE_COMPAT_DIR_INDEX) && \
+		    ((dir)->u.ext2_i.i_flags & EXT2_INDEX_FL))
+
+#define dx_get_count(e)	le16_to_cpu(((struct dx_countlimit *)(e))->count)
+#define dx_get_limit(e)	le16_to_cpu(((struct dx_countlimit *)(e))->limit)
+#define dx_get_hash(e)	le32_to_cpu((e)->hash)
+#define dx_get_block(e)	(le32_to_cpu((e)->block) & 0x00ffffff)
+
+/*
+ * Map directory block n: the page holding it is returned in *pagep,
+ * to be released with ext2_put_page().
+ */
+static char *ext2_get_dir_block(struct inode *dir, unsigned long n,
+				struct page **pagep)
+{
+	unsigned bits = dir->i_sb->s_blocksize_bits;
+	struct page *page;
+
+	if (n >= dir->i_size >> bits)
+		return NULL;
+	page = ext2_get_page(dir, n >> (PAGE_CACHE_SHIFT - bits));
+	if (IS_ERR(page))
+		return NULL;
+	*pagep = page;
+	return (char *) page_address(page) + ((n << bits) & ~PAGE_CACHE_MASK);
+}
+
+/*
+ * The last entry of an index array whose hash is <= hash, or NULL if
+ * the array doesn't check out.
+ */
+static struct dx_entry *dx_search(struct dx_entry *entries, unsigned limit,
+				  u32 hash)
+{
+	struct dx_entry *p, *q, *m;
+	unsigned count = dx_get_count(entries);
+
+	if (dx_get_limit(entries) != limit || !count || count > limit)
+		return NULL;
+	p = entries + 1;
+	q = entries + count - 1;
+	while (p <= q) {
+		m = p + (q - p) / 2;
+		if (dx_get_hash(m) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+	return p - 1;
+}
+
+/*
+ * Look a name up through the index.  Returns the entry, with its page
+ * in *res_page; or NULL and 0 if the name isn't there; or NULL and -1
+ * if the index can't answer (it is damaged, or the name's hash runs
+ * on past the end of an index node), in which case the caller scans
+ * the directory instead.  "." and ".." are in block 0, ahead of the
+ * index, and in no leaf.
+ */
+static ext2_dirent *ext2_dx_find_entry(struct inode *dir,
+			struct dentry *dentry, struct page **res_page,
+			int *err)
+{
+	const char *name = dentry->d_name.name;
+	int namelen = dentry->d_name.len;
+	unsigned blocksize = dir->i_sb->s_blocksize;
+	struct page *root_page, *node_page = NULL, *page;
+	struct dx_root_info *info;
+	struct dx_entry *entries, *at;
+	ext2_dirent *de;
+	char *kaddr, *limit;
+	unsigned levels;
+	u32 hash;
+
+	*err = -1;
+	kaddr = ext2_get_dir_block(dir, 0, &root_page);
+	if (!kaddr)
+		return NULL;
+	if (namelen <= 2 && name[0] == '.' && (namelen == 1 || name[1] == '.')) {
+		de = (ext2_dirent *) kaddr;
+		if (namelen == 2)
+			de = ext2_next_entry(de);
+		if (ext2_match(namelen, name, de)) {
+			*res_page = root_page;
+			*err = 0;
+			return de;
+		}
+		goto out;
+	}
+	info = (struct dx_root_info *)
+		(kaddr + EXT2_DIR_REC_LEN(1) + EXT2_DIR_REC_LEN(2));
+	levels = info->indirect_levels;
+	if (levels > 1 || (info->unused_flags & 1) ||
+	    dx_hash_name(name, namelen, info->hash_version,
+			 dir->i_sb->u.ext2_sb.s_hash_seed, &hash, NULL))
+		goto out;
+	entries = (struct dx_entry *) ((char *) info + info->info_length);
+	at = dx_search(entries, (blocksize - EXT2_DIR_REC_LEN(1) -
+				 EXT2_DIR_REC_LEN(2) - info->info_length) /
+				sizeof(struct dx_entry), hash);
+	if (at && levels) {
+		kaddr = ext2_get_dir_block(dir, dx_get_block(at), &node_page);
+		if (!kaddr)
+			goto out;
+		entries = (struct dx_entry *) (kaddr + EXT2_DIR_REC_LEN(0));
+		at = dx_search(entries, (blocksize - EXT2_DIR_REC_LEN(0)) /
+					sizeof(struct dx_entry), hash);
+	}
+	if (!at)
+		goto out;
+
+	while (1) {
+		kaddr = ext2_get_dir_block(dir, dx_get_block(at), &page);
+		if (!kaddr)
+			goto out;
+		de = (ext2_dirent *) kaddr;
+		limit = kaddr + blocksize - EXT2_DIR_REC_LEN(namelen);
+		for ( ; (char *) de <= limit; de = ext2_next_entry(de))
+			if (ext2_match (namelen, name, de)) {
+				*res_page = page;
+				*err = 0;
+				goto out;
+			}
+		ext2_put_page(page);
+		/* Does the next leaf carry on with this hash? */
+		if (++at >= entries + dx_get_count(entries)) {
+			/* Only our caller can tell us across nodes */
+			if (!levels)
+				*err = 0;
+			break;
+		}
+		if ((dx_get_hash(at) & ~1) != hash) {
+			*err = 0;
+			break;
+		}
+	}
+	de = NULL;
+out:
+	if (node_page)
+		ext2_put_page(node_page);
+	ext2_put_page(root_page);
+	return *err ? NULL : de;
+}
+
 /*
  *	ext2_find_entry()
  *
@@ -312,10 +491,17 @@ struct ext2_dir_entry_2 * ext2_find_entry (struct inode * dir,
 	unsigned long npages = dir_pages(dir);
 	struct page *page = NULL;
 	ext2_dirent * de;
+	int err;
 
 	/* OFFSET_CACHE */
 	*res_page = NULL;
 
+	if (is_dx(dir)) {
+		de = ext2_dx_find_entry(dir, dentry, res_page, &err);
+		if (!err)
+			return de;
+	}
+
 	start = dir->u.ext2_i.i_dir_start_lookup;
 	if (start >= npages)
 		start = 0;
@@ -390,7 +576,6 @@ void ext2_set_link(struct inode *dir, struct ext2_dir_entry_2 *de,
 	UnlockPage(page);
 	ext2_put_page(page);
 	dir->i_mtime = dir->i_ctime = CURRENT_TIME;
-	dir->u.ext2_i.i_flags &= ~EXT2_BTREE_FL;
 	mark_inode_dirty(dir);
 }
 
@@ -457,7 +642,8 @@ got_it:
 	ext2_set_de_type (de, inode);
 	err = ext2_commit_chunk(page, from, to);
 	dir->i_mtime = dir->i_ctime = CURRENT_TIME;
-	dir->u.ext2_i.i_flags &= ~EXT2_BTREE_FL;
+	/* The new name isn't in the hash index, so there is none now */
+	dir->u.ext2_i.i_flags &= ~EXT2_INDEX_FL;
 	mark_inode_dirty(dir);
 	/* OFFSET_CACHE */
 out_unlock:
@@ -500,7 +686,6 @@ int ext2_delete_entry (struct ext2_dir_entry_2 * dir, struct page * page )
 	UnlockPage(page);
 	ext2_put_page(page);
 	inode->i_ctime = inode->i_mtime = CURRENT_TIME;
-	inode->u.ext2_i.i_flags &= ~EXT2_BTREE_FL;
 	mark_inode_dirty(inode);
 	return err;
 }
@@ -42,6 +42,8 @@ struct file_operations ext2_file_operations = {
 	llseek:		generic_file_llseek,
 	read:		generic_file_read,
 	write:		generic_file_write,
+	aio_read:	generic_file_aio_read,
+	aio_write:	generic_file_aio_write,
 	ioctl:		ext2_ioctl,
 	mmap:		generic_file_mmap,
 	open:		generic_file_open,
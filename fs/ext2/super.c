@@ -583,6 +583,9 @@ struct super_block * ext2_read_super (struct super_block * sb, void * data,
 	else
 		sb->u.ext2_sb.s_resgid = le16_to_cpu(es->s_def_resgid);
 	sb->u.ext2_sb.s_mount_state = le16_to_cpu(es->s_state);
+	for (i = 0; i < 4; i++)
+		sb->u.ext2_sb.s_hash_seed[i] = le32_to_cpu(es->s_hash_seed[i]);
+	sb->u.ext2_sb.s_def_hash_version = es->s_def_hash_version;
 	sb->u.ext2_sb.s_addr_per_block_bits =
 		log2 (EXT2_ADDR_PER_BLOCK(sb));
 	sb->u.ext2_sb.s_desc_per_block_bits =
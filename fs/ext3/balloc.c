@@ -450,6 +450,32 @@ static int ext3_test_allocatable(int nr, struct buffer_head *bh)
 	return !ext3_test_bit(nr, bh2jh(bh)->b_committed_data);
 }
 
+/*
+ * The first allocatable block at or after start and before maxblocks,
+ * or -1.  Search forward alternately through the actual bitmap and the
+ * last-committed copy until we find a bit free in both.
+ */
+static int bitmap_search_next_usable_block(int start,
+			struct buffer_head *bh, int maxblocks)
+{
+	int here = start, next;
+
+	while (here < maxblocks) {
+		next  = ext3_find_next_zero_bit ((unsigned long *) bh->b_data, 
+						 maxblocks, here);
+		if (next >= maxblocks)
+			return -1;
+		if (ext3_test_allocatable(next, bh))
+			return next;
+
+		J_ASSERT_BH(bh, bh2jh(bh)->b_committed_data);
+		here = ext3_find_next_zero_bit
+			((unsigned long *) bh2jh(bh)->b_committed_data, 
+			 maxblocks, next);
+	}
+	return -1;
+}
+
 /*
  * Find an allocatable block in a bitmap.  We honour both the bitmap and
  * its last-committed copy (if that exists), and perform the "most
@@ -500,32 +526,212 @@ static int find_next_usable_block(int start,
 	if (next < maxblocks && ext3_test_allocatable(next, bh))
 		return next;
 	
-	/* The bitmap search --- search forward alternately
-	 * through the actual bitmap and the last-committed copy
-	 * until we find a bit free in both. */
+	return bitmap_search_next_usable_block(here, bh, maxblocks);
+}
 
-	while (here < maxblocks) {
-		next  = ext3_find_next_zero_bit ((unsigned long *) bh->b_data, 
-						 maxblocks, here);
-		if (next >= maxblocks)
-			return -1;
-		if (ext3_test_allocatable(next, bh))
-			return next;
+/*
+ * Reservation windows.
+ *
+ * Files appended to side by side in one group would otherwise take
+ * turns at the first free block and end up interleaved.  Instead each
+ * regular file being written gets a window of blocks from its goal on,
+ * which the windows of other files stay out of.  The file's blocks
+ * come from its window for as long as its goal lies inside it, and a
+ * new window is found when it moves outside or the window is used up.
+ * A window more than half used when replaced makes the next one twice
+ * the size, up to EXT3_MAX_RESERVE_BLOCKS.
+ *
+ * Nothing is reserved on disk: the blocks stay free in the bitmap and
+ * allocations without a window (directories, symlinks, noreservation
+ * mounts) may still take them.  A filesystem's windows are kept in
+ * s_rsv_window_root sorted by start block, never overlapping.  The tree
+ * and the windows in it are guarded by s_rsv_window_lock rather than
+ * lock_super, as windows are dropped from clear_inode(), which umount
+ * calls with the superblock locked.
+ */
+static inline int rsv_is_empty(struct ext3_reserve_window *rsv)
+{
+	return rsv->rsv_start == EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+}
 
-		J_ASSERT_BH(bh, bh2jh(bh)->b_committed_data);
-		here = ext3_find_next_zero_bit
-			((unsigned long *) bh2jh(bh)->b_committed_data, 
-			 maxblocks, next);
+static void rsv_window_add(struct super_block *sb,
+			   struct ext3_reserve_window *rsv)
+{
+	rb_root_t *root = &sb->u.ext3_sb.s_rsv_window_root;
+	rb_node_t **p = &root->rb_node, *parent = NULL;
+	struct ext3_reserve_window *this;
+
+	while (*p) {
+		parent = *p;
+		this = rb_entry(parent, struct ext3_reserve_window, rsv_node);
+		if (rsv->rsv_end < this->rsv_start)
+			p = &(*p)->rb_left;
+		else if (rsv->rsv_start > this->rsv_end)
+			p = &(*p)->rb_right;
+		else
+			BUG();
+	}
+	rb_link_node(&rsv->rsv_node, parent, p);
+	rb_insert_color(&rsv->rsv_node, root);
+}
+
+static void rsv_window_remove(struct super_block *sb,
+			      struct ext3_reserve_window *rsv)
+{
+	rb_erase(&rsv->rsv_node, &sb->u.ext3_sb.s_rsv_window_root);
+	rsv->rsv_start = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	rsv->rsv_end = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	rsv->rsv_alloc_hit = 0;
+}
+
+/*
+ * The first window ending at or after block, or NULL.
+ */
+static struct ext3_reserve_window *rsv_window_search(struct super_block *sb,
+						     unsigned long block)
+{
+	rb_node_t *n = sb->u.ext3_sb.s_rsv_window_root.rb_node;
+	struct ext3_reserve_window *rsv, *found = NULL;
+
+	while (n) {
+		rsv = rb_entry(n, struct ext3_reserve_window, rsv_node);
+		if (block > rsv->rsv_end)
+			n = n->rb_right;
+		else {
+			found = rsv;
+			n = n->rb_left;
+		}
+	}
+	return found;
+}
+
+/*
+ * Give rsv a new window in group, starting at the first allocatable
+ * block at or after start (relative to the group, -1 for its start)
+ * with room for the whole window before the next one.  Returns -1 if
+ * there is no such block in the rest of the group.
+ */
+static int alloc_new_reservation(struct super_block *sb,
+				 struct ext3_reserve_window *rsv, int group,
+				 struct buffer_head *bh, int start)
+{
+	unsigned long group_first = group * EXT3_BLOCKS_PER_GROUP(sb) +
+		le32_to_cpu(sb->u.ext3_sb.s_es->s_first_data_block);
+	unsigned long size = rsv->rsv_goal_size;
+	unsigned long block;
+	struct ext3_reserve_window *next;
+
+	if (!rsv_is_empty(rsv)) {
+		if (rsv->rsv_alloc_hit >
+		    (rsv->rsv_end - rsv->rsv_start + 1) / 2) {
+			size *= 2;
+			if (size > EXT3_MAX_RESERVE_BLOCKS)
+				size = EXT3_MAX_RESERVE_BLOCKS;
+			rsv->rsv_goal_size = size;
+		}
+		rsv_window_remove(sb, rsv);
+	}
+
+	if (start < 0)
+		start = 0;
+	while (start < EXT3_BLOCKS_PER_GROUP(sb)) {
+		start = bitmap_search_next_usable_block(start, bh,
+					EXT3_BLOCKS_PER_GROUP(sb));
+		if (start < 0)
+			break;
+		block = group_first + start;
+		next = rsv_window_search(sb, block);
+		if (next && next->rsv_start < block + size) {
+			/* Inside, or too close before, another window */
+			start = next->rsv_end + 1 - group_first;
+			continue;
+		}
+		rsv->rsv_start = block;
+		rsv->rsv_end = block + size - 1;
+		rsv_window_add(sb, rsv);
+		return 0;
 	}
 	return -1;
 }
 
+/*
+ * Allocate for a file with a reservation window: the first allocatable
+ * block at or after goal (relative to the group, -1 for anywhere) in
+ * the part of its window inside group, moving the window on first if
+ * the goal is outside it, and again each time it turns out full.
+ * Returns the block relative to the group, or -1 if the window cannot
+ * be placed in the group.
+ */
+static int ext3_try_to_allocate_with_rsv(struct super_block *sb,
+				struct ext3_reserve_window *rsv, int group,
+				struct buffer_head *bh, int goal)
+{
+	unsigned long group_first = group * EXT3_BLOCKS_PER_GROUP(sb) +
+		le32_to_cpu(sb->u.ext3_sb.s_es->s_first_data_block);
+	unsigned long group_last = group_first + EXT3_BLOCKS_PER_GROUP(sb) - 1;
+	int start, end, j = -1;
+
+	spin_lock(&sb->u.ext3_sb.s_rsv_window_lock);
+	while (1) {
+		if (rsv_is_empty(rsv) ||
+		    rsv->rsv_end < group_first || rsv->rsv_start > group_last ||
+		    (goal >= 0 && (group_first + goal < rsv->rsv_start ||
+				   group_first + goal > rsv->rsv_end))) {
+			if (alloc_new_reservation(sb, rsv, group, bh, goal) < 0)
+				break;
+		}
+
+		start = 0;
+		if (rsv->rsv_start > group_first)
+			start = rsv->rsv_start - group_first;
+		if (goal > start)
+			start = goal;
+		end = EXT3_BLOCKS_PER_GROUP(sb);
+		if (rsv->rsv_end < group_last)
+			end = rsv->rsv_end - group_first + 1;
+
+		j = bitmap_search_next_usable_block(start, bh, end);
+		if (j >= 0) {
+			rsv->rsv_alloc_hit++;
+			break;
+		}
+
+		/* Full up to the end of the group: leave it to the next */
+		if (end >= EXT3_BLOCKS_PER_GROUP(sb))
+			break;
+		goal = end;
+	}
+	spin_unlock(&sb->u.ext3_sb.s_rsv_window_lock);
+	return j;
+}
+
+/*
+ * Drop the inode's reservation window, if it has one.  Called on
+ * truncate, when the last writer closes the file, and when the inode
+ * leaves memory.
+ */
+void ext3_discard_reservation(struct inode *inode)
+{
+	struct ext3_reserve_window *rsv = &inode->u.ext3_i.i_rsv_window;
+	struct super_block *sb = inode->i_sb;
+
+	if (rsv_is_empty(rsv))
+		return;
+	spin_lock(&sb->u.ext3_sb.s_rsv_window_lock);
+	if (!rsv_is_empty(rsv))
+		rsv_window_remove(sb, rsv);
+	spin_unlock(&sb->u.ext3_sb.s_rsv_window_lock);
+}
+
 /*
  * ext3_new_block uses a goal block to assist allocation.  If the goal is
  * free, or there is a free block within 32 blocks of the goal, that block
  * is allocated.  Otherwise a forward search is made for a free block; within 
  * each block group the search first looks for an entire free byte in the block
  * bitmap, and then for any free bit if that fails.
+ * Regular files on filesystems mounted with reservations allocate from
+ * their reservation window instead, and fall back to the plain search
+ * only when no group has room for a window.
  * This function also updates quota and i_blocks field.
  */
 int ext3_new_block (handle_t *handle, struct inode * inode,
@@ -544,6 +750,7 @@ int ext3_new_block (handle_t *handle, struct inode * inode,
 	struct super_block * sb;
 	struct ext3_group_desc * gdp;
 	struct ext3_super_block * es;
+	struct ext3_reserve_window * rsv = NULL;
 #ifdef EXT3FS_DEBUG
 	static int goal_hits = 0, goal_attempts = 0;
 #endif
@@ -554,6 +761,10 @@ int ext3_new_block (handle_t *handle, struct inode * inode,
 		return 0;
 	}
 
+	if (test_opt(sb, RESERVATION) && S_ISREG(inode->i_mode) &&
+	    inode->u.ext3_i.i_rsv_window.rsv_goal_size > 0)
+		rsv = &inode->u.ext3_i.i_rsv_window;
+
 	/*
 	 * Check quota for allocation of this block.
 	 */
@@ -602,17 +813,22 @@ repeat:
 
 		ext3_debug ("goal is at %d:%d.\n", i, j);
 
-		if (ext3_test_allocatable(j, bh)) {
+		if (rsv) {
+			j = ext3_try_to_allocate_with_rsv(sb, rsv, i, bh, j);
+			if (j >= 0)
+				goto got_block;
+		} else if (ext3_test_allocatable(j, bh)) {
 #ifdef EXT3FS_DEBUG
 			goal_hits++;
 			ext3_debug ("goal bit allocated.\n");
 #endif
 			goto got_block;
+		} else {
+			j = find_next_usable_block(j, bh,
+						   EXT3_BLOCKS_PER_GROUP(sb));
+			if (j >= 0)
+				goto search_back;
 		}
-
-		j = find_next_usable_block(j, bh, EXT3_BLOCKS_PER_GROUP(sb));
-		if (j >= 0)
-			goto search_back;
 	}
 
 	ext3_debug ("Bit not found in block group %d.\n", i);
@@ -636,13 +852,26 @@ repeat:
 				goto io_error;
 	
 			bh = sb->u.ext3_sb.s_block_bitmap[bitmap_nr];
-			j = find_next_usable_block(-1, bh, 
-						   EXT3_BLOCKS_PER_GROUP(sb));
-			if (j >= 0) 
-				goto search_back;
+			if (rsv) {
+				j = ext3_try_to_allocate_with_rsv(sb, rsv,
+								  i, bh, -1);
+				if (j >= 0)
+					goto got_block;
+			} else {
+				j = find_next_usable_block(-1, bh, 
+						EXT3_BLOCKS_PER_GROUP(sb));
+				if (j >= 0) 
+					goto search_back;
+			}
 		}
 	}
 
+	/* No room for a window anywhere: try again without one */
+	if (rsv) {
+		rsv = NULL;
+		goto repeat;
+	}
+
 	/* No space left on the device */
 	goto out;
 
@@ -30,11 +30,15 @@
  * Called when an inode is released. Note that this is different
  * from ext3_file_open: open gets called at every open, but release
  * gets called only when /all/ the files are closed.
+ * The reservation window goes with the file's last writer.
  */
 static int ext3_release_file (struct inode * inode, struct file * filp)
 {
-	if (filp->f_mode & FMODE_WRITE)
+	if (filp->f_mode & FMODE_WRITE) {
 		ext3_discard_prealloc (inode);
+		if (atomic_read(&inode->i_writecount) == 1)
+			ext3_discard_reservation (inode);
+	}
 	return 0;
 }
 
@@ -114,6 +118,8 @@ struct file_operations ext3_file_operations = {
 	llseek:		generic_file_llseek,	/* BKL held */
 	read:		generic_file_read,	/* BKL not held.  Don't need */
 	write:		ext3_file_write,	/* BKL not held.  Don't need */
+	aio_read:	generic_file_aio_read,	/* O_DIRECT only */
+	aio_write:	generic_file_aio_write,	/* O_DIRECT only */
 	ioctl:		ext3_ioctl,		/* BKL held */
 	mmap:		generic_file_mmap,
 	open:		ext3_open_file,		/* BKL not held.  Don't need */
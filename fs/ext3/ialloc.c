@@ -495,6 +495,11 @@ repeat:
 	inode->u.ext3_i.i_dir_acl = 0;
 	inode->u.ext3_i.i_dtime = 0;
 	INIT_LIST_HEAD(&inode->u.ext3_i.i_orphan);
+	inode->u.ext3_i.i_rsv_window.rsv_start = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	inode->u.ext3_i.i_rsv_window.rsv_end = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	inode->u.ext3_i.i_rsv_window.rsv_goal_size =
+		sb->u.ext3_sb.s_rsv_goal_size;
+	inode->u.ext3_i.i_rsv_window.rsv_alloc_hit = 0;
 #ifdef EXT3_PREALLOCATE
 	inode->u.ext3_i.i_prealloc_count = 0;
 #endif
@@ -184,6 +184,14 @@ void ext3_put_inode (struct inode * inode)
 	ext3_discard_prealloc (inode);
 }
 
+/*
+ * Called when the inode leaves memory.
+ */
+void ext3_clear_inode (struct inode * inode)
+{
+	ext3_discard_reservation (inode);
+}
+
 /*
  * Called at the last iput() if i_nlink is zero.
  */
@@ -1888,6 +1896,7 @@ void ext3_truncate(struct inode * inode)
 		return;
 
 	ext3_discard_prealloc(inode);
+	ext3_discard_reservation(inode);
 
 	handle = start_transaction(inode);
 	if (IS_ERR(handle))
@@ -2172,6 +2181,11 @@ void ext3_read_inode(struct inode * inode)
 	for (block = 0; block < EXT3_N_BLOCKS; block++)
 		inode->u.ext3_i.i_data[block] = iloc.raw_inode->i_block[block];
 	INIT_LIST_HEAD(&inode->u.ext3_i.i_orphan);
+	inode->u.ext3_i.i_rsv_window.rsv_start = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	inode->u.ext3_i.i_rsv_window.rsv_end = EXT3_RESERVE_WINDOW_NOT_ALLOCATED;
+	inode->u.ext3_i.i_rsv_window.rsv_goal_size =
+		inode->i_sb->u.ext3_sb.s_rsv_goal_size;
+	inode->u.ext3_i.i_rsv_window.rsv_alloc_hit = 0;
 
 	if (inode->i_ino == EXT3_ACL_IDX_INO ||
 	    inode->i_ino == EXT3_ACL_DATA_INO)
@@ -125,6 +125,35 @@ flags_err:
 		ext3_journal_stop(handle, inode);
 		return err;
 	}
+	case EXT3_IOC_GETRSVSZ:
+		if (!test_opt(inode->i_sb, RESERVATION) ||
+		    !S_ISREG(inode->i_mode))
+			return -ENOTTY;
+		return put_user(inode->u.ext3_i.i_rsv_window.rsv_goal_size,
+				(int *) arg);
+	case EXT3_IOC_SETRSVSZ: {
+		int rsv_window_size;
+
+		if (!test_opt(inode->i_sb, RESERVATION) ||
+		    !S_ISREG(inode->i_mode))
+			return -ENOTTY;
+		if (IS_RDONLY(inode))
+			return -EROFS;
+		if ((current->fsuid != inode->i_uid) && !capable(CAP_FOWNER))
+			return -EACCES;
+		if (get_user(rsv_window_size, (int *) arg))
+			return -EFAULT;
+		if (rsv_window_size < 0)
+			return -EINVAL;
+		if (rsv_window_size > EXT3_MAX_RESERVE_BLOCKS)
+			rsv_window_size = EXT3_MAX_RESERVE_BLOCKS;
+
+		/* The window in place keeps its size until it is replaced */
+		spin_lock(&inode->i_sb->u.ext3_sb.s_rsv_window_lock);
+		inode->u.ext3_i.i_rsv_window.rsv_goal_size = rsv_window_size;
+		spin_unlock(&inode->i_sb->u.ext3_sb.s_rsv_window_lock);
+		return 0;
+	}
 #ifdef CONFIG_JBD_DEBUG
 	case EXT3_IOC_WAIT_FOR_READONLY:
 		/*
@@ -456,6 +456,7 @@ static struct super_operations ext3_sops = {
 	dirty_inode:	ext3_dirty_inode,	/* BKL not held.  We take it */
 	put_inode:	ext3_put_inode,		/* BKL not held.  Don't need */
 	delete_inode:	ext3_delete_inode,	/* BKL not held.  We take it */
+	clear_inode:	ext3_clear_inode,	/* BKL not held.  Don't need */
 	put_super:	ext3_put_super,		/* BKL held */
 	write_super:	ext3_write_super,	/* BKL held */
 	sync_fs:	ext3_sync_fs,
@@ -622,6 +623,19 @@ static int parse_options (char * options, unsigned long * sb_block,
 		}
 		else if (!strcmp (this_char, "noload"))
 			set_opt (*mount_options, NOLOAD);
+		else if (!strcmp (this_char, "reservation")) {
+			unsigned long v;
+			set_opt (*mount_options, RESERVATION);
+			if (value && *value) {
+				if (want_numeric(value, "reservation", &v))
+					return 0;
+				if (v > EXT3_MAX_RESERVE_BLOCKS)
+					v = EXT3_MAX_RESERVE_BLOCKS;
+				sbi->s_rsv_goal_size = v;
+			}
+		}
+		else if (!strcmp (this_char, "noreservation"))
+			clear_opt (*mount_options, RESERVATION);
 		else if (!strcmp (this_char, "data")) {
 			int data_opt = 0;
 
@@ -949,6 +963,8 @@ struct super_block * ext3_read_super (struct super_block * sb, void * data,
 		blocksize = hblock;
 
 	sbi->s_mount_opt = 0;
+	set_opt(sbi->s_mount_opt, RESERVATION);
+	sbi->s_rsv_goal_size = EXT3_DEFAULT_RESERVE_BLOCKS;
 	sbi->s_resuid = EXT3_DEF_RESUID;
 	sbi->s_resgid = EXT3_DEF_RESGID;
 	if (!parse_options ((char *) data, &sb_block, sbi, &journal_inum, 0)) {
@@ -1092,6 +1108,9 @@ struct super_block * ext3_read_super (struct super_block * sb, void * data,
 	if (sbi->s_resgid == EXT3_DEF_RESGID)
 		sbi->s_resgid = le16_to_cpu(es->s_def_resgid);
 	sbi->s_mount_state = le16_to_cpu(es->s_state);
+	for (i = 0; i < 4; i++)
+		sbi->s_hash_seed[i] = le32_to_cpu(es->s_hash_seed[i]);
+	sbi->s_def_hash_version = es->s_def_hash_version;
 	sbi->s_addr_per_block_bits = log2(EXT3_ADDR_PER_BLOCK(sb));
 	sbi->s_desc_per_block_bits = log2(EXT3_DESC_PER_BLOCK(sb));
 
@@ -1156,6 +1175,8 @@ struct super_block * ext3_read_super (struct super_block * sb, void * data,
 	sb->s_op = &ext3_sops;
 	sb->dq_op = &ext3_qops;
 	INIT_LIST_HEAD(&sbi->s_orphan); /* unlinked but open files */
+	spin_lock_init(&sbi->s_rsv_window_lock);
+	sbi->s_rsv_window_root = RB_ROOT;
 
 	sb->s_root = 0;
 
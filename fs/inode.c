@@ -215,6 +215,8 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 
 	spin_lock(&inode_lock);
 	if ((inode->i_state & flags) != flags) {
+		if (!(inode->i_state & I_DIRTY))
+			inode->i_dirtied_when = jiffies;
 		inode->i_state |= flags;
 		/* Only add valid (ie hashed) inodes to the dirty list */
 		if (!(inode->i_state & (I_LOCK|I_FREEING|I_CLEAR)) &&
@@ -447,6 +449,48 @@ void sync_unlocked_inodes(void)
 	spin_unlock(&inode_lock);
 }
 
+/*
+ * s_dirty is in the order the inodes were first dirtied, oldest at
+ * the tail, so we can stop at the first one that is still too young.
+ */
+static inline void sync_old_list(struct list_head *head, unsigned long age)
+{
+	struct list_head * tmp;
+
+	while ((tmp = head->prev) != head) {
+		struct inode *inode = list_entry(tmp, struct inode, i_list);
+
+		if (time_before(jiffies, inode->i_dirtied_when + age))
+			break;
+		__sync_one(inode, 0);
+	}
+}
+
+/*
+ * Periodic writeback for one bdflush thread: write the inodes of the
+ * filesystems on its queue that have been dirty for "age" jiffies.
+ * Like sync_unlocked_inodes(), this waits for the data to be written,
+ * but only to the devices of that one queue.
+ */
+void sync_old_inodes(int queue, unsigned long age)
+{
+	struct super_block * sb;
+	spin_lock(&inode_lock);
+	spin_lock(&sb_lock);
+	sb = sb_entry(super_blocks.next);
+	for (; sb != sb_entry(&super_blocks); sb = sb_entry(sb->s_list.next)) {
+		if (bdflush_queue(sb->s_dev) != queue)
+			continue;
+		if (!list_empty(&sb->s_dirty)) {
+			spin_unlock(&sb_lock);
+			sync_old_list(&sb->s_dirty, age);
+			spin_lock(&sb_lock);
+		}
+	}
+	spin_unlock(&sb_lock);
+	spin_unlock(&inode_lock);
+}
+
 /*
  * Find a superblock with inodes that need to be synced
  */
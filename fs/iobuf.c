@@ -20,8 +20,9 @@ void end_kio_request(struct kiobuf *kiobuf, int uptodate)
 
 	if (atomic_dec_and_test(&kiobuf->io_count)) {
 		if (kiobuf->end_io)
-			kiobuf->end_io(kiobuf);
-		wake_up(&kiobuf->wait_queue);
+			kiobuf->end_io(kiobuf);	/* may free it */
+		else
+			wake_up(&kiobuf->wait_queue);
 	}
 }
 
@@ -34,41 +35,24 @@ static int kiobuf_init(struct kiobuf *iobuf)
 	iobuf->bh = NULL;
 	iobuf->blocks = NULL;
 	atomic_set(&iobuf->io_count, 0);
+	iobuf->errno = 0;
 	iobuf->end_io = NULL;
+	iobuf->private = NULL;
 	return expand_kiobuf(iobuf, KIO_STATIC_PAGES);
 }
 
+/*
+ * brw_kiovec() builds its own bios, so only the block list is needed
+ * now.  Not preallocating KIO_MAX_SECTORS buffer_heads also makes a
+ * kiobuf cheap enough to allocate per request, as AIO does.
+ */
 int alloc_kiobuf_bhs(struct kiobuf * kiobuf)
 {
-	int i;
-
 	kiobuf->blocks =
 		kmalloc(sizeof(*kiobuf->blocks) * KIO_MAX_SECTORS, GFP_KERNEL);
 	if (unlikely(!kiobuf->blocks))
-		goto nomem;
-	kiobuf->bh =
-		kmalloc(sizeof(*kiobuf->bh) * KIO_MAX_SECTORS, GFP_KERNEL);
-	if (unlikely(!kiobuf->bh))
-		goto nomem;
-
-	for (i = 0; i < KIO_MAX_SECTORS; i++) {
-		kiobuf->bh[i] = kmem_cache_alloc(bh_cachep, GFP_KERNEL);
-		if (unlikely(!kiobuf->bh[i]))
-			goto nomem2;
-	}
-
+		return -ENOMEM;
 	return 0;
-
-nomem2:
-	while (i--) {
-		kmem_cache_free(bh_cachep, kiobuf->bh[i]);
-		kiobuf->bh[i] = NULL;
-	}
-	memset(kiobuf->bh, 0, sizeof(*kiobuf->bh) * KIO_MAX_SECTORS);
-
-nomem:
-	free_kiobuf_bhs(kiobuf);
-	return -ENOMEM;
 }
 
 void free_kiobuf_bhs(struct kiobuf * kiobuf)
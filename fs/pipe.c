@@ -8,6 +8,8 @@
 #include <linux/file.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/init.h>
 
@@ -36,211 +38,305 @@ void pipe_wait(struct inode * inode)
 	down(PIPE_SEM(*inode));
 }
 
+/*
+ * Pages written by write() belong to the pipe.  A page that comes back
+ * with nobody else holding it is kept for the next write.
+ */
+static void *anon_pipe_buf_map(struct pipe_inode_info *info,
+			       struct pipe_buffer *buf)
+{
+	return kmap(buf->page);
+}
+
+static void anon_pipe_buf_unmap(struct pipe_inode_info *info,
+				struct pipe_buffer *buf)
+{
+	kunmap(buf->page);
+}
+
+static void anon_pipe_buf_release(struct pipe_inode_info *info,
+				  struct pipe_buffer *buf)
+{
+	struct page *page = buf->page;
+
+	if (page_count(page) == 1 && !info->tmp_page)
+		info->tmp_page = page;
+	else
+		page_cache_release(page);
+}
+
+struct pipe_buf_operations anon_pipe_buf_ops = {
+	can_merge:	1,
+	map:		anon_pipe_buf_map,
+	unmap:		anon_pipe_buf_unmap,
+	release:	anon_pipe_buf_release,
+};
+
 static ssize_t
 pipe_read(struct file *filp, char *buf, size_t count, loff_t *ppos)
 {
 	struct inode *inode = filp->f_dentry->d_inode;
-	ssize_t size, read, ret;
+	struct pipe_inode_info *info;
+	ssize_t ret;
+	int do_wakeup;
 
 	/* Seeks are not allowed on pipes.  */
-	ret = -ESPIPE;
-	read = 0;
 	if (ppos != &filp->f_pos)
-		goto out_nolock;
+		return -ESPIPE;
 
 	/* Always return 0 on null read.  */
-	ret = 0;
 	if (count == 0)
-		goto out_nolock;
+		return 0;
 
 	/* Get the pipe semaphore */
-	ret = -ERESTARTSYS;
 	if (down_interruptible(PIPE_SEM(*inode)))
-		goto out_nolock;
-
-	if (PIPE_EMPTY(*inode)) {
-do_more_read:
-		ret = 0;
-		if (!PIPE_WRITERS(*inode))
-			goto out;
-
-		ret = -EAGAIN;
-		if (filp->f_flags & O_NONBLOCK)
-			goto out;
-
-		for (;;) {
-			PIPE_WAITING_READERS(*inode)++;
-			pipe_wait(inode);
-			PIPE_WAITING_READERS(*inode)--;
-			ret = -ERESTARTSYS;
-			if (signal_pending(current))
-				goto out;
-			ret = 0;
-			if (!PIPE_EMPTY(*inode))
-				break;
-			if (!PIPE_WRITERS(*inode))
-				goto out;
-		}
-	}
+		return -ERESTARTSYS;
 
-	/* Read what data is available.  */
-	ret = -EFAULT;
-	while (count > 0 && (size = PIPE_LEN(*inode))) {
-		char *pipebuf = PIPE_BASE(*inode) + PIPE_START(*inode);
-		ssize_t chars = PIPE_MAX_RCHUNK(*inode);
-
-		if (chars > count)
-			chars = count;
-		if (chars > size)
-			chars = size;
-
-		if (copy_to_user(buf, pipebuf, chars))
-			goto out;
-
-		read += chars;
-		PIPE_START(*inode) += chars;
-		PIPE_START(*inode) &= (PIPE_SIZE - 1);
-		PIPE_LEN(*inode) -= chars;
-		count -= chars;
-		buf += chars;
-	}
+	info = inode->i_pipe;
+	do_wakeup = 0;
+	ret = 0;
+	for (;;) {
+		int bufs = info->nrbufs;
+		/* A head splice() is sending isn't ours to take */
+		int ready = bufs && !info->head_busy;
+
+		if (ready) {
+			int curbuf = info->curbuf;
+			struct pipe_buffer *pbuf = info->bufs + curbuf;
+			struct pipe_buf_operations *ops = pbuf->ops;
+			size_t chars = pbuf->len;
+			char *addr;
+			int error;
 
-	/* Cache behaviour optimization */
-	if (!PIPE_LEN(*inode))
-		PIPE_START(*inode) = 0;
-
-	if (count && PIPE_WAITING_WRITERS(*inode) && !(filp->f_flags & O_NONBLOCK)) {
-		/*
-		 * We know that we are going to sleep: signal
-		 * writers synchronously that there is more
-		 * room.
-		 */
-		wake_up_interruptible_sync(PIPE_WAIT(*inode));
-		if (!PIPE_EMPTY(*inode))
-			BUG();
-		goto do_more_read;
-	}
-	/* Signal writers asynchronously that there is more room.  */
-	wake_up_interruptible(PIPE_WAIT(*inode));
+			if (chars > count)
+				chars = count;
 
-	ret = read;
-out:
+			addr = ops->map(info, pbuf);
+			error = copy_to_user(buf, addr + pbuf->offset, chars);
+			ops->unmap(info, pbuf);
+			if (error) {
+				if (!ret)
+					ret = -EFAULT;
+				break;
+			}
+			ret += chars;
+			buf += chars;
+			count -= chars;
+			pbuf->offset += chars;
+			pbuf->len -= chars;
+			if (!pbuf->len) {
+				pbuf->ops = NULL;
+				ops->release(info, pbuf);
+				info->curbuf = (curbuf + 1) & (PIPE_BUFFERS - 1);
+				info->nrbufs = --bufs;
+				ready = bufs != 0;
+				do_wakeup = 1;
+			}
+			if (!count)
+				break;
+		}
+		if (ready)
+			continue;
+		if (!bufs && !PIPE_WRITERS(*inode))
+			break;
+		if (!PIPE_WAITING_WRITERS(*inode)) {
+			/*
+			 * Don't sleep with O_NONBLOCK or once we have some
+			 * data - unless a writer is asleep in the kernel, in
+			 * which case its data can be waited for without
+			 * breaking POSIX.
+			 */
+			if (ret)
+				break;
+			if (filp->f_flags & O_NONBLOCK) {
+				ret = -EAGAIN;
+				break;
+			}
+		}
+		if (signal_pending(current)) {
+			if (!ret)
+				ret = -ERESTARTSYS;
+			break;
+		}
+		if (do_wakeup) {
+			/*
+			 * We know that we are going to sleep: signal
+			 * writers synchronously that there is more
+			 * room.
+			 */
+			wake_up_interruptible_sync(PIPE_WAIT(*inode));
+			do_wakeup = 0;
+		}
+		PIPE_WAITING_READERS(*inode)++;
+		pipe_wait(inode);
+		PIPE_WAITING_READERS(*inode)--;
+	}
 	up(PIPE_SEM(*inode));
-out_nolock:
-	if (read)
-		ret = read;
 
-	UPDATE_ATIME(inode);
+	/* Signal writers asynchronously that there is more room.  */
+	if (do_wakeup)
+		wake_up_interruptible(PIPE_WAIT(*inode));
+	if (ret > 0)
+		UPDATE_ATIME(inode);
 	return ret;
 }
 
+static inline int pipe_buf_can_merge(struct pipe_buffer *buf)
+{
+	/* Not if tee() has put the page in another pipe as well */
+	return buf->ops->can_merge && page_count(buf->page) == 1;
+}
+
 static ssize_t
 pipe_write(struct file *filp, const char *buf, size_t count, loff_t *ppos)
 {
 	struct inode *inode = filp->f_dentry->d_inode;
-	ssize_t free, written, ret;
+	struct pipe_inode_info *info;
+	ssize_t ret;
+	size_t chars;
+	int do_wakeup;
 
 	/* Seeks are not allowed on pipes.  */
-	ret = -ESPIPE;
-	written = 0;
 	if (ppos != &filp->f_pos)
-		goto out_nolock;
+		return -ESPIPE;
 
 	/* Null write succeeds.  */
-	ret = 0;
 	if (count == 0)
-		goto out_nolock;
+		return 0;
 
-	ret = -ERESTARTSYS;
 	if (down_interruptible(PIPE_SEM(*inode)))
-		goto out_nolock;
+		return -ERESTARTSYS;
+
+	info = inode->i_pipe;
+	do_wakeup = 0;
+	ret = 0;
 
 	/* No readers yields SIGPIPE.  */
 	if (!PIPE_READERS(*inode))
 		goto sigpipe;
 
-	/* If count <= PIPE_BUF, we have to make it atomic.  */
-	free = (count <= PIPE_BUF ? count : 1);
-
-	/* Wait, or check for, available space.  */
-	if (filp->f_flags & O_NONBLOCK) {
-		ret = -EAGAIN;
-		if (PIPE_FREE(*inode) < free)
-			goto out;
-	} else {
-		while (PIPE_FREE(*inode) < free) {
-			PIPE_WAITING_WRITERS(*inode)++;
-			pipe_wait(inode);
-			PIPE_WAITING_WRITERS(*inode)--;
-			ret = -ERESTARTSYS;
-			if (signal_pending(current))
+	/*
+	 * Small writes go into the last page if they fit.  A write of up
+	 * to PIPE_BUF (which is one page) is never split: it either fits
+	 * there whole or gets a page to itself.
+	 */
+	chars = count & (PAGE_SIZE - 1);
+	if (info->nrbufs && chars) {
+		int lastbuf = (info->curbuf + info->nrbufs - 1) & (PIPE_BUFFERS - 1);
+		struct pipe_buffer *pbuf = info->bufs + lastbuf;
+		unsigned int offset = pbuf->offset + pbuf->len;
+
+		if (pipe_buf_can_merge(pbuf) && offset + chars <= PAGE_SIZE) {
+			char *addr;
+			int error;
+
+			addr = pbuf->ops->map(info, pbuf);
+			error = copy_from_user(addr + offset, buf, chars);
+			pbuf->ops->unmap(info, pbuf);
+			if (error) {
+				ret = -EFAULT;
+				goto out;
+			}
+			do_wakeup = 1;
+			pbuf->len += chars;
+			ret = chars;
+			buf += chars;
+			count -= chars;
+			if (!count)
 				goto out;
-
-			if (!PIPE_READERS(*inode))
-				goto sigpipe;
 		}
 	}
 
-	/* Copy into available space.  */
-	ret = -EFAULT;
-	while (count > 0) {
-		int space;
-		char *pipebuf = PIPE_BASE(*inode) + PIPE_END(*inode);
-		ssize_t chars = PIPE_MAX_WCHUNK(*inode);
-
-		if ((space = PIPE_FREE(*inode)) != 0) {
+	for (;;) {
+		int bufs;
+
+		if (!PIPE_READERS(*inode))
+			goto sigpipe;
+		bufs = info->nrbufs;
+		if (!PIPE_FULL(*inode)) {
+			int newbuf = (info->curbuf + bufs) & (PIPE_BUFFERS - 1);
+			struct pipe_buffer *pbuf = info->bufs + newbuf;
+			struct page *page = info->tmp_page;
+			int error;
+
+			if (!page) {
+				page = alloc_page(GFP_HIGHUSER);
+				if (!page) {
+					if (!ret)
+						ret = -ENOMEM;
+					break;
+				}
+				info->tmp_page = page;
+			}
+			/*
+			 * Wake up the readers even if the copy fails, or
+			 * one that waits for a sleeping writer (see
+			 * pipe_read()) could wait for ever.
+			 */
+			do_wakeup = 1;
+			chars = PAGE_SIZE;
 			if (chars > count)
 				chars = count;
-			if (chars > space)
-				chars = space;
 
-			if (copy_from_user(pipebuf, buf, chars))
-				goto out;
+			error = copy_from_user(kmap(page), buf, chars);
+			kunmap(page);
+			if (error) {
+				if (!ret)
+					ret = -EFAULT;
+				break;
+			}
+			ret += chars;
+
+			pbuf->page = page;
+			pbuf->ops = &anon_pipe_buf_ops;
+			pbuf->offset = 0;
+			pbuf->len = chars;
+			info->nrbufs = ++bufs;
+			info->tmp_page = NULL;
 
-			written += chars;
-			PIPE_LEN(*inode) += chars;
-			count -= chars;
 			buf += chars;
-			space = PIPE_FREE(*inode);
+			count -= chars;
+			if (!count)
+				break;
+		}
+		if (!PIPE_FULL(*inode))
 			continue;
+		if (filp->f_flags & O_NONBLOCK) {
+			if (!ret)
+				ret = -EAGAIN;
+			break;
 		}
-
-		ret = written;
-		if (filp->f_flags & O_NONBLOCK)
+		if (signal_pending(current)) {
+			if (!ret)
+				ret = -ERESTARTSYS;
 			break;
-
-		do {
+		}
+		if (do_wakeup) {
 			/*
 			 * Synchronous wake-up: it knows that this process
 			 * is going to give up this CPU, so it doesn't have
 			 * to do idle reschedules.
 			 */
 			wake_up_interruptible_sync(PIPE_WAIT(*inode));
-			PIPE_WAITING_WRITERS(*inode)++;
-			pipe_wait(inode);
-			PIPE_WAITING_WRITERS(*inode)--;
-			if (signal_pending(current))
-				goto out;
-			if (!PIPE_READERS(*inode))
-				goto sigpipe;
-		} while (!PIPE_FREE(*inode));
-		ret = -EFAULT;
+			do_wakeup = 0;
+		}
+		PIPE_WAITING_WRITERS(*inode)++;
+		pipe_wait(inode);
+		PIPE_WAITING_WRITERS(*inode)--;
 	}
 
-	/* Signal readers asynchronously that there is more data.  */
-	wake_up_interruptible(PIPE_WAIT(*inode));
-
-	update_mctime(inode);
-
 out:
 	up(PIPE_SEM(*inode));
-out_nolock:
-	if (written)
-		ret = written;
+
+	/* Signal readers asynchronously that there is more data.  */
+	if (do_wakeup)
+		wake_up_interruptible(PIPE_WAIT(*inode));
+	if (ret > 0)
+		update_mctime(inode);
 	return ret;
 
 sigpipe:
-	if (written)
+	if (ret)
 		goto out;
 	up(PIPE_SEM(*inode));
 	send_sig(SIGPIPE, current, 0);
@@ -263,9 +359,18 @@ static int
 pipe_ioctl(struct inode *pino, struct file *filp,
 	   unsigned int cmd, unsigned long arg)
 {
+	struct pipe_inode_info *info;
+	int i, count;
+
 	switch (cmd) {
 		case FIONREAD:
-			return put_user(PIPE_LEN(*pino), (int *)arg);
+			down(PIPE_SEM(*pino));
+			info = pino->i_pipe;
+			count = 0;
+			for (i = 0; i < info->nrbufs; i++)
+				count += info->bufs[(info->curbuf + i) & (PIPE_BUFFERS - 1)].len;
+			up(PIPE_SEM(*pino));
+			return put_user(count, (int *)arg);
 		default:
 			return -EINVAL;
 	}
@@ -281,9 +386,11 @@ pipe_poll(struct file *filp, poll_table *wait)
 	poll_wait(filp, PIPE_WAIT(*inode), wait);
 
 	/* Reading only -- no need for acquiring the semaphore.  */
-	mask = POLLIN | POLLRDNORM;
-	if (PIPE_EMPTY(*inode))
-		mask = POLLOUT | POLLWRNORM;
+	mask = 0;
+	if (!PIPE_EMPTY(*inode) && !PIPE_HEAD_BUSY(*inode))
+		mask = POLLIN | POLLRDNORM;
+	if (!PIPE_FULL(*inode))
+		mask |= POLLOUT | POLLWRNORM;
 	if (!PIPE_WRITERS(*inode) && filp->f_version != PIPE_WCOUNTER(*inode))
 		mask |= POLLHUP;
 	if (!PIPE_READERS(*inode))
@@ -302,10 +409,7 @@ pipe_release(struct inode *inode, int decr, int decw)
 	PIPE_READERS(*inode) -= decr;
 	PIPE_WRITERS(*inode) -= decw;
 	if (!PIPE_READERS(*inode) && !PIPE_WRITERS(*inode)) {
-		struct pipe_inode_info *info = inode->i_pipe;
-		inode->i_pipe = NULL;
-		free_page((unsigned long) info->base);
-		kfree(info);
+		free_pipe_info(inode);
 	} else {
 		wake_up_interruptible(PIPE_WAIT(*inode));
 	}
@@ -437,27 +541,35 @@ struct file_operations rdwr_pipe_fops = {
 
 struct inode* pipe_new(struct inode* inode)
 {
-	unsigned long page;
+	struct pipe_inode_info *info;
 
-	page = __get_free_page(GFP_USER);
-	if (!page)
+	info = kmalloc(sizeof(struct pipe_inode_info), GFP_KERNEL);
+	if (!info)
 		return NULL;
-
-	inode->i_pipe = kmalloc(sizeof(struct pipe_inode_info), GFP_KERNEL);
-	if (!inode->i_pipe)
-		goto fail_page;
+	memset(info, 0, sizeof(*info));
+	inode->i_pipe = info;
 
 	init_waitqueue_head(PIPE_WAIT(*inode));
-	PIPE_BASE(*inode) = (char*) page;
-	PIPE_START(*inode) = PIPE_LEN(*inode) = 0;
-	PIPE_READERS(*inode) = PIPE_WRITERS(*inode) = 0;
-	PIPE_WAITING_READERS(*inode) = PIPE_WAITING_WRITERS(*inode) = 0;
 	PIPE_RCOUNTER(*inode) = PIPE_WCOUNTER(*inode) = 1;
 
 	return inode;
-fail_page:
-	free_page(page);
-	return NULL;
+}
+
+/* Drop whatever is still in the pipe; the last reader or writer is gone */
+void free_pipe_info(struct inode* inode)
+{
+	struct pipe_inode_info *info = inode->i_pipe;
+	int i;
+
+	inode->i_pipe = NULL;
+	for (i = 0; i < PIPE_BUFFERS; i++) {
+		struct pipe_buffer *buf = info->bufs + i;
+		if (buf->ops)
+			buf->ops->release(info, buf);
+	}
+	if (info->tmp_page)
+		__free_page(info->tmp_page);
+	kfree(info);
 }
 
 static struct vfsmount *pipe_mnt;
@@ -571,9 +683,7 @@ close_f12_inode_i_j:
 close_f12_inode_i:
 	put_unused_fd(i);
 close_f12_inode:
-	free_page((unsigned long) PIPE_BASE(*inode));
-	kfree(inode->i_pipe);
-	inode->i_pipe = NULL;
+	free_pipe_info(inode);
 	iput(inode);
 close_f12:
 	put_filp(f2);
@@ -37,6 +37,7 @@
 #include <linux/smp_lock.h>
 #include <linux/seq_file.h>
 #include <linux/sysrq.h>
+#include <linux/vmstat.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgtable.h>
@@ -215,6 +216,57 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
 #undef K
 }
 
+/* In the order of enum vm_event_item */
+static char *vmstat_text[NR_VM_EVENT_ITEMS] = {
+	"pgalloc_dma",
+	"pgalloc_normal",
+	"pgalloc_high",
+	"pgfree",
+	"pgfault",
+	"pgmajfault",
+	"pgactivate",
+	"pgdeactivate",
+	"pgrefill",
+	"pgscan",
+	"pgsteal",
+	"slabs_reclaimed",
+	"kswapd_wakeup",
+	"pageoutrun",
+	"allocstall",
+};
+
+static int vmstat_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	unsigned long events[NR_VM_EVENT_ITEMS];
+	int i, len;
+
+	all_vm_events(events);
+
+	len = sprintf(page,
+		"nr_free_pages %u\n"
+		"nr_active %d\n"
+		"nr_inactive %d\n"
+		"nr_pagecache %lu\n"
+		"nr_swapcache %lu\n"
+		"pgpgin %u\n"
+		"pgpgout %u\n"
+		"pswpin %u\n"
+		"pswpout %u\n",
+		nr_free_pages(),
+		nr_active_pages,
+		nr_inactive_pages,
+		page_cache_size,
+		swapper_space.nrpages,
+		kstat.pgpgin, kstat.pgpgout,
+		kstat.pswpin, kstat.pswpout);
+
+	for (i = 0; i < NR_VM_EVENT_ITEMS; i++)
+		len += sprintf(page + len, "%s %lu\n", vmstat_text[i], events[i]);
+
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
 static int version_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
 {
@@ -268,6 +320,20 @@ static struct file_operations proc_partitions_operations = {
 	release:	seq_release,
 };
 
+#ifdef CONFIG_BLK_STATS
+extern struct seq_operations diskstats_op;
+static int diskstats_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &diskstats_op);
+}
+static struct file_operations proc_diskstats_operations = {
+	open:		diskstats_open,
+	read:		seq_read,
+	llseek:		seq_lseek,
+	release:	seq_release,
+};
+#endif
+
 #ifdef CONFIG_MODULES
 static int modules_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
@@ -597,6 +663,7 @@ void __init proc_misc_init(void)
 		{"loadavg",     loadavg_read_proc},
 		{"uptime",	uptime_read_proc},
 		{"meminfo",	meminfo_read_proc},
+		{"vmstat",	vmstat_read_proc},
 		{"version",	version_read_proc},
 #ifdef CONFIG_PROC_HARDWARE
 		{"hardware",	hardware_read_proc},
@@ -639,6 +706,9 @@ void __init proc_misc_init(void)
 	create_seq_entry("ioports", 0, &proc_ioports_operations);
 	create_seq_entry("iomem", 0, &proc_iomem_operations);
 	create_seq_entry("partitions", 0, &proc_partitions_operations);
+#ifdef CONFIG_BLK_STATS
+	create_seq_entry("diskstats", 0, &proc_diskstats_operations);
+#endif
 	create_seq_entry("slabinfo",S_IWUSR|S_IRUGO,&proc_slabinfo_operations);
 #ifdef CONFIG_MODULES
 	create_seq_entry("ksyms", 0, &proc_ksyms_operations);
@@ -1868,7 +1868,7 @@ void reiserfs_truncate_file(struct inode *p_s_inode, int update_timestamps) {
 			set_buffer_flushtime(bh);
 			refile_buffer(bh);
 			buffer_insert_inode_data_queue(bh, p_s_inode);
-			balance_dirty();
+			balance_dirty(bh->b_dev);
 		}
 	    }
 	}
@@ -0,0 +1,559 @@
+/*
+ *  linux/fs/splice.c
+ *
+ *  splice() and tee().
+ *
+ *  A pipe holds page references (see pipe_fs_i.h), so data can go
+ *  through one without being copied:
+ *
+ *	file -> pipe	page cache pages are put in the pipe as they
+ *			are; other files (sockets) are read into pages
+ *			of the pipe's own, from the kernel.
+ *	pipe -> file	each page goes to ->sendpage() if the file has
+ *			one (sockets), else to ->write() from the kernel.
+ *	pipe -> pipe	tee() puts the same pages in the second pipe,
+ *			leaving them in the first.
+ *
+ *  Pages given to a pipe are only ever read, so a page cache page in a
+ *  pipe shows what the file held when it was read, or any later write.
+ *
+ *  The file or socket is never read or written with PIPE_SEM held, as
+ *  that may take for ever; see pipe_fs_i.h for how the pipe is kept
+ *  meanwhile.  read() and write() go on with what is left of it.
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/uio.h>
+#include <linux/splice.h>
+#include <asm/uaccess.h>
+
+static void *page_cache_pipe_buf_map(struct pipe_inode_info *info,
+				     struct pipe_buffer *buf)
+{
+	return kmap(buf->page);
+}
+
+static void page_cache_pipe_buf_unmap(struct pipe_inode_info *info,
+				      struct pipe_buffer *buf)
+{
+	kunmap(buf->page);
+}
+
+static void page_cache_pipe_buf_release(struct pipe_inode_info *info,
+					struct pipe_buffer *buf)
+{
+	page_cache_release(buf->page);
+}
+
+struct pipe_buf_operations page_cache_pipe_buf_ops = {
+	can_merge:	0,
+	map:		page_cache_pipe_buf_map,
+	unmap:		page_cache_pipe_buf_unmap,
+	release:	page_cache_pipe_buf_release,
+};
+
+/* The pipe behind file, or NULL */
+static inline struct inode *splice_pipe(struct file *file)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+
+	if (S_ISFIFO(inode->i_mode) && inode->i_pipe)
+		return inode;
+	return NULL;
+}
+
+/*
+ * Wait for room in the pipe.  Called and returns with the pipe
+ * semaphore held.
+ */
+static int splice_wait_space(struct inode *pipe, unsigned int flags)
+{
+	for (;;) {
+		if (!PIPE_READERS(*pipe)) {
+			send_sig(SIGPIPE, current, 0);
+			return -EPIPE;
+		}
+		if (!PIPE_FULL(*pipe))
+			return 0;
+		if (flags & SPLICE_F_NONBLOCK)
+			return -EAGAIN;
+		if (signal_pending(current))
+			return -ERESTARTSYS;
+		PIPE_WAITING_WRITERS(*pipe)++;
+		pipe_wait(pipe);
+		PIPE_WAITING_WRITERS(*pipe)--;
+	}
+}
+
+/*
+ * Wait for data in the pipe, and for any other splice() to be done
+ * with the first buffer.  Called and returns with the pipe semaphore
+ * held; the pipe is still empty on return if it has no writers left.
+ */
+static int splice_wait_data(struct inode *pipe, unsigned int flags)
+{
+	while (PIPE_EMPTY(*pipe) || PIPE_HEAD_BUSY(*pipe)) {
+		if (PIPE_EMPTY(*pipe) && !PIPE_WRITERS(*pipe))
+			return 0;
+		if (!PIPE_WAITING_WRITERS(*pipe) && (flags & SPLICE_F_NONBLOCK))
+			return -EAGAIN;
+		if (signal_pending(current))
+			return -ERESTARTSYS;
+		PIPE_WAITING_READERS(*pipe)++;
+		pipe_wait(pipe);
+		PIPE_WAITING_READERS(*pipe)--;
+	}
+	return 0;
+}
+
+/*
+ * Pages read for a pipe, before they are put in it.  There are no
+ * more than the pipe had room for when the read started.
+ */
+struct splice_pages {
+	struct pipe_buffer bufs[PIPE_BUFFERS];
+	int nrbufs, maxbufs;
+};
+
+static void splice_add_buf(struct splice_pages *spd, struct page *page,
+			   unsigned int offset, unsigned int len,
+			   struct pipe_buf_operations *ops)
+{
+	struct pipe_buffer *buf = spd->bufs + spd->nrbufs++;
+
+	buf->page = page;
+	buf->offset = offset;
+	buf->len = len;
+	buf->ops = ops;
+}
+
+/* do_generic_file_read() actor: take a reference to the page */
+static int splice_page_actor(read_descriptor_t *desc, struct page *page,
+			     unsigned long offset, unsigned long size)
+{
+	struct splice_pages *spd = (struct splice_pages *) desc->buf;
+
+	if (spd->nrbufs == spd->maxbufs)
+		return 0;
+	if (size > desc->count)
+		size = desc->count;
+
+	page_cache_get(page);
+	splice_add_buf(spd, page, offset, size, &page_cache_pipe_buf_ops);
+	desc->count -= size;
+	desc->written += size;
+	return size;
+}
+
+/*
+ * A file without a page cache: read into fresh pages, all of them in
+ * one call if the file can do readv(), so that a socket gives what it
+ * has without being waited on once per page.
+ */
+static ssize_t splice_read_copy(struct file *in, loff_t *ppos,
+				struct splice_pages *spd, size_t len)
+{
+	struct iovec iov[PIPE_BUFFERS];
+	struct page *pages[PIPE_BUFFERS];
+	mm_segment_t old_fs;
+	ssize_t ret, left;
+	int i, nr;
+
+	nr = spd->maxbufs - spd->nrbufs;
+	if (nr > (len + PAGE_SIZE - 1) >> PAGE_SHIFT)
+		nr = (len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	if (!in->f_op->readv)
+		nr = 1;
+
+	for (i = 0; i < nr; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			break;
+		iov[i].iov_base = page_address(pages[i]);
+		iov[i].iov_len = len < PAGE_SIZE ? len : PAGE_SIZE;
+		len -= iov[i].iov_len;
+	}
+	nr = i;
+	if (!nr)
+		return -ENOMEM;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (in->f_op->readv)
+		ret = in->f_op->readv(in, iov, nr, ppos);
+	else
+		ret = in->f_op->read(in, iov[0].iov_base, iov[0].iov_len, ppos);
+	set_fs(old_fs);
+
+	left = ret;
+	for (i = 0; i < nr; i++) {
+		size_t chars = iov[i].iov_len;
+
+		if (left <= 0) {
+			__free_page(pages[i]);
+			continue;
+		}
+		if (chars > left)
+			chars = left;
+		splice_add_buf(spd, pages[i], 0, chars, &anon_pipe_buf_ops);
+		left -= chars;
+	}
+	return ret;
+}
+
+/*
+ * Read into pages of our own with the pipe unlocked, then put them in.
+ * The slots they go to are reserved meanwhile, so they fit unless the
+ * readers have all gone.
+ */
+static long splice_to_pipe(struct file *in, loff_t *ppos, struct inode *pipe,
+			   size_t len, unsigned int flags)
+{
+	struct inode *inode = in->f_dentry->d_inode;
+	struct pipe_inode_info *info;
+	struct splice_pages spd;
+	long ret;
+	int i;
+
+	if (!in->f_op || !in->f_op->read)
+		return -EINVAL;
+	ret = locks_verify_area(FLOCK_VERIFY_READ, inode, in, *ppos, len);
+	if (ret)
+		return ret;
+
+	if (down_interruptible(PIPE_SEM(*pipe)))
+		return -ERESTARTSYS;
+	info = pipe->i_pipe;
+	ret = splice_wait_space(pipe, flags);
+	if (ret) {
+		up(PIPE_SEM(*pipe));
+		return ret;
+	}
+	spd.nrbufs = 0;
+	spd.maxbufs = PIPE_BUFFERS - info->nrbufs - info->reserved;
+	info->reserved += spd.maxbufs;
+	up(PIPE_SEM(*pipe));
+
+	if (inode->i_mapping->a_ops->readpage) {
+		read_descriptor_t desc;
+
+		desc.written = 0;
+		desc.count = len;
+		desc.buf = (char *) &spd;
+		desc.error = 0;
+		do_generic_file_read(in, ppos, &desc, splice_page_actor);
+		ret = desc.written ? desc.written : desc.error;
+	} else
+		ret = splice_read_copy(in, ppos, &spd, len);
+
+	down(PIPE_SEM(*pipe));
+	info->reserved -= spd.maxbufs;
+	if (!PIPE_READERS(*pipe)) {
+		for (i = 0; i < spd.nrbufs; i++)
+			spd.bufs[i].ops->release(info, spd.bufs + i);
+		up(PIPE_SEM(*pipe));
+		send_sig(SIGPIPE, current, 0);
+		return -EPIPE;
+	}
+	for (i = 0; i < spd.nrbufs; i++) {
+		info->bufs[(info->curbuf + info->nrbufs) & (PIPE_BUFFERS - 1)] =
+			spd.bufs[i];
+		info->nrbufs++;
+	}
+	up(PIPE_SEM(*pipe));
+
+	/* For the readers, and for writers if some room went unused */
+	wake_up_interruptible(PIPE_WAIT(*pipe));
+	return ret;
+}
+
+/*
+ * Send the buffer at the head of the pipe with the pipe unlocked,
+ * holding a reference to its page, then take what went out off it.
+ * With head_busy set, nobody else takes anything off the pipe
+ * meanwhile, and a write() doesn't append to a page with other users,
+ * so the head is still the same buffer.
+ */
+static long splice_from_pipe(struct inode *pipe, struct file *out,
+			     loff_t *ppos, size_t len, unsigned int flags)
+{
+	struct inode *inode = out->f_dentry->d_inode;
+	struct pipe_inode_info *info;
+	long ret, total;
+
+	if (!out->f_op || (!out->f_op->write && !out->f_op->sendpage))
+		return -EINVAL;
+	ret = locks_verify_area(FLOCK_VERIFY_WRITE, inode, out, *ppos, len);
+	if (ret)
+		return ret;
+
+	info = pipe->i_pipe;
+	total = 0;
+	while (len) {
+		struct pipe_buffer buf, *head;
+		size_t chars;
+
+		if (down_interruptible(PIPE_SEM(*pipe))) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		/* Don't wait for more once something has been moved */
+		if (PIPE_EMPTY(*pipe) || PIPE_HEAD_BUSY(*pipe)) {
+			ret = 0;
+			if (!total)
+				ret = splice_wait_data(pipe, flags);
+			if (ret || PIPE_EMPTY(*pipe) || PIPE_HEAD_BUSY(*pipe)) {
+				up(PIPE_SEM(*pipe));
+				break;
+			}
+		}
+		info->head_busy = 1;
+		buf = info->bufs[info->curbuf];
+		page_cache_get(buf.page);
+		up(PIPE_SEM(*pipe));
+
+		chars = buf.len;
+		if (chars > len)
+			chars = len;
+
+		if (out->f_op->sendpage) {
+			int more = (flags & SPLICE_F_MORE) || chars < len;
+
+			ret = out->f_op->sendpage(out, buf.page, buf.offset,
+						  chars, ppos, more);
+		} else {
+			mm_segment_t old_fs;
+			char *addr;
+
+			addr = buf.ops->map(info, &buf);
+			old_fs = get_fs();
+			set_fs(KERNEL_DS);
+			ret = out->f_op->write(out, addr + buf.offset, chars, ppos);
+			set_fs(old_fs);
+			buf.ops->unmap(info, &buf);
+		}
+		page_cache_release(buf.page);
+
+		down(PIPE_SEM(*pipe));
+		info->head_busy = 0;
+		if (ret > 0) {
+			head = info->bufs + info->curbuf;
+			head->offset += ret;
+			head->len -= ret;
+			if (!head->len) {
+				struct pipe_buf_operations *ops = head->ops;
+
+				head->ops = NULL;
+				ops->release(info, head);
+				info->curbuf = (info->curbuf + 1) & (PIPE_BUFFERS - 1);
+				info->nrbufs--;
+			}
+		}
+		up(PIPE_SEM(*pipe));
+		/* Readers waited for the head even if nothing went out */
+		wake_up_interruptible(PIPE_WAIT(*pipe));
+		if (ret <= 0)
+			break;
+
+		total += ret;
+		len -= ret;
+		if (ret < chars)
+			break;
+	}
+
+	return total ? total : ret;
+}
+
+static long do_splice(struct file *in, loff_t *off_in, struct file *out,
+		      loff_t *off_out, size_t len, unsigned int flags)
+{
+	struct inode *pipe;
+	loff_t offset, *ppos;
+	long ret;
+
+	if ((pipe = splice_pipe(in)) != NULL) {
+		if (off_in)
+			return -ESPIPE;
+		if (splice_pipe(out))
+			return -EINVAL;
+		ppos = &out->f_pos;
+		if (off_out) {
+			if (out->f_op && out->f_op->llseek == no_llseek)
+				return -ESPIPE;
+			if (out->f_flags & O_APPEND)
+				return -EINVAL;
+			if (copy_from_user(&offset, off_out, sizeof(loff_t)))
+				return -EFAULT;
+			ppos = &offset;
+		}
+		ret = splice_from_pipe(pipe, out, ppos, len, flags);
+		if (off_out && copy_to_user(off_out, &offset, sizeof(loff_t)))
+			ret = -EFAULT;
+		return ret;
+	}
+
+	if ((pipe = splice_pipe(out)) != NULL) {
+		if (off_out)
+			return -ESPIPE;
+		ppos = &in->f_pos;
+		if (off_in) {
+			if (in->f_op && in->f_op->llseek == no_llseek)
+				return -ESPIPE;
+			if (copy_from_user(&offset, off_in, sizeof(loff_t)))
+				return -EFAULT;
+			ppos = &offset;
+		}
+		ret = splice_to_pipe(in, ppos, pipe, len, flags);
+		if (off_in && copy_to_user(off_in, &offset, sizeof(loff_t)))
+			ret = -EFAULT;
+		return ret;
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * sys_splice:
+ *	Move up to len bytes from fd_in to fd_out, one of which must be
+ *	a pipe.  The offsets, if given, are used and updated instead of
+ *	the file position of the other one.
+ */
+asmlinkage long sys_splice(int fd_in, loff_t *off_in, int fd_out,
+			   loff_t *off_out, size_t len, unsigned int flags)
+{
+	struct file *in, *out;
+	long error;
+
+	if (!len)
+		return 0;
+
+	error = -EBADF;
+	in = fget(fd_in);
+	if (!in)
+		goto out;
+	out = fget(fd_out);
+	if (!out)
+		goto out_fput_in;
+
+	if ((in->f_mode & FMODE_READ) && (out->f_mode & FMODE_WRITE))
+		error = do_splice(in, off_in, out, off_out, len, flags);
+
+	fput(out);
+out_fput_in:
+	fput(in);
+out:
+	return error;
+}
+
+/*
+ * Give opipe references to the pages at the head of ipipe, up to len
+ * bytes; ipipe keeps them.  Only waits with one pipe locked at a time.
+ */
+static long link_pipe(struct inode *ipipe, struct inode *opipe,
+		      size_t len, unsigned int flags)
+{
+	struct pipe_inode_info *iinfo, *oinfo;
+	long ret;
+	int i;
+
+	for (;;) {
+		if (down_interruptible(PIPE_SEM(*ipipe))) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = splice_wait_data(ipipe, flags);
+		if (!ret && PIPE_EMPTY(*ipipe))
+			ret = 1;	/* end of file */
+		up(PIPE_SEM(*ipipe));
+		if (ret) {
+			if (ret > 0)
+				ret = 0;
+			break;
+		}
+
+		if (down_interruptible(PIPE_SEM(*opipe))) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = splice_wait_space(opipe, flags);
+		up(PIPE_SEM(*opipe));
+		if (ret)
+			break;
+
+		double_down(PIPE_SEM(*ipipe), PIPE_SEM(*opipe));
+		iinfo = ipipe->i_pipe;
+		oinfo = opipe->i_pipe;
+		ret = 0;
+		for (i = 0; i < iinfo->nrbufs && len; i++) {
+			struct pipe_buffer *ibuf, *obuf;
+
+			if (PIPE_FULL(*opipe))
+				break;
+			ibuf = iinfo->bufs + ((iinfo->curbuf + i) & (PIPE_BUFFERS - 1));
+			obuf = oinfo->bufs + ((oinfo->curbuf + oinfo->nrbufs) & (PIPE_BUFFERS - 1));
+			page_cache_get(ibuf->page);
+			*obuf = *ibuf;
+			if (obuf->len > len)
+				obuf->len = len;
+			oinfo->nrbufs++;
+			ret += obuf->len;
+			len -= obuf->len;
+		}
+		double_up(PIPE_SEM(*ipipe), PIPE_SEM(*opipe));
+
+		/* Someone else may have emptied one pipe or filled the other */
+		if (ret) {
+			wake_up_interruptible(PIPE_WAIT(*opipe));
+			break;
+		}
+		if (flags & SPLICE_F_NONBLOCK) {
+			ret = -EAGAIN;
+			break;
+		}
+	}
+	return ret;
+}
+
+/*
+ * sys_tee:
+ *	Copy up to len bytes from the pipe fdin to the pipe fdout,
+ *	without consuming them: they can still be read, or spliced,
+ *	from fdin.
+ */
+asmlinkage long sys_tee(int fdin, int fdout, size_t len, unsigned int flags)
+{
+	struct file *in, *out;
+	struct inode *ipipe, *opipe;
+	long error;
+
+	if (!len)
+		return 0;
+
+	error = -EBADF;
+	in = fget(fdin);
+	if (!in)
+		goto out;
+	out = fget(fdout);
+	if (!out)
+		goto out_fput_in;
+
+	if ((in->f_mode & FMODE_READ) && (out->f_mode & FMODE_WRITE)) {
+		ipipe = splice_pipe(in);
+		opipe = splice_pipe(out);
+		error = -EINVAL;
+		if (ipipe && opipe && ipipe != opipe)
+			error = link_pipe(ipipe, opipe, len, flags);
+	}
+
+	fput(out);
+out_fput_in:
+	fput(in);
+out:
+	return error;
+}
@@ -156,6 +156,7 @@ __asm__ __volatile__("wmb": : :"memory")
 #define smp_mb()	mb()
 #define smp_rmb()	rmb()
 #define smp_wmb()	wmb()
+#define smp_read_barrier_depends()	mb()
 #else
 #define smp_mb()	barrier()
 #define smp_rmb()	barrier()
@@ -149,6 +149,24 @@ static inline void * ioremap_nocache (unsigned long offset, unsigned long size)
         return __ioremap(offset, size, _PAGE_PCD);
 }
 
+/**
+ *	ioremap_wc		-	map bus memory into CPU space write-combined
+ *	@offset:	bus address of the memory
+ *	@size:		size of the resource to map
+ *
+ *	ioremap_wc maps the memory write-combining through the page
+ *	attribute table, so stores to it can be buffered and burst out
+ *	without using up a variable MTRR.  Reads are uncached.  Only use
+ *	it for memory that has no side effects, like a framebuffer; on
+ *	CPUs without a PAT it is equivalent to ioremap_nocache unless an
+ *	MTRR makes the range write-combining.
+ */
+ 
+static inline void * ioremap_wc (unsigned long offset, unsigned long size)
+{
+	return __ioremap(offset, size, _PAGE_CACHE_WC);
+}
+
 extern void iounmap(void *addr);
 
 /*
@@ -358,6 +358,18 @@ static inline pte_t pte_modify(pte_t pte, pgprot_t newprot)
 struct page;
 int change_page_attr(struct page *, int, pgprot_t prot);
 
+/*
+ * Write-combining: pat_init() points PAT entry 1 (PWT alone) at WC.
+ * Without a PAT we fall back to PCD, which still lets a WC MTRR
+ * covering the range take effect.
+ */
+extern int pat_wc_enabled;
+extern void pat_init(void);
+
+#define _PAGE_CACHE_WC		(pat_wc_enabled ? _PAGE_PWT : _PAGE_PCD)
+#define pgprot_writecombine(prot) \
+	__pgprot((pgprot_val(prot) & ~(_PAGE_PCD | _PAGE_PWT)) | _PAGE_CACHE_WC)
+
 #endif /* !__ASSEMBLY__ */
 
 /* Needs to be defined here and not in linux/mm.h, as it is arch dependent */
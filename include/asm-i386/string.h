@@ -315,13 +315,25 @@ static __inline__ void *__memcpy3d(void *to, const void *from, size_t len)
 #else
 
 /*
- *	No 3D Now!
+ *	No 3D Now!  Copies bigger than the cache use SSE2 streaming
+ *	stores when the boot time calibration found them faster,
+ *	see arch/i386/lib/sse2copy.c.
  */
- 
+
+extern unsigned long sse2_copy_threshold;
+extern void *_sse2_memcpy(void *to, const void *from, size_t len);
+
+static __inline__ void *__memcpy_sse2(void *to, const void *from, size_t len)
+{
+	if (len < sse2_copy_threshold)
+		return __memcpy(to, from, len);
+	return _sse2_memcpy(to, from, len);
+}
+
 #define memcpy(t, f, n) \
 (__builtin_constant_p(n) ? \
  __constant_memcpy((t),(f),(n)) : \
- __memcpy((t),(f),(n)))
+ __memcpy_sse2((t),(f),(n)))
 
 #endif
 
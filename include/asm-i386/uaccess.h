@@ -662,6 +662,30 @@ do {								\
 unsigned long __generic_copy_to_user(void *, const void *, unsigned long);
 unsigned long __generic_copy_from_user(void *, const void *, unsigned long);
 
+/*
+ * Streaming (cache bypassing) copies, see arch/i386/lib/sse2copy.c.
+ * They are used for single copies of sse2_copy_threshold bytes or more,
+ * and by the _nocache variants below.
+ */
+extern unsigned long sse2_copy_threshold;
+unsigned long __sse2_copy_to_user(void *, const void *, unsigned long);
+unsigned long __sse2_copy_from_user(void *, const void *, unsigned long);
+
+/*
+ * For a copy that is one piece of a transfer of "total" bytes, such as
+ * one page of a big read(): stream it if the transfer as a whole is
+ * big enough to flush the cache.
+ */
+#define __copy_to_user_nocache(to,from,n,total)			\
+	((total) >= sse2_copy_threshold ?				\
+	 __sse2_copy_to_user((to),(from),(n)) :				\
+	 __copy_to_user((to),(from),(n)))
+
+#define __copy_from_user_nocache(to,from,n,total)		\
+	((total) >= sse2_copy_threshold ?				\
+	 __sse2_copy_from_user((to),(from),(n)) :			\
+	 __copy_from_user((to),(from),(n)))
+
 static inline unsigned long
 __constant_copy_to_user(void *to, const void *from, unsigned long n)
 {
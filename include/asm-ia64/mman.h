@@ -27,6 +27,8 @@
 #define MAP_NORESERVE	0x4000		/* don't check for reservations */
 #define MAP_WRITECOMBINED 0x10000	/* write-combine the area */
 #define MAP_NONCACHED	0x20000		/* don't cache the memory */
+#define MAP_POPULATE	0x8000		/* populate (prefault) pagetables */
+#define MAP_NONBLOCK	0x40000		/* do not block on IO */
 
 #define MS_ASYNC	1		/* sync memory asynchronously */
 #define MS_INVALIDATE	2		/* invalidate the caches */
@@ -0,0 +1,85 @@
+#ifndef __LINUX__AIO_H
+#define __LINUX__AIO_H
+
+#include <linux/list.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/tqueue.h>
+#include <linux/aio_abi.h>
+
+#include <asm/atomic.h>
+
+struct mm_struct;
+struct kiobuf;
+struct page;
+struct file;
+
+#define AIO_RING_MAGIC			0xa10a10a1
+#define AIO_RING_COMPAT_FEATURES	1
+#define AIO_RING_INCOMPAT_FEATURES	0
+
+/*
+ * The completion ring as user space sees it.  The kernel only ever
+ * moves tail, user space (or io_getevents) moves head.
+ */
+struct aio_ring {
+	unsigned	id;	/* kernel internal index number */
+	unsigned	nr;	/* number of io_events */
+	unsigned	head;
+	unsigned	tail;
+
+	unsigned	magic;
+	unsigned	compat_features;
+	unsigned	incompat_features;
+	unsigned	header_length;	/* size of aio_ring */
+
+	struct io_event	io_events[0];
+};
+
+struct kioctx {
+	atomic_t		users;
+	int			dead;
+	unsigned long		user_id;	/* the ring's address */
+	struct kioctx		*next;		/* mm->ioctx_list */
+
+	wait_queue_head_t	wait;		/* for events, and io_destroy() */
+
+	spinlock_t		ctx_lock;	/* active_reqs and the ring */
+	int			reqs_active;
+	struct list_head	active_reqs;
+
+	unsigned		max_reqs;	/* what io_setup() was asked for */
+	unsigned		nr;		/* events the ring holds */
+	unsigned		tail;
+	unsigned long		mmap_size;
+	int			nr_pages;
+	struct page		**ring_pages;
+};
+
+struct kiocb {
+	struct list_head	ki_list;	/* ctx->active_reqs */
+	struct kioctx		*ki_ctx;
+	struct file		*ki_filp;
+	struct iocb		*ki_user_obj;	/* the iocb in user space */
+	__u64			ki_user_data;
+
+	/* I/O that completes through a kiobuf, see aio_kiobuf_map() */
+	int			ki_rw;
+	struct kiobuf		*ki_iobuf;
+	ssize_t			ki_res;
+	void			(*ki_done)(struct kiocb *);
+	struct tq_struct	ki_tq;
+};
+
+/* fs/aio.c */
+extern int aio_nr;
+extern int aio_max_nr;
+
+extern void aio_complete(struct kiocb *iocb, long res, long res2);
+extern int aio_kiobuf_map(struct kiocb *iocb, int rw, char *buf, size_t len,
+			  void (*done)(struct kiocb *));
+extern void aio_kiobuf_submitted(struct kiocb *iocb, ssize_t res);
+extern void aio_kiobuf_cancel(struct kiocb *iocb);
+extern void exit_aio(struct mm_struct *mm);
+
+#endif /* __LINUX__AIO_H */
@@ -0,0 +1,53 @@
+#ifndef _LINUX_BIO_H
+#define _LINUX_BIO_H
+
+/*
+ * A bio describes one piece of block I/O: a vector of page ranges to be
+ * read from or written to consecutive sectors of a device.  submit_bio()
+ * queues the whole thing as one request where the queue limits allow,
+ * instead of going through the elevator once per block and merging the
+ * blocks back together.
+ *
+ * Drivers still get buffer_heads.  Every vector entry is backed by one
+ * of the bio's own, which is also what goes to queues with their own
+ * make_request function (md, LVM, loop...), one at a time.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+
+#define BIO_MAX_VECS	16
+
+struct bio;
+typedef void (bio_end_io_t)(struct bio *, int);
+
+struct bio_vec {
+	struct page	*bv_page;
+	unsigned int	bv_len;
+	unsigned int	bv_offset;
+};
+
+struct bio {
+	kdev_t		bi_dev;
+	unsigned long	bi_sector;	/* first sector, in 512 byte units */
+	unsigned int	bi_size;	/* bytes, all the vectors together */
+	unsigned short	bi_vcnt;
+	unsigned short	bi_max_vecs;
+	unsigned long	bi_flags;
+	atomic_t	bi_remaining;	/* buffer_heads still under I/O */
+	struct bio	*bi_next;	/* free for the submitter to use */
+	bio_end_io_t	*bi_end_io;
+	void		*bi_private;
+	struct bio_vec	*bi_io_vec;
+	struct buffer_head *bi_bh;	/* one for every vector */
+};
+
+/* bi_flags */
+#define BIO_UPTODATE	0	/* no errors so far */
+
+extern struct bio *bio_alloc(int gfp_mask, int nr_vecs);
+extern void bio_put(struct bio *);
+extern int bio_add_page(struct bio *, struct page *, unsigned int, unsigned int);
+extern void submit_bio(int, struct bio *);
+
+#endif /* _LINUX_BIO_H */
@@ -9,7 +9,7 @@
 /*
  * Spinlock for protecting the request queue which
  * is mucked around with in interrupts on potentially
- * multiple CPU's..
+ * multiple CPU's..  This is the default: see blk_queue_lock().
  */
 extern spinlock_t io_request_lock;
 
@@ -87,6 +87,7 @@ void initrd_init(void);
 static inline void blkdev_dequeue_request(struct request * req)
 {
 	list_del(&req->queue);
+	elevator_fifo_del(req);
 }
 
 int end_that_request_first(struct request *req, int uptodate, char *name);
@@ -22,6 +22,7 @@ typedef struct elevator_s elevator_t;
 struct request {
 	struct list_head queue;
 	int elevator_sequence;
+	struct list_head fifo;	/* deadline elevator, by arrival */
 
 	volatile int rq_status;	/* should split this into a few status bits */
 #define RQ_INACTIVE		(-1)
@@ -147,10 +148,11 @@ struct request_queue
 	unsigned long		bounce_pfn;
 
 	/*
-	 * Is meant to protect the queue in the future instead of
-	 * io_request_lock
+	 * Protects the queue, and is held when request_fn is called:
+	 * io_request_lock, unless the driver has set up another one
+	 * with blk_queue_lock()
 	 */
-	spinlock_t		queue_lock;
+	spinlock_t		* queue_lock;
 
 	/*
 	 * Tasks wait here for free read and write requests
@@ -243,8 +245,10 @@ extern int blk_grow_request_list(request_queue_t *q, int nr_requests, int max_qu
 extern void blk_init_queue(request_queue_t *, request_fn_proc *);
 extern void blk_cleanup_queue(request_queue_t *);
 extern void blk_queue_headactive(request_queue_t *, int);
+extern void blk_queue_lock(request_queue_t *, spinlock_t *);
 extern void blk_queue_throttle_sectors(request_queue_t *, int);
 extern void blk_queue_make_request(request_queue_t *, make_request_fn *);
+extern int blk_queue_has_elevator(request_queue_t *);
 extern void generic_unplug_device(void *);
 extern inline int blk_seg_merge_ok(struct buffer_head *, struct buffer_head *);
 
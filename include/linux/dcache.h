@@ -6,6 +6,8 @@
 #include <asm/atomic.h>
 #include <linux/mount.h>
 #include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 
 /*
  * linux/include/linux/dcache.h
@@ -67,10 +69,11 @@ static __inline__ unsigned int full_name_hash(const unsigned char * name, unsign
 struct dentry {
 	atomic_t d_count;
 	unsigned int d_flags;
+	spinlock_t d_lock;		/* per dentry lock */
 	struct inode  * d_inode;	/* Where the name belongs to - NULL is negative */
 	struct dentry * d_parent;	/* parent directory */
-	struct list_head d_hash;	/* lookup hash list */
-	struct list_head d_lru;		/* d_count = 0 LRU list */
+	struct hlist_node d_hash;	/* lookup hash list */
+	struct list_head d_lru;		/* unused LRU list, may hold busy dentries */
 	struct list_head d_child;	/* child of parent list */
 	struct list_head d_subdirs;	/* our children */
 	struct list_head d_alias;	/* inode alias list */
@@ -81,6 +84,7 @@ struct dentry {
 	struct super_block * d_sb;	/* The root of the dentry tree */
 	unsigned long d_vfs_flags;
 	void * d_fsdata;		/* fs-specific data */
+	struct rcu_head d_rcu;		/* deferred free, see d_free() */
 	unsigned char d_iname[DNAME_INLINE_LEN]; /* small names */
 };
 
@@ -102,13 +106,19 @@ struct dentry_operations {
 
 /*
 locking rules:
-		big lock	dcache_lock	may block
-d_revalidate:	no		no		yes
-d_hash		no		no		yes
-d_compare:	no		yes		no
-d_delete:	no		yes		no
-d_release:	no		no		yes
-d_iput:		no		no		yes
+		big lock	dcache_lock	d_lock		may block
+d_revalidate:	no		no		no		yes
+d_hash		no		no		no		yes
+d_compare:	no		no		yes		no
+d_delete:	no		yes		yes		no
+d_release:	no		no		no		yes
+d_iput:		no		no		no		yes
+
+d_lookup() walks the hash chains without dcache_lock; changes to the
+chains are made under dcache_lock, and changes to d_name, d_parent
+and the hashed state also under the dentry's d_lock, which the lookup
+takes to check a candidate and grab a reference.  Freeing is deferred
+until no lookup can still be looking at the dentry.
  */
 
 /* d_flags entries */
@@ -144,11 +154,19 @@ extern spinlock_t dcache_lock;
  * timeouts or autofs deletes).
  */
 
+/* Called with dcache_lock and dentry->d_lock held */
+static __inline__ void __d_drop(struct dentry * dentry)
+{
+	if (!hlist_unhashed(&dentry->d_hash))
+		hlist_del_rcu(&dentry->d_hash);
+}
+
 static __inline__ void d_drop(struct dentry * dentry)
 {
 	spin_lock(&dcache_lock);
-	list_del(&dentry->d_hash);
-	INIT_LIST_HEAD(&dentry->d_hash);
+	spin_lock(&dentry->d_lock);
+	__d_drop(dentry);
+	spin_unlock(&dentry->d_lock);
 	spin_unlock(&dcache_lock);
 }
 
@@ -262,7 +280,7 @@ extern struct dentry * dget_locked(struct dentry *);
  
 static __inline__ int d_unhashed(struct dentry *dentry)
 {
-	return list_empty(&dentry->d_hash);
+	return hlist_unhashed(&dentry->d_hash);
 }
 
 extern void dput(struct dentry *);
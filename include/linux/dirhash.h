@@ -0,0 +1,22 @@
+/*
+ * dirhash.h
+ * Directory name hashes of the ext2/ext3 hash tree index;
+ * see linux/lib/dirhash.c
+ */
+#ifndef _LINUX_DIRHASH_H
+#define _LINUX_DIRHASH_H
+
+#include <linux/types.h>
+
+/* Legal values for the dx_root hash_version field: */
+#define DX_HASH_LEGACY		0
+#define DX_HASH_HALF_MD4	1
+#define DX_HASH_TEA		2
+
+/* No name hashes to this; ext3 keeps it for its end-of-directory f_pos */
+#define DX_HASH_EOF		0x7fffffff
+
+extern int dx_hash_name(const char *name, int len, int hash_version,
+			__u32 *seed, __u32 *hashp, __u32 *minorp);
+
+#endif /* _LINUX_DIRHASH_H */
@@ -12,6 +12,10 @@ typedef void (elevator_merge_cleanup_fn) (request_queue_t *, struct request *, i
 
 typedef void (elevator_merge_req_fn) (struct request *, struct request *);
 
+typedef int (elevator_add_req_fn) (request_queue_t *, struct request *);
+
+typedef void (elevator_completed_req_fn) (request_queue_t *, struct request *);
+
 struct elevator_s
 {
 	int read_latency;
@@ -19,8 +23,23 @@ struct elevator_s
 
 	elevator_merge_fn *elevator_merge_fn;
 	elevator_merge_req_fn *elevator_merge_req_fn;
+	elevator_add_req_fn *elevator_add_req_fn;
+	elevator_completed_req_fn *elevator_completed_req_fn;
 
+	const char *elevator_name;
 	unsigned int queue_ID;
+
+	/*
+	 * Only used by the deadline and anticipatory elevators: the
+	 * queued requests in order of arrival, and the idling state.
+	 */
+	struct list_head fifo[2];
+	struct timer_list antic_timer;
+	int antic_status;
+	int antic_score;
+	kdev_t antic_dev;
+	unsigned long antic_sector;
+	unsigned long antic_stamp;
 };
 
 int elevator_noop_merge(request_queue_t *, struct request **, struct list_head *, struct buffer_head *, int, int);
@@ -31,6 +50,13 @@ int elevator_linus_merge(request_queue_t *, struct request **, struct list_head
 void elevator_linus_merge_cleanup(request_queue_t *, struct request *, int);
 void elevator_linus_merge_req(struct request *, struct request *);
 
+int elevator_deadline_merge(request_queue_t *, struct request **, struct list_head *, struct buffer_head *, int, int);
+int elevator_deadline_add_req(request_queue_t *, struct request *);
+void elevator_deadline_completed_req(request_queue_t *, struct request *);
+
+int elevator_antic_add_req(request_queue_t *, struct request *);
+void elevator_antic_completed_req(request_queue_t *, struct request *);
+
 typedef struct blkelv_ioctl_arg_s {
 	int queue_ID;
 	int read_latency;
@@ -41,10 +67,32 @@ typedef struct blkelv_ioctl_arg_s {
 #define BLKELVGET   _IOR(0x12,106,sizeof(blkelv_ioctl_arg_t))
 #define BLKELVSET   _IOW(0x12,107,sizeof(blkelv_ioctl_arg_t))
 
+#define ELV_NAME_MAX	16
+
+/* 0x12,115 and 116: take or return the elevator name, a char[ELV_NAME_MAX] */
+#define BLKELVNAME   _IOR(0x12,115,sizeof(char[ELV_NAME_MAX]))
+#define BLKELVSELECT _IOW(0x12,116,sizeof(char[ELV_NAME_MAX]))
+
 extern int blkelvget_ioctl(elevator_t *, blkelv_ioctl_arg_t *);
 extern int blkelvset_ioctl(elevator_t *, const blkelv_ioctl_arg_t *);
+extern int blkelvname_ioctl(elevator_t *, char *);
+extern int blkelvselect_ioctl(request_queue_t *, const char *);
 
 extern void elevator_init(elevator_t *, elevator_t);
+extern void elevator_exit(elevator_t *);
+extern elevator_t elevator_default(void);
+extern int elevator_select(request_queue_t *, const char *);
+
+/*
+ * Requests get on the fifo lists in add_request(), and off them again
+ * in blkdev_dequeue_request() or when they are freed.  Requests that
+ * did not come from get_request() have a zeroed entry.
+ */
+static inline void elevator_fifo_del(struct request *rq)
+{
+	if (rq->fifo.next)
+		list_del_init(&rq->fifo);
+}
 
 /*
  * Return values from elevator merger
@@ -89,6 +137,9 @@ static inline int elevator_request_latency(elevator_t * elevator, int rw)
 									\
 	elevator_noop_merge,		/* elevator_merge_fn */		\
 	elevator_noop_merge_req,	/* elevator_merge_req_fn */	\
+	NULL,				/* elevator_add_req_fn */	\
+	NULL,				/* elevator_completed_req_fn */	\
+	"noop",				/* elevator_name */		\
 	})
 
 #define ELEVATOR_LINUS							\
@@ -98,6 +149,44 @@ static inline int elevator_request_latency(elevator_t * elevator, int rw)
 									\
 	elevator_linus_merge,		/* elevator_merge_fn */		\
 	elevator_linus_merge_req,	/* elevator_merge_req_fn */	\
+	NULL,				/* elevator_add_req_fn */	\
+	NULL,				/* elevator_completed_req_fn */	\
+	"linus",			/* elevator_name */		\
+	})
+
+/*
+ * The deadline elevator keeps reads sorted in front of writes, and
+ * moves a request to the head of the queue once it has waited longer
+ * than its expiry time.  read_latency and write_latency are those
+ * times in milliseconds.
+ */
+#define ELEVATOR_DEADLINE						\
+((elevator_t) {								\
+	500,				/* read expiry, ms */		\
+	5000,				/* write expiry, ms */		\
+									\
+	elevator_deadline_merge,	/* elevator_merge_fn */		\
+	elevator_noop_merge_req,	/* elevator_merge_req_fn */	\
+	elevator_deadline_add_req,	/* elevator_add_req_fn */	\
+	elevator_deadline_completed_req, /* elevator_completed_req_fn */ \
+	"deadline",			/* elevator_name */		\
+	})
+
+/*
+ * The anticipatory elevator is the deadline elevator, except that
+ * after a read it holds the queue plugged for a moment in case the
+ * same reader comes back with another read close by.
+ */
+#define ELEVATOR_ANTICIPATORY						\
+((elevator_t) {								\
+	250,				/* read expiry, ms */		\
+	5000,				/* write expiry, ms */		\
+									\
+	elevator_deadline_merge,	/* elevator_merge_fn */		\
+	elevator_noop_merge_req,	/* elevator_merge_req_fn */	\
+	elevator_antic_add_req,		/* elevator_add_req_fn */	\
+	elevator_antic_completed_req,	/* elevator_completed_req_fn */	\
+	"anticipatory",			/* elevator_name */		\
 	})
 
 #endif
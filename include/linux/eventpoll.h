@@ -0,0 +1,65 @@
+/*
+ *  include/linux/eventpoll.h
+ *
+ *  epoll: a set of file descriptors to watch, kept in the kernel
+ *  between calls.  epoll_ctl() changes the set, and epoll_wait() only
+ *  ever looks at the files that have signalled an event, however many
+ *  more are in the set.
+ *
+ *  The events are the poll() ones.  By default a file is reported for
+ *  as long as it is ready (level triggered); with EPOLLET it is
+ *  reported once each time it becomes ready (edge triggered).
+ */
+
+#ifndef _LINUX_EVENTPOLL_H
+#define _LINUX_EVENTPOLL_H
+
+#include <asm/types.h>
+
+/* epoll_ctl() operations */
+#define EPOLL_CTL_ADD	1
+#define EPOLL_CTL_DEL	2
+#define EPOLL_CTL_MOD	3
+
+/* edge triggered, in addition to the POLL* bits */
+#define EPOLLET		(1 << 31)
+
+#ifdef __x86_64__
+#define EPOLL_PACKED __attribute__((packed))
+#else
+#define EPOLL_PACKED
+#endif
+
+struct epoll_event {
+	__u32 events;
+	__u64 data;
+} EPOLL_PACKED;
+
+#ifdef __KERNEL__
+
+#include <linux/fs.h>
+
+/* Called when a file structure is set up */
+static inline void eventpoll_init_file(struct file *file)
+{
+	INIT_LIST_HEAD(&file->f_ep_links);
+	spin_lock_init(&file->f_ep_lock);
+}
+
+extern void eventpoll_release_file(struct file *file);
+
+/*
+ * Called on the last fput() of a file, to take it out of the epoll
+ * sets it is in.  Most files never are, so check that without
+ * locking: nobody can add the file to a set once its count is zero.
+ */
+static inline void eventpoll_release(struct file *file)
+{
+	if (list_empty(&file->f_ep_links))
+		return;
+	eventpoll_release_file(file);
+}
+
+#endif /* __KERNEL__ */
+
+#endif /* _LINUX_EVENTPOLL_H */
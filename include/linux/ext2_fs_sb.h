@@ -56,6 +56,8 @@ struct ext2_sb_info {
 	int s_desc_per_block_bits;
 	int s_inode_size;
 	int s_first_ino;
+	u32 s_hash_seed[4];
+	int s_def_hash_version;
 };
 
 #endif	/* _LINUX_EXT2_FS_SB */
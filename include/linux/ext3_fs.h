@@ -33,6 +33,14 @@
 #undef  EXT3_PREALLOCATE /* @@@ Fix this! */
 #define EXT3_DEFAULT_PREALLOC_BLOCKS	8
 
+/*
+ * Reservation windows: free blocks claimed in memory ahead of each
+ * writer.  A window starting at block 0 is no window at all.
+ */
+#define EXT3_DEFAULT_RESERVE_BLOCKS	8
+#define EXT3_MAX_RESERVE_BLOCKS		1027
+#define EXT3_RESERVE_WINDOW_NOT_ALLOCATED 0
+
 /*
  * The second extended file system version
  */
@@ -221,6 +229,8 @@ struct ext3_group_desc
 #define	EXT3_IOC_SETFLAGS		_IOW('f', 2, long)
 #define	EXT3_IOC_GETVERSION		_IOR('f', 3, long)
 #define	EXT3_IOC_SETVERSION		_IOW('f', 4, long)
+#define	EXT3_IOC_GETRSVSZ		_IOR('f', 5, long)
+#define	EXT3_IOC_SETRSVSZ		_IOW('f', 6, long)
 #define	EXT3_IOC_GETVERSION_OLD		_IOR('v', 1, long)
 #define	EXT3_IOC_SETVERSION_OLD		_IOW('v', 2, long)
 #ifdef CONFIG_JBD_DEBUG
@@ -339,6 +349,7 @@ struct ext3_inode {
   #define EXT3_MOUNT_WRITEBACK_DATA	0x0C00	/* No data ordering */
 #define EXT3_MOUNT_UPDATE_JOURNAL	0x1000	/* Update the journal format */
 #define EXT3_MOUNT_NO_UID32		0x2000  /* Disable 32-bit UIDs */
+#define EXT3_MOUNT_RESERVATION		0x4000	/* Reservation windows for files */
 
 /* Compatibility, for having both ext2_fs.h and ext3_fs.h included at once */
 #ifndef _LINUX_EXT2_FS_H
@@ -594,7 +605,64 @@ struct ext3_dir_entry_2 {
 #define EXT3_DIR_REC_LEN(name_len)	(((name_len) + 8 + EXT3_DIR_ROUND) & \
 					 ~EXT3_DIR_ROUND)
 
+/*
+ * Hash tree directory indexing.  An indexed directory keeps its first
+ * block as a dx_root: "." and "..", then a small tree of (hash, block)
+ * pairs pointing at ordinary directory blocks holding the names whose
+ * hash falls in that range.  Old kernels see plain directory blocks
+ * with an empty entry covering the index, so the format stays
+ * compatible.
+ */
+
+#ifdef __KERNEL__
+#define is_dx(dir) (EXT3_HAS_COMPAT_FEATURE(dir->i_sb, \
+				      EXT3_FEATURE_COMPAT_DIR_INDEX) && \
+		    (EXT3_I(dir)->i_flags & EXT3_INDEX_FL))
+
+/*
+ * A directory changed by a kernel which cannot keep its index up to
+ * date must not claim to have one.
+ */
+static inline void ext3_update_dx_flag(struct inode *inode)
+{
+	if (!EXT3_HAS_COMPAT_FEATURE(inode->i_sb,
+				     EXT3_FEATURE_COMPAT_DIR_INDEX))
+		EXT3_I(inode)->i_flags &= ~EXT3_INDEX_FL;
+}
+#endif
+
 #ifdef __KERNEL__
+#include <linux/dirhash.h>
+
+/* hash info structure used by the directory hash */
+struct dx_hash_info
+{
+	u32		hash;
+	u32		minor_hash;
+	int		hash_version;
+	u32		*seed;
+};
+
+static inline int ext3fs_dirhash(const char *name, int len,
+				 struct dx_hash_info *hinfo)
+{
+	return dx_hash_name(name, len, hinfo->hash_version, hinfo->seed,
+			    &hinfo->hash, &hinfo->minor_hash);
+}
+
+#define EXT3_HTREE_EOF	DX_HASH_EOF
+
+/*
+ * Control parameters used by ext3_htree_next_block
+ */
+#define HASH_NB_ALWAYS		1
+
+/*
+ * Returned by the index code when an index block does not check out;
+ * callers fall back to treating the directory as a linear one.
+ */
+#define ERR_BAD_DX_DIR	-75000
+
 /*
  * Describe an inode's exact location on disk and in memory
  */
@@ -629,8 +697,12 @@ extern void ext3_check_blocks_bitmap (struct super_block *);
 extern struct ext3_group_desc * ext3_get_group_desc(struct super_block * sb,
 						    unsigned int block_group,
 						    struct buffer_head ** bh);
+extern void ext3_discard_reservation (struct inode *);
 
 /* dir.c */
+extern int ext3_htree_store_dirent(struct file *dir_file, __u32 hash,
+				   __u32 minor_hash,
+				   struct ext3_dir_entry_2 *dirent);
 extern int ext3_check_dir_entry(const char *, struct inode *,
 				struct ext3_dir_entry_2 *, struct buffer_head *,
 				unsigned long);
@@ -655,6 +727,7 @@ extern void ext3_write_inode (struct inode *, int);
 extern int  ext3_setattr (struct dentry *, struct iattr *);
 extern void ext3_put_inode (struct inode *);
 extern void ext3_delete_inode (struct inode *);
+extern void ext3_clear_inode (struct inode *);
 extern int  ext3_sync_inode (handle_t *, struct inode *);
 extern void ext3_discard_prealloc (struct inode *);
 extern void ext3_dirty_inode(struct inode *);
@@ -669,6 +742,8 @@ extern int ext3_ioctl (struct inode *, struct file *, unsigned int,
 /* namei.c */
 extern int ext3_orphan_add(handle_t *, struct inode *);
 extern int ext3_orphan_del(handle_t *, struct inode *);
+extern int ext3_htree_fill_tree(struct file *dir_file, __u32 start_hash,
+				__u32 start_minor_hash, __u32 *next_hash);
 
 /* super.c */
 extern void ext3_error (struct super_block *, const char *, const char *, ...)
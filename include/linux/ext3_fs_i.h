@@ -17,6 +17,20 @@
 #define _LINUX_EXT3_FS_I
 
 #include <linux/rwsem.h>
+#include <linux/rbtree.h>
+
+/*
+ * A reservation window: blocks ahead of a file's writer which other
+ * reserving writers keep out of, so that files appended to side by
+ * side each get contiguous runs.  In memory only; see balloc.c.
+ */
+struct ext3_reserve_window {
+	rb_node_t	rsv_node;	/* in the per-fs tree, by start */
+	__u32		rsv_start;	/* first block of the window */
+	__u32		rsv_end;	/* last block of the window */
+	__u32		rsv_goal_size;	/* blocks to reserve, 0 for none */
+	__u32		rsv_alloc_hit;	/* blocks allocated in the window */
+};
 
 /*
  * second extended file system inode data in memory
@@ -42,6 +56,7 @@ struct ext3_inode_info {
 	__u32	i_prealloc_count;
 #endif
 	__u32	i_dir_start_lookup;
+	struct ext3_reserve_window i_rsv_window;	/* s_rsv_window_lock */
 	
 	struct list_head i_orphan;	/* unlinked but open inodes */
 
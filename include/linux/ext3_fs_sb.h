@@ -19,6 +19,7 @@
 #ifdef __KERNEL__
 #include <linux/timer.h>
 #include <linux/wait.h>
+#include <linux/rbtree.h>
 #endif
 
 /*
@@ -62,6 +63,11 @@ struct ext3_sb_info {
 	int s_inode_size;
 	int s_first_ino;
 	u32 s_next_generation;
+	u32 s_hash_seed[4];
+	int s_def_hash_version;
+	unsigned long s_rsv_goal_size;	/* Default reservation window size */
+	spinlock_t s_rsv_window_lock;	/* Guards the windows and their tree */
+	rb_root_t s_rsv_window_root;	/* Reservation windows */
 
 	/* Journaling */
 	struct inode * s_journal_inode;
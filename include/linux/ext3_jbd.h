@@ -40,6 +40,12 @@
 
 extern int ext3_writepage_trans_blocks(struct inode *inode);
 
+/* A directory insert which splits the hash index can touch the root,
+ * an index node, a new index node, the old and new leaves, and the
+ * bitmaps and indirect blocks to allocate the new ones. */
+
+#define EXT3_INDEX_EXTRA_TRANS_BLOCKS	8
+
 /* Delete operations potentially hit one directory's namespace plus an
  * entire inode, plus arbitrary amounts of bitmap/indirection data.  Be
  * generous.  We can grow the delete transaction later if necessary. */
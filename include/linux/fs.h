@@ -26,6 +26,7 @@
 #include <asm/bitops.h>
 
 struct poll_table_struct;
+struct kiocb;
 
 
 /*
@@ -190,6 +191,7 @@ extern int leases_enable, dir_notify_enable, lease_break_time;
 #define BLKBSZGET  _IOR(0x12,112,sizeof(int))
 #define BLKBSZSET  _IOW(0x12,113,sizeof(int))
 #define BLKGETSIZE64 _IOR(0x12,114,sizeof(u64))	/* return device size in bytes (u64 *arg) */
+/* 115 and 116 are BLKELVNAME and BLKELVSELECT, see elevator.h */
 
 #define BMAP_IOCTL 1		/* obsolete - kept for compatibility */
 #define FIBMAP	   _IO(0x00,1)	/* bmap access */
@@ -250,6 +252,7 @@ struct buffer_head {
 	unsigned short b_size;		/* block size */
 	unsigned short b_list;		/* List that this buffer appears */
 	kdev_t b_dev;			/* device (B_FREE = free) */
+	unsigned short b_flushq;	/* queue of the LRU lists it is on */
 
 	atomic_t b_count;		/* users using this block */
 	kdev_t b_rdev;			/* Real device */
@@ -483,6 +486,7 @@ struct inode {
 	struct dnotify_struct	*i_dnotify; /* for directory notifications */
 
 	unsigned long		i_state;
+	unsigned long		i_dirtied_when;	/* jiffies of first dirtying */
 
 	unsigned int		i_flags;
 	unsigned char		i_sock;
@@ -584,6 +588,10 @@ struct file {
 	/* preallocated helper kiobuf to speedup O_DIRECT */
 	struct kiobuf		*f_iobuf;
 	long			f_iobuf_lock;
+
+	/* epoll sets this file is in, see fs/eventpoll.c */
+	struct list_head	f_ep_links;
+	spinlock_t		f_ep_lock;
 };
 extern spinlock_t files_lock;
 #define file_list_lock() spin_lock(&files_lock);
@@ -876,6 +884,14 @@ struct file_operations {
 	ssize_t (*writev) (struct file *, const struct iovec *, unsigned long, loff_t *);
 	ssize_t (*sendpage) (struct file *, struct page *, int, size_t, loff_t *, int);
 	unsigned long (*get_unmapped_area)(struct file *, unsigned long, unsigned long, unsigned long, unsigned long);
+	/*
+	 * Start an io_submit() read or write at the given offset and return
+	 * -EIOCBQUEUED if it will finish through aio_complete(), or its
+	 * result if it is already done.  -ENOTBLK makes fs/aio.c do it
+	 * with plain read or write instead.
+	 */
+	ssize_t (*aio_read) (struct kiocb *, char *, size_t, loff_t);
+	ssize_t (*aio_write) (struct kiocb *, const char *, size_t, loff_t);
 };
 
 struct inode_operations {
@@ -1260,7 +1276,7 @@ static inline void mark_buffer_dirty_inode(struct buffer_head *bh, struct inode
 
 extern void set_buffer_flushtime(struct buffer_head *);
 extern inline int get_buffer_flushtime(void);
-extern void balance_dirty(void);
+extern void balance_dirty(kdev_t);
 extern int check_disk_change(kdev_t);
 extern int invalidate_inodes(struct super_block *);
 extern int invalidate_device(kdev_t, int);
@@ -1273,6 +1289,7 @@ extern void invalidate_bdev(struct block_device *, int);
 extern void __invalidate_buffers(kdev_t dev, int);
 extern void sync_inodes(kdev_t);
 extern void sync_unlocked_inodes(void);
+extern void sync_old_inodes(int, unsigned long);
 extern void write_inode_now(struct inode *, int);
 extern int sync_buffers(kdev_t, int);
 extern void sync_dev(kdev_t);
@@ -1290,6 +1307,7 @@ static inline int fsync_inode_data_buffers(struct inode *inode)
 	return fsync_buffers_list(&inode->i_dirty_data_buffers);
 }
 extern int inode_has_buffers(struct inode *);
+extern int do_fsync(struct file *, int);
 extern int do_fdatasync(struct file *);
 extern int filemap_fdatawrite(struct address_space *);
 extern int filemap_fdatasync(struct address_space *);
@@ -1490,6 +1508,15 @@ static inline struct buffer_head * sb_get_hash_table(struct super_block *sb, int
 }
 extern void wakeup_bdflush(void);
 extern void wakeup_kupdate(void);
+
+/*
+ * The buffer LRU lists are split up by device into nr_bdflush queues,
+ * and dirty buffers and inodes are written back by one thread per
+ * queue.  Partitions of one disk mostly end up in the same queue.
+ */
+extern int nr_bdflush;
+extern int bdflush_queue(kdev_t dev);
+
 extern void put_unused_buffer_head(struct buffer_head * bh);
 extern struct buffer_head * get_unused_buffer_head(int async);
 extern int block_dump;
@@ -1526,6 +1553,8 @@ extern ssize_t generic_file_read(struct file *, char *, size_t, loff_t *);
 extern inline ssize_t do_generic_direct_read(struct file *, char *, size_t, loff_t *);
 extern int precheck_file_write(struct file *, struct inode *, size_t *, loff_t *);
 extern ssize_t generic_file_write(struct file *, const char *, size_t, loff_t *);
+extern ssize_t generic_file_aio_read(struct kiocb *, char *, size_t, loff_t);
+extern ssize_t generic_file_aio_write(struct kiocb *, const char *, size_t, loff_t);
 extern void do_generic_file_read(struct file *, loff_t *, read_descriptor_t *, read_actor_t);
 extern ssize_t do_generic_file_write(struct file *, const char *, size_t, loff_t *);
 extern ssize_t do_generic_direct_write(struct file *, const char *, size_t, loff_t *);
@@ -58,6 +58,14 @@ struct partition {
 #ifdef __KERNEL__
 #  include <linux/devfs_fs_kernel.h>
 
+/*
+ * Request latency histogram, in /proc/diskstats: slot 0 counts requests
+ * that took under a millisecond, slot n those that took 2^(n-1) to
+ * 2^n - 1 ms, and the last slot everything slower.  Latency is measured
+ * in jiffies, so the slots below one tick stay empty.
+ */
+#define DISK_HIST_SLOTS	14
+
 struct hd_struct {
 	unsigned long start_sect;
 	unsigned long nr_sects;
@@ -81,6 +89,9 @@ struct hd_struct {
 	unsigned int wr_merges;
 	unsigned int wr_ticks;
 	unsigned int wr_sectors;	
+
+	unsigned int rd_hist[DISK_HIST_SLOTS];
+	unsigned int wr_hist[DISK_HIST_SLOTS];
 #endif /* CONFIG_BLK_STATS */
 };
 
@@ -107,6 +118,7 @@ struct gendisk {
 
 /* drivers/block/genhd.c */
 extern struct gendisk *gendisk_head;
+extern unsigned char gendisk_minor_shift[];
 
 extern void add_gendisk(struct gendisk *gp);
 extern void del_gendisk(struct gendisk *gp);
@@ -273,7 +285,9 @@ extern void disk_round_stats(struct hd_struct *hd);
 extern void req_new_io(struct request *req, int merge, int sectors);
 extern void req_merged_io(struct request *req);
 extern void req_finished_io(struct request *req);
+extern void disk_stat_io(struct hd_struct *hd, int rw, int sectors);
 #else
+static inline void disk_stat_io(struct hd_struct *hd, int rw, int sectors) { }
 static inline void req_new_io(struct request *req, int merge, int sectors) { }
 static inline void req_merged_io(struct request *req) { }
 static inline void req_finished_io(struct request *req) { }
@@ -1749,9 +1749,8 @@ extern int ide_set_xfer_rate(ide_drive_t *drive, u8 rate);
 typedef void (*ide_driver_call)(void);
 extern void __init ide_register_driver(ide_driver_call);
 
-/* ide locks for 2.4 */
-
-#define ide_lock		(io_request_lock)
+/* the queue lock of every IDE drive, see ide_do_request() */
+extern spinlock_t ide_lock;
 #define DRIVE_LOCK(drive)       ((drive)->queue.queue_lock)
 
 
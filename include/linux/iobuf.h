@@ -47,9 +47,19 @@ struct kiobuf
 	atomic_t	io_count;	/* IOs still in progress */
 	int		errno;		/* Status of completed IO */
 	void		(*end_io) (struct kiobuf *); /* Completion callback */
+	void		*private;	/* for end_io */
 	wait_queue_head_t wait_queue;
 };
 
+/*
+ * A kiobuf with an end_io callback is asynchronous: brw_kiovec() only
+ * submits the I/O, and end_io is called, possibly from an interrupt,
+ * once io_count drops to zero.  The caller holds one io_count itself
+ * while it submits, so that end_io cannot run before it is done, and
+ * drops it with end_kio_request().  Nobody waits on an asynchronous
+ * kiobuf; end_io may free it.
+ */
+
 
 /* mm/memory.c */
 
@@ -56,6 +56,7 @@ struct loop_device {
 	struct semaphore	lo_ctl_mutex;
 	struct semaphore	lo_bh_mutex;
 	atomic_t		lo_pending;
+	int			lo_threads;	/* workers serving lo_bh */
 };
 
 typedef	int (* transfer_proc_t)(struct loop_device *, int cmd,
@@ -78,6 +79,7 @@ static inline int lo_do_transfer(struct loop_device *lo, int cmd, char *rbuf,
 #define LO_FLAGS_DO_BMAP	1
 #define LO_FLAGS_READ_ONLY	2
 #define LO_FLAGS_BH_REMAP	4
+#define LO_FLAGS_DIRECT_IO	8	/* backing file opened with O_DIRECT */
 
 /* 
  * Note that this structure gets the wrong offsets when directly used
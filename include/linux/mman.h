@@ -6,4 +6,7 @@
 #define MREMAP_MAYMOVE	1
 #define MREMAP_FIXED	2
 
+/* /dev/mem ioctl: make later mmap()s of device memory write-combining */
+#define MEMIOC_WRITE_COMBINE	('M' << 24 | 'E' << 16 | 'M' << 8 | 0x01)
+
 #endif /* _LINUX_MMAN_H */
@@ -58,6 +58,20 @@ nbd_end_request(struct request *req)
 }
 
 #define MAX_NBD 128
+#define NBD_MAX_CONNS 8
+
+/*
+ * One socket to the server.  Requests are sent on it under tx_lock and
+ * wait on queue_head for their reply, which a process sitting in
+ * NBD_DO_IT reads off the same socket in whatever order the server
+ * sends them.
+ */
+struct nbd_conn {
+	struct socket * sock;
+	struct file * file;
+	struct list_head queue_head;	/* Requests sent here, by handle	*/
+	struct semaphore tx_lock;
+};
 
 struct nbd_device {
 	int refcnt;	
@@ -65,12 +79,12 @@ struct nbd_device {
 	int harderror;		/* Code of hard error			*/
 #define NBD_READ_ONLY 0x0001
 #define NBD_WRITE_NOCHK 0x0002
-	struct socket * sock;
-	struct file * file; 		/* If == NULL, device is not ready, yet	*/
 	int magic;			/* FIXME: not if debugging is off	*/
-	spinlock_t queue_lock;
-	struct list_head queue_head;	/* Requests are added here...			*/
-	struct semaphore tx_lock;
+	spinlock_t queue_lock;		/* nr_conns, next_conn, the queues	*/
+	int nr_conns;			/* If == 0, device is not ready, yet	*/
+	int receivers;			/* NBD_DO_IT callers			*/
+	unsigned next_conn;		/* requests go round robin		*/
+	struct nbd_conn conns[NBD_MAX_CONNS];
 };
 #endif
 
@@ -2,28 +2,53 @@
 #define _LINUX_PIPE_FS_I_H
 
 #define PIPEFS_MAGIC 0x50495045
+
+/*
+ * A pipe is a ring of PIPE_BUFFERS page references.  write() copies
+ * into pages of the pipe's own, but splice() can put pages of the page
+ * cache there instead, and tee() can put the same page in two pipes.
+ */
+#define PIPE_BUFFERS	(16)
+
+struct pipe_inode_info;
+
+struct pipe_buffer {
+	struct page *page;
+	unsigned int offset, len;
+	struct pipe_buf_operations *ops;
+};
+
+struct pipe_buf_operations {
+	int can_merge;		/* write() may append to the page */
+	void * (*map)(struct pipe_inode_info *, struct pipe_buffer *);
+	void (*unmap)(struct pipe_inode_info *, struct pipe_buffer *);
+	void (*release)(struct pipe_inode_info *, struct pipe_buffer *);
+};
+
 struct pipe_inode_info {
 	wait_queue_head_t wait;
-	char *base;
-	unsigned int len;
-	unsigned int start;
+	unsigned int nrbufs, curbuf;
+	struct pipe_buffer bufs[PIPE_BUFFERS];
+	struct page *tmp_page;	/* a spare page for the next write */
 	unsigned int readers;
 	unsigned int writers;
 	unsigned int waiting_readers;
 	unsigned int waiting_writers;
 	unsigned int r_counter;
 	unsigned int w_counter;
+	unsigned int reserved;	/* slots splice() is filling */
+	int head_busy;		/* splice() is sending the first buffer */
 };
 
-/* Differs from PIPE_BUF in that PIPE_SIZE is the length of the actual
-   memory allocation, whereas PIPE_BUF makes atomicity guarantees.  */
-#define PIPE_SIZE		PAGE_SIZE
-
+/*
+ * PIPE_SEM guards the ring and is only ever held for a short while.
+ * splice() reads and writes files and sockets with it dropped.  While
+ * it sends the first buffer, head_busy keeps anybody else from taking
+ * it off; while it reads into pages of its own, the slots they go to
+ * are counted in reserved, so the pipe is full to everybody else.
+ */
 #define PIPE_SEM(inode)		(&(inode).i_sem)
 #define PIPE_WAIT(inode)	(&(inode).i_pipe->wait)
-#define PIPE_BASE(inode)	((inode).i_pipe->base)
-#define PIPE_START(inode)	((inode).i_pipe->start)
-#define PIPE_LEN(inode)		((inode).i_pipe->len)
 #define PIPE_READERS(inode)	((inode).i_pipe->readers)
 #define PIPE_WRITERS(inode)	((inode).i_pipe->writers)
 #define PIPE_WAITING_READERS(inode)	((inode).i_pipe->waiting_readers)
@@ -31,16 +56,19 @@ struct pipe_inode_info {
 #define PIPE_RCOUNTER(inode)	((inode).i_pipe->r_counter)
 #define PIPE_WCOUNTER(inode)	((inode).i_pipe->w_counter)
 
-#define PIPE_EMPTY(inode)	(PIPE_LEN(inode) == 0)
-#define PIPE_FULL(inode)	(PIPE_LEN(inode) == PIPE_SIZE)
-#define PIPE_FREE(inode)	(PIPE_SIZE - PIPE_LEN(inode))
-#define PIPE_END(inode)	((PIPE_START(inode) + PIPE_LEN(inode)) & (PIPE_SIZE-1))
-#define PIPE_MAX_RCHUNK(inode)	(PIPE_SIZE - PIPE_START(inode))
-#define PIPE_MAX_WCHUNK(inode)	(PIPE_SIZE - PIPE_END(inode))
+#define PIPE_EMPTY(inode)	((inode).i_pipe->nrbufs == 0)
+#define PIPE_FULL(inode)	((inode).i_pipe->nrbufs + \
+				 (inode).i_pipe->reserved >= PIPE_BUFFERS)
+#define PIPE_HEAD_BUSY(inode)	((inode).i_pipe->head_busy)
 
 /* Drop the inode semaphore and wait for a pipe event, atomically */
 void pipe_wait(struct inode * inode);
 
 struct inode* pipe_new(struct inode* inode);
+void free_pipe_info(struct inode* inode);
+
+/* Pages of the pipe's own, and references to page cache pages */
+extern struct pipe_buf_operations anon_pipe_buf_ops;
+extern struct pipe_buf_operations page_cache_pipe_buf_ops;
 
 #endif
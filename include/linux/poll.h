@@ -11,24 +11,39 @@
 #include <asm/uaccess.h>
 
 struct poll_table_page;
+struct poll_table_struct;
+
+/*
+ * select() and poll() queue the caller on each wait queue a file's
+ * ->poll() hands to poll_wait(); anyone else (epoll) can set qproc to
+ * do it its own way.
+ */
+typedef void (*poll_queue_proc)(struct file *, wait_queue_head_t *,
+				struct poll_table_struct *);
 
 typedef struct poll_table_struct {
 	int error;
 	struct poll_table_page * table;
+	poll_queue_proc qproc;
 } poll_table;
 
 extern void __pollwait(struct file * filp, wait_queue_head_t * wait_address, poll_table *p);
 
 static inline void poll_wait(struct file * filp, wait_queue_head_t * wait_address, poll_table *p)
 {
-	if (p && wait_address)
-		__pollwait(filp, wait_address, p);
+	if (p && wait_address) {
+		if (p->qproc)
+			p->qproc(filp, wait_address, p);
+		else
+			__pollwait(filp, wait_address, p);
+	}
 }
 
 static inline void poll_initwait(poll_table* pt)
 {
 	pt->error = 0;
 	pt->table = NULL;
+	pt->qproc = NULL;
 }
 extern void poll_freewait(poll_table* pt);
 
@@ -77,6 +77,8 @@ extern int md_update_sb (mddev_t *mddev);
 extern int md_do_sync(mddev_t *mddev, mdp_disk_t *spare);
 extern void md_done_sync(mddev_t *mddev, int blocks, int ok);
 extern void md_sync_acct(kdev_t dev, unsigned long nr_sectors);
+extern int sync_page_io(kdev_t dev, unsigned long sector, int size,
+			struct page *page, int rw);
 extern void md_recover_arrays (void);
 extern int md_check_ordering (mddev_t *mddev);
 extern int md_notify_reboot(struct notifier_block *this,
@@ -59,10 +59,56 @@ struct raid1_private_data {
 	md_wait_queue_head_t	wait_done;
 	md_wait_queue_head_t	wait_ready;
 	md_spinlock_t		segment_lock;
+
+	/* write-intent bitmap, NULL if we could not allocate one */
+	struct page		*bitmap_page;	/* header and bits, as on disk */
+	unsigned long		*bitmap;	/* bits known to be on disk */
+	unsigned long		*bitmap_idle;	/* not written since last sweep */
+	unsigned short		*bitmap_count;	/* writes in flight per chunk */
+	int			bitmap_shift;	/* log2 of sectors per chunk */
+	int			bitmap_chunks;
+	int			bitmap_resync;	/* resync only marked chunks */
+	int			bitmap_sweep;	/* set by the timer for raid1d */
+	__u64			bitmap_events;	/* sb events of the disk copy */
+	struct semaphore	bitmap_sem;	/* serialises bitmap writes */
+	md_spinlock_t		bitmap_lock;	/* bitmap_count, bitmap_idle */
+	struct timer_list	bitmap_timer;
 };
 
 typedef struct raid1_private_data raid1_conf_t;
 
+/*
+ * The write-intent bitmap lives in the reserved area of every mirror,
+ * in the 4k following the superblock: a header, then one bit per chunk
+ * of the array.  A chunk's bit is on all mirrors before any write to
+ * the chunk is started, and is cleared again once the chunk has been
+ * idle for a while.  After an unclean shutdown only the chunks still
+ * marked can differ between the mirrors.
+ *
+ * The bitmap is trusted only if its events count matches the
+ * superblock's: a superblock update not followed by a bitmap write
+ * (an older kernel, or a crash in between) forces a full resync.
+ */
+#define RAID1_BITMAP_MAGIC	0x6d746962
+#define RAID1_BITMAP_OFFSET	MD_SB_SECTORS	/* sectors after the sb */
+#define RAID1_BITMAP_BYTES	4096
+#define RAID1_BITMAP_HDR_BYTES	512
+#define RAID1_BITMAP_CHUNKS	((RAID1_BITMAP_BYTES - RAID1_BITMAP_HDR_BYTES) * 8)
+#define RAID1_BITMAP_MIN_SHIFT	7		/* 64k chunks at least */
+
+typedef struct raid1_bitmap_super_s {
+	__u32 magic;		/*  0 RAID1_BITMAP_MAGIC		      */
+	__u32 set_uuid0;	/*  1 copy of the array's uuid		      */
+	__u32 set_uuid1;	/*  2					      */
+	__u32 set_uuid2;	/*  3					      */
+	__u32 set_uuid3;	/*  4					      */
+	__u32 events_lo;	/*  5 superblock events when written	      */
+	__u32 events_hi;	/*  6					      */
+	__u32 chunk_shift;	/*  7 log2 of sectors per chunk		      */
+	__u32 chunks;		/*  8 number of bits in use		      */
+	__u32 reserved[RAID1_BITMAP_HDR_BYTES / 4 - 9];
+} raid1_bitmap_super_t;
+
 /*
  * this is the only point in the RAID code where we violate
  * C type safety. mddev->private is an 'opaque' pointer.
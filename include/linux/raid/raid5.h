@@ -140,6 +140,7 @@ struct stripe_head {
 	atomic_t		count;			/* nr of active thread/requests */
 	spinlock_t		lock;
 	int			sync_redone;
+	unsigned long		delayed_since;		/* jiffies, with STRIPE_BATCHING */
 };
 
 
@@ -160,6 +161,7 @@ struct stripe_head {
 #define	STRIPE_INSYNC		4
 #define	STRIPE_PREREAD_ACTIVE	5
 #define	STRIPE_DELAYED		6
+#define	STRIPE_BATCHING		7
 
 /*
  * Plugging:
@@ -182,6 +184,13 @@ struct stripe_head {
  * In stripe_handle, if we find pre-reading is necessary, we do it if
  * PREREAD_ACTIVE is set, else we set DELAYED which will send it to the delayed queue.
  * HANDLE gets cleared if stripe_handle leave nothing locked.
+ *
+ * Sequential writes fill a stripe one chunk at a time, so an unplug
+ * usually comes long before the rest of the stripe has arrived.  A
+ * delayed stripe therefore stays delayed (BATCHING, since delayed_since)
+ * for up to STRIPE_BATCH_DELAY after it was first delayed, unless
+ * somebody is waiting for a free stripe.  If the last block comes in
+ * meanwhile, the stripe is written without reading anything.
  */
  
 
@@ -223,6 +232,17 @@ struct raid5_private_data {
 
 	int			plugged;
 	struct tq_struct	plug_tq;
+	struct timer_list	delay_timer;	/* activates BATCHING stripes */
+
+	/*
+	 * raid5d and the workers all take stripes off handle_list, so
+	 * parity is computed on as many CPUs as there are stripes ready.
+	 */
+	int			nr_workers;
+	unsigned		next_worker;
+	mdk_thread_t		*workers[NR_CPUS];
+
+	struct list_head	all_confs;	/* for stripe_cache_size */
 };
 
 typedef struct raid5_private_data raid5_conf_t;
@@ -0,0 +1,66 @@
+#ifndef _RAID6_H
+#define _RAID6_H
+
+/*
+ * RAID-6 keeps two syndromes per stripe: P, the plain XOR of the data
+ * blocks as in RAID-5, and Q, a Reed-Solomon syndrome over GF(2^8)
+ * with the generator {02} and the polynomial x^8+x^4+x^3+x^2+1:
+ *
+ *	Q = g^0 * D_0 + g^1 * D_1 + ... + g^(n-1) * D_(n-1)
+ *
+ * Any two blocks of a stripe can be rebuilt from the others.
+ *
+ * The stripe cache and configuration are the RAID-5 ones; Q lives on
+ * the disk after P (raid6_next_disk()), and the data blocks follow Q.
+ */
+
+#include <linux/raid/raid5.h>
+#include <linux/types.h>
+
+typedef raid5_conf_t raid6_conf_t;
+
+/* compute_parity() method: P and Q from what is in the cache */
+#define UPDATE_PARITY		4
+
+static inline int raid6_next_disk(int disk, int raid_disks)
+{
+	disk++;
+	return (disk < raid_disks) ? disk : 0;
+}
+
+/*
+ * A syndrome routine.  ptrs[] holds disks pointers: the data blocks
+ * D_0 .. D_(disks-3), then P and Q, which are overwritten.  bytes is
+ * a multiple of 64.
+ */
+struct raid6_calls {
+	void (*gen_syndrome)(int disks, size_t bytes, void **ptrs);
+	int  (*valid)(void);	/* may be used on this CPU */
+	const char *name;
+	int speed;		/* set by raid6_select_algo() */
+};
+
+/* The one in use */
+extern struct raid6_calls raid6_call;
+
+/* raid6algos.c */
+extern const struct raid6_calls * const raid6_algos[];
+extern int raid6_select_algo(void);
+
+/* Galois field tables, filled in by raid6_init_tables() */
+extern u8 raid6_gfmul[256][256];
+extern u8 raid6_gfexp[256];	/* g^x */
+extern u8 raid6_gfinv[256];	/* x^-1 */
+extern u8 raid6_gfexi[256];	/* (g^x + 1)^-1 */
+extern void *raid6_empty_zero_page;
+
+extern int raid6_init_tables(void);
+extern void raid6_free_tables(void);
+
+/* raid6recov.c: rebuild data blocks faila < failb, or D_faila and P */
+extern void raid6_2data_recov(int disks, size_t bytes, int faila, int failb,
+			      void **ptrs);
+extern void raid6_datap_recov(int disks, size_t bytes, int faila, void **ptrs);
+extern int raid6_recov_selftest(void);
+
+#endif
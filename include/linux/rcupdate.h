@@ -0,0 +1,130 @@
+#ifndef __LINUX_RCUPDATE_H
+#define __LINUX_RCUPDATE_H
+
+/*
+ * Read-copy update.
+ *
+ * Readers walk a structure without taking any lock.  A writer unlinks
+ * an element and hands it to call_rcu(), which calls back once every
+ * CPU has gone through a quiescent state - a context switch, user
+ * mode, or the idle loop - since the call.  No reader can still be
+ * looking at the element then, as readers never sleep and the kernel
+ * is not preempted.
+ */
+
+#ifdef __KERNEL__
+
+#include <linux/list.h>
+#include <linux/cache.h>
+#include <linux/threads.h>
+#include <asm/system.h>
+
+struct rcu_head {
+	struct list_head list;
+	void (*func)(void *obj);
+	void *arg;
+};
+
+#define RCU_HEAD_INIT(head)	{ list: LIST_HEAD_INIT(head.list), func: NULL, arg: NULL }
+#define RCU_HEAD(head)		struct rcu_head head = RCU_HEAD_INIT(head)
+#define INIT_RCU_HEAD(ptr)	do { \
+	INIT_LIST_HEAD(&(ptr)->list); (ptr)->func = NULL; (ptr)->arg = NULL; \
+} while (0)
+
+/* Per-CPU state; batches are numbered, see kernel/rcupdate.c */
+struct rcu_data {
+	long qsctr;		/* quiescent states seen */
+	long last_qsctr;	/* qsctr when the current batch started */
+	long batch;		/* batch curlist is waiting for */
+	struct list_head nxtlist;	/* not yet in a batch */
+	struct list_head curlist;	/* waiting for batch to complete */
+} ____cacheline_aligned_in_smp;
+
+extern struct rcu_data rcu_data[NR_CPUS];
+
+/* A context switch is a quiescent state; called from schedule() */
+static inline void rcu_qsctr_inc(int cpu)
+{
+	rcu_data[cpu].qsctr++;
+}
+
+/*
+ * Mark a read-side critical section.  A reader may not sleep inside
+ * one; with no kernel preemption that is all it takes, so the plain
+ * pair compiles to nothing.  The _bh pair is for readers that also
+ * need bottom halves off for their own sake.
+ */
+#define rcu_read_lock()		do { } while (0)
+#define rcu_read_unlock()	do { } while (0)
+#define rcu_read_lock_bh()	local_bh_disable()
+#define rcu_read_unlock_bh()	local_bh_enable()
+
+/*
+ * A reader that has loaded a pointer may use what it points to
+ * without a barrier on everything but alpha, which can see a stale
+ * copy of the pointed-to data.
+ */
+#ifndef smp_read_barrier_depends
+#define smp_read_barrier_depends()	do { } while (0)
+#endif
+
+/*
+ * List updates that a lockless reader may be walking at the same
+ * time.  Writers still serialise among themselves; the element is
+ * initialised before it becomes reachable, and a deleted element
+ * keeps its forward pointer so a reader standing on it can carry on.
+ * It must not be reused or freed until after a grace period.
+ */
+static inline void list_add_rcu(struct list_head *new, struct list_head *head)
+{
+	struct list_head *next = head->next;
+
+	new->next = next;
+	new->prev = head;
+	smp_wmb();
+	next->prev = new;
+	head->next = new;
+}
+
+static inline void list_del_rcu(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	entry->prev = NULL;
+}
+
+#define list_for_each_rcu(pos, head) \
+	for (pos = (head)->next; \
+	     ({ smp_read_barrier_depends(); pos != (head); }); \
+	     pos = pos->next)
+
+static inline void hlist_add_head_rcu(struct hlist_node *n, struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	n->pprev = &h->first;
+	smp_wmb();
+	if (first)
+		first->pprev = &n->next;
+	h->first = n;
+}
+
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+	__hlist_del(n);
+	n->pprev = NULL;
+}
+
+#define hlist_for_each_rcu(pos, head) \
+	for (pos = (head)->first; \
+	     ({ smp_read_barrier_depends(); pos != NULL; }); \
+	     pos = pos->next)
+
+extern void call_rcu(struct rcu_head *head, void (*func)(void *arg), void *arg);
+extern void synchronize_kernel(void);
+extern void rcu_check_callbacks(int cpu, int user);
+extern void rcu_init(void);
+
+#endif /* __KERNEL__ */
+
+#endif /* __LINUX_RCUPDATE_H */
@@ -166,6 +166,7 @@ extern void set_cpus_allowed(struct task_struct *p, unsigned long new_mask);
 #define NR_OPEN_DEFAULT BITS_PER_LONG
 
 struct namespace;
+struct kioctx;
 /*
  * Open file table structure
  */
@@ -229,6 +230,10 @@ struct mm_struct {
 
 	unsigned dumpable:1;
 
+	/* AIO contexts, see fs/aio.c */
+	rwlock_t ioctx_list_lock;
+	struct kioctx *ioctx_list;
+
 	/* Architecture-specific MM context */
 	mm_context_t context;
 };
@@ -244,6 +249,7 @@ extern int mmlist_nr;
 	mmap_sem:	__RWSEM_INITIALIZER(name.mmap_sem), \
 	page_table_lock: SPIN_LOCK_UNLOCKED, 		\
 	mmlist:		LIST_HEAD_INIT(name.mmlist),	\
+	ioctx_list_lock: RW_LOCK_UNLOCKED,		\
 }
 
 struct signal_struct {
@@ -367,6 +373,8 @@ struct task_struct {
 /* mm fault and swap info: this can arguably be seen as either mm-specific or thread-specific */
 	unsigned long min_flt, maj_flt, nswap, cmin_flt, cmaj_flt, cnswap;
 	int swappable:1;
+/* recent buffer dirtying, decays every second; see balance_dirty() */
+	unsigned long nr_dirtied, dirtied_stamp;
 /* process credentials */
 	uid_t uid,euid,suid,fsuid;
 	gid_t gid,egid,sgid,fsgid;
@@ -433,6 +441,7 @@ struct task_struct {
 #define PF_FREE_PAGES	0x00002000	/* per process page freeing */
 #define PF_NOIO		0x00004000	/* avoid generating further I/O */
 #define PF_FSTRANS	0x00008000	/* inside a filesystem transaction */
+#define PF_NOFAULT	0x00010000	/* user faults go to the fixup, no sleeping */
 
 #define PF_USEDFPU	0x00100000	/* task used FPU this quantum (SMP) */
 
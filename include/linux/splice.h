@@ -0,0 +1,13 @@
+#ifndef _LINUX_SPLICE_H
+#define _LINUX_SPLICE_H
+
+/*
+ * splice() moves data between a pipe and a file, tee() copies it from
+ * one pipe to another, both without a trip through user space.
+ */
+
+#define SPLICE_F_MOVE		0x01	/* move pages instead of copying (hint) */
+#define SPLICE_F_NONBLOCK	0x02	/* don't block on the pipe */
+#define SPLICE_F_MORE		0x04	/* more data will follow */
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _LINUX_VMSTAT_H
+#define _LINUX_VMSTAT_H
+
+#include <linux/config.h>
+#include <linux/threads.h>
+#include <linux/smp.h>
+#include <linux/cache.h>
+
+/*
+ * VM event counters, shown in /proc/vmstat.
+ *
+ * Each CPU bumps its own copy without any locking and the copies are
+ * only added up when somebody reads the file, so counting costs an
+ * increment of a cacheline the CPU already owns.  An update from an
+ * interrupt racing with one from process context on the same CPU may
+ * get lost on some architectures; that is fine for statistics.
+ *
+ * Keep vmstat_text[] in fs/proc/proc_misc.c in the same order.
+ */
+enum vm_event_item {
+	PGALLOC_DMA,		/* in the order of ZONE_* */
+	PGALLOC_NORMAL,
+	PGALLOC_HIGH,
+	PGFREE,
+	PGFAULT,
+	PGMAJFAULT,
+	PGACTIVATE,
+	PGDEACTIVATE,
+	PGREFILL,		/* active pages looked at */
+	PGSCAN,			/* inactive pages looked at */
+	PGSTEAL,		/* inactive pages freed */
+	SLABS_RECLAIMED,	/* pages given back by kmem_cache_reap() */
+	KSWAPD_WAKEUP,
+	PAGEOUTRUN,		/* kswapd passes over all the zones */
+	ALLOCSTALL,		/* allocations that had to free pages themselves */
+	NR_VM_EVENT_ITEMS
+};
+
+struct vm_event_state {
+	unsigned long event[NR_VM_EVENT_ITEMS];
+} ____cacheline_aligned;
+
+extern struct vm_event_state vm_event_states[NR_CPUS];
+
+static inline void count_vm_event(enum vm_event_item item)
+{
+	vm_event_states[smp_processor_id()].event[item]++;
+}
+
+static inline void count_vm_events(enum vm_event_item item, unsigned long delta)
+{
+	vm_event_states[smp_processor_id()].event[item] += delta;
+}
+
+extern void all_vm_events(unsigned long *ret);
+
+#endif /* _LINUX_VMSTAT_H */
@@ -9,6 +9,7 @@
 #define _NET_DST_H
 
 #include <linux/config.h>
+#include <linux/rcupdate.h>
 #include <net/neighbour.h>
 
 /*
@@ -61,6 +62,8 @@ struct dst_entry
 	__u32			tclassid;
 #endif
 
+	struct rcu_head		rcu_head;	/* deferred free, if hashed */
+
 	struct  dst_ops	        *ops;
 		
 	char			info[0];
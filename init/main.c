@@ -28,6 +28,7 @@
 #include <linux/bootmem.h>
 #include <linux/file.h>
 #include <linux/tty.h>
+#include <linux/rcupdate.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -367,6 +368,7 @@ asmlinkage void __init start_kernel(void)
 	init_IRQ();
 	sched_init();
 	softirq_init();
+	rcu_init();
 	time_init();
 
 	/*
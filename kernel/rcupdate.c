@@ -0,0 +1,243 @@
+/*
+ *  linux/kernel/rcupdate.c
+ *
+ *  Read-copy update: deferring frees until no reader can be using
+ *  the object any more.
+ *
+ *  Callbacks are grouped in numbered batches.  A CPU queues new
+ *  callbacks on nxtlist; when its curlist is free it moves them there
+ *  and asks for the next batch number.  A batch starts by marking
+ *  every online CPU in rcu_cpu_mask, and each CPU clears its bit once
+ *  it has been through a quiescent state since the batch started.
+ *  When the mask is clear, the batch is complete, the callbacks that
+ *  wait for it can run, and the next batch starts if one was asked
+ *  for.
+ *
+ *  Quiescent states are counted by schedule(), and by the timer tick
+ *  when it interrupts user mode or the idle loop; the tick also runs
+ *  the per-CPU tasklet that does the rest.
+ */
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/interrupt.h>
+#include <linux/smp.h>
+#include <linux/module.h>
+#include <linux/completion.h>
+#include <linux/rcupdate.h>
+#include <asm/bitops.h>
+
+/* Batch numbers wrap; compare them like jiffies */
+#define rcu_batch_before(a, b)	((long) (a) - (long) (b) < 0)
+#define rcu_batch_after(a, b)	((long) (a) - (long) (b) > 0)
+
+#define RCU_QSCTR_INVALID	0
+
+static struct rcu_ctrlblk {
+	spinlock_t mutex;
+	long curbatch;		/* the batch in progress */
+	long maxbatch;		/* the highest batch asked for */
+	unsigned long rcu_cpu_mask;	/* CPUs yet to pass through a QS */
+} rcu_ctrlblk __cacheline_aligned = {
+	mutex:		SPIN_LOCK_UNLOCKED,
+	curbatch:	1,
+	maxbatch:	1,
+	rcu_cpu_mask:	0,
+};
+
+struct rcu_data rcu_data[NR_CPUS] __cacheline_aligned;
+
+static struct tasklet_struct rcu_tasklet[NR_CPUS];
+
+#define RCU_qsctr(cpu)		(rcu_data[(cpu)].qsctr)
+#define RCU_last_qsctr(cpu)	(rcu_data[(cpu)].last_qsctr)
+#define RCU_batch(cpu)		(rcu_data[(cpu)].batch)
+#define RCU_nxtlist(cpu)	(rcu_data[(cpu)].nxtlist)
+#define RCU_curlist(cpu)	(rcu_data[(cpu)].curlist)
+
+/**
+ * call_rcu - queue a callback for after the current grace period
+ * @head: structure to be used for queueing the callback
+ * @func: the callback
+ * @arg: its argument
+ *
+ * @func(@arg) is called, from a tasklet, once every CPU has been
+ * through a quiescent state.  May be called from interrupts.
+ */
+void call_rcu(struct rcu_head *head, void (*func)(void *arg), void *arg)
+{
+	unsigned long flags;
+	int cpu;
+
+	head->func = func;
+	head->arg = arg;
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	list_add_tail(&head->list, &RCU_nxtlist(cpu));
+	local_irq_restore(flags);
+}
+
+/* Call the callbacks of a completed batch */
+static void rcu_do_batch(struct list_head *list)
+{
+	struct list_head *entry;
+	struct rcu_head *head;
+
+	while (!list_empty(list)) {
+		entry = list->next;
+		list_del(entry);
+		head = list_entry(entry, struct rcu_head, list);
+		head->func(head->arg);
+	}
+}
+
+/*
+ * Ask for batch newbatch, and start it if no batch is in progress.
+ * Called with rcu_ctrlblk.mutex held.
+ */
+static void rcu_start_batch(long newbatch)
+{
+	if (rcu_batch_before(rcu_ctrlblk.maxbatch, newbatch))
+		rcu_ctrlblk.maxbatch = newbatch;
+	if (rcu_batch_before(rcu_ctrlblk.maxbatch, rcu_ctrlblk.curbatch) ||
+	    rcu_ctrlblk.rcu_cpu_mask)
+		return;
+	rcu_ctrlblk.rcu_cpu_mask = cpu_online_map;
+}
+
+/*
+ * Clear this CPU's bit in the mask if it has been through a quiescent
+ * state since the batch started, and complete the batch if it was the
+ * last one.
+ */
+static void rcu_check_quiescent_state(void)
+{
+	int cpu = smp_processor_id();
+
+	if (!test_bit(cpu, &rcu_ctrlblk.rcu_cpu_mask))
+		return;
+
+	/*
+	 * First time round for this batch: note where the counter is,
+	 * it has to move before this CPU is done.
+	 */
+	if (RCU_last_qsctr(cpu) == RCU_QSCTR_INVALID) {
+		RCU_last_qsctr(cpu) = RCU_qsctr(cpu);
+		return;
+	}
+	if (RCU_qsctr(cpu) == RCU_last_qsctr(cpu))
+		return;
+
+	spin_lock(&rcu_ctrlblk.mutex);
+	if (!test_bit(cpu, &rcu_ctrlblk.rcu_cpu_mask))
+		goto out_unlock;
+
+	clear_bit(cpu, &rcu_ctrlblk.rcu_cpu_mask);
+	RCU_last_qsctr(cpu) = RCU_QSCTR_INVALID;
+	if (rcu_ctrlblk.rcu_cpu_mask)
+		goto out_unlock;
+
+	rcu_ctrlblk.curbatch++;
+	rcu_start_batch(rcu_ctrlblk.maxbatch);
+
+out_unlock:
+	spin_unlock(&rcu_ctrlblk.mutex);
+}
+
+static void rcu_process_callbacks(unsigned long unused)
+{
+	int cpu = smp_processor_id();
+	LIST_HEAD(list);
+
+	if (!list_empty(&RCU_curlist(cpu)) &&
+	    rcu_batch_after(rcu_ctrlblk.curbatch, RCU_batch(cpu))) {
+		list_splice(&RCU_curlist(cpu), &list);
+		INIT_LIST_HEAD(&RCU_curlist(cpu));
+	}
+
+	local_irq_disable();
+	if (!list_empty(&RCU_nxtlist(cpu)) && list_empty(&RCU_curlist(cpu))) {
+		list_splice(&RCU_nxtlist(cpu), &RCU_curlist(cpu));
+		INIT_LIST_HEAD(&RCU_nxtlist(cpu));
+		local_irq_enable();
+
+		/* These wait for the batch after the current one */
+		spin_lock(&rcu_ctrlblk.mutex);
+		RCU_batch(cpu) = rcu_ctrlblk.curbatch + 1;
+		rcu_start_batch(RCU_batch(cpu));
+		spin_unlock(&rcu_ctrlblk.mutex);
+	} else
+		local_irq_enable();
+
+	rcu_check_quiescent_state();
+	if (!list_empty(&list))
+		rcu_do_batch(&list);
+}
+
+static inline int rcu_pending(int cpu)
+{
+	if ((!list_empty(&RCU_curlist(cpu)) &&
+	     rcu_batch_after(rcu_ctrlblk.curbatch, RCU_batch(cpu))) ||
+	    (list_empty(&RCU_curlist(cpu)) &&
+	     !list_empty(&RCU_nxtlist(cpu))) ||
+	    test_bit(cpu, &rcu_ctrlblk.rcu_cpu_mask))
+		return 1;
+	return 0;
+}
+
+/*
+ * Called from the timer tick.  Interrupting user mode, or the idle
+ * loop with nothing else in progress, counts as a quiescent state.
+ */
+void rcu_check_callbacks(int cpu, int user)
+{
+	if (user || (current->pid == 0 && local_irq_count(cpu) <= 1 &&
+		     !local_bh_count(cpu)))
+		RCU_qsctr(cpu)++;
+	if (rcu_pending(cpu))
+		tasklet_schedule(&rcu_tasklet[cpu]);
+}
+
+struct rcu_synchronize {
+	struct rcu_head head;
+	struct completion completion;
+};
+
+static void wakeme_after_rcu(void *arg)
+{
+	struct rcu_synchronize *rcu = arg;
+
+	complete(&rcu->completion);
+}
+
+/**
+ * synchronize_kernel - wait for a grace period
+ *
+ * Returns once every reader that was running when it was called has
+ * finished.  For writers that would rather sleep than queue a
+ * callback, e.g. before freeing something unlinked from a list.
+ */
+void synchronize_kernel(void)
+{
+	struct rcu_synchronize rcu;
+
+	init_completion(&rcu.completion);
+	call_rcu(&rcu.head, wakeme_after_rcu, &rcu);
+	wait_for_completion(&rcu.completion);
+}
+
+void __init rcu_init(void)
+{
+	int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		INIT_LIST_HEAD(&RCU_nxtlist(i));
+		INIT_LIST_HEAD(&RCU_curlist(i));
+		tasklet_init(&rcu_tasklet[i], rcu_process_callbacks, 0UL);
+	}
+}
+
+EXPORT_SYMBOL(call_rcu);
+EXPORT_SYMBOL(synchronize_kernel);
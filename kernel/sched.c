@@ -29,6 +29,7 @@
 #include <linux/completion.h>
 #include <linux/prefetch.h>
 #include <linux/compiler.h>
+#include <linux/rcupdate.h>
 
 #include <asm/uaccess.h>
 #include <asm/mmu_context.h>
@@ -565,6 +566,7 @@ need_resched_back:
 	}
 
 	release_kernel_lock(prev, this_cpu);
+	rcu_qsctr_inc(this_cpu);
 
 	/*
 	 * 'sched_data' is protected by the fact that we can run
@@ -725,6 +727,12 @@ static inline void __wake_up_common (wait_queue_head_t *q, unsigned int mode,
                 wait_queue_t *curr = list_entry(tmp, wait_queue_t, task_list);
 
 		CHECK_MAGIC(curr->__magic);
+		if (curr->func) {
+			if (curr->func(curr, mode, sync) &&
+			    (curr->flags&WQ_FLAG_EXCLUSIVE) && !--nr_exclusive)
+				break;
+			continue;
+		}
 		p = curr->task;
 		state = p->state;
 		if (state & mode) {
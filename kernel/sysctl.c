@@ -31,6 +31,7 @@
 #include <linux/sysrq.h>
 #include <linux/highuid.h>
 #include <linux/swap.h>
+#include <linux/aio.h>
 
 #include <asm/uaccess.h>
 
@@ -44,6 +45,8 @@
 extern int panic_timeout;
 extern int C_A_D;
 extern int bdf_prm[], bdflush_min[], bdflush_max[];
+extern int bdflush_proc_dointvec(ctl_table *, int, struct file *,
+				 void *, size_t *);
 extern int sysctl_overcommit_memory;
 extern int max_threads;
 extern atomic_t nr_queued_signals;
@@ -60,6 +63,10 @@ extern int block_dump;
 static int maxolduid = 65535;
 static int minolduid;
 
+/* vm_fault_around is a window in pages; 0 or 1 turns it off */
+static int min_fault_around;
+static int max_fault_around = 1024;
+
 #ifdef CONFIG_KMOD
 extern char modprobe_path[];
 #endif
@@ -292,7 +299,7 @@ static ctl_table vm_table[] = {
 	{VM_PASSES, "vm_passes", 
 	 &vm_passes, sizeof(int), 0644, NULL, &proc_dointvec},
 	{VM_BDFLUSH, "bdflush", &bdf_prm, 9*sizeof(int), 0644, NULL,
-	 &proc_dointvec_minmax, &sysctl_intvec, NULL,
+	 &bdflush_proc_dointvec, &sysctl_intvec, NULL,
 	 &bdflush_min, &bdflush_max},
 	{VM_OVERCOMMIT_MEMORY, "overcommit_memory", &sysctl_overcommit_memory,
 	 sizeof(sysctl_overcommit_memory), 0644, NULL, &proc_dointvec},
@@ -306,6 +313,10 @@ static ctl_table vm_table[] = {
 	&vm_min_readahead,sizeof(int), 0644, NULL, &proc_dointvec},
 	{VM_MAX_READAHEAD, "max-readahead",
 	&vm_max_readahead,sizeof(int), 0644, NULL, &proc_dointvec},
+	{VM_FAULT_AROUND, "fault-around",
+	 &vm_fault_around, sizeof(int), 0644, NULL,
+	 &proc_dointvec_minmax, &sysctl_intvec, NULL,
+	 &min_fault_around, &max_fault_around},
 	{VM_MAX_MAP_COUNT, "max_map_count",
 	 &max_map_count, sizeof(int), 0644, NULL, &proc_dointvec},
 	{VM_LAPTOP_MODE, "laptop_mode",
@@ -342,6 +353,9 @@ static ctl_table fs_table[] = {
 	 sizeof(int), 0644, NULL, &proc_dointvec},
 	{FS_LEASE_TIME, "lease-break-time", &lease_break_time, sizeof(int),
 	 0644, NULL, &proc_dointvec},
+	{FS_AIO_NR, "aio-nr", &aio_nr, sizeof(int), 0444, NULL, &proc_dointvec},
+	{FS_AIO_MAX_NR, "aio-max-nr", &aio_max_nr, sizeof(int), 0644, NULL,
+	 &proc_dointvec},
 	{0}
 };
 
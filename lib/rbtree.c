@@ -294,3 +294,37 @@ void rb_erase(rb_node_t * node, rb_root_t * root)
 		__rb_erase_color(child, parent, root);
 }
 EXPORT_SYMBOL(rb_erase);
+
+/*
+ * In-order iteration: the first node of the tree, and the node
+ * following a given one (NULL at the end).
+ */
+rb_node_t * rb_first(rb_root_t * root)
+{
+	rb_node_t * n = root->rb_node;
+
+	if (!n)
+		return NULL;
+	while (n->rb_left)
+		n = n->rb_left;
+	return n;
+}
+EXPORT_SYMBOL(rb_first);
+
+rb_node_t * rb_next(rb_node_t * node)
+{
+	/* The leftmost node of the right subtree, if there is one */
+	if (node->rb_right)
+	{
+		node = node->rb_right;
+		while (node->rb_left)
+			node = node->rb_left;
+		return node;
+	}
+
+	/* Else the first ancestor we reach from its left subtree */
+	while (node->rb_parent && node == node->rb_parent->rb_right)
+		node = node->rb_parent;
+	return node->rb_parent;
+}
+EXPORT_SYMBOL(rb_next);
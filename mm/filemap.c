@@ -23,6 +23,8 @@
 #include <linux/init.h>
 #include <linux/mm.h>
 #include <linux/iobuf.h>
+#include <linux/vmstat.h>
+#include <linux/aio.h>
 
 #include <asm/pgalloc.h>
 #include <asm/uaccess.h>
@@ -64,6 +66,15 @@ spinlock_cacheline_t pagecache_lock_cacheline  = {SPIN_LOCK_UNLOCKED};
  */
 spinlock_cacheline_t pagemap_lru_lock_cacheline = {SPIN_LOCK_UNLOCKED};
 
+/*
+ * Architectures with cache bypassing user copies use them for the
+ * pages of a large read() or write(), see file_read_actor().
+ */
+#ifndef __copy_to_user_nocache
+#define __copy_to_user_nocache(to,from,n,total)	__copy_to_user(to,from,n)
+#define __copy_from_user_nocache(to,from,n,total) __copy_from_user(to,from,n)
+#endif
+
 #define CLUSTER_PAGES		(1 << page_cluster)
 #define CLUSTER_OFFSET(x)	(((x) >> page_cluster) << page_cluster)
 
@@ -1733,8 +1744,12 @@ int file_read_actor(read_descriptor_t * desc, struct page *page, unsigned long o
 	if (size > count)
 		size = count;
 
+	/*
+	 * A read bigger than the cache would only push everything else
+	 * out of it, so let the architecture stream it if it can.
+	 */
 	kaddr = kmap(page);
-	left = __copy_to_user(desc->buf, kaddr + offset, size);
+	left = __copy_to_user_nocache(desc->buf, kaddr + offset, size, count);
 	kunmap(page);
 	
 	if (left) {
@@ -2115,6 +2130,8 @@ success:
 	return page;
 
 no_cached_page:
+	count_vm_event(PGMAJFAULT);
+
 	/*
 	 * If the requested offset is within our file, try to read a whole 
 	 * cluster of pages at once.
@@ -2307,8 +2324,154 @@ int filemap_sync(struct vm_area_struct * vma, unsigned long address,
 	return error;
 }
 
+/*
+ * Map the page cache pages backing one page table's worth of a file
+ * mapping.  Only empty ptes are filled, read-only, so a later write
+ * fault still does the usual C-O-W or dirtying work.  With "nonblock"
+ * set we only take pages that are already up-to-date; otherwise we
+ * wait for pages that are still being read in.
+ *
+ * Called with mm->page_table_lock held.  It is dropped while waiting
+ * on a page; the page table itself can't go away under us because
+ * the caller holds the mmap semaphore.
+ */
+static void filemap_populate_pte_range(pmd_t * pmd, unsigned long address,
+	unsigned long size, struct vm_area_struct *vma, unsigned long offset,
+	int nonblock)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct address_space *mapping = vma->vm_file->f_dentry->d_inode->i_mapping;
+	unsigned long pgoff, filesize, end;
+	pte_t * pte;
+
+	pte = pte_alloc(mm, pmd, offset + address);
+	if (!pte)
+		return;
+	offset += address & PMD_MASK;
+	address &= ~PMD_MASK;
+	end = address + size;
+	if (end > PMD_SIZE)
+		end = PMD_SIZE;
+	pgoff = ((address + offset - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	filesize = (mapping->host->i_size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+
+	do {
+		struct page *page;
+		pte_t entry;
+
+		if (pgoff >= filesize)
+			break;
+		if (!pte_none(*pte))
+			goto next;
+		page = __find_get_page(mapping, pgoff, page_hash(mapping, pgoff));
+		if (!page)
+			goto next;
+		if (!Page_Uptodate(page) && !nonblock) {
+			spin_unlock(&mm->page_table_lock);
+			wait_on_page(page);
+			spin_lock(&mm->page_table_lock);
+		}
+		/*
+		 * Hold the page lock while we set up the pte, so that we
+		 * can't race with truncate removing it from the mapping.
+		 */
+		if (TryLockPage(page))
+			goto release;
+		if (!page->mapping || !Page_Uptodate(page) || !pte_none(*pte)) {
+			UnlockPage(page);
+			goto release;
+		}
+		++mm->rss;
+		flush_page_to_ram(page);
+		flush_icache_page(vma, page);
+		entry = mk_pte(page, vma->vm_page_prot);
+		set_pte(pte, entry);
+		update_mmu_cache(vma, address + offset, entry);
+		UnlockPage(page);
+		goto next;
+release:
+		page_cache_release(page);
+next:
+		address += PAGE_SIZE;
+		pgoff++;
+		pte++;
+	} while (address && (address < end));
+}
+
+static inline void filemap_populate_pmd_range(pgd_t * pgd,
+	unsigned long address, unsigned long size,
+	struct vm_area_struct *vma, int nonblock)
+{
+	pmd_t * pmd;
+	unsigned long offset, end;
+
+	pmd = pmd_alloc(vma->vm_mm, pgd, address);
+	if (!pmd)
+		return;
+	offset = address & PGDIR_MASK;
+	address &= ~PGDIR_MASK;
+	end = address + size;
+	if (end > PGDIR_SIZE)
+		end = PGDIR_SIZE;
+	do {
+		filemap_populate_pte_range(pmd, address, end - address, vma, offset, nonblock);
+		address = (address + PMD_SIZE) & PMD_MASK;
+		pmd++;
+	} while (address && (address < end));
+}
+
+/*
+ * Populate the page tables of [address, address+size) in one go,
+ * rather than taking a minor fault for every page.  Unless "nonblock"
+ * is set, I/O is first started for everything not yet in the page
+ * cache and we wait for it; with "nonblock" only pages that are
+ * already cached and up-to-date get mapped.
+ *
+ * Used for fault-around, MAP_POPULATE and MADV_WILLNEED.  The caller
+ * holds the mmap semaphore.
+ */
+int filemap_populate(struct vm_area_struct * vma, unsigned long address,
+	unsigned long size, int nonblock)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long end = address + size;
+	pgd_t * dir;
+
+	if (address >= end)
+		BUG();
+
+	if (!nonblock) {
+		struct file *file = vma->vm_file;
+		struct inode *inode = file->f_dentry->d_inode;
+		unsigned long pgoff, endoff, filesize;
+
+		filesize = (inode->i_size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+		pgoff = ((address - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+		endoff = ((end - vma->vm_start + PAGE_SIZE - 1) >> PAGE_SHIFT) + vma->vm_pgoff;
+		pgoff = CLUSTER_OFFSET(pgoff);
+		while ((pgoff < endoff) && (pgoff < filesize)) {
+			if (read_cluster_nonblocking(file, pgoff, filesize) < 0)
+				break;
+			pgoff += CLUSTER_PAGES;
+		}
+		run_task_queue(&tq_disk);
+	}
+
+	spin_lock(&mm->page_table_lock);
+	dir = pgd_offset(mm, address);
+	do {
+		filemap_populate_pmd_range(dir, address, end - address, vma, nonblock);
+		address = (address + PGDIR_SIZE) & PGDIR_MASK;
+		dir++;
+	} while (address && (address < end));
+	spin_unlock(&mm->page_table_lock);
+
+	return 0;
+}
+
 static struct vm_operations_struct generic_file_vm_ops = {
 	nopage:		filemap_nopage,
+	populate:	filemap_populate,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -2580,7 +2743,9 @@ static long madvise_behavior(struct vm_area_struct * vma,
 
 /*
  * Schedule all required I/O operations, then run the disk queue
- * to make sure they are started.  Do not wait for completion.
+ * to make sure they are started.  Do not wait for completion, but
+ * map whatever is already up-to-date in one go so that touching it
+ * later doesn't cost a fault per page.
  */
 static long madvise_willneed(struct vm_area_struct * vma,
 	unsigned long start, unsigned long end)
@@ -2589,6 +2754,7 @@ static long madvise_willneed(struct vm_area_struct * vma,
 	struct file * file;
 	struct inode * inode;
 	unsigned long size, rlim_rss;
+	unsigned long vstart = start, vend;
 
 	/* Doesn't work if there's no mapped file. */
 	if (!vma->vm_file)
@@ -2602,6 +2768,7 @@ static long madvise_willneed(struct vm_area_struct * vma,
 	start = ((start - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 	if (end > vma->vm_end)
 		end = vma->vm_end;
+	vend = end;
 	end = ((end - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
 	/* Make sure this doesn't exceed the process's max rss. */
@@ -2634,6 +2801,9 @@ static long madvise_willneed(struct vm_area_struct * vma,
 	/* Don't wait for someone else to push these requests. */
 	run_task_queue(&tq_disk);
 
+	if (error >= 0 && vma->vm_ops && vma->vm_ops->populate)
+		vma->vm_ops->populate(vma, vstart, vend - vstart, 1);
+
 	return error;
 }
 
@@ -3230,7 +3400,7 @@ do_generic_file_write(struct file *file,const char *buf,size_t count, loff_t *pp
 		status = mapping->a_ops->prepare_write(file, page, offset, offset+bytes);
 		if (status)
 			goto sync_failure;
-		page_fault = __copy_from_user(kaddr+offset, buf, bytes);
+		page_fault = __copy_from_user_nocache(kaddr+offset, buf, bytes, count);
 		flush_dcache_page(page);
 		status = mapping->a_ops->commit_write(file, page, offset, offset+bytes);
 		if (page_fault)
@@ -3382,6 +3552,109 @@ generic_file_write(struct file *file,const char *buf,size_t count, loff_t *ppos)
 	return err;
 }
 
+static void generic_aio_direct_done(struct kiocb *iocb)
+{
+	struct inode *inode = iocb->ki_filp->f_dentry->d_inode->i_mapping->host;
+
+	if (iocb->ki_rw == WRITE)
+		invalidate_inode_pages2(inode->i_mapping);
+	up_read(&inode->i_alloc_sem);
+}
+
+/*
+ * Start an O_DIRECT transfer of at most one kiobuf for io_submit().
+ * i_sem is only held while the blocks are looked up, i_alloc_sem until
+ * the I/O has completed.  Writes that would extend the file have to
+ * update i_size when they are done, so they go through the synchronous
+ * path like everything else that returns -ENOTBLK.
+ */
+static ssize_t generic_file_direct_aio(int rw, struct kiocb *iocb, char *buf,
+				       size_t count, loff_t pos)
+{
+	struct file *filp = iocb->ki_filp;
+	struct address_space *mapping = filp->f_dentry->d_inode->i_mapping;
+	struct inode *inode = mapping->host;
+	int blocksize_mask = (1 << inode->i_blkbits) - 1;
+	ssize_t retval;
+
+	if (!(filp->f_flags & O_DIRECT) || count > (KIO_MAX_ATOMIC_IO << 10))
+		return -ENOTBLK;
+
+	down_read(&inode->i_alloc_sem);
+	down(&inode->i_sem);
+
+	retval = -EINVAL;
+	if ((pos & blocksize_mask) || (count & blocksize_mask) ||
+	    ((unsigned long) buf & blocksize_mask))
+		goto out;
+	retval = -ENOTBLK;
+	if (!have_mapping_directIO(mapping))
+		goto out;
+
+	if (rw == WRITE) {
+		retval = precheck_file_write(filp, inode, &count, &pos);
+		if (retval || !count)
+			goto out;
+		retval = -ENOTBLK;
+		if (pos + count > inode->i_size && !S_ISBLK(inode->i_mode))
+			goto out;
+		remove_suid(inode);
+		inode->i_ctime = inode->i_mtime = CURRENT_TIME;
+		mark_inode_dirty_sync(inode);
+	} else {
+		retval = 0;
+		if (pos >= inode->i_size || !count)
+			goto out;
+		if (pos + count > inode->i_size)
+			count = inode->i_size - pos;
+	}
+
+	retval = filemap_fdatasync(mapping);
+	if (retval == 0)
+		retval = fsync_inode_data_buffers(inode);
+	if (retval == 0)
+		retval = filemap_fdatawait(mapping);
+	if (retval < 0)
+		goto out;
+
+	retval = aio_kiobuf_map(iocb, rw, buf, count, generic_aio_direct_done);
+	if (retval)
+		goto out;
+	retval = do_call_directIO(rw, filp, iocb->ki_iobuf,
+				  pos >> inode->i_blkbits, blocksize_mask + 1);
+	if (retval == -ENOTBLK) {
+		aio_kiobuf_cancel(iocb);
+		goto out;
+	}
+	up(&inode->i_sem);
+	if (rw == READ)
+		UPDATE_ATIME(inode);
+
+	/* From here on generic_aio_direct_done() drops i_alloc_sem */
+	aio_kiobuf_submitted(iocb, retval);
+	return -EIOCBQUEUED;
+
+out:
+	up(&inode->i_sem);
+	up_read(&inode->i_alloc_sem);
+	return retval;
+}
+
+/*
+ * The aio_read and aio_write routines for filesystems using
+ * generic_file_read and generic_file_write.  Only O_DIRECT I/O is
+ * asynchronous; -ENOTBLK has io_submit() do the rest synchronously.
+ */
+ssize_t generic_file_aio_read(struct kiocb *iocb, char *buf, size_t count, loff_t pos)
+{
+	return generic_file_direct_aio(READ, iocb, buf, count, pos);
+}
+
+ssize_t generic_file_aio_write(struct kiocb *iocb, const char *buf, size_t count, loff_t pos)
+{
+	return generic_file_direct_aio(WRITE, iocb, (char *) buf, count, pos);
+}
+
 void __init page_cache_init(unsigned long mempages)
 {
 	unsigned long htable_size, order;
@@ -45,6 +45,7 @@
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
 #include <linux/module.h>
+#include <linux/vmstat.h>
 
 #include <asm/pgalloc.h>
 #include <asm/uaccess.h>
@@ -1142,6 +1143,7 @@ static int do_swap_page(struct mm_struct * mm,
 
 		/* Had to read the page from swap area: Major fault */
 		ret = 2;
+		count_vm_event(PGMAJFAULT);
 	}
 
 	mark_page_accessed(page);
@@ -1230,6 +1232,32 @@ no_mem:
 	return -1;
 }
 
+/*
+ * Map the already cached neighbours of a page we just faulted in on a
+ * read fault, so that walking through a cached file doesn't cost one
+ * minor fault per page.  The window is aligned, so that a sequential
+ * scan faults once per window rather than once per page.
+ */
+int vm_fault_around = 16;
+
+static void do_fault_around(struct vm_area_struct * vma, unsigned long address)
+{
+	unsigned long nr = vm_fault_around;
+	unsigned long start, end;
+
+	if (nr <= 1 || VM_RandomReadHint(vma))
+		return;
+
+	start = address - ((address >> PAGE_SHIFT) % nr) * PAGE_SIZE;
+	if (start < vma->vm_start)
+		start = vma->vm_start;
+	end = start + nr * PAGE_SIZE;
+	if (end > vma->vm_end || end < start)
+		end = vma->vm_end;
+
+	vma->vm_ops->populate(vma, start, end - start, 1);
+}
+
 /*
  * do_no_page() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -1305,6 +1333,9 @@ static int do_no_page(struct mm_struct * mm, struct vm_area_struct * vma,
 	/* no need to invalidate: a not-present page shouldn't be cached */
 	update_mmu_cache(vma, address, entry);
 	spin_unlock(&mm->page_table_lock);
+
+	if (!write_access && vma->vm_ops->populate)
+		do_fault_around(vma, address);
 	return 2;	/* Major fault */
 }
 
@@ -1369,6 +1400,7 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct * vma,
 	pmd_t *pmd;
 
 	current->state = TASK_RUNNING;
+	count_vm_event(PGFAULT);
 	pgd = pgd_offset(mm, address);
 
 	/*
@@ -1477,6 +1509,34 @@ int make_pages_present(unsigned long addr, unsigned long end)
 	return ret == len ? 0 : -1;
 }
 
+/*
+ * Set up the page tables for [addr, end) in batch, for MAP_POPULATE.
+ * Mappings without a populate operation fall back to faulting the
+ * pages in one at a time, unless the caller asked us not to block.
+ * The caller holds the mmap semaphore.
+ */
+int populate_range(unsigned long addr, unsigned long end, int nonblock)
+{
+	struct vm_area_struct * vma;
+	int error = 0;
+
+	vma = find_vma(current->mm, addr);
+	while (vma && vma->vm_start < end && !error) {
+		unsigned long start = addr, stop = end;
+
+		if (start < vma->vm_start)
+			start = vma->vm_start;
+		if (stop > vma->vm_end)
+			stop = vma->vm_end;
+		if (vma->vm_ops && vma->vm_ops->populate)
+			error = vma->vm_ops->populate(vma, start, stop - start, nonblock);
+		else if (!nonblock)
+			error = make_pages_present(start, stop);
+		vma = vma->vm_next;
+	}
+	return error;
+}
+
 struct page * vmalloc_to_page(void * vmalloc_addr)
 {
 	unsigned long addr = (unsigned long) vmalloc_addr;
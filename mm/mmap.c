@@ -590,7 +590,8 @@ out:
 	if (vm_flags & VM_LOCKED) {
 		mm->locked_vm += len >> PAGE_SHIFT;
 		make_pages_present(addr, addr + len);
-	}
+	} else if (flags & MAP_POPULATE)
+		populate_range(addr, addr + len, flags & MAP_NONBLOCK);
 	return addr;
 
 unmap_and_free_vma:
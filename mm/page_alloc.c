@@ -21,6 +21,7 @@
 #include <linux/bootmem.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/vmstat.h>
 
 int nr_swap_pages;
 int nr_active_pages;
@@ -29,6 +30,8 @@ LIST_HEAD(inactive_list);
 LIST_HEAD(active_list);
 pg_data_t *pgdat_list;
 
+struct vm_event_state vm_event_states[NR_CPUS];
+
 /*
  *
  * The zone_table array is used to look up the address of the
@@ -111,6 +114,7 @@ static void __free_pages_ok (struct page *page, unsigned int order)
 		BUG();
 	ClearPageReferenced(page);
 	ClearPageDirty(page);
+	count_vm_events(PGFREE, 1UL << order);
 
 	if (current->flags & PF_FREE_PAGES)
 		goto local_freelist;
@@ -235,6 +239,7 @@ static struct page * rmqueue(zone_t *zone, unsigned int order)
 				BUG();
 			if (PageActive(page))
 				BUG();
+			count_vm_events(PGALLOC_DMA + zone_idx(zone), 1UL << order);
 			return page;	
 		}
 		curr_order++;
@@ -262,6 +267,7 @@ static struct page * balance_classzone(zone_t * classzone, unsigned int gfp_mask
 	if (in_interrupt())
 		BUG();
 
+	count_vm_event(ALLOCSTALL);
 	current->allocation_order = order;
 	current->flags |= PF_MEMALLOC | PF_FREE_PAGES;
 
@@ -356,8 +362,10 @@ struct page * __alloc_pages(unsigned int gfp_mask, unsigned int order, zonelist_
 
 	classzone->need_balance = 1;
 	mb();
-	if (waitqueue_active(&kswapd_wait))
+	if (waitqueue_active(&kswapd_wait)) {
+		count_vm_event(KSWAPD_WAKEUP);
 		wake_up_interruptible(&kswapd_wait);
+	}
 
 	zone = zonelist->zones;
 	for (;;) {
@@ -494,6 +502,19 @@ unsigned int nr_free_pages (void)
 	return sum;
 }
 
+/*
+ * Add up the VM event counters of all CPUs, for /proc/vmstat.
+ */
+void all_vm_events(unsigned long *ret)
+{
+	int cpu, i;
+
+	memset(ret, 0, NR_VM_EVENT_ITEMS * sizeof(unsigned long));
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+		for (i = 0; i < NR_VM_EVENT_ITEMS; i++)
+			ret[i] += vm_event_states[cpu].event[i];
+}
+
 /*
  * Amount of free RAM allocatable as buffer memory:
  */
@@ -74,6 +74,7 @@
 #include	<linux/init.h>
 #include	<linux/compiler.h>
 #include	<linux/seq_file.h>
+#include	<linux/vmstat.h>
 #include	<asm/uaccess.h>
 
 /*
@@ -1855,6 +1856,7 @@ perfect:
 	}
 	spin_unlock_irq(&best_cachep->spinlock);
 	ret = scan * (1 << best_cachep->gfporder);
+	count_vm_events(SLABS_RECLAIMED, ret);
 out:
 	up(&cache_chain_sem);
 	return ret;
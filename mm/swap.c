@@ -19,6 +19,7 @@
 #include <linux/swapctl.h>
 #include <linux/pagemap.h>
 #include <linux/init.h>
+#include <linux/vmstat.h>
 
 #include <asm/dma.h>
 #include <asm/uaccess.h> /* for copy_to/from_user */
@@ -41,6 +42,7 @@ static inline void activate_page_nolock(struct page * page)
 	if (PageLRU(page) && !PageActive(page)) {
 		del_page_from_inactive_list(page);
 		add_page_to_active_list(page);
+		count_vm_event(PGACTIVATE);
 	}
 }
 
@@ -23,6 +23,7 @@
 #include <linux/init.h>
 #include <linux/highmem.h>
 #include <linux/file.h>
+#include <linux/vmstat.h>
 
 #include <asm/pgalloc.h>
 
@@ -402,6 +403,7 @@ static int shrink_cache(int nr_pages, zone_t * classzone, unsigned int gfp_mask,
 			continue;
 
 		max_scan--;
+		count_vm_event(PGSCAN);
 
 		/* Racy check to avoid trylocking when not worthwhile */
 		if (!page->buffers && (page_count(page) != 1 || !page->mapping))
@@ -473,6 +475,7 @@ static int shrink_cache(int nr_pages, zone_t * classzone, unsigned int gfp_mask,
 
 					/* effectively free the page here */
 					page_cache_release(page);
+					count_vm_event(PGSTEAL);
 
 					if (--nr_pages)
 						continue;
@@ -559,6 +562,7 @@ page_mapped:
 
 		/* effectively free the page here */
 		page_cache_release(page);
+		count_vm_event(PGSTEAL);
 
 		if (--nr_pages)
 			continue;
@@ -590,6 +594,7 @@ static void refill_inactive(int nr_pages, zone_t * classzone)
 
 		page = list_entry(entry, struct page, lru);
 		entry = entry->prev;
+		count_vm_event(PGREFILL);
 		if (PageTestandClearReferenced(page)) {
 			list_del(&page->lru);
 			list_add(&page->lru, &active_list);
@@ -601,6 +606,7 @@ static void refill_inactive(int nr_pages, zone_t * classzone)
 		del_page_from_active_list(page);
 		add_page_to_inactive_list(page);
 		SetPageReferenced(page);
+		count_vm_event(PGDEACTIVATE);
 	}
 
 	if (entry != &active_list) {
@@ -733,6 +739,7 @@ static void kswapd_balance(void)
 
 	do {
 		need_more_balance = 0;
+		count_vm_event(PAGEOUTRUN);
 
 		for_each_pgdat(pgdat)
 			need_more_balance |= kswapd_balance_pgdat(pgdat);